@@ -0,0 +1,276 @@
+#include "bench_fixture.h"
+
+#include <stdio.h>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavdevice/avdevice.h"
+#include "libavformat/avformat.h"
+#include "libavutil/opt.h"
+}
+
+#include "codec/ffmpeghelper.h"
+#include "spdlog/spdlog.h"
+
+// Codec of the video stream, or false if the file is no usable fixture.
+static bool ProbeFixture(const std::string& path, std::string* codec)
+{
+    AVFormatContext* fmt_ctx = nullptr;
+    if (avformat_open_input(&fmt_ctx, path.c_str(), nullptr, nullptr) < 0)
+        return false;
+    DEFER(avformat_close_input(&fmt_ctx);)
+
+    if (avformat_find_stream_info(fmt_ctx, nullptr) < 0)
+        return false;
+
+    int index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (index < 0)
+        return false;
+
+    *codec = avcodec_get_name(fmt_ctx->streams[index]->codecpar->codec_id);
+    return true;
+}
+
+static bool EncodeFrame(AVCodecContext* enc_ctx, AVFrame* frame, AVPacket* pkt,
+                        AVFormatContext* out_ctx, AVStream* out_stream)
+{
+    int ret = avcodec_send_frame(enc_ctx, frame);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    while (true) {
+        ret = avcodec_receive_packet(enc_ctx, pkt);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        } else if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        pkt->stream_index = out_stream->index;
+        av_packet_rescale_ts(pkt, enc_ctx->time_base, out_stream->time_base);
+        ret = av_interleaved_write_frame(out_ctx, pkt);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+    }
+}
+
+bool BenchFixture::Generate(const std::string& folder)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "fixture_%dx%d_%d_%d.mkv", width, height, rate, duration);
+    path = folder + "/" + name;
+
+    if (ProbeFixture(path, &codec)) {
+        SPDLOG_INFO("Reuse fixture {0}, codec: {1}.", path, codec);
+        return true;
+    }
+
+    avdevice_register_all();
+    const AVInputFormat* lavfi = av_find_input_format("lavfi");
+    if (!lavfi) {
+        SPDLOG_ERROR("FFmpeg is built without the lavfi device.");
+        return false;
+    }
+
+    char graph[256];
+    snprintf(graph, sizeof(graph),
+             "testsrc2=size=%dx%d:rate=%d:duration=%d,format=yuv420p[out0];"
+             "sine=frequency=440:sample_rate=48000:duration=%d[out1]",
+             width, height, rate, duration, duration);
+
+    AVFormatContext* in_ctx = nullptr;
+    AVFormatContext* out_ctx = nullptr;
+    AVCodecContext* dec_ctx = nullptr;
+    AVCodecContext* enc_ctx = nullptr;
+    AVPacket* pkt = av_packet_alloc();
+    AVPacket* enc_pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    DEFER(av_packet_free(&pkt); av_packet_free(&enc_pkt); av_frame_free(&frame);
+          avcodec_free_context(&dec_ctx); avcodec_free_context(&enc_ctx);
+          avformat_close_input(&in_ctx);)
+    if (!pkt || !enc_pkt || !frame) {
+        SPDLOG_ERROR("Failed to alloc packet or frame.");
+        return false;
+    }
+
+    int ret = avformat_open_input(&in_ctx, graph, const_cast<AVInputFormat*>(lavfi), nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    ret = avformat_find_stream_info(in_ctx, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    int video_index = av_find_best_stream(in_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    int audio_index = av_find_best_stream(in_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (video_index < 0 || audio_index < 0) {
+        SPDLOG_ERROR("Failed to find the lavfi streams.");
+        return false;
+    }
+    AVStream* in_video = in_ctx->streams[video_index];
+    AVStream* in_audio = in_ctx->streams[audio_index];
+
+    // Decoder of the raw lavfi frames
+    const AVCodec* decoder = avcodec_find_decoder(in_video->codecpar->codec_id);
+    dec_ctx = decoder ? avcodec_alloc_context3(decoder) : nullptr;
+    if (!dec_ctx) {
+        SPDLOG_ERROR("Failed to alloc decoder of the lavfi video.");
+        return false;
+    }
+    ret = avcodec_parameters_to_context(dec_ctx, in_video->codecpar);
+    if (ret >= 0) {
+        ret = avcodec_open2(dec_ctx, decoder, nullptr);
+    }
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    // Written aside and renamed when complete, a broken run never leaves a fixture behind.
+    std::string part = path + ".part";
+    ret = avformat_alloc_output_context2(&out_ctx, nullptr, "matroska", part.c_str());
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+    DEFER(if (!(out_ctx->oformat->flags & AVFMT_NOFILE)) { avio_closep(&out_ctx->pb); }
+          avformat_free_context(out_ctx);)
+
+    // Encoder, what the player sees most, else what every FFmpeg build has.
+    const AVCodec* encoder = avcodec_find_encoder_by_name("libx264");
+    if (!encoder) {
+        encoder = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    }
+    enc_ctx = encoder ? avcodec_alloc_context3(encoder) : nullptr;
+    if (!enc_ctx) {
+        SPDLOG_ERROR("Failed to find a video encoder for the fixture.");
+        return false;
+    }
+
+    enc_ctx->width = width;
+    enc_ctx->height = height;
+    enc_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    enc_ctx->time_base = {1, rate};
+    enc_ctx->framerate = {rate, 1};
+    enc_ctx->gop_size = rate * 2;
+    enc_ctx->bit_rate = 4000000;
+    if (encoder->id == AV_CODEC_ID_H264) {
+        av_opt_set(enc_ctx->priv_data, "preset", "veryfast", 0);
+    }
+    if (out_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+        enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    ret = avcodec_open2(enc_ctx, encoder, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    AVStream* out_video = avformat_new_stream(out_ctx, nullptr);
+    AVStream* out_audio = avformat_new_stream(out_ctx, nullptr);
+    if (!out_video || !out_audio) {
+        SPDLOG_ERROR("Failed to alloc output stream.");
+        return false;
+    }
+    out_video->time_base = enc_ctx->time_base;
+    out_audio->time_base = in_audio->time_base;
+
+    ret = avcodec_parameters_from_context(out_video->codecpar, enc_ctx);
+    if (ret >= 0) {
+        ret = avcodec_parameters_copy(out_audio->codecpar, in_audio->codecpar);
+        out_audio->codecpar->codec_tag = 0;
+    }
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    if (!(out_ctx->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open2(&out_ctx->pb, part.c_str(), AVIO_FLAG_WRITE, nullptr, nullptr);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+    }
+
+    ret = avformat_write_header(out_ctx, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    int64_t frame_num = 0;
+    auto decode = [&](const AVPacket* packet) -> bool {
+        int ret = avcodec_send_packet(dec_ctx, packet);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        while (true) {
+            ret = avcodec_receive_frame(dec_ctx, frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return true;
+            } else if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                return false;
+            }
+
+            frame->pts = frame_num++;
+            frame->pict_type = AV_PICTURE_TYPE_NONE;
+            bool ok = EncodeFrame(enc_ctx, frame, enc_pkt, out_ctx, out_video);
+            av_frame_unref(frame);
+            if (!ok)
+                return false;
+        }
+    };
+
+    bool ok = true;
+    while (ok && (ret = av_read_frame(in_ctx, pkt)) >= 0) {
+        if (pkt->stream_index == video_index) {
+            ok = decode(pkt);
+        } else if (pkt->stream_index == audio_index) {
+            pkt->stream_index = out_audio->index;
+            av_packet_rescale_ts(pkt, in_audio->time_base, out_audio->time_base);
+            ret = av_interleaved_write_frame(out_ctx, pkt);
+            if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                ok = false;
+            }
+        }
+        av_packet_unref(pkt);
+    }
+
+    ok = ok && decode(nullptr) && EncodeFrame(enc_ctx, nullptr, enc_pkt, out_ctx, out_video);
+    if (!ok)
+        return false;
+
+    ret = av_write_trailer(out_ctx);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    avio_closep(&out_ctx->pb);
+    remove(path.c_str());
+    if (rename(part.c_str(), path.c_str()) != 0) {
+        SPDLOG_ERROR("Failed to rename fixture {0}.", part);
+        return false;
+    }
+
+    codec = avcodec_get_name(encoder->id);
+    SPDLOG_INFO("Generated fixture {0}, frames: {1}, codec: {2}.", path, frame_num, codec);
+
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef BENCH_FIXTURE_H_
+#define BENCH_FIXTURE_H_
+
+#include <string>
+
+/**
+ * @brief Synthetic input of the benchmarks, generated locally so every machine measures the same.
+ *
+ * The lavfi testsrc2 pattern is encoded to H.264, MPEG-4 part 2 without libx264, and muxed into
+ * Matroska next to a sine tone as PCM, so demuxing also has to skip an audio stream.
+ */
+struct BenchFixture
+{
+    int width;
+    int height;
+    int rate;     // fps
+    int duration; // s
+    std::string codec;
+    std::string path;
+
+    BenchFixture()
+        : width(1280)
+        , height(720)
+        , rate(30)
+        , duration(10)
+    {}
+
+    /**
+     * @brief Write the fixture into the folder, an existing one of the same parameters is reused.
+     */
+    bool Generate(const std::string& folder);
+};
+
+#endif
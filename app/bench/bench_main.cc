@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <stdio.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+extern "C"
+{
+#include "libavutil/log.h"
+#include "libavutil/parseutils.h"
+}
+
+#include "bench_fixture.h"
+#include "bench_scenarios.h"
+#include "common/singleton.h"
+#include "config/config.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+
+struct BenchEntry
+{
+    const char* name;
+    BenchScenario run;
+};
+
+static const BenchEntry kScenarios[] = {
+    {"decode", BenchDecode},
+    {"decode_convert", BenchDecodeConvert},
+    {"queue", BenchQueue},
+    {"record", BenchRecord},
+    {"grid", BenchGrid},
+    {"segments", BenchSegments},
+};
+
+// Scenarios whose md5 differs from the baseline, an output change has to be deliberate.
+static int CompareBaseline(const QJsonObject& scenarios, const QString& file)
+{
+    QFile baseline_file(file);
+    if (!baseline_file.open(QIODevice::ReadOnly)) {
+        SPDLOG_ERROR("Failed to open baseline {0}.", file.toStdString());
+        return 1;
+    }
+
+    QJsonObject baseline =
+        QJsonDocument::fromJson(baseline_file.readAll()).object().value("scenarios").toObject();
+
+    int mismatches = 0;
+    for (auto it = scenarios.begin(); it != scenarios.end(); ++it) {
+        if (!baseline.contains(it.key()))
+            continue;
+
+        QString expected = baseline.value(it.key()).toObject().value("md5").toString();
+        QString actual = it.value().toObject().value("md5").toString();
+        if (expected != actual) {
+            SPDLOG_ERROR("Output of {0} changed, md5 {1}, baseline {2}.", it.key().toStdString(),
+                         actual.toStdString(), expected.toStdString());
+            ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // Stdout carries the report.
+    spdlog::set_default_logger(spdlog::stderr_color_mt("bench"));
+    av_log_set_level(AV_LOG_ERROR);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless decode, convert, queue and record benchmarks.");
+    parser.addHelpOption();
+
+    QCommandLineOption scenario_option(
+        "scenario",
+        "decode, decode_convert, queue, record, grid or segments, repeatable, all by default.",
+        "name");
+    QCommandLineOption size_option("size", "Frame size of the fixture.", "WxH", "1280x720");
+    QCommandLineOption rate_option("rate", "Frame rate of the fixture.", "fps", "30");
+    QCommandLineOption duration_option("duration", "Duration of the fixture.", "s", "10");
+    QCommandLineOption streams_option("streams", "Decoders of the grid scenario.", "count", "4");
+    QCommandLineOption queue_option("queue-frames", "Frames passed through the queue.", "count",
+                                    "3000");
+    QCommandLineOption workdir_option("workdir", "Folder of the fixture and the outputs.", "dir",
+                                      QDir::tempPath() + "/spark-bench");
+    QCommandLineOption output_option("output", "Write the report to the file, else stdout.",
+                                     "file");
+    QCommandLineOption baseline_option(
+        "baseline", "Fail if an output differs from the md5 of this earlier report.", "file");
+    parser.addOption(scenario_option);
+    parser.addOption(size_option);
+    parser.addOption(rate_option);
+    parser.addOption(duration_option);
+    parser.addOption(streams_option);
+    parser.addOption(queue_option);
+    parser.addOption(workdir_option);
+    parser.addOption(output_option);
+    parser.addOption(baseline_option);
+    parser.process(app);
+
+    // Measure the software path with the default output, whatever the player is configured to.
+    Singleton<Config>::Instance()->SetOverride("video_param", "enable_hw_decode", false);
+    Singleton<Config>::Instance()->SetOverride("video_param", "dst_pix_fmt", "YUV");
+
+    BenchFixture fixture;
+    if (av_parse_video_size(&fixture.width, &fixture.height,
+                            parser.value(size_option).toStdString().c_str())
+        < 0) {
+        SPDLOG_ERROR("Invalid size {0}.", parser.value(size_option).toStdString());
+        return 1;
+    }
+    fixture.rate = std::max(1, parser.value(rate_option).toInt());
+    fixture.duration = std::max(1, parser.value(duration_option).toInt());
+
+    QString workdir = parser.value(workdir_option);
+    if (!QDir().mkpath(workdir)) {
+        SPDLOG_ERROR("Failed to create {0}.", workdir.toStdString());
+        return 1;
+    }
+    if (!fixture.Generate(workdir.toStdString()))
+        return 1;
+
+    BenchOptions options;
+    options.fixture = fixture.path;
+    options.workdir = workdir.toStdString();
+    options.streams = std::max(1, parser.value(streams_option).toInt());
+    options.queue_frames = std::max(1, parser.value(queue_option).toInt());
+
+    QStringList selected = parser.values(scenario_option);
+    QJsonObject scenarios;
+    bool ok = true;
+    for (const BenchEntry& entry : kScenarios) {
+        if (!selected.isEmpty() && !selected.contains(entry.name))
+            continue;
+
+        SPDLOG_INFO("Run {0}.", entry.name);
+        BenchMeter meter;
+        QJsonObject extra;
+        bool passed = entry.run(options, &meter, &extra);
+
+        QJsonObject report = meter.Report();
+        for (auto it = extra.begin(); it != extra.end(); ++it) {
+            report.insert(it.key(), it.value());
+        }
+        report["ok"] = passed;
+        scenarios[entry.name] = report;
+
+        ok = ok && passed;
+    }
+
+    QJsonObject fixture_info;
+    fixture_info["path"] = QString::fromStdString(fixture.path);
+    fixture_info["codec"] = QString::fromStdString(fixture.codec);
+    fixture_info["width"] = fixture.width;
+    fixture_info["height"] = fixture.height;
+    fixture_info["rate"] = fixture.rate;
+    fixture_info["duration"] = fixture.duration;
+
+    QJsonObject root;
+    root["fixture"] = fixture_info;
+    root["scenarios"] = scenarios;
+    QByteArray json = QJsonDocument(root).toJson();
+
+    if (parser.isSet(output_option)) {
+        QFile output(parser.value(output_option));
+        if (!output.open(QIODevice::WriteOnly) || output.write(json) != json.size()) {
+            SPDLOG_ERROR("Failed to write {0}.", parser.value(output_option).toStdString());
+            return 1;
+        }
+    } else {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+
+    if (parser.isSet(baseline_option)
+        && CompareBaseline(scenarios, parser.value(baseline_option)) > 0) {
+        return 2;
+    }
+
+    return ok ? 0 : 1;
+}
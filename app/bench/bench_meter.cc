@@ -0,0 +1,251 @@
+#include "bench_meter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+extern "C"
+{
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/md5.h"
+#include "libavutil/pixdesc.h"
+}
+
+static std::atomic<int64_t> g_allocs(0);
+static std::atomic<int64_t> g_alloc_bytes(0);
+
+// Every C++ allocation of the bench goes through here, FFmpeg's av_malloc is not counted.
+void* operator new(size_t size)
+{
+    ++g_allocs;
+    g_alloc_bytes += size;
+
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    ++g_allocs;
+    g_alloc_bytes += size;
+
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static double CpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit_time, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit_time, &kernel, &user))
+        return 0.0;
+
+    auto seconds = [](const FILETIME& time) {
+        ULARGE_INTEGER value;
+        value.LowPart = time.dwLowDateTime;
+        value.HighPart = time.dwHighDateTime;
+        return value.QuadPart / 1e7; // 100 ns
+    };
+    return seconds(kernel) + seconds(user);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec
+           + usage.ru_stime.tv_usec / 1e6;
+#endif
+}
+
+BenchMeter::BenchMeter()
+    : md5_ctx_(av_md5_alloc())
+    , frames_(0)
+    , wall_(0.0)
+    , cpu_(0.0)
+    , cpu_begin_(0.0)
+    , allocs_(0)
+    , alloc_bytes_(0)
+    , allocs_begin_(0)
+    , alloc_bytes_begin_(0)
+    , hash_(0.0)
+    , pending_hash_(0.0)
+    , merged_hash_max_(0.0)
+    , merged_hash_sum_(0.0)
+{
+    if (md5_ctx_) {
+        av_md5_init(md5_ctx_);
+    }
+}
+
+BenchMeter::~BenchMeter()
+{
+    av_freep(&md5_ctx_);
+}
+
+void BenchMeter::Begin()
+{
+    // Growing the samples would count as allocations of the scenario.
+    latencies_.reserve(latencies_.size() + (1 << 16));
+
+    cpu_begin_ = CpuSeconds();
+    allocs_begin_ = g_allocs;
+    alloc_bytes_begin_ = g_alloc_bytes;
+
+    begin_ = std::chrono::steady_clock::now();
+    last_ = begin_;
+}
+
+void BenchMeter::End()
+{
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - begin_;
+    wall_ = std::max(0.0, wall.count() - hash_);
+    cpu_ = std::max(0.0, CpuSeconds() - cpu_begin_ - hash_);
+    allocs_ = g_allocs - allocs_begin_;
+    alloc_bytes_ = g_alloc_bytes - alloc_bytes_begin_;
+}
+
+void BenchMeter::Frame()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::micro> latency = now - last_;
+    last_ = now;
+
+    Frame(std::max(0.0, latency.count() - pending_hash_ * 1e6));
+}
+
+void BenchMeter::Frame(double latency_us)
+{
+    ++frames_;
+    latencies_.push_back(latency_us);
+    pending_hash_ = 0.0;
+}
+
+void BenchMeter::Hash(const void* data, size_t size)
+{
+    if (!md5_ctx_)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    av_md5_update(md5_ctx_, static_cast<const uint8_t*>(data), size);
+    std::chrono::duration<double> spent = std::chrono::steady_clock::now() - start;
+
+    hash_ += spent.count();
+    pending_hash_ += spent.count();
+}
+
+void BenchMeter::HashFrame(const AVFrame* frame)
+{
+    AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (!desc)
+        return;
+
+    for (int plane = 0; plane < av_pix_fmt_count_planes(format); ++plane) {
+        int bytes = av_image_get_linesize(format, frame->width, plane);
+        int rows = plane == 1 || plane == 2 ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h)
+                                            : frame->height;
+        for (int y = 0; y < rows; ++y) {
+            Hash(frame->data[plane] + static_cast<ptrdiff_t>(y) * frame->linesize[plane], bytes);
+        }
+    }
+}
+
+void BenchMeter::Merge(const BenchMeter& other)
+{
+    frames_ += other.frames_;
+    latencies_.insert(latencies_.end(), other.latencies_.begin(), other.latencies_.end());
+
+    // Merged meters hashed in parallel, the slowest of them held up the wall time.
+    merged_hash_max_ = std::max(merged_hash_max_, other.hash_);
+    merged_hash_sum_ += other.hash_;
+}
+
+std::string BenchMeter::md5()
+{
+    if (md5_.empty() && md5_ctx_) {
+        uint8_t digest[16];
+        av_md5_final(md5_ctx_, digest);
+
+        static const char hex[] = "0123456789abcdef";
+        for (uint8_t byte : digest) {
+            md5_ += hex[byte >> 4];
+            md5_ += hex[byte & 0x0f];
+        }
+    }
+
+    return md5_;
+}
+
+QJsonObject BenchMeter::Report()
+{
+    QJsonObject latency;
+    latency["p50"] = Percentile(0.50) / 1000.0;
+    latency["p99"] = Percentile(0.99) / 1000.0;
+    latency["max"] = Percentile(1.0) / 1000.0;
+
+    double wall = std::max(0.0, wall_ - merged_hash_max_);
+    double cpu = std::max(0.0, cpu_ - merged_hash_sum_);
+
+    QJsonObject report;
+    report["frames"] = static_cast<qint64>(frames_);
+    report["wall_s"] = wall;
+    report["fps"] = wall > 0.0 ? frames_ / wall : 0.0;
+    report["latency_ms"] = latency;
+    report["cpu_s"] = cpu;
+    report["cpu_per_frame_ms"] = frames_ > 0 ? cpu * 1000.0 / frames_ : 0.0;
+    report["allocs"] = static_cast<qint64>(allocs_);
+    report["alloc_bytes"] = static_cast<qint64>(alloc_bytes_);
+    report["md5"] = QString::fromStdString(md5());
+
+    return report;
+}
+
+double BenchMeter::Percentile(double p)
+{
+    if (latencies_.empty())
+        return 0.0;
+
+    size_t index = static_cast<size_t>(p * (latencies_.size() - 1) + 0.5);
+    std::nth_element(latencies_.begin(), latencies_.begin() + index, latencies_.end());
+    return latencies_[index];
+}
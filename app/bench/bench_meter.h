@@ -0,0 +1,84 @@
+#ifndef BENCH_METER_H_
+#define BENCH_METER_H_
+
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <QJsonObject>
+
+struct AVMD5;
+struct AVFrame;
+
+/**
+ * @brief Measures one scenario: frame rate, per-frame latency, process CPU time, heap allocations
+ * and an MD5 of the output, so a faster build can be checked to produce the same frames.
+ *
+ * CPU time and allocations are process wide, scenarios run one after another. The time spent
+ * hashing until End is taken out of the wall time, the CPU time and the latencies.
+ */
+class BenchMeter
+{
+public:
+    BenchMeter();
+    ~BenchMeter();
+
+    void Begin();
+    void End();
+
+    /**
+     * @brief Account a frame, its latency is the time since the previous one or Begin.
+     */
+    void Frame();
+
+    /**
+     * @brief Account a frame whose latency was measured by the caller.
+     */
+    void Frame(double latency_us);
+
+    void Hash(const void* data, size_t size);
+
+    /**
+     * @brief Hash the visible pixels of the planes, independent of the line padding.
+     */
+    void HashFrame(const AVFrame* frame);
+
+    /**
+     * @brief Add the frames and latencies of a meter that ran in parallel, e.g. one stream.
+     */
+    void Merge(const BenchMeter& other);
+
+    int64_t frames() const { return frames_; }
+    std::string md5();
+
+    QJsonObject Report();
+
+private:
+    double Percentile(double p);
+
+private:
+    AVMD5* md5_ctx_;
+    std::string md5_;
+
+    int64_t frames_;
+    std::vector<double> latencies_; // us
+    std::chrono::steady_clock::time_point last_;
+
+    std::chrono::steady_clock::time_point begin_;
+    double wall_;    // s
+    double cpu_;     // s
+    double cpu_begin_;
+    int64_t allocs_; // operator new calls
+    int64_t alloc_bytes_;
+    int64_t allocs_begin_;
+    int64_t alloc_bytes_begin_;
+
+    // s spent hashing, by this meter and by the merged ones
+    double hash_;
+    double pending_hash_; // Not yet taken out of a latency
+    double merged_hash_max_;
+    double merged_hash_sum_;
+};
+
+#endif
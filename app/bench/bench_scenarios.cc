@@ -0,0 +1,371 @@
+#include "bench_scenarios.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include <QThread>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+#include "codec/ffmpegdecoder.h"
+#include "codec/ffmpeghelper.h"
+#include "codec/ffmpegwriter.h"
+#include "common/singleton.h"
+#include "config/config.h"
+#include "job/job_context.h"
+#include "spdlog/spdlog.h"
+#include "util/decode_frame_buf.h"
+#include "util/task_thread.h"
+
+#define BENCH_QUEUE_CACHE 8       // frames
+#define BENCH_FILE_BLOCK (1 << 20) // bytes
+
+static bool OpenDecoder(FFmpegDecoder* decoder, const std::string& file)
+{
+    MediaInfo media;
+    media.type = kFile;
+    media.src = file;
+    decoder->set_media(media);
+
+    return decoder->Open();
+}
+
+// Decode the rest of the input, every frame is hashed as the renderers would get it.
+static void DrainDecoder(FFmpegDecoder* decoder, BenchMeter* meter)
+{
+    while (!decoder->end()) {
+        DecodeFrame* frame = decoder->GetFrame();
+        if (!frame)
+            continue;
+
+        meter->Frame();
+        meter->Hash(frame->buf.base, frame->buf.len);
+    }
+}
+
+static bool HashFile(const std::string& path, BenchMeter* meter)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        SPDLOG_ERROR("Failed to open {0}.", path);
+        return false;
+    }
+    DEFER(fclose(fp);)
+
+    std::vector<uint8_t> block(BENCH_FILE_BLOCK);
+    size_t size = 0;
+    while ((size = fread(block.data(), 1, block.size(), fp)) > 0) {
+        meter->Hash(block.data(), size);
+    }
+
+    return true;
+}
+
+bool BenchDecode(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra)
+{
+    AVFormatContext* fmt_ctx = nullptr;
+    int ret = avformat_open_input(&fmt_ctx, options.fixture.c_str(), nullptr, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+    DEFER(avformat_close_input(&fmt_ctx);)
+
+    ret = avformat_find_stream_info(fmt_ctx, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    const AVCodec* codec = nullptr;
+    int index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (index < 0 || !codec) {
+        SPDLOG_ERROR("Failed to find a video stream.");
+        return false;
+    }
+
+    AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    DEFER(avcodec_free_context(&codec_ctx); av_packet_free(&pkt); av_frame_free(&frame);)
+    if (!codec_ctx || !pkt || !frame) {
+        SPDLOG_ERROR("Failed to alloc codec context, packet or frame.");
+        return false;
+    }
+
+    ret = avcodec_parameters_to_context(codec_ctx, fmt_ctx->streams[index]->codecpar);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    // The same threading as the player.
+    codec_ctx->thread_count = 0;
+    ret = avcodec_open2(codec_ctx, codec, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+    (*extra)["decoder"] = codec->name;
+    (*extra)["threads"] = codec_ctx->thread_count;
+
+    auto decode = [&](const AVPacket* packet) -> bool {
+        int ret = avcodec_send_packet(codec_ctx, packet);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        while (true) {
+            ret = avcodec_receive_frame(codec_ctx, frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return true;
+            } else if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                return false;
+            }
+
+            meter->Frame();
+            meter->HashFrame(frame);
+            av_frame_unref(frame);
+        }
+    };
+
+    meter->Begin();
+
+    bool ok = true;
+    while (ok && av_read_frame(fmt_ctx, pkt) >= 0) {
+        if (pkt->stream_index == index) {
+            ok = decode(pkt);
+        }
+        av_packet_unref(pkt);
+    }
+    ok = ok && decode(nullptr);
+
+    meter->End();
+
+    return ok;
+}
+
+bool BenchDecodeConvert(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra)
+{
+    Singleton<Config>::Instance()->SetOverride("video_param", "dst_pix_fmt", "RGB");
+    DEFER(Singleton<Config>::Instance()->SetOverride("video_param", "dst_pix_fmt", "YUV");)
+
+    FFmpegDecoder decoder;
+    if (!OpenDecoder(&decoder, options.fixture))
+        return false;
+    (*extra)["output"] = "rgb24";
+
+    meter->Begin();
+    DrainDecoder(&decoder, meter);
+    meter->End();
+
+    return meter->frames() > 0;
+}
+
+bool BenchQueue(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra)
+{
+    // One real frame, copied through the queue over and over.
+    FFmpegDecoder decoder;
+    if (!OpenDecoder(&decoder, options.fixture))
+        return false;
+
+    DecodeFrame frame;
+    while (!decoder.end() && frame.IsNull()) {
+        DecodeFrame* decoded = decoder.GetFrame();
+        if (decoded) {
+            frame.Copy(*decoded);
+        }
+    }
+    if (frame.IsNull()) {
+        SPDLOG_ERROR("Failed to decode a frame for the queue.");
+        return false;
+    }
+    (*extra)["frame_bytes"] = static_cast<qint64>(frame.buf.len);
+
+    DecodeFrameBuf queue;
+    queue.set_cache(BENCH_QUEUE_CACHE);
+
+    // The buffer drops the oldest frame when full, the producer stays within its cache instead,
+    // so every frame arrives and the hash is stable.
+    int count = options.queue_frames;
+    std::atomic<int> pushed(0);
+    std::atomic<int> popped(0);
+    TaskThread producer([&] {
+        for (int i = 0; i < count; ++i) {
+            while (pushed - popped >= BENCH_QUEUE_CACHE) {
+                std::this_thread::yield();
+            }
+
+            frame.ts = static_cast<uint64_t>(i);
+            queue.Push(&frame);
+            ++pushed;
+        }
+    });
+
+    meter->Begin();
+    producer.start();
+
+    DecodeFrame item;
+    int64_t order_errors = 0;
+    while (popped < count) {
+        if (!queue.Pop(&item)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (item.ts != static_cast<uint64_t>(popped.load())) {
+            ++order_errors;
+        }
+        ++popped;
+
+        meter->Frame();
+        meter->Hash(&item.ts, sizeof(item.ts));
+    }
+
+    producer.wait();
+    meter->End();
+
+    // The payload of the last frame has to be the one pushed.
+    meter->Hash(item.buf.base, item.buf.len);
+    (*extra)["order_errors"] = static_cast<qint64>(order_errors);
+
+    return order_errors == 0;
+}
+
+bool BenchRecord(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra)
+{
+    FFmpegDecoder decoder;
+    if (!OpenDecoder(&decoder, options.fixture))
+        return false;
+
+    std::string outfile = options.workdir + "/record.mp4";
+    MediaInfo media;
+    media.type = kFile;
+    media.src = outfile;
+
+    FFmpegWriter writer;
+    writer.set_media(media);
+    if (!writer.Open(*decoder.encode_data_info()))
+        return false;
+    (*extra)["output"] = QString::fromStdString(outfile);
+
+    meter->Begin();
+
+    bool ok = true;
+    while (ok && !decoder.end()) {
+        DecodeFrame* frame = decoder.GetFrame();
+        if (!frame)
+            continue;
+
+        auto start = std::chrono::steady_clock::now();
+        ok = writer.Write(*frame);
+        std::chrono::duration<double, std::micro> latency =
+            std::chrono::steady_clock::now() - start;
+        meter->Frame(latency.count());
+    }
+    writer.Close();
+
+    meter->End();
+
+    // The recorded file, so a change of the encoder settings shows up as well.
+    return ok && HashFile(outfile, meter);
+}
+
+bool BenchGrid(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra)
+{
+    int streams = std::max(1, options.streams);
+    std::vector<std::unique_ptr<FFmpegDecoder>> decoders;
+    std::vector<std::unique_ptr<BenchMeter>> meters;
+    for (int i = 0; i < streams; ++i) {
+        decoders.emplace_back(new FFmpegDecoder);
+        meters.emplace_back(new BenchMeter);
+        if (!OpenDecoder(decoders.back().get(), options.fixture))
+            return false;
+    }
+    (*extra)["streams"] = streams;
+
+    std::vector<std::unique_ptr<TaskThread>> threads;
+    for (int i = 0; i < streams; ++i) {
+        FFmpegDecoder* decoder = decoders[i].get();
+        BenchMeter* stream_meter = meters[i].get();
+        threads.emplace_back(new TaskThread([decoder, stream_meter] {
+            stream_meter->Begin();
+            DrainDecoder(decoder, stream_meter);
+            stream_meter->End();
+        }));
+    }
+
+    meter->Begin();
+    for (auto& thread : threads) {
+        thread->start();
+    }
+    for (auto& thread : threads) {
+        thread->wait();
+    }
+    meter->End();
+
+    // Every stream decodes the same input, so every stream must see the same frames.
+    bool match = true;
+    for (auto& stream_meter : meters) {
+        meter->Merge(*stream_meter);
+        match = match && stream_meter->md5() == meters.front()->md5();
+    }
+    meter->Hash(meters.front()->md5().data(), meters.front()->md5().size());
+    (*extra)["streams_match"] = match;
+
+    return match;
+}
+
+bool BenchSegments(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra)
+{
+    // Any build has mpeg4, x264 is what the dialog offers first.
+    FFmpegHelper::VideoInfo info = {};
+    info.codec_name = avcodec_find_encoder_by_name("libx264") ? "libx264" : "mpeg4";
+    info.bit_rate = 2000000;
+    info.gop_size = 50;
+    (*extra)["codec"] = QString::fromStdString(info.codec_name);
+
+    std::string serial_file = options.workdir + "/segments_serial.es";
+    auto serial_start = std::chrono::steady_clock::now();
+    if (!FFmpegHelper::SaveSegmentedVideo(info, options.fixture.c_str(), serial_file.c_str(), 1))
+        return false;
+    std::chrono::duration<double> serial = std::chrono::steady_clock::now() - serial_start;
+
+    std::string outfile = options.workdir + "/segments.es";
+    JobContext job;
+
+    meter->Begin();
+    job.Start();
+    bool ok = FFmpegHelper::SaveSegmentedVideo(info, options.fixture.c_str(), outfile.c_str(), 0,
+                                               &job);
+    job.Finish();
+    meter->End();
+    if (!ok)
+        return false;
+
+    // Per frame latencies are not observable inside the workers, the mean is accounted.
+    int64_t frames = job.frames();
+    double frame_us = frames > 0 ? job.elapsed() * 1e6 / frames : 0.0;
+    for (int64_t i = 0; i < frames; ++i) {
+        meter->Frame(frame_us);
+    }
+
+    (*extra)["serial_s"] = serial.count();
+    (*extra)["parallel_s"] = job.elapsed();
+    (*extra)["speedup"] = job.elapsed() > 0.0 ? serial.count() / job.elapsed() : 0.0;
+    (*extra)["segments"] = std::max(1, QThread::idealThreadCount());
+    (*extra)["output"] = QString::fromStdString(outfile);
+
+    return HashFile(outfile, meter);
+}
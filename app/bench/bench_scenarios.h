@@ -0,0 +1,55 @@
+#ifndef BENCH_SCENARIOS_H_
+#define BENCH_SCENARIOS_H_
+
+#include <string>
+
+#include <QJsonObject>
+
+#include "bench_meter.h"
+
+struct BenchOptions
+{
+    std::string fixture; // Input of every scenario
+    std::string workdir; // Outputs of the scenarios
+    int streams;         // Decoders of the grid
+    int queue_frames;    // Frames passed through the queue
+};
+
+/**
+ * @brief A scenario measures between Begin and End of the meter, opening the input is excluded.
+ *
+ * @param extra Scenario specific values of the report
+ */
+typedef bool (*BenchScenario)(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra);
+
+/**
+ * @brief Demux and decode as fast as possible, no conversion.
+ */
+bool BenchDecode(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra);
+
+/**
+ * @brief Decode through FFmpegDecoder with RGB output, the swscale path of the player.
+ */
+bool BenchDecodeConvert(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra);
+
+/**
+ * @brief Pass decoded frames from a producer thread through DecodeFrameBuf to a consumer.
+ */
+bool BenchQueue(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra);
+
+/**
+ * @brief Decode and record through FFmpegWriter, the latency is that of Write.
+ */
+bool BenchRecord(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra);
+
+/**
+ * @brief Decode the input in several streams at once, like a grid of video widgets.
+ */
+bool BenchGrid(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra);
+
+/**
+ * @brief Transcode in keyframe segments on all cores, the speed-up is against one segment.
+ */
+bool BenchSegments(const BenchOptions& options, BenchMeter* meter, QJsonObject* extra);
+
+#endif
@@ -0,0 +1,130 @@
+#include "audio_interleave.h"
+
+#include <string.h>
+
+#if defined(AUDIO_INTERLEAVE_SSE2)
+#include <emmintrin.h>
+#elif defined(AUDIO_INTERLEAVE_NEON)
+#include <arm_neon.h>
+#endif
+
+// Interleave the leading samples of two planes a vector at a time, returns how many were done.
+// kBytes is a constant, the switches fold away.
+template <int kBytes>
+static int InterleaveStereo(const uint8_t* l, const uint8_t* r, int samples, uint8_t* dst)
+{
+    const int step = 16 / kBytes;
+    int i = 0;
+
+#if defined(AUDIO_INTERLEAVE_SSE2)
+    for (; i + step <= samples; i += step) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i * kBytes));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i * kBytes));
+        __m128i lo;
+        __m128i hi;
+        switch (kBytes) {
+        case 1:
+            lo = _mm_unpacklo_epi8(a, b);
+            hi = _mm_unpackhi_epi8(a, b);
+            break;
+        case 2:
+            lo = _mm_unpacklo_epi16(a, b);
+            hi = _mm_unpackhi_epi16(a, b);
+            break;
+        case 4:
+            lo = _mm_unpacklo_epi32(a, b);
+            hi = _mm_unpackhi_epi32(a, b);
+            break;
+        default:
+            lo = _mm_unpacklo_epi64(a, b);
+            hi = _mm_unpackhi_epi64(a, b);
+            break;
+        }
+        uint8_t* out = dst + 2 * i * kBytes;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), hi);
+    }
+#elif defined(AUDIO_INTERLEAVE_NEON)
+    // vst2 stores two registers interleaved, exactly the packed layout.
+    for (; i + step <= samples; i += step) {
+        const uint8_t* a = l + i * kBytes;
+        const uint8_t* b = r + i * kBytes;
+        uint8_t* out = dst + 2 * i * kBytes;
+        switch (kBytes) {
+        case 1: {
+            uint8x16x2_t v = {{vld1q_u8(a), vld1q_u8(b)}};
+            vst2q_u8(out, v);
+        } break;
+        case 2: {
+            uint16x8x2_t v = {{vld1q_u16(reinterpret_cast<const uint16_t*>(a)),
+                               vld1q_u16(reinterpret_cast<const uint16_t*>(b))}};
+            vst2q_u16(reinterpret_cast<uint16_t*>(out), v);
+        } break;
+        case 4: {
+            uint32x4x2_t v = {{vld1q_u32(reinterpret_cast<const uint32_t*>(a)),
+                               vld1q_u32(reinterpret_cast<const uint32_t*>(b))}};
+            vst2q_u32(reinterpret_cast<uint32_t*>(out), v);
+        } break;
+        default:
+            // Two doubles per register, plain copies are as fast.
+            return i;
+        }
+    }
+#else
+    (void)l;
+    (void)r;
+    (void)samples;
+    (void)dst;
+    (void)step;
+#endif
+
+    return i;
+}
+
+template <typename T>
+static void Interleave(const uint8_t* const* planes, int channels, int samples, uint8_t* dst)
+{
+    int start = 0;
+    if (channels == 2) {
+        start = InterleaveStereo<sizeof(T)>(planes[0], planes[1], samples, dst);
+    }
+
+    // One channel at a time, the reads stay sequential and the loop has no inner branch.
+    T* out = reinterpret_cast<T*>(dst) + start * channels;
+    for (int ch = 0; ch < channels; ++ch) {
+        const T* in = reinterpret_cast<const T*>(planes[ch]);
+        T* o = out + ch;
+        for (int i = start; i < samples; ++i, o += channels) {
+            *o = in[i];
+        }
+    }
+}
+
+void InterleaveAudio(const uint8_t* const* planes, int channels, int samples,
+                     int bytes_per_sample, uint8_t* dst)
+{
+    if (channels <= 0 || samples <= 0)
+        return;
+
+    if (channels == 1) {
+        memcpy(dst, planes[0], static_cast<size_t>(samples) * bytes_per_sample);
+        return;
+    }
+
+    switch (bytes_per_sample) {
+    case 1:
+        Interleave<uint8_t>(planes, channels, samples, dst);
+        break;
+    case 2:
+        Interleave<uint16_t>(planes, channels, samples, dst);
+        break;
+    case 4:
+        Interleave<uint32_t>(planes, channels, samples, dst);
+        break;
+    case 8:
+        Interleave<uint64_t>(planes, channels, samples, dst);
+        break;
+    default:
+        break;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef AUDIO_INTERLEAVE_H_
+#define AUDIO_INTERLEAVE_H_
+
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUDIO_INTERLEAVE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AUDIO_INTERLEAVE_NEON
+#endif
+
+/**
+ * @brief Pack planar samples into interleaved order, L L L + R R R ==> L R L R L R.
+ *
+ * Samples are moved as opaque words, so one kernel serves s16, s32/flt and dbl. Stereo, the
+ * common case, is unpacked with SSE2 or NEON, other channel counts use a strided copy.
+ *
+ * @param bytes_per_sample 1, 2, 4 or 8
+ */
+void InterleaveAudio(const uint8_t* const* planes, int channels, int samples,
+                     int bytes_per_sample, uint8_t* dst);
+
+#endif
@@ -1,13 +1,17 @@
 #include "ffmpegdecoder.h"
 
+#include <algorithm>
 #include <cmath>
+#include <ctime>
+
+#include <QTime>
 
 #include "ffmpeghelper.h"
 #include "common/singleton.h"
 #include "config/config.h"
 #include "spdlog/spdlog.h"
 #include "util/cthread.h"
-#include "widget/video_display/video_display_widget.h"
+#include "util/trace.h"
 
 FFmpegDecoder::FFmpegDecoder()
     : fmt_ctx_(nullptr)
@@ -19,8 +23,10 @@ FFmpegDecoder::FFmpegDecoder()
     , hw_decode_(false)
     , hw_frame_(nullptr)
     , hw_dev_ctx_(nullptr)
+    , decode_pix_fmt_(AV_PIX_FMT_NONE)
     , block_start_time_(0)
     , block_timeout_(10)
+    , input_bytes_(0)
     , fps_(0)
     , end_(true)
 {
@@ -99,6 +105,9 @@ int FFmpegDecoder::GetPacket(AVPacket* pkt)
 
         block_start_time_ = time(nullptr);
         ret = av_read_frame(fmt_ctx_, pkt);
+        if (ret >= 0) {
+            input_bytes_ += pkt->size;
+        }
     } while (pkt->stream_index != video_stream_->index && ret >= 0);
 
     return ret;
@@ -112,28 +121,79 @@ static int GetCommonFmt(int format)
         return PIX_FMT_IYUV;
     case AV_PIX_FMT_NV12:
         return PIX_FMT_NV12;
+    case AV_PIX_FMT_P010LE:
+        return PIX_FMT_P010;
+    case AV_PIX_FMT_P016LE:
+        return PIX_FMT_P016;
+    case AV_PIX_FMT_RGB24:
+        return PIX_FMT_RGB;
     default:
         return 0;
     }
 }
 
+static int GetColorSpace(const AVFrame* frame)
+{
+    switch (frame->colorspace) {
+    case AVCOL_SPC_BT709:
+        return kColorSpaceBT709;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        return kColorSpaceBT2020;
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+        return kColorSpaceBT601;
+    default:
+        // Unspecified, assume HD content is BT.709 as most players do.
+        return frame->height >= 720 ? kColorSpaceBT709 : kColorSpaceBT601;
+    }
+}
+
+static bool IsJpegFmt(int format)
+{
+    return format == AV_PIX_FMT_YUVJ420P || format == AV_PIX_FMT_YUVJ422P
+           || format == AV_PIX_FMT_YUVJ444P;
+}
+
+static int GetColorRange(const AVFrame* frame)
+{
+    if (IsJpegFmt(frame->format) || frame->color_range == AVCOL_RANGE_JPEG)
+        return kColorRangeFull;
+
+    return kColorRangeLimited;
+}
+
 DecodeFrame* FFmpegDecoder::GetFrame()
 {
-    int ret = GetPacket(packet_);
-    if (ret == 0) {
-        if (packet_->stream_index == video_stream_->index) {
-            if (avcodec_send_packet(codec_ctx_, packet_) != 0) {
-                FFmpegHelper::FFmpegError(ret);
+    TRACE_SCOPE("decoder.get_frame");
+
+    int ret;
+    {
+        TRACE_SCOPE("demux");
+        ret = GetPacket(packet_);
+    }
+
+    {
+        TRACE_SCOPE("decode.send");
+        if (ret == 0) {
+            if (packet_->stream_index == video_stream_->index) {
+                if (avcodec_send_packet(codec_ctx_, packet_) != 0) {
+                    FFmpegHelper::FFmpegError(ret);
+                }
             }
+        } else if (ret == AVERROR_EOF) {
+            avcodec_send_packet(codec_ctx_, nullptr); // Flush decoder
+        } else {
+            FFmpegHelper::FFmpegError(ret);
         }
-    } else if (ret == AVERROR_EOF) {
-        avcodec_send_packet(codec_ctx_, nullptr); // Flush decoder
-    } else {
-        FFmpegHelper::FFmpegError(ret);
+        av_packet_unref(packet_);
     }
-    av_packet_unref(packet_);
 
-    int error_code = avcodec_receive_frame(codec_ctx_, frame_);
+    int error_code;
+    {
+        TRACE_SCOPE("decode.receive");
+        error_code = avcodec_receive_frame(codec_ctx_, frame_);
+    }
     if (error_code == AVERROR(EAGAIN) || error_code == AVERROR_EOF) {
         av_frame_unref(frame_);
 
@@ -155,7 +215,17 @@ DecodeFrame* FFmpegDecoder::GetFrame()
         }
     }
     decode_frame_.pict_type_ = frame->pict_type;
-    ret = Scale(frame);
+    decode_frame_.color_space = GetColorSpace(frame);
+    decode_frame_.color_range = GetColorRange(frame);
+    if (IsPassthroughFmt(frame->format)) {
+        ret = CopyFrame(frame);
+    } else {
+        // Swscale converts the YUVJ formats to limited range, other ranges are kept as is.
+        if (IsJpegFmt(frame->format)) {
+            decode_frame_.color_range = kColorRangeLimited;
+        }
+        ret = Scale(frame);
+    }
     av_frame_unref(frame);
 
     if (!ret) {
@@ -165,6 +235,38 @@ DecodeFrame* FFmpegDecoder::GetFrame()
     return &decode_frame_;
 }
 
+bool FFmpegDecoder::Seek(int64_t position, bool forward)
+{
+    if (!fmt_ctx_ || !codec_ctx_)
+        return false;
+
+    int64_t ts = av_rescale_q(position, {1, 1000}, video_stream_->time_base);
+    int ret = 0;
+    if (forward) {
+        // Never lands before the position, which av_seek_frame may do without an index.
+        ret = avformat_seek_file(fmt_ctx_, video_stream_->index, ts, ts, INT64_MAX, 0);
+    } else {
+        ret = av_seek_frame(fmt_ctx_, video_stream_->index, ts, AVSEEK_FLAG_BACKWARD);
+    }
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    avcodec_flush_buffers(codec_ctx_);
+    end_ = false;
+
+    return true;
+}
+
+void FFmpegDecoder::SetKeyframesOnly(bool enable)
+{
+    if (!codec_ctx_)
+        return;
+
+    codec_ctx_->skip_frame = enable ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+}
+
 bool FFmpegDecoder::AllocFrame()
 {
     packet_ = av_packet_alloc();
@@ -475,25 +577,19 @@ void FFmpegDecoder::ResizeDecodeFrame(int dst_w, int dst_h, int dst_pix_fmt)
     decode_frame_.w = dst_w;
     decode_frame_.h = dst_h;
     decode_frame_.format = GetCommonFmt(dst_pix_fmt);
+    decode_pix_fmt_ = dst_pix_fmt;
 
-    if (dst_pix_fmt == AV_PIX_FMT_YUV420P) {
-        int y_size = dst_w * dst_h;
-        decode_frame_.buf.len = y_size * 3 / 2;
-        data_[0] = reinterpret_cast<uint8_t*>(decode_frame_.buf.base);
-        data_[1] = data_[0] + y_size;
-        data_[2] = data_[1] + y_size / 4;
-        linesize_[0] = dst_w;
-        linesize_[1] = dst_w / 2;
-        linesize_[2] = dst_w / 2;
-    } else {
-        decode_frame_.buf.len = dst_w * dst_h * 3;
-        data_[0] = reinterpret_cast<uint8_t*>(decode_frame_.buf.base);
-        linesize_[0] = dst_w * 3;
-    }
+    // Tightly packed planes, the layout the renderers expect.
+    AVPixelFormat pix_fmt = static_cast<AVPixelFormat>(dst_pix_fmt);
+    decode_frame_.buf.len = av_image_get_buffer_size(pix_fmt, dst_w, dst_h, 1);
+    av_image_fill_arrays(data_, linesize_, reinterpret_cast<uint8_t*>(decode_frame_.buf.base),
+                         pix_fmt, dst_w, dst_h, 1);
 }
 
 bool FFmpegDecoder::GpuDataToCpu(AVFrame* src, AVFrame* dst) const
 {
+    TRACE_SCOPE("decode.hw_map");
+
     const AVPixelFormat* format = static_cast<const AVPixelFormat*>(codec_ctx_->opaque);
     if (src->format != *format) {
         return false;
@@ -515,9 +611,56 @@ bool FFmpegDecoder::GpuDataToCpu(AVFrame* src, AVFrame* dst) const
     return true;
 }
 
+bool FFmpegDecoder::IsPassthroughFmt(int format)
+{
+    // Formats the renderers can draw directly, unless RGB output is configured.
+    if (GetDstPixFormat() != AV_PIX_FMT_YUV420P)
+        return false;
+
+    switch (format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_NV12:
+    case AV_PIX_FMT_P010LE:
+    case AV_PIX_FMT_P016LE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool FFmpegDecoder::CopyFrame(AVFrame* src)
+{
+    TRACE_SCOPE("decode.copy");
+
+    int dst_w;
+    int dst_h;
+    AlignSize(src->width, src->height, &dst_w, &dst_h);
+
+    if (src->format != decode_pix_fmt_ || dst_w != decode_frame_.w || dst_h != decode_frame_.h) {
+        ResizeDecodeFrame(dst_w, dst_h, src->format);
+    }
+
+    // Only repack the planes, no swscale involved.
+    av_image_copy(data_, linesize_, const_cast<const uint8_t**>(src->data), src->linesize,
+                  static_cast<AVPixelFormat>(src->format), dst_w, dst_h);
+    decode_frame_.ts = src->pts * av_q2d(video_stream_->time_base) * 1000;
+
+    return true;
+}
+
 bool FFmpegDecoder::Scale(AVFrame* src)
 {
+    TRACE_SCOPE("swscale");
+
     AVPixelFormat dst_pix_fmt = GetDstPixFormat();
+    if (dst_pix_fmt != decode_pix_fmt_) {
+        int dst_w;
+        int dst_h;
+        AlignSize(codec_ctx_->width, codec_ctx_->height, &dst_w, &dst_h);
+        ResizeDecodeFrame(dst_w, dst_h, dst_pix_fmt);
+    }
+
     if (!sws_ctx_) {
         int src_w = codec_ctx_->width;
         int src_h = codec_ctx_->height;
@@ -30,6 +30,19 @@ public:
     int GetPacket(AVPacket* pkt);
     DecodeFrame* GetFrame();
 
+    /**
+     * @brief Seek to the keyframe at or before the position, the decoder is flushed.
+     *
+     * @param position ms, in the time of DecodeFrame::ts
+     * @param forward Seek to the keyframe at or after the position instead
+     */
+    bool Seek(int64_t position, bool forward = false);
+
+    /**
+     * @brief Discard every frame but the keyframes before decoding them, for trick play.
+     */
+    void SetKeyframesOnly(bool enable);
+
     const EncodeDataInfo* encode_data_info() const { return &encode_info_; }
 
     int fps() const { return fps_; }
@@ -39,6 +52,9 @@ public:
     int64_t block_start_time() const { return block_start_time_; }
     int64_t block_timeout() const { return block_timeout_; }
 
+    // Packets of every stream read so far
+    uint64_t input_bytes() const { return input_bytes_; }
+
 private:
     bool OpenInputFormat();
     bool FindStream();
@@ -59,6 +75,8 @@ private:
 
     bool GpuDataToCpu(AVFrame* src, AVFrame* dst) const;
 
+    static bool IsPassthroughFmt(int format);
+    bool CopyFrame(AVFrame* src);
     bool Scale(AVFrame* src);
 
     // callback
@@ -80,6 +98,7 @@ private:
     std::vector<uint32_t> hw_devices_;
 
     DecodeFrame decode_frame_;
+    int decode_pix_fmt_; // AVPixelFormat of the layout in decode_frame_
     uint8_t* data_[4];
     int linesize_[4];
 
@@ -88,6 +107,7 @@ private:
     int64_t block_start_time_;
     int64_t block_timeout_;
 
+    uint64_t input_bytes_;
     int fps_;
     bool end_;
 };
@@ -1,17 +1,25 @@
 #include "ffmpeghelper.h"
 extern "C"
 {
+#include "libavutil/avstring.h"
 #include "libavutil/avutil.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/time.h"
 #include "libswresample/swresample.h"
 }
+#include "pcm_encoder.h"
+#include "pcm_writer.h"
+#include "raw_dump_pipeline.h"
+#include "raw_video_reader.h"
+#include "rendition_ladder.h"
+#include "segment_transcoder.h"
+#include "smart_cutter.h"
 #include "spdlog/spdlog.h"
 
-#define AUDIO_INBUF_SIZE 20480
-#define AUDIO_REFILL_THRESH 4096
-#define AV_INPUT_BUFFER_PADDING_SIZE 64
+#define EXPORT_READ_BUFFER_SIZE (1 << 20)
+#define READ_AGAIN_INTERVAL 10000 // us
 
 FFmpegHelper::FFmpegHelper() {}
 
@@ -49,107 +57,118 @@ int FFmpegHelper::read_packet(void* opaque, uint8_t* buf, int buf_size)
     return read_size;
 }
 
-void FFmpegHelper::DecodeAudio(AVCodecContext* codec_ctx, AVPacket* pkt, AVFrame* frame, FILE* outfile_fp)
+int FFmpegHelper::read_mapped(void* opaque, uint8_t* buf, int buf_size)
 {
-    int ret = avcodec_send_packet(codec_ctx, pkt);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return;
-    }
+    MappedFile* file = static_cast<MappedFile*>(opaque);
+    size_t read_size = FFMIN(static_cast<size_t>(buf_size), file->size - file->pos);
+    if (read_size == 0)
+        return AVERROR_EOF;
 
-    while (ret >= 0) {
-        ret = avcodec_receive_frame(codec_ctx, frame);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            return;
-        } else if (ret < 0) {
-            FFmpegError(ret);
-            return;
-        }
+    memcpy(buf, file->base + file->pos, read_size);
+    file->pos += read_size;
 
-        // Note
-        int data_size = av_get_bytes_per_sample(codec_ctx->sample_fmt);
-        if (data_size < 0) {
-            FFmpegError(ret);
-            return;
-        }
+    return static_cast<int>(read_size);
+}
 
-        // frame: planar and packed mode.
-        // L L L L ==> L R L R L R L R
-        // R R R R
-        for (int i = 0; i < frame->nb_samples; ++i) {
-            for (int ch = 0; ch < codec_ctx->channels; ++ch) {
-                fwrite(frame->data[ch] + i * data_size, 1, data_size, outfile_fp);
-            }
-        }
+int64_t FFmpegHelper::seek_mapped(void* opaque, int64_t offset, int whence)
+{
+    MappedFile* file = static_cast<MappedFile*>(opaque);
+
+    int64_t pos = 0;
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+        return static_cast<int64_t>(file->size);
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos = static_cast<int64_t>(file->pos) + offset;
+        break;
+    case SEEK_END:
+        pos = static_cast<int64_t>(file->size) + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
     }
+
+    if (pos < 0 || pos > static_cast<int64_t>(file->size))
+        return AVERROR(EINVAL);
+
+    file->pos = static_cast<size_t>(pos);
+    return pos;
 }
 
-void FFmpegHelper::EncodeAudio(AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* pkt,
-                               AVFormatContext* outfmt_ctx)
+int FFmpegHelper::OpenInput(AVFormatContext** fmt_ctx, const char* infile, JobContext* job)
 {
-    int ret = avcodec_send_frame(codec_ctx, frame);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return;
+    if (job) {
+        *fmt_ctx = avformat_alloc_context();
+        if (!*fmt_ctx)
+            return AVERROR(ENOMEM);
+
+        (*fmt_ctx)->interrupt_callback = job->interrupt_cb();
     }
 
-    while (ret >= 0) {
-        ret = avcodec_receive_packet(codec_ctx, pkt);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            return;
-        } else if (ret < 0) {
-            FFmpegError(ret);
-            return;
-        }
+    // Frees the context on failure.
+    return avformat_open_input(fmt_ctx, infile, nullptr, nullptr);
+}
 
-        ret = av_interleaved_write_frame(outfmt_ctx, pkt);
-        if (ret < 0) {
-            FFmpegError(ret);
-            av_packet_unref(pkt);
-            break;
-        }
-        av_packet_unref(pkt);
-    }
+int FFmpegHelper::OpenOutputIO(AVFormatContext* fmt_ctx, const char* outfile, JobContext* job)
+{
+    if (!job)
+        return avio_open2(&fmt_ctx->pb, outfile, AVIO_FLAG_WRITE, nullptr, nullptr);
 
-    return;
+    fmt_ctx->interrupt_callback = job->interrupt_cb();
+    return avio_open2(&fmt_ctx->pb, outfile, AVIO_FLAG_WRITE, &fmt_ctx->interrupt_callback,
+                      nullptr);
 }
 
-void FFmpegHelper::EncodeVideo(AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* pkt, FILE* outfile_fp)
+int64_t FFmpegHelper::FileSize(FILE* fp)
 {
-    int ret = avcodec_send_frame(codec_ctx, frame);
+    long pos = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, pos, SEEK_SET);
+
+    return size;
+}
+
+bool FFmpegHelper::DecodeAudio(AVCodecContext* codec_ctx, AVPacket* pkt, AVFrame* frame,
+                               PcmWriter* writer)
+{
+    int ret = avcodec_send_packet(codec_ctx, pkt);
     if (ret < 0) {
         FFmpegError(ret);
-        return;
+        return false;
     }
 
     while (ret >= 0) {
-        ret = avcodec_receive_packet(codec_ctx, pkt);
+        ret = avcodec_receive_frame(codec_ctx, frame);
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            return;
+            return true;
         } else if (ret < 0) {
             FFmpegError(ret);
-            return;
+            return false;
         }
 
-        fwrite(pkt->data, 1, pkt->size, outfile_fp);
-
-        av_packet_unref(pkt);
+        bool ok = writer->Write(frame);
+        av_frame_unref(frame);
+        if (!ok)
+            return false;
     }
 
-    return;
+    return true;
 }
 
-void FFmpegHelper::DecodeVideo(SwsContext* sws_ctx, AVCodecContext* codec_ctx, AVPixelFormat fmt,
-                               AVPacket* pkt, AVFrame* src_frame, AVFrame* dst_frame, FILE* outfile_fp)
+void FFmpegHelper::EncodeVideo(AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* pkt, FILE* outfile_fp)
 {
-    int ret = avcodec_send_packet(codec_ctx, pkt);
+    int ret = avcodec_send_frame(codec_ctx, frame);
     if (ret < 0) {
         FFmpegError(ret);
         return;
     }
 
     while (ret >= 0) {
-        ret = avcodec_receive_frame(codec_ctx, src_frame);
+        ret = avcodec_receive_packet(codec_ctx, pkt);
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             return;
         } else if (ret < 0) {
@@ -157,22 +176,9 @@ void FFmpegHelper::DecodeVideo(SwsContext* sws_ctx, AVCodecContext* codec_ctx, A
             return;
         }
 
-        ret = sws_scale(sws_ctx, src_frame->data, src_frame->linesize, 0, src_frame->height,
-                        dst_frame->data, dst_frame->linesize);
-        if (ret <= 0) {
-            av_frame_unref(src_frame);
-            continue;
-        }
-
-        if (fmt == AV_PIX_FMT_YUV420P) {
-            fwrite(dst_frame->data[0], 1, dst_frame->width * dst_frame->height, outfile_fp);
-            fwrite(dst_frame->data[1], 1, dst_frame->width * dst_frame->height / 4, outfile_fp);
-            fwrite(dst_frame->data[2], 1, dst_frame->width * dst_frame->height / 4, outfile_fp);
-        } else if (fmt == AV_PIX_FMT_RGB24) {
-            fwrite(dst_frame->data[0], 1, dst_frame->width * dst_frame->height * 3, outfile_fp);
-        }
+        fwrite(pkt->data, 1, pkt->size, outfile_fp);
 
-        av_frame_unref(src_frame);
+        av_packet_unref(pkt);
     }
 
     return;
@@ -246,137 +252,13 @@ bool FFmpegHelper::ReadMediaByAvio(const char* filename)
     return true;
 }
 
-bool FFmpegHelper::SaveTranscodeFormat(const VideoInfo& info, const char* infile, const char* outfile)
+bool FFmpegHelper::SaveTranscodeFormat(const VideoInfo& info, const char* infile, const char* outfile,
+                                       JobContext* job)
 {
-    AVFormatContext* infmt_ctx = nullptr;
-    int ret = avformat_open_input(&infmt_ctx, infile, nullptr, nullptr);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-    DEFER(avformat_close_input(&infmt_ctx);)
-
-    ret = avformat_find_stream_info(infmt_ctx, nullptr);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    AVFormatContext* outfmt_ctx = nullptr;
-    ret = avformat_alloc_output_context2(&outfmt_ctx, nullptr, nullptr, outfile);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-    DEFER(avformat_free_context(outfmt_ctx);)
-
-    // Copy all streams.(If you want, you can only operate part of the stream.)
-    for (uint32_t i = 0; i < infmt_ctx->nb_streams; ++i) {
-        AVStream* in_stream = infmt_ctx->streams[i];
-        AVStream* out_stream = avformat_new_stream(outfmt_ctx, nullptr);
-        if (!out_stream) {
-            SPDLOG_ERROR("Failed to create out stream index[{0}]", i);
-            continue;
-        }
-
-        ret = avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar);
-        if (ret < 0) {
-            FFmpegError(ret);
-            continue;
-        }
-        // Solve incompatible for codec
-        out_stream->codecpar->codec_tag = 0;
-    }
-
-    // Open avio before writer header
-    if (!(outfmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-        ret = avio_open2(&outfmt_ctx->pb, outfile, AVIO_FLAG_WRITE, nullptr, nullptr);
-        if (ret < 0) {
-            FFmpegError(ret);
-            return false;
-        }
-    }
-    DEFER(avio_closep(&outfmt_ctx->pb);)
-
-    ret = avformat_write_header(outfmt_ctx, nullptr);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    AVPacket* pkt = av_packet_alloc();
-    if (!pkt) {
-        SPDLOG_ERROR("Failed to alloc packet.");
-        return false;
-    }
-    DEFER(av_packet_free(&pkt);)
-
-    // Seek frame
-    ret = av_seek_frame(infmt_ctx, -1, info.start_time * AV_TIME_BASE, AVSEEK_FLAG_ANY);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    int64_t* start_pts = new int64_t[infmt_ctx->nb_streams];
-    memset(start_pts, 0, infmt_ctx->nb_streams * sizeof(int64_t));
-
-    int64_t* start_dts = new int64_t[infmt_ctx->nb_streams];
-    memset(start_dts, 0, infmt_ctx->nb_streams * sizeof(int64_t));
-
-    DEFER(delete[] start_pts; delete[] start_dts;)
-
-    while (av_read_frame(infmt_ctx, pkt) == 0) {
-        AVStream* in_stream = infmt_ctx->streams[pkt->stream_index];
-        AVStream* out_stream = outfmt_ctx->streams[pkt->stream_index];
-
-        if (info.end_time * in_stream->time_base.den < pkt->pts) {
-            av_packet_unref(pkt);
-            break;
-        };
-
-        // Init start pts and dts, due to cropping.
-        if (start_pts[pkt->stream_index] == 0) {
-            start_pts[pkt->stream_index] = pkt->pts;
-        }
-        if (start_dts[pkt->stream_index] == 0) {
-            start_dts[pkt->stream_index] = pkt->dts;
-        }
-
-        // Different encapsulation stream timebase may be different and timestamp need to be converted.
-        pkt->pts -= start_pts[pkt->stream_index];
-        pkt->dts -= start_dts[pkt->stream_index];
-        av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base); // pts, dts, duration...
-        if (pkt->pts < 0) {
-            pkt->pts = 0;
-        }
-        if (pkt->dts < 0) {
-            pkt->dts = 0;
-        }
-        pkt->pos = -1;
-
-        if (pkt->dts > pkt->pts) {
-            av_packet_unref(pkt);
-            continue;
-        }
-
-        ret = av_interleaved_write_frame(outfmt_ctx, pkt);
-        if (ret < 0) {
-            FFmpegError(ret);
-            av_packet_unref(pkt);
-            break;
-        }
-
-        av_packet_unref(pkt);
-    }
-
-    ret = av_write_trailer(outfmt_ctx);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    return true;
+    SmartCutter cutter(job);
+    int64_t start_us = info.start_time * INT64_C(1000);
+    int64_t end_us = info.end_time * INT64_C(1000);
+    return cutter.Run(infile, outfile, start_us, end_us);
 }
 
 static int get_format_from_sample_fmt(const char** fmt, enum AVSampleFormat sample_fmt)
@@ -408,39 +290,44 @@ static int get_format_from_sample_fmt(const char** fmt, enum AVSampleFormat samp
     return -1;
 }
 
-bool FFmpegHelper::SaveDecodeAudio(const char* infile, const char* outfile)
+bool FFmpegHelper::SaveDecodeAudio(const AudioInfo& info, const char* infile, const char* outfile,
+                                   JobContext* job)
 {
     if (!infile || *infile == '\0' || !outfile || *outfile == '\0')
         return false;
 
-    AVFormatContext* infmt_ctx = nullptr;
-    int ret = avformat_open_input(&infmt_ctx, infile, nullptr, nullptr);
+    AVFormatContext* fmt_ctx = nullptr;
+    int ret = OpenInput(&fmt_ctx, infile, job);
     if (ret < 0) {
         FFmpegError(ret);
         return false;
     }
+    DEFER(avformat_close_input(&fmt_ctx);)
 
-    AVCodecID codec_id;
-    {
-        DEFER(avformat_close_input(&infmt_ctx);)
+    ret = avformat_find_stream_info(fmt_ctx, nullptr);
+    if (ret < 0) {
+        FFmpegError(ret);
+        return false;
+    }
 
-        ret = avformat_find_stream_info(infmt_ctx, nullptr);
-        if (ret < 0) {
-            FFmpegError(ret);
-            return false;
-        }
+    ret = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (ret < 0) {
+        FFmpegError(ret);
+        return false;
+    }
+    int audio_index = ret;
+    AVStream* stream = fmt_ctx->streams[audio_index];
 
-        ret = av_find_best_stream(infmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
-        if (ret < 0) {
-            FFmpegError(ret);
-            return false;
+    // The demuxer skips the packets of the other streams.
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; ++i) {
+        if (static_cast<int>(i) != audio_index) {
+            fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
         }
-        codec_id = infmt_ctx->streams[ret]->codecpar->codec_id;
     }
 
-    AVCodec* codec = avcodec_find_decoder(codec_id);
+    AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
     if (!codec) {
-        SPDLOG_ERROR("Failed to find Codec {0}.", static_cast<int>(codec_id));
+        SPDLOG_ERROR("Failed to find Codec {0}.", static_cast<int>(stream->codecpar->codec_id));
         return false;
     }
 
@@ -451,12 +338,11 @@ bool FFmpegHelper::SaveDecodeAudio(const char* infile, const char* outfile)
     }
     DEFER(avcodec_free_context(&codec_ctx);)
 
-    AVCodecParserContext* parser_ctx = av_parser_init(codec->id);
-    if (!parser_ctx) {
-        SPDLOG_ERROR("Failed to init codec parser.");
+    ret = avcodec_parameters_to_context(codec_ctx, stream->codecpar);
+    if (ret < 0) {
+        FFmpegError(ret);
         return false;
     }
-    DEFER(av_parser_close(parser_ctx);)
 
     ret = avcodec_open2(codec_ctx, codec, nullptr);
     if (ret < 0) {
@@ -464,28 +350,16 @@ bool FFmpegHelper::SaveDecodeAudio(const char* infile, const char* outfile)
         return false;
     }
 
-    FILE* infile_fp = fopen(infile, "rb");
-    if (!infile_fp) {
-        SPDLOG_ERROR("Failed to open input file.");
+    PcmWriter writer;
+    if (!writer.Open(outfile, static_cast<AVSampleFormat>(info.sample_fmt)))
         return false;
-    }
-    DEFER(fclose(infile_fp);)
-
-    FILE* outfile_fp = fopen(outfile, "wb");
-    if (!outfile_fp) {
-        av_free(codec_ctx);
-
-        SPDLOG_ERROR("Failed to open output file.");
-        return false;
-    }
-    DEFER(fclose(outfile_fp);)
 
     AVPacket* pkt = av_packet_alloc();
     if (!pkt) {
         SPDLOG_ERROR("Failed to alloc packet.");
         return false;
     }
-    DEFER(av_packet_unref(pkt);)
+    DEFER(av_packet_free(&pkt);)
 
     AVFrame* decoded_frame = av_frame_alloc();
     if (!decoded_frame) {
@@ -494,271 +368,64 @@ bool FFmpegHelper::SaveDecodeAudio(const char* infile, const char* outfile)
     }
     DEFER(av_frame_free(&decoded_frame);)
 
-    uint8_t inbuf[AUDIO_INBUF_SIZE + AV_INPUT_BUFFER_PADDING_SIZE];
-    uint8_t* data_buf = inbuf;
-
-    size_t data_size = fread(inbuf, 1, AUDIO_INBUF_SIZE, infile_fp);
-    while (data_size > 0) {
-        // Parse a packet from buffer.
-        int used_size =
-            av_parser_parse2(parser_ctx, codec_ctx, &pkt->data, &pkt->size, data_buf,
-                             static_cast<int>(data_size), AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0);
-        if (used_size < 0) {
-            SPDLOG_ERROR("Error while parsing.");
+    if (job) {
+        job->set_duration(fmt_ctx->duration);
+    }
+
+    while (true) {
+        ret = av_read_frame(fmt_ctx, pkt);
+        if (ret == AVERROR_EOF) {
+            break;
+        } else if (ret < 0) {
+            if (!Cancelled(job)) {
+                FFmpegError(ret);
+            }
             return false;
         }
 
-        data_buf += used_size;
-        data_size -= used_size;
-
-        if (pkt->size > 0) {
-            DecodeAudio(codec_ctx, pkt, decoded_frame, outfile_fp);
+        if (pkt->stream_index != audio_index) {
+            av_packet_unref(pkt);
+            continue;
         }
 
-        if (data_size < AUDIO_REFILL_THRESH) {
-            memmove(inbuf, data_buf, data_size);
-            data_buf = inbuf;
-
-            size_t len = fread(data_buf + data_size, 1, AUDIO_INBUF_SIZE - data_size, infile_fp);
-            if (len > 0) {
-                data_size += len;
-            }
+        if (job) {
+            job->UpdatePacket(pkt, stream);
         }
+
+        bool ok = DecodeAudio(codec_ctx, pkt, decoded_frame, &writer);
+        av_packet_unref(pkt);
+        if (!ok)
+            return false;
     }
 
     // Flush the decoder, otherwise the last few frames may be lost.
-    pkt->data = nullptr;
-    pkt->size = 0;
-    DecodeAudio(codec_ctx, pkt, decoded_frame, outfile_fp);
-
-    AVSampleFormat sfmt = codec_ctx->sample_fmt;
-    if (av_sample_fmt_is_planar(sfmt)) {
-        const char* packed = av_get_sample_fmt_name(sfmt);
-        SPDLOG_WARN("Warning: the sample format the decoder produced is planar {0}. This example "
-                    "will output the first channel only.",
-                    packed ? packed : "?");
-        sfmt = av_get_packed_sample_fmt(sfmt);
-    }
+    if (!DecodeAudio(codec_ctx, nullptr, decoded_frame, &writer) || !writer.Close())
+        return false;
 
     const char* fmt = nullptr;
-    if ((ret = get_format_from_sample_fmt(&fmt, sfmt)) < 0) {
-        return false;
+    if ((ret = get_format_from_sample_fmt(&fmt, writer.sample_fmt())) < 0) {
+        return true;
     }
 
-    int channels = codec_ctx->channels;
     SPDLOG_INFO("Play the output audio file with the command:\n"
                 "ffplay -f {0} -ac {1} -ar {2} {3}",
-                fmt, channels, codec_ctx->sample_rate, outfile);
+                fmt, writer.channels(), writer.sample_rate(), outfile);
 
     return true;
 }
 
-int AudioChLayout(int type)
+bool FFmpegHelper::SaveEncodeAudio(const AudioInfo& info, const char* infile, const char* outfile,
+                                   JobContext* job)
 {
-    switch (type) {
-    case 1:
-        return AV_CH_LAYOUT_MONO;
-    case 2:
-        return AV_CH_LAYOUT_STEREO;
-    case 3:
-        return AV_CH_LAYOUT_SURROUND;
-    default:
-        break;
-    }
-
-    return AV_CH_LAYOUT_STEREO;
+    PcmEncoder encoder(info, job);
+    return encoder.Run(infile, outfile);
 }
 
-bool FFmpegHelper::SaveEncodeAudio(const AudioInfo& info, const char* infile, const char* outfile)
-{
-    AVCodec* codec = avcodec_find_encoder(info.codec_id ? AV_CODEC_ID_AAC : AV_CODEC_ID_MP3);
-    if (!codec) {
-        SPDLOG_ERROR("Failed to find audio codec.");
-        return false;
-    }
-
-    AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
-    if (!codec_ctx) {
-        SPDLOG_ERROR("Failed to alloc codec context.");
-        return false;
-    }
-    DEFER(avcodec_free_context(&codec_ctx););
-
-    codec_ctx->bit_rate = info.bit_rate;
-    codec_ctx->sample_rate = info.sample_rate;
-    codec_ctx->channels = info.channels;
-    codec_ctx->channel_layout = AudioChLayout(info.channels);
-    // output fltp
-    codec_ctx->sample_fmt = AV_SAMPLE_FMT_FLTP;
-
-    int ret = avcodec_open2(codec_ctx, codec, nullptr);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-    DEFER(avcodec_close(codec_ctx););
-
-    // open pcm file.
-    FILE* infile_fp = fopen(infile, "rb");
-    if (!infile_fp) {
-        SPDLOG_ERROR("Failed to open infile.");
-        return false;
-    }
-    DEFER(fclose(infile_fp););
-
-    FILE* outfile_fp = fopen(outfile, "wb");
-    if (!outfile_fp) {
-        SPDLOG_ERROR("Failed to open infile.");
-        return false;
-    }
-    DEFER(fclose(outfile_fp););
-
-    // output fomrat
-    AVFormatContext* outfmt_ctx = nullptr;
-    ret = avformat_alloc_output_context2(&outfmt_ctx, nullptr, nullptr, outfile);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-    DEFER(avformat_free_context(outfmt_ctx);)
-
-    AVStream* out_stream = avformat_new_stream(outfmt_ctx, codec);
-    ret = avcodec_parameters_from_context(out_stream->codecpar, codec_ctx);
-    if (ret < 0) {
-        SPDLOG_ERROR("Failed to set parameters from context.");
-        return false;
-    }
-
-    ret = avio_open(&outfmt_ctx->pb, outfile, AVIO_FLAG_WRITE);
-    if (ret < 0) {
-        return false;
-    }
-    DEFER(avio_closep(&outfmt_ctx->pb);)
-
-    ret = avformat_write_header(outfmt_ctx, nullptr);
-    if (ret < 0) {
-        printf("avformat_write_header fail \n");
-        return false;
-    }
-
-    AVPacket* pkt = av_packet_alloc();
-    if (!pkt) {
-        SPDLOG_ERROR("Failed to alloc packet.");
-        return false;
-    }
-    DEFER(av_packet_free(&pkt););
-
-    AVFrame* src_frame = av_frame_alloc();
-    if (!src_frame) {
-        SPDLOG_ERROR("Failed to alloc frame.");
-        return false;
-    }
-    DEFER(av_frame_free(&src_frame););
-
-    src_frame->nb_samples = codec_ctx->frame_size;
-    src_frame->format = AV_SAMPLE_FMT_FLT;
-    src_frame->channel_layout = codec_ctx->channel_layout;
-    src_frame->sample_rate = codec_ctx->sample_rate;
-    ret = av_frame_get_buffer(src_frame, 0);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    AVFrame* dst_frame = av_frame_alloc();
-    if (!dst_frame) {
-        SPDLOG_ERROR("Failed to alloc frame.");
-        return false;
-    }
-    DEFER(av_frame_free(&dst_frame););
-
-    dst_frame->sample_rate = codec_ctx->sample_rate;
-    dst_frame->format = codec_ctx->sample_fmt;
-    dst_frame->channels = codec_ctx->channels;
-    dst_frame->channel_layout = codec_ctx->channel_layout;
-    dst_frame->nb_samples = codec_ctx->frame_size; // encoding: set by libavcodec in avcodec_open2()
-    ret = av_frame_get_buffer(dst_frame, 0);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    int pcm_per_sample_size = av_get_bytes_per_sample(static_cast<AVSampleFormat>(src_frame->format));
-    int pcm_buffer_size = src_frame->nb_samples * pcm_per_sample_size * src_frame->channels;
-
-    uint8_t* pcm_buffer = static_cast<uint8_t*>(av_malloc(pcm_buffer_size));
-    DEFER(av_freep(&pcm_buffer);)
-
-    // Resampling required due to sampling format changes
-    SwrContext* swr_ctx = swr_alloc_set_opts(nullptr, codec_ctx->channel_layout, codec_ctx->sample_fmt,
-                                             codec_ctx->sample_rate, codec_ctx->channel_layout,
-                                             static_cast<AVSampleFormat>(src_frame->format),
-                                             codec_ctx->sample_rate, 0, nullptr);
-    if (!swr_ctx) {
-        SPDLOG_ERROR("Failed to alloc swr ctx.");
-        return false;
-    }
-    DEFER(swr_free(&swr_ctx);)
-
-    ret = swr_init(swr_ctx);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    int pts = 0;
-    while (true) {
-        // Read audio frames one by one.
-        size_t size = fread(pcm_buffer, 1, pcm_buffer_size, infile_fp);
-        if (size == 0) {
-            if (feof(infile_fp)) {
-                SPDLOG_INFO("Data reading complete.");
-            } else if (ferror(infile_fp)) {
-                SPDLOG_ERROR("Failed to read packet.");
-            }
-            break;
-        }
-
-        // Maybe size != pcm_buffer_size
-        int cur_nb_samples = size / (pcm_per_sample_size * src_frame->channels);
-        src_frame->nb_samples = cur_nb_samples;
-        dst_frame->nb_samples = cur_nb_samples;
-
-        // Pcm buffer fill to src frame arrays
-        ret = av_samples_fill_arrays(src_frame->data, src_frame->linesize, pcm_buffer,
-                                     src_frame->channels, src_frame->nb_samples,
-                                     static_cast<AVSampleFormat>(src_frame->format), 0);
-        if (ret < 0) {
-            FFmpegError(ret);
-            return false;
-        }
-
-        // convert audio
-        ret = swr_convert(swr_ctx, dst_frame->data, dst_frame->nb_samples,
-                          const_cast<const uint8_t**>(src_frame->data), src_frame->nb_samples);
-        if (ret < 0) {
-            FFmpegError(ret);
-            return false;
-        }
-
-        dst_frame->pts = pts++;
-        EncodeAudio(codec_ctx, dst_frame, pkt, outfmt_ctx);
-    }
-    EncodeAudio(codec_ctx, nullptr, pkt, outfmt_ctx);
-
-    ret = av_write_trailer(outfmt_ctx);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    return true;
-}
-
-bool FFmpegHelper::SaveDecodeVideo(const VideoInfo& info, const char* infile, const char* outfile)
+bool FFmpegHelper::SaveDecodeVideo(const VideoInfo& info, const char* infile, const char* outfile,
+                                   JobContext* job)
 {
     AVFormatContext* fmt_ctx = nullptr;
-    int ret = avformat_open_input(&fmt_ctx, infile, nullptr, nullptr);
+    int ret = OpenInput(&fmt_ctx, infile, job);
     if (ret < 0) {
         FFmpegError(ret);
         return false;
@@ -798,6 +465,7 @@ bool FFmpegHelper::SaveDecodeVideo(const VideoInfo& info, const char* infile, co
         FFmpegError(ret);
         return false;
     }
+    codec_ctx->thread_count = 0; // decode on all cores, the pipeline keeps up
 
     ret = avcodec_open2(codec_ctx, codec, nullptr);
     if (ret < 0) {
@@ -820,13 +488,6 @@ bool FFmpegHelper::SaveDecodeVideo(const VideoInfo& info, const char* infile, co
     }
     DEFER(av_frame_free(&src_frame););
 
-    FILE* outfile_fp = fopen(outfile, "wb");
-    if (!outfile_fp) {
-        SPDLOG_ERROR("Failed to open outfile.");
-        return false;
-    }
-    DEFER(fclose(outfile_fp););
-
     int width;
     int height;
     ret = av_parse_video_size(&width, &height, info.video_size.c_str());
@@ -838,61 +499,88 @@ bool FFmpegHelper::SaveDecodeVideo(const VideoInfo& info, const char* infile, co
     AVPixelFormat src_fmt = static_cast<AVPixelFormat>(stream->codecpar->format);
     AVPixelFormat dst_fmt = info.pix_fmt == 0 ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_RGB24;
 
-    AVFrame* dst_frame = av_frame_alloc();
-    if (!dst_frame) {
-        SPDLOG_ERROR("Failed to alloc frame.");
-        return false;
-    }
-    DEFER(av_frame_free(&dst_frame);)
-
-    dst_frame->width = width;
-    dst_frame->height = height;
-    dst_frame->format = dst_fmt;
-    ret = av_frame_get_buffer(dst_frame, 0);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-
-    SwsContext* sws_ctx =
-        sws_getContext(stream->codecpar->width, stream->codecpar->height, src_fmt, width, height,
-                       dst_fmt, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
-    if (!sws_ctx) {
-        SPDLOG_ERROR("Failed to get sws context.");
-        return false;
-    }
-    DEFER(sws_freeContext(sws_ctx);)
+    // A .y4m outfile carries size, rate and aspect, so players need no extra options.
+    const char* ext = strrchr(outfile, '.');
+    bool y4m = ext && av_strcasecmp(ext, ".y4m") == 0;
+
+    RawDumpPipeline pipeline(job);
+    if (!pipeline.Open(outfile, width, height, dst_fmt,
+                       av_guess_frame_rate(fmt_ctx, stream, nullptr),
+                       stream->codecpar->sample_aspect_ratio, y4m)) {
+        return false;
+    }
+
+    if (job) {
+        job->set_duration(fmt_ctx->duration);
+    }
+
+    // Decode here, scaling and writing run on the pipeline threads.
+    bool ok = true;
+    bool flushing = false;
+    while (ok) {
+        if (!flushing) {
+            ret = av_read_frame(fmt_ctx, pkt);
+            if (ret == AVERROR(EAGAIN)) {
+                // No packet yet on a live input, only AVERROR_EOF ends the stream.
+                if (Cancelled(job)) {
+                    ok = false;
+                    break;
+                }
+                av_usleep(READ_AGAIN_INTERVAL);
+                continue;
+            } else if (ret == AVERROR_EOF) {
+                flushing = true;
+            } else if (ret < 0) {
+                if (!Cancelled(job)) {
+                    FFmpegError(ret);
+                }
+                ok = false;
+                break;
+            } else if (pkt->stream_index != video_index) {
+                av_packet_unref(pkt);
+                continue;
+            } else if (job) {
+                job->UpdatePacket(pkt, stream);
+            }
+        }
 
-    // Write frame to outfile
-    while (ret >= 0) {
-        ret = av_read_frame(fmt_ctx, pkt);
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            break;
-        } else if (ret < 0) {
+        ret = avcodec_send_packet(codec_ctx, flushing ? nullptr : pkt);
+        av_packet_unref(pkt);
+        if (ret < 0) {
             FFmpegError(ret);
-            return false;
+            ok = false;
+            break;
         }
 
-        if (pkt->stream_index != video_index) {
-            continue;
+        while (ok) {
+            ret = avcodec_receive_frame(codec_ctx, src_frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                break;
+            } else if (ret < 0) {
+                FFmpegError(ret);
+                ok = false;
+            } else {
+                ok = pipeline.Push(src_frame);
+            }
         }
 
-        DecodeVideo(sws_ctx, codec_ctx, dst_fmt, pkt, src_frame, dst_frame, outfile_fp);
-
-        av_packet_unref(pkt);
+        if (flushing)
+            break;
     }
-    // Flush decoder
-    DecodeVideo(sws_ctx, codec_ctx, dst_fmt, nullptr, src_frame, dst_frame, outfile_fp);
 
-    av_frame_unref(dst_frame);
+    // Finish even after an error, so the stage threads are joined.
+    ok = pipeline.Finish() && ok && !Cancelled(job);
 
-    SPDLOG_INFO("src video size:[{0}x{1}], format:{2}, dest video size:[{3}x{4}], format:{5}]",
-                codec_ctx->width, codec_ctx->height, src_fmt, width, height, dst_fmt);
+    SPDLOG_INFO("src video size:[{0}x{1}], format:{2}, dest video size:[{3}x{4}], format:{5}], "
+                "frames:{6}",
+                codec_ctx->width, codec_ctx->height, src_fmt, width, height, dst_fmt,
+                pipeline.frames());
 
-    return true;
+    return ok;
 }
 
-bool FFmpegHelper::SaveEncodeVideo(const VideoInfo& info, const char* infile, const char* outfile)
+bool FFmpegHelper::SaveEncodeVideo(const VideoInfo& info, const char* infile, const char* outfile,
+                                   JobContext* job)
 {
     AVCodec* codec = avcodec_find_encoder_by_name(info.codec_name.c_str());
     if (!codec) {
@@ -900,6 +588,22 @@ bool FFmpegHelper::SaveEncodeVideo(const VideoInfo& info, const char* infile, co
         return false;
     }
 
+    // Headerless input needs the size, a Y4M header brings its own.
+    int width = 0;
+    int height = 0;
+    if (!info.video_size.empty()) {
+        int ret = av_parse_video_size(&width, &height, info.video_size.c_str());
+        if (ret < 0) {
+            SPDLOG_ERROR("Failed to parse video size:{0}.", info.video_size);
+            return false;
+        }
+    }
+
+    // Declared before the encoder, which may still hold frames of the mapping when it is freed.
+    RawVideoReader reader;
+    if (!reader.Open(infile, width, height))
+        return false;
+
     AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
     if (!codec_ctx) {
         SPDLOG_ERROR("Failed to alloc codec context.");
@@ -907,20 +611,16 @@ bool FFmpegHelper::SaveEncodeVideo(const VideoInfo& info, const char* infile, co
     }
     DEFER(avcodec_free_context(&codec_ctx);)
 
-    int width;
-    int height;
-    int ret = av_parse_video_size(&width, &height, info.video_size.c_str());
-    if (ret < 0) {
-        SPDLOG_ERROR("Failed to parse video size:{0}.", info.video_size);
-        return false;
-    }
+    AVRational framerate = reader.y4m() ? reader.frame_rate() : AVRational{info.framerate, 1};
 
     // Encoder params
-    codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
-    codec_ctx->width = width;
-    codec_ctx->height = height;
-    codec_ctx->framerate = {info.framerate, 1};
-    codec_ctx->time_base = {1, info.framerate};
+    codec_ctx->pix_fmt = reader.pix_fmt();
+    codec_ctx->width = reader.width();
+    codec_ctx->height = reader.height();
+    codec_ctx->sample_aspect_ratio = reader.sample_aspect_ratio();
+    codec_ctx->color_range = reader.color_range();
+    codec_ctx->framerate = framerate;
+    codec_ctx->time_base = av_inv_q(framerate);
     codec_ctx->bit_rate = info.bit_rate;
     codec_ctx->gop_size = info.gop_size;
     codec_ctx->max_b_frames = info.max_b_frames;
@@ -929,21 +629,13 @@ bool FFmpegHelper::SaveEncodeVideo(const VideoInfo& info, const char* infile, co
         av_opt_set(codec_ctx->priv_data, "preset", "slow", 0);
     }
 
-    ret = avcodec_open2(codec_ctx, codec, nullptr);
+    int ret = avcodec_open2(codec_ctx, codec, nullptr);
     if (ret < 0) {
         FFmpegError(ret);
         return false;
     }
     DEFER(avcodec_close(codec_ctx);)
 
-    // Intput and output file
-    FILE* infile_fp = fopen(infile, "rb");
-    if (!infile_fp) {
-        SPDLOG_ERROR("Failed to open infile.");
-        return false;
-    }
-    DEFER(fclose(infile_fp););
-
     FILE* outfile_fp = fopen(outfile, "wb");
     if (!outfile_fp) {
         SPDLOG_ERROR("Failed to open output file.");
@@ -951,7 +643,6 @@ bool FFmpegHelper::SaveEncodeVideo(const VideoInfo& info, const char* infile, co
     }
     DEFER(fclose(outfile_fp);)
 
-
     AVPacket* pkt = av_packet_alloc();
     if (!pkt) {
         SPDLOG_ERROR("Failed to alloc packet.");
@@ -966,34 +657,28 @@ bool FFmpegHelper::SaveEncodeVideo(const VideoInfo& info, const char* infile, co
     }
     DEFER(av_frame_free(&frame);)
 
-    frame->format = codec_ctx->pix_fmt;
-    frame->width = codec_ctx->width;
-    frame->height = codec_ctx->height;
-
-    // Malloc image buffer
-    // yuv420p: w * h * 3/2
-    uint8_t* frame_buffer = static_cast<uint8_t*>(av_malloc(
-        av_image_get_buffer_size(codec_ctx->pix_fmt, codec_ctx->width, codec_ctx->height, 1)));
-    DEFER(av_freep(&frame_buffer);)
-
-    // Fill data and linesize
-    av_image_fill_arrays(frame->data, frame->linesize, frame_buffer, codec_ctx->pix_fmt,
-                         codec_ctx->width, codec_ctx->height, 1);
-
     SPDLOG_INFO("Start video encoding encoder:{0}, video size:[{1}x{2}], pixel format:{3}.",
-                codec->name, width, height, (int)codec_ctx->pix_fmt);
+                codec->name, codec_ctx->width, codec_ctx->height, (int)codec_ctx->pix_fmt);
 
-    int video_size = width * height;
+    // The frames point into the mapped infile, nothing is read or copied here.
+    while ((ret = reader.ReadFrame(frame)) == 0) {
+        if (Cancelled(job))
+            return false;
 
-    int frame_num = 0;
-    while (fread(frame_buffer, 1, video_size * 3 / 2, infile_fp) == video_size * 3 / 2) {
-        frame->data[0] = frame_buffer;
-        frame->data[1] = frame_buffer + video_size;
-        frame->data[2] = frame_buffer + video_size + video_size / 4;
-        // Presentation time order in encoder.
-        frame->pts = frame_num++;
+        int64_t frame_bytes = frame->buf[0]->size;
 
         EncodeVideo(codec_ctx, frame, pkt, outfile_fp);
+        av_frame_unref(frame);
+
+        if (job) {
+            job->AddFrames(1);
+            job->AddBytes(frame_bytes);
+            job->UpdatePosition(reader.position(), reader.size());
+        }
+    }
+    if (ret != AVERROR_EOF) {
+        FFmpegError(ret);
+        return false;
     }
     EncodeVideo(codec_ctx, nullptr, pkt, outfile_fp);
 
@@ -1006,15 +691,76 @@ bool FFmpegHelper::SaveEncodeVideo(const VideoInfo& info, const char* infile, co
     return true;
 }
 
-bool FFmpegHelper::ExportSingleStream(int media_type, const char* infile, const char* outfile)
+bool FFmpegHelper::SaveSegmentedVideo(const VideoInfo& info, const char* infile, const char* outfile,
+                                      int segments, JobContext* job)
+{
+    SegmentTranscoder transcoder(info, job);
+    return transcoder.Run(infile, outfile, segments);
+}
+
+bool FFmpegHelper::SaveRenditions(const VideoInfo& info, const char* infile,
+                                  const std::vector<Rendition>& renditions, JobContext* job)
+{
+    RenditionLadder ladder(info, job);
+    return ladder.Run(infile, renditions);
+}
+
+bool FFmpegHelper::ExportSingleStream(int media_type, const char* infile, const char* outfile,
+                                      JobContext* job)
+{
+    ExportTarget target;
+    target.media_type = media_type;
+    target.outfile = outfile;
+
+    return ExportStreams(infile, std::vector<ExportTarget>(1, target), job);
+}
+
+bool FFmpegHelper::ExportStreams(const char* infile, const std::vector<ExportTarget>& targets,
+                                 JobContext* job)
 {
-    AVFormatContext* infmt_ctx = nullptr;
+    if (targets.empty())
+        return false;
+
+    uint8_t* map_buf = nullptr;
+    size_t map_size = 0;
+    MappedFile file = {nullptr, 0, 0};
+    AVIOContext* avio_ctx = nullptr;
+
+    AVFormatContext* infmt_ctx = avformat_alloc_context();
+    if (!infmt_ctx) {
+        FFmpegError(AVERROR(ENOMEM));
+        return false;
+    }
+    DEFER(avformat_close_input(&infmt_ctx); if (avio_ctx) { av_freep(&avio_ctx->buffer); }
+          avio_context_free(&avio_ctx); if (map_buf) { av_file_unmap(map_buf, map_size); })
+
+    // Local files are mapped and read in large blocks, other inputs use their protocol.
+    if (av_file_map(infile, &map_buf, &map_size, 0, nullptr) >= 0) {
+        file.base = map_buf;
+        file.size = map_size;
+
+        uint8_t* avio_buf = static_cast<uint8_t*>(av_malloc(EXPORT_READ_BUFFER_SIZE));
+        if (avio_buf) {
+            avio_ctx = avio_alloc_context(avio_buf, EXPORT_READ_BUFFER_SIZE, 0, &file, read_mapped,
+                                          nullptr, seek_mapped);
+        }
+        if (!avio_ctx) {
+            av_free(avio_buf);
+            FFmpegError(AVERROR(ENOMEM));
+            return false;
+        }
+        infmt_ctx->pb = avio_ctx;
+    }
+
+    if (job) {
+        infmt_ctx->interrupt_callback = job->interrupt_cb();
+    }
+
     int ret = avformat_open_input(&infmt_ctx, infile, nullptr, nullptr);
     if (ret < 0) {
         FFmpegError(ret);
         return false;
     }
-    DEFER(avformat_close_input(&infmt_ctx););
 
     // Fill stream info
     ret = avformat_find_stream_info(infmt_ctx, nullptr);
@@ -1023,92 +769,142 @@ bool FFmpegHelper::ExportSingleStream(int media_type, const char* infile, const
         return false;
     }
 
-    ret = av_find_best_stream(infmt_ctx, static_cast<AVMediaType>(media_type), -1, -1, nullptr, 0);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
+    // One muxer per target, routes map input streams to them.
+    std::vector<AVFormatContext*> outputs;
+    std::vector<std::vector<int>> routes(infmt_ctx->nb_streams);
+    DEFER(for (auto outfmt_ctx : outputs) {
+        if (!(outfmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&outfmt_ctx->pb);
+        }
+        avformat_free_context(outfmt_ctx);
+    })
+
+    for (const auto& target : targets) {
+        ret = av_find_best_stream(infmt_ctx, static_cast<AVMediaType>(target.media_type), -1, -1,
+                                  nullptr, 0);
+        if (ret < 0) {
+            FFmpegError(ret);
+            return false;
+        }
+        int dump_index = ret;
 
-    int dump_index = ret;
+        AVFormatContext* outfmt_ctx = nullptr;
+        ret = avformat_alloc_output_context2(&outfmt_ctx, nullptr, nullptr, target.outfile.c_str());
+        if (ret < 0) {
+            FFmpegError(ret);
+            return false;
+        }
+        outputs.push_back(outfmt_ctx);
 
-    AVFormatContext* outfmt_ctx = nullptr;
-    ret = avformat_alloc_output_context2(&outfmt_ctx, nullptr, nullptr, outfile);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
-    }
-    DEFER(avformat_free_context(outfmt_ctx);)
+        if (!(outfmt_ctx->oformat->flags & AVFMT_NOFILE)) {
+            ret = OpenOutputIO(outfmt_ctx, target.outfile.c_str(), job);
+            if (ret < 0) {
+                FFmpegError(ret);
+                return false;
+            }
+        }
+
+        // Copy stream params
+        AVStream* out_stream = avformat_new_stream(outfmt_ctx, nullptr);
+        if (!out_stream) {
+            SPDLOG_ERROR("Failed to create out stream");
+            return false;
+        }
 
-    if (!(outfmt_ctx->oformat->flags & AVFMT_NOFILE)) {
-        ret = avio_open(&outfmt_ctx->pb, outfile, AVIO_FLAG_WRITE);
+        ret = avcodec_parameters_copy(out_stream->codecpar,
+                                      infmt_ctx->streams[dump_index]->codecpar);
         if (ret < 0) {
             FFmpegError(ret);
             return false;
         }
-    }
-    DEFER(avio_closep(&outfmt_ctx->pb);)
+        // Solve incompatible for codec
+        out_stream->codecpar->codec_tag = 0;
 
-    // Copy stream params
-    AVStream* in_stream = infmt_ctx->streams[dump_index];
-    AVStream* out_stream = avformat_new_stream(outfmt_ctx, nullptr);
-    if (!out_stream) {
-        SPDLOG_ERROR("Failed to create out stream");
-        return false;
-    }
+        ret = avformat_write_header(outfmt_ctx, nullptr);
+        if (ret < 0) {
+            FFmpegError(ret);
+            return false;
+        }
 
-    ret = avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
+        routes[dump_index].push_back(static_cast<int>(outputs.size() - 1));
     }
-    // Solve incompatible for codec
-    out_stream->codecpar->codec_tag = 0;
 
-    ret = avformat_write_header(outfmt_ctx, nullptr);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
+    // The demuxer skips the packets nobody wants.
+    for (unsigned int i = 0; i < infmt_ctx->nb_streams; ++i) {
+        if (routes[i].empty()) {
+            infmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
     }
 
     AVPacket* pkt = av_packet_alloc();
-    if (!pkt) {
+    AVPacket* ref_pkt = av_packet_alloc();
+    DEFER(av_packet_free(&pkt); av_packet_free(&ref_pkt);)
+    if (!pkt || !ref_pkt) {
         SPDLOG_ERROR("Failed to alloc packet.");
         return false;
     }
-    DEFER(av_packet_free(&pkt);)
 
-    while (av_read_frame(infmt_ctx, pkt) == 0) {
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+    if (job) {
+        job->set_duration(infmt_ctx->duration);
+    }
+
+    while (!Cancelled(job)) {
+        ret = av_read_frame(infmt_ctx, pkt);
+        if (ret == AVERROR_EOF) {
             break;
         } else if (ret < 0) {
-            FFmpegError(ret);
+            if (!Cancelled(job)) {
+                FFmpegError(ret);
+            }
             return false;
         }
 
-        if (pkt->stream_index != dump_index) {
-            av_packet_unref(pkt);
-            continue;
-        }
+        AVStream* in_stream = infmt_ctx->streams[pkt->stream_index];
+        const std::vector<int>& route = routes[pkt->stream_index];
+        if (job) {
+            job->UpdatePacket(pkt, in_stream);
+        }
+
+        for (size_t i = 0; i < route.size(); ++i) {
+            AVFormatContext* outfmt_ctx = outputs[route[i]];
+            AVStream* out_stream = outfmt_ctx->streams[0];
+
+            // The last output takes the packet, the others a new reference to its data.
+            AVPacket* out_pkt = pkt;
+            if (i + 1 < route.size()) {
+                ret = av_packet_ref(ref_pkt, pkt);
+                if (ret < 0) {
+                    FFmpegError(ret);
+                    return false;
+                }
+                out_pkt = ref_pkt;
+            }
 
-        av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base); // pts, dts, duration...
-        pkt->pos = -1;
-        pkt->stream_index = 0;
+            av_packet_rescale_ts(out_pkt, in_stream->time_base, out_stream->time_base);
+            out_pkt->pos = -1;
+            out_pkt->stream_index = 0;
 
-        ret = av_interleaved_write_frame(outfmt_ctx, pkt);
-        if (ret < 0) {
-            FFmpegError(ret);
-            av_packet_unref(pkt);
-            break;
+            ret = av_interleaved_write_frame(outfmt_ctx, out_pkt);
+            if (ret < 0) {
+                FFmpegError(ret);
+                av_packet_unref(pkt);
+                return false;
+            }
         }
 
         av_packet_unref(pkt);
     }
 
-    ret = av_write_trailer(outfmt_ctx);
-    if (ret < 0) {
-        FFmpegError(ret);
-        return false;
+    bool ok = !Cancelled(job);
+    for (auto outfmt_ctx : outputs) {
+        ret = av_write_trailer(outfmt_ctx);
+        if (ret < 0) {
+            FFmpegError(ret);
+            ok = false;
+        }
     }
 
-    return true;
+    SPDLOG_INFO("Exported {0} streams of {1} in one pass.", outputs.size(), infile);
+
+    return ok;
 }
@@ -2,6 +2,8 @@
 #define FFMPEGHELPER_H_
 
 #include <functional>
+#include <string>
+#include <vector>
 extern "C"
 {
 #include "libavformat/avformat.h"
@@ -9,6 +11,10 @@ extern "C"
 #include "libswscale/swscale.h"
 }
 
+#include "job/job_context.h"
+
+class PcmWriter;
+
 using Function = std::function<void()>;
 
 // same as golang defer
@@ -49,29 +55,70 @@ public:
         int gop_size;
         int max_b_frames;
 
-        int start_time;
-        int end_time;
+        int start_time; // ms
+        int end_time;   // ms
     };
 
     struct AudioInfo
     {
-        int codec_id; // 0: mp3, 1: aac
+        int codec_id; // 0: mp3, 1: aac, 2: opus
         int bit_rate;
         int sample_rate;
-        int channels; // 1: mono, 2: stereo, 3: surround
+        int channels;   // 1: mono, 2: stereo, 3: surround
+        int sample_fmt; // decoded output or encoded input, AV_SAMPLE_FMT_NONE for the default
     };
 
     static void FFmpegError(int code);
+    static int64_t FileSize(FILE* fp);
 
     static bool ReadMediaByAvio(const char* filename);
 
-    static bool SaveTranscodeFormat(const VideoInfo& info, const char* infile, const char* outfile);
+    // The optional job reports progress and throughput, and cancels the operation.
+
+    /**
+     * @brief Remux the range [start_time, end_time) of the input into the format of the outfile.
+     *
+     * Cuts are frame accurate, whole GOPs are copied and only the partial GOPs at the cut points
+     * are re-encoded. An end_time at or before start_time keeps the rest of the input.
+     */
+    static bool SaveTranscodeFormat(const VideoInfo& info, const char* infile, const char* outfile,
+                                    JobContext* job = nullptr);
+
+    /**
+     * @brief Decode the best audio stream of any container into headerless packed PCM.
+     *
+     * @param info only sample_fmt is used, AV_SAMPLE_FMT_NONE keeps the decoder format
+     */
+    static bool SaveDecodeAudio(const AudioInfo& info, const char* infile, const char* outfile,
+                                JobContext* job = nullptr);
 
-    static bool SaveDecodeAudio(const char* infile, const char* outfile);
-    static bool SaveEncodeAudio(const AudioInfo& info, const char* infile, const char* outfile);
+    /**
+     * @brief Encode headerless PCM to the codec of info, see PcmEncoder.
+     */
+    static bool SaveEncodeAudio(const AudioInfo& info, const char* infile, const char* outfile,
+                                JobContext* job = nullptr);
 
-    static bool SaveDecodeVideo(const VideoInfo& info, const char* infile, const char* outfile);
-    static bool SaveEncodeVideo(const VideoInfo& info, const char* infile, const char* outfile);
+    static bool SaveDecodeVideo(const VideoInfo& info, const char* infile, const char* outfile,
+                                JobContext* job = nullptr);
+
+    /**
+     * @brief Encode raw I420 or Y4M video, the infile is memory mapped.
+     *
+     * @param info encoder parameters, the video size and frame rate are taken from a Y4M header
+     */
+    static bool SaveEncodeVideo(const VideoInfo& info, const char* infile, const char* outfile,
+                                JobContext* job = nullptr);
+
+    /**
+     * @brief Transcode the video of a media file in keyframe aligned segments on all cores.
+     *
+     * @param info encoder parameters, an empty video size or a zero frame rate keeps the input's
+     * @param segments count of segments, 0 for one per core
+     *
+     * @return Success or failure
+     */
+    static bool SaveSegmentedVideo(const VideoInfo& info, const char* infile, const char* outfile,
+                                   int segments = 0, JobContext* job = nullptr);
 
     /**
      * @brief Dump single stream from the input media file.
@@ -79,10 +126,47 @@ public:
      * @param media_type video: 0 audio: 1 subtitle: 3
      * @param infile input media file
      * @param outfile output media file
+     * @param job optional progress and cancellation
      *
      * @return Success or failure
      */
-    static bool ExportSingleStream(int media_type, const char* infile, const char* outfile);
+    static bool ExportSingleStream(int media_type, const char* infile, const char* outfile,
+                                   JobContext* job = nullptr);
+
+    struct ExportTarget
+    {
+        int media_type; // video: 0 audio: 1 subtitle: 3
+        std::string outfile;
+    };
+
+    /**
+     * @brief Dump several streams from the input media file in a single pass.
+     *
+     * The input is read once through a large buffer and every packet is routed to the muxers of
+     * the targets that want its stream.
+     *
+     * @return Success or failure
+     */
+    static bool ExportStreams(const char* infile, const std::vector<ExportTarget>& targets,
+                              JobContext* job = nullptr);
+
+    struct Rendition
+    {
+        std::string outfile; // The container follows the suffix
+        int width;           // 0 keeps the aspect ratio of the input
+        int height;
+        int bit_rate;
+    };
+
+    /**
+     * @brief Transcode the video of a media file into several sizes from a single decode.
+     *
+     * @param info codec name, gop size and max b frames shared by the renditions
+     *
+     * @return Success or failure, see RenditionLadder
+     */
+    static bool SaveRenditions(const VideoInfo& info, const char* infile,
+                               const std::vector<Rendition>& renditions, JobContext* job = nullptr);
 
 private:
     struct BufferData
@@ -92,13 +176,24 @@ private:
     };
     static int read_packet(void* opaque, uint8_t* buf, int buf_size);
 
-    static void DecodeAudio(AVCodecContext* codec_ctx, AVPacket* pkt, AVFrame* frame, FILE* outfile_fp);
-    static void EncodeAudio(AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* pkt,
-                            AVFormatContext* outfmt_ctx);
+    struct MappedFile
+    {
+        const uint8_t* base;
+        size_t size;
+        size_t pos;
+    };
+    static int read_mapped(void* opaque, uint8_t* buf, int buf_size);
+    static int64_t seek_mapped(void* opaque, int64_t offset, int whence);
+
+    // Open the input with the interrupt callback of the job installed.
+    static int OpenInput(AVFormatContext** fmt_ctx, const char* infile, JobContext* job);
+    static int OpenOutputIO(AVFormatContext* fmt_ctx, const char* outfile, JobContext* job);
+    static bool Cancelled(JobContext* job) { return job && job->cancelled(); }
+
+    static bool DecodeAudio(AVCodecContext* codec_ctx, AVPacket* pkt, AVFrame* frame,
+                            PcmWriter* writer);
 
     static void EncodeVideo(AVCodecContext* codec_ctx, AVFrame* frame, AVPacket* pkt, FILE* outfile_fp);
-    static void DecodeVideo(SwsContext* sws_ctx, AVCodecContext* codec_ctx, AVPixelFormat fmt,
-                            AVPacket* pkt, AVFrame* src_frame, AVFrame* dst_frame, FILE* outfile_fp);
 };
 
 #endif
@@ -6,13 +6,10 @@
 FFmpegWriter::FFmpegWriter()
     : opened_(false)
     , stop_(false)
-    , fmt_ctx_(nullptr)
     , codec_(nullptr)
     , codec_ctx_(nullptr)
-    , video_stream_(nullptr)
     , frame_(nullptr)
     , packet_(nullptr)
-    , header_written_(false)
     , frame_index_(0)
 {}
 
@@ -23,6 +20,11 @@ void FFmpegWriter::set_media(const MediaInfo& media)
     media_ = media;
 }
 
+void FFmpegWriter::AddSink(const std::string& url, MuxSink::Policy policy)
+{
+    sinks_.emplace_back(new MuxSink(url, policy));
+}
+
 bool FFmpegWriter::Open(const EncodeDataInfo& encode_info)
 {
     const char* filename = media_.src.c_str();
@@ -46,23 +48,6 @@ bool FFmpegWriter::Open(const EncodeDataInfo& encode_info)
     }
     SPDLOG_INFO("Find the encoder name: {0}", codec_->name);
 
-    int error_code = avformat_alloc_output_context2(&fmt_ctx_, nullptr, nullptr, filename);
-    if (error_code < 0) {
-        SPDLOG_ERROR("Failed to alloc output context from file extension.");
-
-        error_code = avformat_alloc_output_context2(&fmt_ctx_, nullptr, "mp4", filename);
-        if (error_code) {
-            SPDLOG_ERROR("Failed to alloc output context for mp4.");
-            return false;
-        }
-    }
-
-    error_code = avio_open(&fmt_ctx_->pb, filename, AVIO_FLAG_WRITE);
-    if (error_code < 0) {
-        SPDLOG_ERROR("Failed to open avio filename: {0}.", filename);
-        return false;
-    }
-
     codec_ctx_ = avcodec_alloc_context3(codec_);
     if (!codec_ctx_) {
         SPDLOG_ERROR("Failed to alloc codec context");
@@ -81,31 +66,26 @@ bool FFmpegWriter::Open(const EncodeDataInfo& encode_info)
     codec_ctx_->pix_fmt = pix_fmt;
     codec_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
 
-    error_code = avcodec_open2(codec_ctx_, nullptr, nullptr);
+    int error_code = avcodec_open2(codec_ctx_, nullptr, nullptr);
     if (error_code < 0) {
         FFmpegHelper::FFmpegError(error_code);
         return false;
     }
 
-    video_stream_ = avformat_new_stream(fmt_ctx_, nullptr);
-    if (!video_stream_) {
-        SPDLOG_ERROR("Failed to create new video stream.");
-        return false;
-    }
+    // The recording must open, a mirror that does not is left out.
+    sinks_.emplace(sinks_.begin(), new MuxSink(filename, MuxSink::kBlock));
+    for (auto it = sinks_.begin(); it != sinks_.end();) {
+        if ((*it)->Open(codec_ctx_)) {
+            ++it;
+            continue;
+        }
 
-    error_code = avcodec_parameters_from_context(video_stream_->codecpar, codec_ctx_);
-    if (error_code < 0) {
-        FFmpegHelper::FFmpegError(error_code);
-        return false;
-    }
+        if (it == sinks_.begin())
+            return false;
 
-    // note
-    error_code = avformat_write_header(fmt_ctx_, nullptr);
-    if (error_code < 0) {
-        FFmpegHelper::FFmpegError(error_code);
-        return false;
+        SPDLOG_WARN("Failed to open sink {0}, skipped.", (*it)->url());
+        it = sinks_.erase(it);
     }
-    header_written_ = true;
 
     frame_ = av_frame_alloc();
     if (!frame_) {
@@ -159,15 +139,15 @@ bool FFmpegWriter::Write(const DecodeFrame& frame)
             return false;
         }
 
-        av_packet_rescale_ts(packet_, codec_ctx_->time_base, video_stream_->time_base);
-        ret = av_interleaved_write_frame(fmt_ctx_, packet_);
-        if (ret < 0) {
-            FFmpegHelper::FFmpegError(ret);
-            av_packet_unref(packet_);
-            break;
+        // Every sink takes its own reference, the payload is not copied.
+        bool recorded = sinks_.front()->Push(packet_);
+        for (size_t i = 1; i < sinks_.size(); ++i) {
+            sinks_[i]->Push(packet_);
         }
-
         av_packet_unref(packet_);
+
+        if (!recorded)
+            return false;
     }
 
     return true;
@@ -180,19 +160,10 @@ void FFmpegWriter::Close()
 
     std::unique_lock<std::mutex> lock(mutex_);
 
-    if (fmt_ctx_) {
-        if (header_written_) {
-            header_written_ = false;
-
-            int error_code = av_write_trailer(fmt_ctx_);
-            if (error_code < 0) {
-                FFmpegHelper::FFmpegError(error_code);
-                return;
-            }
-            SPDLOG_INFO("Stop record.");
-        }
-        avio_close(fmt_ctx_->pb);
+    for (auto& sink : sinks_) {
+        sink->Close();
     }
+    SPDLOG_INFO("Stop record.");
 
     frame_index_ = 0;
     opened_ = false;
@@ -202,10 +173,7 @@ void FFmpegWriter::Close()
 
 void FFmpegWriter::FreeResource()
 {
-    if (fmt_ctx_) {
-        avformat_free_context(fmt_ctx_);
-        fmt_ctx_ = nullptr;
-    }
+    sinks_.clear();
 
     if (codec_ctx_) {
         avcodec_free_context(&codec_ctx_);
@@ -2,7 +2,10 @@
 #define FFMPEGWRITER_H_
 
 #include <atomic>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <vector>
 
 extern "C"
 {
@@ -14,8 +17,15 @@ extern "C"
 }
 
 #include "common/media_info.h"
+#include "mux_sink.h"
 #include "util/decode_frame.h"
 
+/**
+ * @brief Encodes frames once and muxes the packets into any number of sinks.
+ *
+ * The src of the media is the recording, written without loss. Further sinks, such as a local
+ * MPEG-TS over UDP consumer, get the same packets and drop on their own when they fall behind.
+ */
 class FFmpegWriter
 {
 public:
@@ -24,6 +34,11 @@ public:
 
     void set_media(const MediaInfo& media);
 
+    /**
+     * @brief Mirror the encoded stream to another url, call before Open.
+     */
+    void AddSink(const std::string& url, MuxSink::Policy policy = MuxSink::kDropToKeyframe);
+
     bool Open(const EncodeDataInfo& encode_info);
     bool Write(const DecodeFrame& frame);
     void Close();
@@ -41,15 +56,14 @@ private:
     std::atomic<bool> opened_;
     std::atomic<bool> stop_;
 
-    AVFormatContext* fmt_ctx_;
     AVCodec* codec_;
     AVCodecContext* codec_ctx_;
-    AVStream* video_stream_;
 
     AVFrame* frame_;
     AVPacket* packet_;
 
-    bool header_written_;
+    // The recording first, then the mirrors
+    std::vector<std::unique_ptr<MuxSink>> sinks_;
 
     std::mutex mutex_;
     int64_t frame_index_;
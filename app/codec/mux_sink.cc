@@ -0,0 +1,199 @@
+#include "mux_sink.h"
+
+#include "ffmpeghelper.h"
+#include "spdlog/spdlog.h"
+
+#define MUX_SINK_QUEUE_SIZE 64 // packets
+
+// Network protocols without a container of their own.
+static const char* GuessFormat(const std::string& url)
+{
+    if (url.compare(0, 6, "udp://") == 0 || url.compare(0, 6, "rtp://") == 0
+        || url.compare(0, 6, "srt://") == 0 || url.compare(0, 6, "tcp://") == 0)
+        return "mpegts";
+    if (url.compare(0, 7, "rtsp://") == 0)
+        return "rtsp";
+    if (url.compare(0, 7, "rtmp://") == 0)
+        return "flv";
+
+    return nullptr;
+}
+
+MuxSink::MuxSink(const std::string& url, Policy policy)
+    : url_(url)
+    , policy_(policy)
+    , fmt_ctx_(nullptr)
+    , stream_(nullptr)
+    , codec_time_base_({1, 1})
+    , header_written_(false)
+    , packets_(MUX_SINK_QUEUE_SIZE)
+    , failed_(false)
+    , aborted_(false)
+    , wait_keyframe_(false)
+    , written_(0)
+    , dropped_(0)
+{}
+
+MuxSink::~MuxSink()
+{
+    aborted_ = true;
+    packets_.Close();
+
+    if (mux_thread_) {
+        mux_thread_->wait();
+        mux_thread_.reset();
+    }
+
+    AVPacket* packet = nullptr;
+    while (packets_.Pop(&packet)) {
+        av_packet_free(&packet);
+    }
+
+    if (fmt_ctx_) {
+        if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&fmt_ctx_->pb);
+        }
+        avformat_free_context(fmt_ctx_);
+    }
+}
+
+bool MuxSink::Open(const AVCodecContext* codec_ctx)
+{
+    int ret = avformat_alloc_output_context2(&fmt_ctx_, nullptr, GuessFormat(url_), url_.c_str());
+    if (ret < 0) {
+        SPDLOG_WARN("Failed to alloc output context from {0}, using mp4.", url_);
+
+        ret = avformat_alloc_output_context2(&fmt_ctx_, nullptr, "mp4", url_.c_str());
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+    }
+
+    fmt_ctx_->interrupt_callback.callback = &MuxSink::Interrupt;
+    fmt_ctx_->interrupt_callback.opaque = this;
+
+    stream_ = avformat_new_stream(fmt_ctx_, nullptr);
+    if (!stream_) {
+        SPDLOG_ERROR("Failed to create new video stream.");
+        return false;
+    }
+    codec_time_base_ = codec_ctx->time_base;
+    stream_->time_base = codec_ctx->time_base;
+
+    ret = avcodec_parameters_from_context(stream_->codecpar, codec_ctx);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open2(&fmt_ctx_->pb, url_.c_str(), AVIO_FLAG_WRITE,
+                         &fmt_ctx_->interrupt_callback, nullptr);
+        if (ret < 0) {
+            SPDLOG_ERROR("Failed to open avio url: {0}.", url_);
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+    }
+
+    ret = avformat_write_header(fmt_ctx_, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+    header_written_ = true;
+
+    mux_thread_.reset(new TaskThread([this] { MuxStage(); }));
+    mux_thread_->start();
+
+    return true;
+}
+
+bool MuxSink::Push(const AVPacket* pkt)
+{
+    if (failed_)
+        return false;
+
+    // Packets after a gap can not be decoded before the next keyframe.
+    bool key = (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+    if (wait_keyframe_ && !key) {
+        ++dropped_;
+        return true;
+    }
+
+    AVPacket* packet = av_packet_clone(pkt);
+    if (!packet) {
+        SPDLOG_ERROR("Failed to alloc packet.");
+        return false;
+    }
+
+    bool queued = policy_ == kBlock ? packets_.Push(packet) : packets_.TryPush(packet);
+    if (!queued) {
+        av_packet_free(&packet);
+        if (failed_ || policy_ == kBlock)
+            return false;
+
+        if (!wait_keyframe_) {
+            SPDLOG_WARN("Sink {0} is behind, dropping to the next keyframe.", url_);
+        }
+        wait_keyframe_ = true;
+        ++dropped_;
+        return true;
+    }
+    wait_keyframe_ = false;
+
+    return true;
+}
+
+bool MuxSink::Close()
+{
+    packets_.Close();
+
+    if (mux_thread_) {
+        mux_thread_->wait();
+        mux_thread_.reset();
+    }
+
+    if (header_written_ && !failed_) {
+        header_written_ = false;
+
+        int ret = av_write_trailer(fmt_ctx_);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            failed_ = true;
+        }
+    }
+
+    SPDLOG_INFO("Sink {0} closed, packets: {1}, dropped: {2}.", url_, written_.load(),
+                dropped_.load());
+
+    return !failed_;
+}
+
+void MuxSink::MuxStage()
+{
+    AVPacket* packet = nullptr;
+    while (packets_.Pop(&packet)) {
+        if (!failed_) {
+            packet->stream_index = stream_->index;
+            av_packet_rescale_ts(packet, codec_time_base_, stream_->time_base);
+
+            int ret = av_interleaved_write_frame(fmt_ctx_, packet);
+            if (ret < 0) {
+                SPDLOG_ERROR("Failed to write sink {0}.", url_);
+                FFmpegHelper::FFmpegError(ret);
+                failed_ = true;
+                packets_.Close();
+            } else {
+                ++written_;
+            }
+        }
+        av_packet_free(&packet);
+    }
+}
+
+int MuxSink::Interrupt(void* opaque)
+{
+    return static_cast<MuxSink*>(opaque)->aborted_ ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+#ifndef MUX_SINK_H_
+#define MUX_SINK_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+#include "util/bounded_queue.h"
+#include "util/task_thread.h"
+
+/**
+ * @brief One output of an encoded stream, a file or a network url muxed on its own I/O thread.
+ *
+ * The encoder hands every packet to all sinks by reference. Each sink has its own queue, so a
+ * stalled network consumer never holds up the encoder or the other sinks.
+ */
+class MuxSink
+{
+public:
+    enum Policy
+    {
+        kBlock,         // Wait for space, nothing is lost, for recordings
+        kDropToKeyframe // Drop when full and resume at the next keyframe, for live consumers
+    };
+
+    /**
+     * @param url File path or network url, udp and rtp are muxed as MPEG-TS, rtmp as FLV.
+     */
+    MuxSink(const std::string& url, Policy policy);
+    ~MuxSink();
+
+    /**
+     * @brief Write the header of a stream with the parameters of the opened encoder.
+     */
+    bool Open(const AVCodecContext* codec_ctx);
+
+    /**
+     * @brief Queue a new reference to the packet, pts in the encoder time base.
+     *
+     * @return False once the sink has failed.
+     */
+    bool Push(const AVPacket* pkt);
+
+    /**
+     * @brief Write the queued packets and the trailer.
+     */
+    bool Close();
+
+    const std::string& url() const { return url_; }
+    int64_t written() const { return written_; }
+    int64_t dropped() const { return dropped_; }
+
+private:
+    void MuxStage();
+
+    static int Interrupt(void* opaque);
+
+private:
+    std::string url_;
+    Policy policy_;
+
+    AVFormatContext* fmt_ctx_;
+    AVStream* stream_;
+    AVRational codec_time_base_;
+    bool header_written_;
+
+    BoundedQueue<AVPacket*> packets_;
+    std::unique_ptr<TaskThread> mux_thread_;
+    std::atomic<bool> failed_;
+    std::atomic<bool> aborted_; // Interrupts blocking I/O when the sink is destroyed
+    bool wait_keyframe_;
+
+    std::atomic<int64_t> written_;
+    std::atomic<int64_t> dropped_;
+};
+
+#endif
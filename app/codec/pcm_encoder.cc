@@ -0,0 +1,465 @@
+#include "pcm_encoder.h"
+
+#include <stdio.h>
+
+extern "C"
+{
+#include "libavutil/channel_layout.h"
+#include "libavutil/samplefmt.h"
+}
+
+#include "spdlog/spdlog.h"
+
+#define PCM_READ_BLOCK_SIZE (4 << 20) // bytes
+#define PCM_PACKET_QUEUE_SIZE 64      // packets
+#define PCM_DEFAULT_FRAME_SIZE 1024   // samples, for encoders without a fixed frame size
+
+static int64_t AudioChLayout(int type)
+{
+    switch (type) {
+    case 1:
+        return AV_CH_LAYOUT_MONO;
+    case 2:
+        return AV_CH_LAYOUT_STEREO;
+    case 3:
+        return AV_CH_LAYOUT_SURROUND;
+    default:
+        break;
+    }
+
+    return AV_CH_LAYOUT_STEREO;
+}
+
+// Planar float when the encoder takes it, the native format of AAC and Opus, else its first.
+static AVSampleFormat ChooseSampleFormat(const AVCodec* codec)
+{
+    if (!codec->sample_fmts)
+        return AV_SAMPLE_FMT_FLTP;
+
+    for (const AVSampleFormat* fmt = codec->sample_fmts; *fmt != AV_SAMPLE_FMT_NONE; ++fmt) {
+        if (*fmt == AV_SAMPLE_FMT_FLTP || *fmt == AV_SAMPLE_FMT_FLT)
+            return *fmt;
+    }
+
+    return codec->sample_fmts[0];
+}
+
+// The requested rate when supported, else the next higher one, Opus only takes 48k and below.
+static int ChooseSampleRate(const AVCodec* codec, int sample_rate)
+{
+    if (!codec->supported_samplerates)
+        return sample_rate;
+
+    int best = 0;
+    int highest = 0;
+    for (const int* rate = codec->supported_samplerates; *rate != 0; ++rate) {
+        if (*rate == sample_rate)
+            return sample_rate;
+
+        if (*rate > sample_rate && (best == 0 || *rate < best)) {
+            best = *rate;
+        }
+        highest = FFMAX(highest, *rate);
+    }
+
+    return best ? best : highest;
+}
+
+PcmEncoder::PcmEncoder(const FFmpegHelper::AudioInfo& info, JobContext* job)
+    : info_(info)
+    , job_(job)
+    , in_fmt_(AV_SAMPLE_FMT_FLT)
+    , in_layout_(AudioChLayout(info.channels))
+    , in_channels_(av_get_channel_layout_nb_channels(in_layout_))
+    , codec_(nullptr)
+    , codec_ctx_(nullptr)
+    , outfmt_ctx_(nullptr)
+    , stream_(nullptr)
+    , swr_ctx_(nullptr)
+    , fifo_(nullptr)
+    , convert_data_(nullptr)
+    , convert_capacity_(0)
+    , frame_(av_frame_alloc())
+    , pkt_(av_packet_alloc())
+    , frame_size_(0)
+    , next_pts_(0)
+    , packets_(PCM_PACKET_QUEUE_SIZE)
+    , mux_failed_(false)
+{
+    if (info.sample_fmt != AV_SAMPLE_FMT_NONE) {
+        in_fmt_ = av_get_packed_sample_fmt(static_cast<AVSampleFormat>(info.sample_fmt));
+    }
+}
+
+PcmEncoder::~PcmEncoder()
+{
+    StopMux();
+
+    if (convert_data_) {
+        av_freep(&convert_data_[0]);
+    }
+    av_freep(&convert_data_);
+    av_audio_fifo_free(fifo_);
+    swr_free(&swr_ctx_);
+    av_frame_free(&frame_);
+    av_packet_free(&pkt_);
+    avcodec_free_context(&codec_ctx_);
+
+    if (outfmt_ctx_) {
+        if (!(outfmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&outfmt_ctx_->pb);
+        }
+        avformat_free_context(outfmt_ctx_);
+    }
+}
+
+bool PcmEncoder::Run(const char* infile, const char* outfile)
+{
+    if (!frame_ || !pkt_) {
+        SPDLOG_ERROR("Failed to alloc packet or frame.");
+        return false;
+    }
+
+    FILE* infile_fp = fopen(infile, "rb");
+    if (!infile_fp) {
+        SPDLOG_ERROR("Failed to open infile.");
+        return false;
+    }
+    DEFER(fclose(infile_fp);)
+
+    // The muxer decides about global headers, so it comes before the encoder.
+    int ret = avformat_alloc_output_context2(&outfmt_ctx_, nullptr, nullptr, outfile);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    if (!OpenEncoder() || !OpenOutput(outfile) || !OpenResampler())
+        return false;
+
+    mux_thread_.reset(new TaskThread([this] { MuxStage(); }));
+    mux_thread_->start();
+
+    int sample_bytes = av_get_bytes_per_sample(in_fmt_) * in_channels_;
+    size_t block_size = PCM_READ_BLOCK_SIZE / sample_bytes * sample_bytes;
+    std::vector<uint8_t> block(block_size);
+
+    int64_t infile_size = FFmpegHelper::FileSize(infile_fp);
+    int64_t read_size = 0;
+
+    bool ok = true;
+    while (ok) {
+        if (job_ && job_->cancelled()) {
+            ok = false;
+            break;
+        }
+
+        size_t size = fread(block.data(), 1, block_size, infile_fp);
+        if (size == 0) {
+            if (ferror(infile_fp)) {
+                SPDLOG_ERROR("Failed to read infile.");
+                ok = false;
+            }
+            break;
+        }
+
+        int samples = static_cast<int>(size / sample_bytes);
+        ok = Convert(block.data(), samples) && EncodeFifo(false);
+
+        read_size += size;
+        if (job_) {
+            job_->AddBytes(size);
+            job_->UpdatePosition(read_size, infile_size);
+        }
+    }
+
+    // Drain the resampler, the fifo and the encoder.
+    ok = ok && Convert(nullptr, 0) && EncodeFifo(true) && SendFrame(nullptr);
+    ok = StopMux() && ok;
+    if (!ok)
+        return false;
+
+    ret = av_write_trailer(outfmt_ctx_);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    SPDLOG_INFO("Audio encoded, encoder:{0}, rate:{1}, format:{2}, samples:{3}.", codec_->name,
+                codec_ctx_->sample_rate, av_get_sample_fmt_name(codec_ctx_->sample_fmt),
+                next_pts_);
+
+    return true;
+}
+
+bool PcmEncoder::OpenEncoder()
+{
+    switch (info_.codec_id) {
+    case 1:
+        codec_ = avcodec_find_encoder(AV_CODEC_ID_AAC);
+        break;
+    case 2:
+        codec_ = avcodec_find_encoder_by_name("libopus");
+        if (!codec_) {
+            codec_ = avcodec_find_encoder(AV_CODEC_ID_OPUS);
+        }
+        break;
+    default:
+        codec_ = avcodec_find_encoder(AV_CODEC_ID_MP3);
+        break;
+    }
+    if (!codec_) {
+        SPDLOG_ERROR("Failed to find audio codec.");
+        return false;
+    }
+
+    codec_ctx_ = avcodec_alloc_context3(codec_);
+    if (!codec_ctx_) {
+        SPDLOG_ERROR("Failed to alloc codec context.");
+        return false;
+    }
+
+    codec_ctx_->bit_rate = info_.bit_rate;
+    codec_ctx_->channel_layout = in_layout_;
+    codec_ctx_->channels = in_channels_;
+    codec_ctx_->sample_fmt = ChooseSampleFormat(codec_);
+    codec_ctx_->sample_rate = ChooseSampleRate(codec_, info_.sample_rate);
+    codec_ctx_->time_base = {1, codec_ctx_->sample_rate};
+    // The native Opus encoder is still marked experimental.
+    codec_ctx_->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+
+    if (outfmt_ctx_->oformat->flags & AVFMT_GLOBALHEADER) {
+        codec_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    int ret = avcodec_open2(codec_ctx_, codec_, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    frame_size_ = codec_ctx_->frame_size > 0 ? codec_ctx_->frame_size : PCM_DEFAULT_FRAME_SIZE;
+
+    frame_->format = codec_ctx_->sample_fmt;
+    frame_->channel_layout = codec_ctx_->channel_layout;
+    frame_->channels = codec_ctx_->channels;
+    frame_->sample_rate = codec_ctx_->sample_rate;
+    frame_->nb_samples = frame_size_;
+    ret = av_frame_get_buffer(frame_, 0);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    return true;
+}
+
+bool PcmEncoder::OpenOutput(const char* outfile)
+{
+    stream_ = avformat_new_stream(outfmt_ctx_, nullptr);
+    if (!stream_) {
+        SPDLOG_ERROR("Failed to alloc output stream.");
+        return false;
+    }
+    stream_->time_base = codec_ctx_->time_base;
+
+    int ret = avcodec_parameters_from_context(stream_->codecpar, codec_ctx_);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    if (!(outfmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+        AVIOInterruptCB* interrupt_cb = nullptr;
+        if (job_) {
+            outfmt_ctx_->interrupt_callback = job_->interrupt_cb();
+            interrupt_cb = &outfmt_ctx_->interrupt_callback;
+        }
+
+        ret = avio_open2(&outfmt_ctx_->pb, outfile, AVIO_FLAG_WRITE, interrupt_cb, nullptr);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+    }
+
+    ret = avformat_write_header(outfmt_ctx_, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    return true;
+}
+
+bool PcmEncoder::OpenResampler()
+{
+    swr_ctx_ = swr_alloc_set_opts(nullptr, codec_ctx_->channel_layout, codec_ctx_->sample_fmt,
+                                  codec_ctx_->sample_rate, in_layout_, in_fmt_,
+                                  info_.sample_rate, 0, nullptr);
+    if (!swr_ctx_) {
+        SPDLOG_ERROR("Failed to alloc swr ctx.");
+        return false;
+    }
+
+    int ret = swr_init(swr_ctx_);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    fifo_ = av_audio_fifo_alloc(codec_ctx_->sample_fmt, codec_ctx_->channels, frame_size_ * 2);
+    if (!fifo_) {
+        SPDLOG_ERROR("Failed to alloc audio fifo.");
+        return false;
+    }
+
+    return true;
+}
+
+bool PcmEncoder::Convert(const uint8_t* data, int samples)
+{
+    int out_samples = swr_get_out_samples(swr_ctx_, samples);
+    if (out_samples <= 0)
+        return true;
+
+    if (out_samples > convert_capacity_) {
+        if (convert_data_) {
+            av_freep(&convert_data_[0]);
+        }
+        av_freep(&convert_data_);
+        convert_capacity_ = 0;
+
+        int ret = av_samples_alloc_array_and_samples(&convert_data_, nullptr,
+                                                     codec_ctx_->channels, out_samples,
+                                                     codec_ctx_->sample_fmt, 0);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+        convert_capacity_ = out_samples;
+    }
+
+    const uint8_t* in[1] = {data};
+    int converted = swr_convert(swr_ctx_, convert_data_, out_samples, data ? in : nullptr,
+                                samples);
+    if (converted < 0) {
+        FFmpegHelper::FFmpegError(converted);
+        return false;
+    }
+
+    if (converted > 0
+        && av_audio_fifo_write(fifo_, reinterpret_cast<void**>(convert_data_), converted)
+               < converted) {
+        SPDLOG_ERROR("Failed to write audio fifo.");
+        return false;
+    }
+
+    return true;
+}
+
+bool PcmEncoder::EncodeFifo(bool flush)
+{
+    bool small_last_frame =
+        codec_->capabilities & (AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_VARIABLE_FRAME_SIZE);
+
+    while (av_audio_fifo_size(fifo_) >= frame_size_ || (flush && av_audio_fifo_size(fifo_) > 0)) {
+        // The encoder may still reference the previous frame.
+        frame_->nb_samples = frame_size_;
+        int ret = av_frame_make_writable(frame_);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        int samples = FFMIN(av_audio_fifo_size(fifo_), frame_size_);
+        if (av_audio_fifo_read(fifo_, reinterpret_cast<void**>(frame_->extended_data), samples)
+            < samples) {
+            SPDLOG_ERROR("Failed to read audio fifo.");
+            return false;
+        }
+
+        if (samples < frame_size_) {
+            if (small_last_frame) {
+                frame_->nb_samples = samples;
+            } else {
+                av_samples_set_silence(frame_->extended_data, samples, frame_size_ - samples,
+                                       codec_ctx_->channels, codec_ctx_->sample_fmt);
+            }
+        }
+
+        frame_->pts = next_pts_;
+        next_pts_ += frame_->nb_samples;
+
+        if (!SendFrame(frame_))
+            return false;
+    }
+
+    return true;
+}
+
+bool PcmEncoder::SendFrame(AVFrame* frame)
+{
+    int ret = avcodec_send_frame(codec_ctx_, frame);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    while (true) {
+        ret = avcodec_receive_packet(codec_ctx_, pkt_);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        } else if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        AVPacket* packet = av_packet_alloc();
+        if (!packet) {
+            SPDLOG_ERROR("Failed to alloc packet.");
+            av_packet_unref(pkt_);
+            return false;
+        }
+        av_packet_move_ref(packet, pkt_);
+
+        // Closed when the muxer failed.
+        if (!packets_.Push(packet)) {
+            av_packet_free(&packet);
+            return false;
+        }
+    }
+}
+
+void PcmEncoder::MuxStage()
+{
+    AVPacket* packet = nullptr;
+    while (packets_.Pop(&packet)) {
+        if (!mux_failed_) {
+            packet->stream_index = stream_->index;
+            av_packet_rescale_ts(packet, codec_ctx_->time_base, stream_->time_base);
+
+            int ret = av_interleaved_write_frame(outfmt_ctx_, packet);
+            if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                mux_failed_ = true;
+                packets_.Close();
+            } else if (job_) {
+                job_->AddFrames(1);
+            }
+        }
+        av_packet_free(&packet);
+    }
+}
+
+bool PcmEncoder::StopMux()
+{
+    packets_.Close();
+
+    if (mux_thread_) {
+        mux_thread_->wait();
+        mux_thread_.reset();
+    }
+
+    return !mux_failed_;
+}
@@ -0,0 +1,90 @@
+#ifndef PCM_ENCODER_H_
+#define PCM_ENCODER_H_
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/audio_fifo.h"
+#include "libswresample/swresample.h"
+}
+
+#include "ffmpeghelper.h"
+#include "job/job_context.h"
+#include "util/bounded_queue.h"
+#include "util/task_thread.h"
+
+/**
+ * @brief Encodes headerless PCM to AAC, MP3 or Opus as a stream.
+ *
+ * The input is read in large blocks, each block is converted to the encoder format and rate by
+ * one swr_convert call and queued in an AVAudioFifo, the encoder takes frames of its own size
+ * from there. Packets are muxed on a separate thread, so the encoder never waits for the disk.
+ * Every instance is independent, the job executor runs several files at once.
+ */
+class PcmEncoder
+{
+public:
+    /**
+     * @param info codec, bit rate and the input layout, sample_rate, channels and sample_fmt
+     *             describe the PCM, AV_SAMPLE_FMT_NONE for f32le.
+     */
+    PcmEncoder(const FFmpegHelper::AudioInfo& info, JobContext* job = nullptr);
+    ~PcmEncoder();
+
+    bool Run(const char* infile, const char* outfile);
+
+private:
+    bool OpenEncoder();
+    bool OpenOutput(const char* outfile);
+    bool OpenResampler();
+
+    /**
+     * @brief Convert interleaved samples into the fifo, null data drains the resampler.
+     */
+    bool Convert(const uint8_t* data, int samples);
+
+    /**
+     * @brief Encode the whole frames of the fifo, with flush the rest as well.
+     */
+    bool EncodeFifo(bool flush);
+    bool SendFrame(AVFrame* frame);
+
+    void MuxStage();
+    bool StopMux();
+
+private:
+    FFmpegHelper::AudioInfo info_;
+    JobContext* job_;
+
+    // Input layout
+    AVSampleFormat in_fmt_;
+    int64_t in_layout_;
+    int in_channels_;
+
+    const AVCodec* codec_;
+    AVCodecContext* codec_ctx_;
+    AVFormatContext* outfmt_ctx_;
+    AVStream* stream_;
+
+    SwrContext* swr_ctx_;
+    AVAudioFifo* fifo_;
+    uint8_t** convert_data_; // Planes of one converted block
+    int convert_capacity_;   // samples
+
+    AVFrame* frame_;
+    AVPacket* pkt_;
+    int frame_size_;
+    int64_t next_pts_;
+
+    BoundedQueue<AVPacket*> packets_;
+    std::unique_ptr<TaskThread> mux_thread_;
+    std::atomic<bool> mux_failed_;
+};
+
+#endif
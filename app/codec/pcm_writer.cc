@@ -0,0 +1,142 @@
+#include "pcm_writer.h"
+
+extern "C"
+{
+#include "libavutil/channel_layout.h"
+}
+
+#include "audio_interleave.h"
+#include "ffmpeghelper.h"
+#include "spdlog/spdlog.h"
+
+#define PCM_WRITE_BUFFER_SIZE (1 << 20) // bytes
+
+PcmWriter::PcmWriter()
+    : fp_(nullptr)
+    , request_fmt_(AV_SAMPLE_FMT_NONE)
+    , out_fmt_(AV_SAMPLE_FMT_NONE)
+    , in_fmt_(AV_SAMPLE_FMT_NONE)
+    , channels_(0)
+    , sample_rate_(0)
+    , swr_ctx_(nullptr)
+    , bytes_(0)
+{}
+
+PcmWriter::~PcmWriter()
+{
+    Close();
+}
+
+bool PcmWriter::Open(const char* outfile, AVSampleFormat sample_fmt)
+{
+    fp_ = fopen(outfile, "wb");
+    if (!fp_) {
+        SPDLOG_ERROR("Failed to open output file.");
+        return false;
+    }
+    setvbuf(fp_, nullptr, _IOFBF, PCM_WRITE_BUFFER_SIZE);
+
+    request_fmt_ = sample_fmt;
+
+    return true;
+}
+
+bool PcmWriter::Write(const AVFrame* frame)
+{
+    if (!fp_)
+        return false;
+
+    if (!Prepare(frame))
+        return false;
+
+    int bytes_per_sample = av_get_bytes_per_sample(out_fmt_);
+    size_t size = static_cast<size_t>(frame->nb_samples) * channels_ * bytes_per_sample;
+    const uint8_t* data = frame->data[0];
+
+    if (swr_ctx_) {
+        // Same rate on both sides, so the output never exceeds the input.
+        if (buffer_.size() < size) {
+            buffer_.resize(size);
+        }
+        uint8_t* out = buffer_.data();
+        int ret = swr_convert(swr_ctx_, &out, frame->nb_samples,
+                              const_cast<const uint8_t**>(frame->extended_data),
+                              frame->nb_samples);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+        size = static_cast<size_t>(ret) * channels_ * bytes_per_sample;
+        data = out;
+    } else if (av_sample_fmt_is_planar(static_cast<AVSampleFormat>(in_fmt_)) && channels_ > 1) {
+        if (buffer_.size() < size) {
+            buffer_.resize(size);
+        }
+        InterleaveAudio(frame->extended_data, channels_, frame->nb_samples, bytes_per_sample,
+                        buffer_.data());
+        data = buffer_.data();
+    }
+
+    if (fwrite(data, 1, size, fp_) != size) {
+        SPDLOG_ERROR("Failed to write output file.");
+        return false;
+    }
+    bytes_ += size;
+
+    return true;
+}
+
+bool PcmWriter::Close()
+{
+    swr_free(&swr_ctx_);
+
+    if (!fp_)
+        return true;
+
+    bool ok = fclose(fp_) == 0;
+    fp_ = nullptr;
+
+    return ok;
+}
+
+bool PcmWriter::Prepare(const AVFrame* frame)
+{
+    if (frame->format == in_fmt_ && frame->channels == channels_
+        && frame->sample_rate == sample_rate_)
+        return true;
+
+    swr_free(&swr_ctx_);
+
+    AVSampleFormat in_fmt = static_cast<AVSampleFormat>(frame->format);
+    in_fmt_ = frame->format;
+    channels_ = frame->channels;
+    sample_rate_ = frame->sample_rate;
+
+    AVSampleFormat out_fmt = request_fmt_ == AV_SAMPLE_FMT_NONE ? in_fmt : request_fmt_;
+    out_fmt_ = av_get_packed_sample_fmt(out_fmt);
+
+    // Only a change of the sample type needs swresample, interleaving is done here.
+    if (av_get_packed_sample_fmt(in_fmt) == out_fmt_)
+        return true;
+
+    int64_t layout = frame->channel_layout ? frame->channel_layout
+                                           : av_get_default_channel_layout(channels_);
+    swr_ctx_ = swr_alloc_set_opts(nullptr, layout, out_fmt_, sample_rate_, layout, in_fmt,
+                                  sample_rate_, 0, nullptr);
+    if (!swr_ctx_) {
+        SPDLOG_ERROR("Failed to alloc swr context.");
+        return false;
+    }
+
+    int ret = swr_init(swr_ctx_);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        swr_free(&swr_ctx_);
+        return false;
+    }
+
+    SPDLOG_INFO("Convert decoded audio from {0} to {1}.", av_get_sample_fmt_name(in_fmt),
+                av_get_sample_fmt_name(out_fmt_));
+
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef PCM_WRITER_H_
+#define PCM_WRITER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+extern "C"
+{
+#include "libavutil/frame.h"
+#include "libavutil/samplefmt.h"
+#include "libswresample/swresample.h"
+}
+
+/**
+ * @brief Writes decoded audio frames as headerless packed PCM.
+ *
+ * Planar frames of the output sample type are interleaved with vector kernels, other sample types
+ * go through swresample. Every frame is a single write into a large file buffer.
+ */
+class PcmWriter
+{
+public:
+    PcmWriter();
+    ~PcmWriter();
+
+    /**
+     * @param sample_fmt Output sample type, AV_SAMPLE_FMT_NONE keeps the type of the decoder.
+     *                   Planar formats are written packed.
+     */
+    bool Open(const char* outfile, AVSampleFormat sample_fmt);
+    bool Write(const AVFrame* frame);
+    bool Close();
+
+    // Layout of the written samples, known after the first frame.
+    AVSampleFormat sample_fmt() const { return out_fmt_; }
+    int channels() const { return channels_; }
+    int sample_rate() const { return sample_rate_; }
+    int64_t bytes() const { return bytes_; }
+
+private:
+    /**
+     * @brief Pick the conversion for the frame layout, again whenever the layout changes.
+     */
+    bool Prepare(const AVFrame* frame);
+
+private:
+    FILE* fp_;
+    AVSampleFormat request_fmt_;
+    AVSampleFormat out_fmt_;
+
+    int in_fmt_;
+    int channels_;
+    int sample_rate_;
+
+    SwrContext* swr_ctx_;
+    std::vector<uint8_t> buffer_; // Interleaved or converted samples of one frame
+    int64_t bytes_;
+};
+
+#endif
@@ -0,0 +1,327 @@
+#include "raw_dump_pipeline.h"
+
+#include <chrono>
+#include <string.h>
+
+extern "C"
+{
+#include "libavutil/cpu.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/opt.h"
+}
+
+#include "ffmpeghelper.h"
+#include "spdlog/spdlog.h"
+
+#define PIPELINE_QUEUE_SIZE 8       // frames
+#define WRITE_BLOCK_SIZE (8 << 20) // bytes, a multiple of the page size
+
+// The scaled buffers are owned by the pipeline, swscale only borrows them.
+static void no_free(void* opaque, uint8_t* data)
+{
+    (void)opaque;
+    (void)data;
+}
+
+RawDumpPipeline::RawDumpPipeline(JobContext* job)
+    : job_(job)
+    , fp_(nullptr)
+    , width_(0)
+    , height_(0)
+    , fmt_(AV_PIX_FMT_NONE)
+    , y4m_(false)
+    , frame_size_(0)
+    , sws_ctx_(nullptr)
+    , src_w_(0)
+    , src_h_(0)
+    , src_fmt_(AV_PIX_FMT_NONE)
+    , decoded_(PIPELINE_QUEUE_SIZE)
+    , scaled_(PIPELINE_QUEUE_SIZE)
+    , free_(PIPELINE_QUEUE_SIZE + 2)
+    , block_(nullptr)
+    , block_used_(0)
+    , bytes_(0)
+    , failed_(false)
+    , frames_(0)
+{}
+
+RawDumpPipeline::~RawDumpPipeline()
+{
+    Fail();
+    Stop();
+
+    for (auto buffer : buffers_) {
+        av_free(buffer);
+    }
+    av_free(block_);
+    sws_freeContext(sws_ctx_);
+
+    if (fp_) {
+        fclose(fp_);
+    }
+}
+
+bool RawDumpPipeline::Open(const char* outfile, int width, int height, AVPixelFormat fmt,
+                           AVRational frame_rate, AVRational sar, bool y4m)
+{
+    if (y4m && fmt != AV_PIX_FMT_YUV420P) {
+        SPDLOG_WARN("Y4M holds yuv only, writing headerless frames.");
+        y4m = false;
+    }
+
+    width_ = width;
+    height_ = height;
+    fmt_ = fmt;
+    y4m_ = y4m;
+
+    int size = av_image_get_buffer_size(fmt, width, height, 1);
+    if (size < 0) {
+        FFmpegHelper::FFmpegError(size);
+        return false;
+    }
+    frame_size_ = static_cast<size_t>(size);
+
+    // One buffer per queue slot, plus the ones being scaled and written.
+    for (size_t i = 0; i < free_.capacity(); ++i) {
+        uint8_t* buffer = static_cast<uint8_t*>(av_malloc(frame_size_));
+        if (!buffer) {
+            SPDLOG_ERROR("Failed to alloc frame buffer.");
+            return false;
+        }
+        buffers_.push_back(buffer);
+        free_.Push(buffer);
+    }
+
+    block_ = static_cast<uint8_t*>(av_malloc(WRITE_BLOCK_SIZE));
+    if (!block_) {
+        SPDLOG_ERROR("Failed to alloc write block.");
+        return false;
+    }
+
+    fp_ = fopen(outfile, "wb");
+    if (!fp_) {
+        SPDLOG_ERROR("Failed to open outfile.");
+        return false;
+    }
+    // Writes are whole blocks already, stdio buffering would only add a copy.
+    setvbuf(fp_, nullptr, _IONBF, 0);
+
+    if (y4m_) {
+        if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+            frame_rate = {25, 1};
+        }
+        if (sar.num <= 0 || sar.den <= 0) {
+            sar = {0, 0};
+        }
+
+        char header[128];
+        int length = snprintf(header, sizeof(header),
+                              "YUV4MPEG2 W%d H%d F%d:%d Ip A%d:%d C420jpeg\n", width, height,
+                              frame_rate.num, frame_rate.den, sar.num, sar.den);
+        if (!Write(reinterpret_cast<const uint8_t*>(header), length))
+            return false;
+    }
+
+    scale_thread_.reset(new TaskThread([this] { ScaleStage(); }));
+    write_thread_.reset(new TaskThread([this] { WriteStage(); }));
+    scale_thread_->start();
+    write_thread_->start();
+
+    return true;
+}
+
+bool RawDumpPipeline::Push(AVFrame* frame)
+{
+    if (failed_)
+        return false;
+
+    AVFrame* item = av_frame_alloc();
+    if (!item) {
+        SPDLOG_ERROR("Failed to alloc frame.");
+        return false;
+    }
+    av_frame_move_ref(item, frame);
+
+    if (!decoded_.Push(item)) {
+        av_frame_free(&item);
+        return false;
+    }
+
+    return true;
+}
+
+bool RawDumpPipeline::Finish()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    Stop();
+
+    std::chrono::duration<double> drain = std::chrono::steady_clock::now() - start;
+    SPDLOG_INFO("Raw dump frames: {0}, bytes: {1}, drain: {2:.2f}s.", frames_.load(), bytes_,
+                drain.count());
+
+    if (fp_ && fclose(fp_) != 0) {
+        failed_ = true;
+    }
+    fp_ = nullptr;
+
+    return !failed_;
+}
+
+void RawDumpPipeline::ScaleStage()
+{
+    AVFrame* frame = nullptr;
+    while (decoded_.Pop(&frame)) {
+        // Keep draining after a failure, the queued frames still have to be freed.
+        uint8_t* buffer = nullptr;
+        bool ok = !failed_ && free_.Pop(&buffer) && Scale(frame, buffer);
+        av_frame_free(&frame);
+
+        if (!ok || !scaled_.Push(buffer)) {
+            Fail();
+        }
+    }
+
+    scaled_.Close();
+}
+
+void RawDumpPipeline::WriteStage()
+{
+    static const uint8_t frame_header[] = {'F', 'R', 'A', 'M', 'E', '\n'};
+
+    uint8_t* buffer = nullptr;
+    while (scaled_.Pop(&buffer)) {
+        bool ok = !failed_ && (!y4m_ || Write(frame_header, sizeof(frame_header)))
+                  && Write(buffer, frame_size_);
+        free_.Push(buffer);
+
+        if (!ok) {
+            Fail();
+            continue;
+        }
+
+        ++frames_;
+        if (job_) {
+            job_->AddFrames(1);
+        }
+    }
+
+    if (!failed_ && !FlushBlock()) {
+        Fail();
+    }
+}
+
+bool RawDumpPipeline::Scale(const AVFrame* src, uint8_t* dst)
+{
+    if (!sws_ctx_ || src->width != src_w_ || src->height != src_h_ || src->format != src_fmt_) {
+        sws_freeContext(sws_ctx_);
+
+        // Slices of every frame are scaled on all cores.
+        sws_ctx_ = sws_alloc_context();
+        if (!sws_ctx_) {
+            SPDLOG_ERROR("Failed to get sws context.");
+            return false;
+        }
+        av_opt_set_int(sws_ctx_, "srcw", src->width, 0);
+        av_opt_set_int(sws_ctx_, "srch", src->height, 0);
+        av_opt_set_int(sws_ctx_, "src_format", src->format, 0);
+        av_opt_set_int(sws_ctx_, "dstw", width_, 0);
+        av_opt_set_int(sws_ctx_, "dsth", height_, 0);
+        av_opt_set_int(sws_ctx_, "dst_format", fmt_, 0);
+        av_opt_set_int(sws_ctx_, "sws_flags", SWS_FAST_BILINEAR, 0);
+        av_opt_set_int(sws_ctx_, "threads", av_cpu_count(), 0);
+
+        int ret = sws_init_context(sws_ctx_, nullptr, nullptr);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            sws_freeContext(sws_ctx_);
+            sws_ctx_ = nullptr;
+            return false;
+        }
+
+        src_w_ = src->width;
+        src_h_ = src->height;
+        src_fmt_ = src->format;
+    }
+
+    AVFrame* dst_frame = av_frame_alloc();
+    if (!dst_frame) {
+        SPDLOG_ERROR("Failed to alloc frame.");
+        return false;
+    }
+    DEFER(av_frame_free(&dst_frame);)
+
+    // Planes are packed without padding, the layout of the output file.
+    dst_frame->width = width_;
+    dst_frame->height = height_;
+    dst_frame->format = fmt_;
+    av_image_fill_arrays(dst_frame->data, dst_frame->linesize, dst, fmt_, width_, height_, 1);
+    dst_frame->buf[0] = av_buffer_create(dst, static_cast<int>(frame_size_), no_free, nullptr, 0);
+    if (!dst_frame->buf[0]) {
+        SPDLOG_ERROR("Failed to alloc frame buffer.");
+        return false;
+    }
+
+    int ret = sws_scale_frame(sws_ctx_, dst_frame, src);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    return true;
+}
+
+bool RawDumpPipeline::Write(const uint8_t* data, size_t size)
+{
+    while (size > 0) {
+        size_t count = FFMIN(size, WRITE_BLOCK_SIZE - block_used_);
+        memcpy(block_ + block_used_, data, count);
+        block_used_ += count;
+        data += count;
+        size -= count;
+
+        if (block_used_ == WRITE_BLOCK_SIZE && !FlushBlock())
+            return false;
+    }
+
+    return true;
+}
+
+bool RawDumpPipeline::FlushBlock()
+{
+    if (block_used_ == 0)
+        return true;
+
+    if (fwrite(block_, 1, block_used_, fp_) != block_used_) {
+        SPDLOG_ERROR("Failed to write outfile.");
+        return false;
+    }
+
+    bytes_ += block_used_;
+    block_used_ = 0;
+
+    return true;
+}
+
+void RawDumpPipeline::Fail()
+{
+    failed_ = true;
+
+    decoded_.Close();
+    scaled_.Close();
+    free_.Close();
+}
+
+void RawDumpPipeline::Stop()
+{
+    decoded_.Close();
+
+    if (scale_thread_) {
+        scale_thread_->wait();
+        scale_thread_.reset();
+    }
+    if (write_thread_) {
+        write_thread_->wait();
+        write_thread_.reset();
+    }
+}
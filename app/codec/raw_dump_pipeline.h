@@ -0,0 +1,97 @@
+#ifndef RAW_DUMP_PIPELINE_H_
+#define RAW_DUMP_PIPELINE_H_
+
+#include <atomic>
+#include <memory>
+#include <stdio.h>
+#include <vector>
+
+extern "C"
+{
+#include "libavutil/frame.h"
+#include "libswscale/swscale.h"
+}
+
+#include "job/job_context.h"
+#include "util/bounded_queue.h"
+#include "util/task_thread.h"
+
+/**
+ * @brief Writes decoded frames as raw video with scaling and writing on their own threads.
+ *
+ * The decoder pushes its frames, a scale thread converts them with slice threaded swscale into
+ * tightly packed planes and a write thread gathers them into large blocks for unbuffered writes.
+ * The stages are joined by bounded queues, so the slowest one sets the pace and memory stays
+ * constant.
+ */
+class RawDumpPipeline
+{
+public:
+    explicit RawDumpPipeline(JobContext* job = nullptr);
+    ~RawDumpPipeline();
+
+    /**
+     * @param fmt YUV420P or RGB24.
+     * @param y4m Write a YUV4MPEG2 stream instead of headerless frames, yuv formats only.
+     */
+    bool Open(const char* outfile, int width, int height, AVPixelFormat fmt, AVRational frame_rate,
+              AVRational sar, bool y4m);
+
+    /**
+     * @brief Queue a decoded frame, the reference is moved out of it.
+     *
+     * Blocks while the scaler is behind.
+     */
+    bool Push(AVFrame* frame);
+
+    /**
+     * @brief Drain the stages and close the file.
+     */
+    bool Finish();
+
+    int64_t frames() const { return frames_; }
+
+private:
+    void ScaleStage();
+    void WriteStage();
+    bool Scale(const AVFrame* src, uint8_t* dst);
+    bool Write(const uint8_t* data, size_t size);
+    bool FlushBlock();
+
+    void Fail();
+    void Stop();
+
+private:
+    JobContext* job_;
+    FILE* fp_;
+
+    int width_;
+    int height_;
+    AVPixelFormat fmt_;
+    bool y4m_;
+    size_t frame_size_;
+
+    // Scale stage
+    SwsContext* sws_ctx_;
+    int src_w_;
+    int src_h_;
+    int src_fmt_;
+
+    // Decoded frames, scaled frames and the scaled buffers that can be reused.
+    BoundedQueue<AVFrame*> decoded_;
+    BoundedQueue<uint8_t*> scaled_;
+    BoundedQueue<uint8_t*> free_;
+    std::vector<uint8_t*> buffers_;
+
+    // Write stage
+    uint8_t* block_;
+    size_t block_used_;
+    int64_t bytes_;
+
+    std::unique_ptr<TaskThread> scale_thread_;
+    std::unique_ptr<TaskThread> write_thread_;
+    std::atomic<bool> failed_;
+    std::atomic<int64_t> frames_;
+};
+
+#endif
@@ -0,0 +1,420 @@
+#include "raw_video_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+extern "C"
+{
+#include "libavutil/imgutils.h"
+}
+
+#include "spdlog/spdlog.h"
+
+#define PREFETCH_FRAMES 4       // frames
+#define Y4M_MAX_HEADER_SIZE 1024 // bytes
+
+static const char kY4mMagic[] = "YUV4MPEG2 ";
+
+struct Y4mColorspace
+{
+    const char* tag;
+    AVPixelFormat pix_fmt;
+};
+
+static const Y4mColorspace kY4mColorspaces[] = {
+    {"420jpeg", AV_PIX_FMT_YUV420P},    {"420paldv", AV_PIX_FMT_YUV420P},
+    {"420mpeg2", AV_PIX_FMT_YUV420P},   {"420", AV_PIX_FMT_YUV420P},
+    {"422", AV_PIX_FMT_YUV422P},        {"444", AV_PIX_FMT_YUV444P},
+    {"mono", AV_PIX_FMT_GRAY8},         {"420p10", AV_PIX_FMT_YUV420P10LE},
+    {"422p10", AV_PIX_FMT_YUV422P10LE}, {"444p10", AV_PIX_FMT_YUV444P10LE},
+};
+
+// The mapping is owned by the reader, frames only borrow it.
+static void no_free(void* opaque, uint8_t* data)
+{
+    (void)opaque;
+    (void)data;
+}
+
+RawVideoReader::RawVideoReader()
+    : base_(nullptr)
+    , size_(0)
+    , pos_(0)
+    , data_start_(0)
+    , prefetched_(0)
+#ifdef _WIN32
+    , file_(INVALID_HANDLE_VALUE)
+    , mapping_(nullptr)
+#endif
+    , y4m_(false)
+    , width_(0)
+    , height_(0)
+    , pix_fmt_(AV_PIX_FMT_NONE)
+    , frame_rate_({25, 1})
+    , sar_({0, 1})
+    , color_range_(AVCOL_RANGE_UNSPECIFIED)
+    , frame_size_(0)
+    , frame_index_(0)
+{}
+
+RawVideoReader::~RawVideoReader()
+{
+    Close();
+}
+
+bool RawVideoReader::Open(const char* file, int width, int height)
+{
+    Close();
+
+    if (!Map(file))
+        return false;
+
+    size_t magic_size = sizeof(kY4mMagic) - 1;
+    y4m_ = size_ >= magic_size && memcmp(base_, kY4mMagic, magic_size) == 0;
+    if (y4m_) {
+        if (!ParseHeader()) {
+            Close();
+            return false;
+        }
+    } else {
+        width_ = width;
+        height_ = height;
+        pix_fmt_ = AV_PIX_FMT_YUV420P;
+    }
+
+    int ret = av_image_check_size(width_, height_, 0, nullptr);
+    if (ret < 0) {
+        SPDLOG_ERROR("Invalid raw video size:[{0}x{1}].", width_, height_);
+        Close();
+        return false;
+    }
+    frame_size_ = av_image_get_buffer_size(pix_fmt_, width_, height_, 1);
+
+    pos_ = data_start_;
+    Prefetch(pos_);
+
+    SPDLOG_INFO("Raw video opened, size:[{0}x{1}], format:{2}, y4m:{3}, bytes:{4}.", width_,
+                height_, (int)pix_fmt_, y4m_, size_);
+
+    return true;
+}
+
+void RawVideoReader::Close()
+{
+    Unmap();
+
+    size_ = 0;
+    pos_ = 0;
+    data_start_ = 0;
+    prefetched_ = 0;
+    y4m_ = false;
+    frame_rate_ = {25, 1};
+    sar_ = {0, 1};
+    color_range_ = AVCOL_RANGE_UNSPECIFIED;
+    frame_size_ = 0;
+    frame_index_ = 0;
+}
+
+int RawVideoReader::ReadFrame(AVFrame* frame)
+{
+    av_frame_unref(frame);
+
+    if (!base_)
+        return AVERROR(EINVAL);
+
+    if (pos_ >= size_)
+        return AVERROR_EOF;
+
+    size_t frame_start = pos_;
+    if (y4m_) {
+        // "FRAME", optional parameters, newline.
+        if (size_ - pos_ < 5 || memcmp(base_ + pos_, "FRAME", 5) != 0) {
+            SPDLOG_ERROR("Invalid Y4M frame header at {0}.", pos_);
+            return AVERROR_INVALIDDATA;
+        }
+
+        const void* end = memchr(base_ + pos_, '\n', FFMIN(size_ - pos_, Y4M_MAX_HEADER_SIZE));
+        if (!end) {
+            SPDLOG_ERROR("Invalid Y4M frame header at {0}.", pos_);
+            return AVERROR_INVALIDDATA;
+        }
+        frame_start = static_cast<const uint8_t*>(end) - base_ + 1;
+    }
+
+    if (size_ - frame_start < frame_size_) {
+        SPDLOG_WARN("Truncated raw video frame at {0} ignored.", frame_start);
+        pos_ = size_;
+        return AVERROR_EOF;
+    }
+
+    uint8_t* data = base_ + frame_start;
+    frame->buf[0] = av_buffer_create(data, static_cast<int>(frame_size_), no_free, nullptr,
+                                     AV_BUFFER_FLAG_READONLY);
+    if (!frame->buf[0])
+        return AVERROR(ENOMEM);
+
+    av_image_fill_arrays(frame->data, frame->linesize, data, pix_fmt_, width_, height_, 1);
+    frame->width = width_;
+    frame->height = height_;
+    frame->format = pix_fmt_;
+    frame->sample_aspect_ratio = sar_;
+    frame->color_range = color_range_;
+    frame->pts = frame_index_++;
+
+    pos_ = frame_start + frame_size_;
+    Prefetch(pos_);
+
+    return 0;
+}
+
+void RawVideoReader::Rewind()
+{
+    pos_ = data_start_;
+    prefetched_ = 0;
+    frame_index_ = 0;
+
+    Prefetch(pos_);
+}
+
+int RawVideoReader::SeekFrame(int64_t index)
+{
+    if (!base_ || index < 0)
+        return AVERROR(EINVAL);
+
+    if (!y4m_) {
+        size_t pos = data_start_ + static_cast<size_t>(index) * frame_size_;
+        if (pos >= size_)
+            return AVERROR_EOF;
+
+        pos_ = pos;
+        frame_index_ = index;
+    } else {
+        // Frame headers may carry parameters, so their size varies, walk them.
+        if (index < frame_index_) {
+            pos_ = data_start_;
+            frame_index_ = 0;
+        }
+
+        while (frame_index_ < index) {
+            if (pos_ >= size_)
+                return AVERROR_EOF;
+
+            const void* end = memchr(base_ + pos_, '\n', FFMIN(size_ - pos_, Y4M_MAX_HEADER_SIZE));
+            if (!end || memcmp(base_ + pos_, "FRAME", FFMIN(size_ - pos_, 5)) != 0) {
+                SPDLOG_ERROR("Invalid Y4M frame header at {0}.", pos_);
+                return AVERROR_INVALIDDATA;
+            }
+            pos_ = static_cast<const uint8_t*>(end) - base_ + 1 + frame_size_;
+            ++frame_index_;
+        }
+
+        if (pos_ >= size_)
+            return AVERROR_EOF;
+    }
+
+    prefetched_ = 0;
+    Prefetch(pos_);
+
+    return 0;
+}
+
+bool RawVideoReader::Map(const char* file)
+{
+#ifdef _WIN32
+    int length = MultiByteToWideChar(CP_UTF8, 0, file, -1, nullptr, 0);
+    std::wstring wfile(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, file, -1, &wfile[0], length);
+
+    HANDLE handle = CreateFileW(wfile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        SPDLOG_ERROR("Failed to open raw video: {0}.", file);
+        return false;
+    }
+    file_ = handle;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+        SPDLOG_ERROR("Failed to get raw video size or it is empty: {0}.", file);
+        Unmap();
+        return false;
+    }
+
+    mapping_ = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) {
+        SPDLOG_ERROR("Failed to map raw video: {0}.", file);
+        Unmap();
+        return false;
+    }
+
+    base_ = static_cast<uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!base_) {
+        SPDLOG_ERROR("Failed to map raw video: {0}.", file);
+        Unmap();
+        return false;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        SPDLOG_ERROR("Failed to open raw video: {0}.", file);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        SPDLOG_ERROR("Failed to get raw video size or it is empty: {0}.", file);
+        close(fd);
+        return false;
+    }
+
+    // The mapping keeps its own reference to the file.
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        SPDLOG_ERROR("Failed to map raw video: {0}.", file);
+        return false;
+    }
+
+    base_ = static_cast<uint8_t*>(base);
+    size_ = static_cast<size_t>(st.st_size);
+
+    // Larger read ahead, pages behind the read position can be dropped early.
+    madvise(base_, size_, MADV_SEQUENTIAL);
+#endif
+
+    return true;
+}
+
+void RawVideoReader::Unmap()
+{
+#ifdef _WIN32
+    if (base_) {
+        UnmapViewOfFile(base_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (base_) {
+        munmap(base_, size_);
+    }
+#endif
+
+    base_ = nullptr;
+}
+
+bool RawVideoReader::ParseHeader()
+{
+    const void* end = memchr(base_, '\n', FFMIN(size_, Y4M_MAX_HEADER_SIZE));
+    if (!end) {
+        SPDLOG_ERROR("Invalid Y4M header.");
+        return false;
+    }
+    data_start_ = static_cast<const uint8_t*>(end) - base_ + 1;
+
+    std::string header(reinterpret_cast<const char*>(base_) + sizeof(kY4mMagic) - 1,
+                       reinterpret_cast<const char*>(end));
+
+    pix_fmt_ = AV_PIX_FMT_YUV420P;
+
+    size_t begin = 0;
+    while (begin < header.size()) {
+        size_t space = header.find(' ', begin);
+        if (space == std::string::npos) {
+            space = header.size();
+        }
+        std::string token = header.substr(begin, space - begin);
+        begin = space + 1;
+
+        if (token.empty())
+            continue;
+
+        const char* value = token.c_str() + 1;
+        switch (token[0]) {
+        case 'W':
+            width_ = atoi(value);
+            break;
+        case 'H':
+            height_ = atoi(value);
+            break;
+        case 'F':
+            if (sscanf(value, "%d:%d", &frame_rate_.num, &frame_rate_.den) != 2
+                || frame_rate_.num <= 0 || frame_rate_.den <= 0) {
+                frame_rate_ = {25, 1};
+            }
+            break;
+        case 'A':
+            if (sscanf(value, "%d:%d", &sar_.num, &sar_.den) != 2 || sar_.num <= 0
+                || sar_.den <= 0) {
+                sar_ = {0, 1};
+            }
+            break;
+        case 'C': {
+            bool found = false;
+            for (const auto& colorspace : kY4mColorspaces) {
+                if (strcmp(value, colorspace.tag) == 0) {
+                    pix_fmt_ = colorspace.pix_fmt;
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                SPDLOG_ERROR("Unsupported Y4M colorspace: {0}.", value);
+                return false;
+            }
+        } break;
+        case 'X':
+            if (strcmp(value, "COLORRANGE=FULL") == 0) {
+                color_range_ = AVCOL_RANGE_JPEG;
+            } else if (strcmp(value, "COLORRANGE=LIMITED") == 0) {
+                color_range_ = AVCOL_RANGE_MPEG;
+            }
+            break;
+        default:
+            // Interlacing and other parameters do not change the frame layout.
+            break;
+        }
+    }
+
+    return true;
+}
+
+void RawVideoReader::Prefetch(size_t offset)
+{
+    size_t end = FFMIN(offset + PREFETCH_FRAMES * (frame_size_ + Y4M_MAX_HEADER_SIZE), size_);
+    size_t start = FFMAX(offset, prefetched_);
+    if (start >= end)
+        return;
+
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = base_ + start;
+    range.NumberOfBytes = end - start;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    start = start / page_size * page_size;
+    madvise(base_ + start, end - start, MADV_WILLNEED);
+#endif
+
+    prefetched_ = end;
+}
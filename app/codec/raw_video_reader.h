@@ -0,0 +1,102 @@
+#ifndef RAW_VIDEO_READER_H_
+#define RAW_VIDEO_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C"
+{
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+#include "libavutil/rational.h"
+}
+
+/**
+ * @brief Reads raw video from a memory mapped file, without demuxing and without copies.
+ *
+ * A YUV4MPEG2 header sets the frame size, rate and pixel format, headerless files are I420 of a
+ * size given by the caller. The frames handed out point straight into the mapping, the frames
+ * ahead of the read position are prefetched so the reads rarely fault.
+ */
+class RawVideoReader
+{
+public:
+    RawVideoReader();
+    ~RawVideoReader();
+
+    /**
+     * @param width, height Frame size of headerless input, ignored for Y4M.
+     */
+    bool Open(const char* file, int width = 0, int height = 0);
+    void Close();
+
+    /**
+     * @brief Point the planes of frame at the next frame of the mapping.
+     *
+     * The frame holds a read only reference, so encoders take it without a copy. The data stays
+     * valid until Close(), the frame must be released before that.
+     *
+     * @return 0, AVERROR_EOF at the end of the input or a negative error.
+     */
+    int ReadFrame(AVFrame* frame);
+
+    /**
+     * @brief Go back to the first frame.
+     */
+    void Rewind();
+
+    /**
+     * @brief Make the frame of the index the next one to read.
+     *
+     * @return 0, AVERROR_EOF past the last frame or a negative error.
+     */
+    int SeekFrame(int64_t index);
+
+    bool opened() const { return base_ != nullptr; }
+    bool y4m() const { return y4m_; }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    AVPixelFormat pix_fmt() const { return pix_fmt_; }
+    AVRational frame_rate() const { return frame_rate_; }
+    AVRational sample_aspect_ratio() const { return sar_; }
+    AVColorRange color_range() const { return color_range_; }
+
+    int64_t position() const { return pos_; }
+    int64_t size() const { return size_; }
+    int64_t frame_index() const { return frame_index_; }
+
+private:
+    bool Map(const char* file);
+    void Unmap();
+    bool ParseHeader();
+
+    /**
+     * @brief Ask the system to read the frames ahead of offset.
+     */
+    void Prefetch(size_t offset);
+
+private:
+    uint8_t* base_;
+    size_t size_;
+    size_t pos_;
+    size_t data_start_; // First frame, after the stream header
+    size_t prefetched_; // End of the range already prefetched
+
+#ifdef _WIN32
+    void* file_;
+    void* mapping_;
+#endif
+
+    bool y4m_;
+    int width_;
+    int height_;
+    AVPixelFormat pix_fmt_;
+    AVRational frame_rate_;
+    AVRational sar_;
+    AVColorRange color_range_;
+    size_t frame_size_;
+    int64_t frame_index_;
+};
+
+#endif
@@ -0,0 +1,573 @@
+#include "rendition_ladder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+extern "C"
+{
+#include "libavutil/opt.h"
+#include "libswscale/swscale.h"
+}
+
+#include "spdlog/spdlog.h"
+#include "util/bounded_queue.h"
+#include "util/task_thread.h"
+
+#define LADDER_QUEUE_SIZE 8  // frames per branch
+#define LADDER_GOP_SECONDS 2 // s, when the info has no gop size
+
+class RenditionLadder::Branch
+{
+public:
+    Branch(const Rendition& rendition, const FFmpegHelper::VideoInfo& info, JobContext* job)
+        : rendition_(rendition)
+        , info_(info)
+        , job_(job)
+        , enc_ctx_(nullptr)
+        , outfmt_ctx_(nullptr)
+        , out_stream_(nullptr)
+        , sws_ctx_(nullptr)
+        , scaled_(av_frame_alloc())
+        , pkt_(av_packet_alloc())
+        , frames_(LADDER_QUEUE_SIZE)
+        , failed_(false)
+        , encoded_(0)
+        , bytes_(0)
+        , busy_(0.0)
+    {}
+
+    ~Branch()
+    {
+        Stop();
+
+        sws_freeContext(sws_ctx_);
+        av_frame_free(&scaled_);
+        av_packet_free(&pkt_);
+        avcodec_free_context(&enc_ctx_);
+
+        if (outfmt_ctx_) {
+            if (!(outfmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+                avio_closep(&outfmt_ctx_->pb);
+            }
+            avformat_free_context(outfmt_ctx_);
+        }
+    }
+
+    /**
+     * @param threads Codec threads of the encoder, the branches share the cores.
+     */
+    bool Open(const AVCodecContext* dec_ctx, AVRational time_base, AVRational frame_rate,
+              int threads)
+    {
+        if (!scaled_ || !pkt_) {
+            SPDLOG_ERROR("Failed to alloc packet or frame.");
+            return false;
+        }
+
+        // Keep the aspect ratio for a missing side, 4:2:0 needs even sizes.
+        int width = rendition_.width;
+        int height = rendition_.height;
+        if (width <= 0 && height <= 0) {
+            width = dec_ctx->width;
+            height = dec_ctx->height;
+        } else if (width <= 0) {
+            width = static_cast<int>(av_rescale(height, dec_ctx->width, dec_ctx->height));
+        } else if (height <= 0) {
+            height = static_cast<int>(av_rescale(width, dec_ctx->height, dec_ctx->width));
+        }
+        width = FFMAX(2, width & ~1);
+        height = FFMAX(2, height & ~1);
+
+        int ret = avformat_alloc_output_context2(&outfmt_ctx_, nullptr, nullptr,
+                                                 rendition_.outfile.c_str());
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        std::string codec_name = info_.codec_name.empty() ? "libx264" : info_.codec_name;
+        const AVCodec* encoder = avcodec_find_encoder_by_name(codec_name.c_str());
+        if (!encoder) {
+            SPDLOG_ERROR("Failed to find video codec {0}.", codec_name);
+            return false;
+        }
+
+        enc_ctx_ = avcodec_alloc_context3(encoder);
+        if (!enc_ctx_) {
+            SPDLOG_ERROR("Failed to alloc codec context.");
+            return false;
+        }
+
+        if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+            frame_rate = {25, 1};
+        }
+
+        enc_ctx_->pix_fmt = AV_PIX_FMT_YUV420P;
+        enc_ctx_->width = width;
+        enc_ctx_->height = height;
+        enc_ctx_->time_base = time_base;
+        enc_ctx_->framerate = frame_rate;
+        enc_ctx_->bit_rate = rendition_.bit_rate;
+        enc_ctx_->gop_size = info_.gop_size > 0
+                                 ? info_.gop_size
+                                 : static_cast<int>(av_rescale(LADDER_GOP_SECONDS, frame_rate.num,
+                                                               frame_rate.den));
+        enc_ctx_->max_b_frames = info_.max_b_frames;
+        enc_ctx_->thread_count = threads;
+
+        // The same picture on a differently shaped grid.
+        if (dec_ctx->sample_aspect_ratio.num > 0) {
+            enc_ctx_->sample_aspect_ratio =
+                av_mul_q(dec_ctx->sample_aspect_ratio,
+                         {dec_ctx->width * height, dec_ctx->height * width});
+        }
+
+        if (encoder->id == AV_CODEC_ID_H264) {
+            av_opt_set(enc_ctx_->priv_data, "preset", "slow", 0);
+        }
+
+        if (outfmt_ctx_->oformat->flags & AVFMT_GLOBALHEADER) {
+            enc_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
+        ret = avcodec_open2(enc_ctx_, encoder, nullptr);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        out_stream_ = avformat_new_stream(outfmt_ctx_, nullptr);
+        if (!out_stream_) {
+            SPDLOG_ERROR("Failed to alloc output stream.");
+            return false;
+        }
+        out_stream_->time_base = enc_ctx_->time_base;
+        out_stream_->sample_aspect_ratio = enc_ctx_->sample_aspect_ratio;
+
+        ret = avcodec_parameters_from_context(out_stream_->codecpar, enc_ctx_);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        if (!(outfmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+            AVIOInterruptCB* interrupt_cb = nullptr;
+            if (job_) {
+                outfmt_ctx_->interrupt_callback = job_->interrupt_cb();
+                interrupt_cb = &outfmt_ctx_->interrupt_callback;
+            }
+
+            ret = avio_open2(&outfmt_ctx_->pb, rendition_.outfile.c_str(), AVIO_FLAG_WRITE,
+                             interrupt_cb, nullptr);
+            if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                return false;
+            }
+        }
+
+        ret = avformat_write_header(outfmt_ctx_, nullptr);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        scaled_->width = width;
+        scaled_->height = height;
+        scaled_->format = enc_ctx_->pix_fmt;
+        ret = av_frame_get_buffer(scaled_, 0);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        start_ = std::chrono::steady_clock::now();
+        thread_.reset(new TaskThread([this] { Stage(); }));
+        thread_->start();
+
+        return true;
+    }
+
+    /**
+     * @brief Queue a new reference to the frame, blocks while the branch is behind.
+     *
+     * @return False once the branch has failed.
+     */
+    bool Push(const AVFrame* frame)
+    {
+        if (failed_)
+            return false;
+
+        AVFrame* item = av_frame_clone(frame);
+        if (!item) {
+            SPDLOG_ERROR("Failed to alloc frame.");
+            Fail();
+            return false;
+        }
+
+        if (!frames_.Push(item)) {
+            av_frame_free(&item);
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Drain the queue and the encoder and close the rendition.
+     */
+    bool Finish()
+    {
+        Stop();
+
+        if (!failed_) {
+            int ret = av_write_trailer(outfmt_ctx_);
+            if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                failed_ = true;
+            }
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_;
+        double seconds = FFMAX(elapsed.count(), 1e-6);
+        SPDLOG_INFO("Rendition {0}: {1}x{2}, frames: {3}, {4:.1f} fps, {5:.2f} MB/s, busy: "
+                    "{6:.0f}%.",
+                    rendition_.outfile, enc_ctx_ ? enc_ctx_->width : 0,
+                    enc_ctx_ ? enc_ctx_->height : 0, encoded_, encoded_ / seconds,
+                    bytes_ / (1024.0 * 1024.0) / seconds, busy_ * 100.0 / seconds);
+
+        return !failed_;
+    }
+
+    bool failed() const { return failed_; }
+
+private:
+    void Stage()
+    {
+        AVFrame* frame = nullptr;
+        while (frames_.Pop(&frame)) {
+            // Keep draining after a failure, the queued references still have to be released.
+            if (!failed_) {
+                auto start = std::chrono::steady_clock::now();
+                if (!Encode(frame)) {
+                    Fail();
+                }
+                std::chrono::duration<double> busy = std::chrono::steady_clock::now() - start;
+                busy_ += busy.count();
+            }
+            av_frame_free(&frame);
+        }
+
+        if (!failed_ && !Send(nullptr)) {
+            Fail();
+        }
+    }
+
+    bool Encode(AVFrame* frame)
+    {
+        // Let the encoder place its own keyframes.
+        frame->pict_type = AV_PICTURE_TYPE_NONE;
+
+        // A rung of the input size and format takes the decoded frame as it is.
+        if (frame->width == enc_ctx_->width && frame->height == enc_ctx_->height
+            && frame->format == enc_ctx_->pix_fmt) {
+            return Send(frame);
+        }
+
+        sws_ctx_ = sws_getCachedContext(sws_ctx_, frame->width, frame->height,
+                                        static_cast<AVPixelFormat>(frame->format),
+                                        enc_ctx_->width, enc_ctx_->height, enc_ctx_->pix_fmt,
+                                        SWS_BICUBIC, nullptr, nullptr, nullptr);
+        if (!sws_ctx_) {
+            SPDLOG_ERROR("Failed to get sws context.");
+            return false;
+        }
+
+        // The encoder may still reference the previous frame.
+        int ret = av_frame_make_writable(scaled_);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        sws_scale(sws_ctx_, frame->data, frame->linesize, 0, frame->height, scaled_->data,
+                  scaled_->linesize);
+        scaled_->pts = frame->pts;
+
+        return Send(scaled_);
+    }
+
+    bool Send(const AVFrame* frame)
+    {
+        int ret = avcodec_send_frame(enc_ctx_, frame);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+        if (frame) {
+            ++encoded_;
+        }
+
+        while (true) {
+            ret = avcodec_receive_packet(enc_ctx_, pkt_);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return true;
+            } else if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                return false;
+            }
+
+            bytes_ += pkt_->size;
+            pkt_->stream_index = out_stream_->index;
+            av_packet_rescale_ts(pkt_, enc_ctx_->time_base, out_stream_->time_base);
+
+            // Takes the packet reference.
+            ret = av_interleaved_write_frame(outfmt_ctx_, pkt_);
+            if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                return false;
+            }
+        }
+    }
+
+    // Unblock the decoder, the stage frees what is still queued.
+    void Fail()
+    {
+        failed_ = true;
+        frames_.Close();
+    }
+
+    void Stop()
+    {
+        frames_.Close();
+
+        if (thread_) {
+            thread_->wait();
+            thread_.reset();
+        }
+    }
+
+private:
+    Rendition rendition_;
+    FFmpegHelper::VideoInfo info_;
+    JobContext* job_;
+
+    AVCodecContext* enc_ctx_;
+    AVFormatContext* outfmt_ctx_;
+    AVStream* out_stream_;
+
+    SwsContext* sws_ctx_;
+    AVFrame* scaled_;
+    AVPacket* pkt_;
+
+    BoundedQueue<AVFrame*> frames_;
+    std::unique_ptr<TaskThread> thread_;
+    std::atomic<bool> failed_;
+
+    // Throughput, written by the stage and read after it has stopped
+    int64_t encoded_;
+    int64_t bytes_;
+    double busy_; // s spent scaling and encoding
+    std::chrono::steady_clock::time_point start_;
+};
+
+RenditionLadder::RenditionLadder(const FFmpegHelper::VideoInfo& info, JobContext* job)
+    : info_(info)
+    , job_(job)
+    , infmt_ctx_(nullptr)
+    , dec_ctx_(nullptr)
+    , stream_(nullptr)
+    , frame_(av_frame_alloc())
+    , last_pts_(AV_NOPTS_VALUE)
+{}
+
+RenditionLadder::~RenditionLadder()
+{
+    // The branches hold references to decoded frames, release them before the decoder.
+    branches_.clear();
+
+    av_frame_free(&frame_);
+    avcodec_free_context(&dec_ctx_);
+    avformat_close_input(&infmt_ctx_);
+}
+
+bool RenditionLadder::Run(const char* infile, const std::vector<Rendition>& renditions)
+{
+    if (renditions.empty())
+        return false;
+
+    if (!frame_) {
+        SPDLOG_ERROR("Failed to alloc frame.");
+        return false;
+    }
+
+    if (!OpenInput(infile) || !OpenDecoder())
+        return false;
+
+    // Every branch runs one encoder, the codec threads split the remaining cores.
+    int cores = std::max(1, QThread::idealThreadCount());
+    int threads = std::max(1, cores / static_cast<int>(renditions.size()));
+    AVRational frame_rate = av_guess_frame_rate(infmt_ctx_, stream_, nullptr);
+
+    for (const auto& rendition : renditions) {
+        branches_.emplace_back(new Branch(rendition, info_, job_));
+        if (!branches_.back()->Open(dec_ctx_, stream_->time_base, frame_rate, threads))
+            return false;
+    }
+
+    SPDLOG_INFO("Transcoding {0} into {1} renditions, encoder threads: {2}.", infile,
+                renditions.size(), threads);
+
+    if (job_) {
+        job_->set_duration(infmt_ctx_->duration);
+    }
+
+    AVPacket* pkt = av_packet_alloc();
+    if (!pkt) {
+        SPDLOG_ERROR("Failed to alloc packet.");
+        return false;
+    }
+    DEFER(av_packet_free(&pkt);)
+
+    bool ok = true;
+    int ret = 0;
+    while (ok && (ret = av_read_frame(infmt_ctx_, pkt)) >= 0) {
+        if (pkt->stream_index == stream_->index) {
+            if (job_) {
+                job_->UpdatePacket(pkt, stream_);
+            }
+            ok = Decode(pkt);
+        }
+        av_packet_unref(pkt);
+
+        ok = ok && !Cancelled();
+    }
+
+    if (ok && ret != AVERROR_EOF) {
+        FFmpegHelper::FFmpegError(ret);
+        ok = false;
+    }
+
+    ok = ok && Decode(nullptr);
+
+    for (auto& branch : branches_) {
+        ok = branch->Finish() && ok;
+    }
+
+    return ok && !Cancelled();
+}
+
+bool RenditionLadder::OpenInput(const char* infile)
+{
+    infmt_ctx_ = avformat_alloc_context();
+    if (!infmt_ctx_) {
+        SPDLOG_ERROR("Failed to alloc format context.");
+        return false;
+    }
+
+    if (job_) {
+        infmt_ctx_->interrupt_callback = job_->interrupt_cb();
+    }
+
+    // Frees the context on failure.
+    int ret = avformat_open_input(&infmt_ctx_, infile, nullptr, nullptr);
+    if (ret < 0) {
+        if (!Cancelled()) {
+            FFmpegHelper::FFmpegError(ret);
+        }
+        return false;
+    }
+
+    ret = avformat_find_stream_info(infmt_ctx_, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    ret = av_find_best_stream(infmt_ctx_, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+    stream_ = infmt_ctx_->streams[ret];
+
+    for (unsigned int i = 0; i < infmt_ctx_->nb_streams; ++i) {
+        if (infmt_ctx_->streams[i] != stream_) {
+            infmt_ctx_->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    return true;
+}
+
+bool RenditionLadder::OpenDecoder()
+{
+    const AVCodec* decoder = avcodec_find_decoder(stream_->codecpar->codec_id);
+    if (!decoder) {
+        SPDLOG_ERROR("Failed to find codec.");
+        return false;
+    }
+
+    dec_ctx_ = avcodec_alloc_context3(decoder);
+    if (!dec_ctx_) {
+        SPDLOG_ERROR("Failed to alloc codec context.");
+        return false;
+    }
+
+    int ret = avcodec_parameters_to_context(dec_ctx_, stream_->codecpar);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    // The single decode feeds every branch, give it all the codec threads it wants.
+    dec_ctx_->thread_count = 0;
+    dec_ctx_->pkt_timebase = stream_->time_base;
+
+    ret = avcodec_open2(dec_ctx_, decoder, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    return true;
+}
+
+bool RenditionLadder::Decode(const AVPacket* pkt)
+{
+    int ret = avcodec_send_packet(dec_ctx_, pkt);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    while (true) {
+        ret = avcodec_receive_frame(dec_ctx_, frame_);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        } else if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        // Encoders need strictly increasing pts.
+        int64_t pts = frame_->best_effort_timestamp;
+        if (pts == AV_NOPTS_VALUE || (last_pts_ != AV_NOPTS_VALUE && pts <= last_pts_)) {
+            pts = last_pts_ == AV_NOPTS_VALUE ? 0 : last_pts_ + 1;
+        }
+        frame_->pts = pts;
+        last_pts_ = pts;
+
+        // Every branch gets a reference to the same buffers.
+        bool any = false;
+        for (auto& branch : branches_) {
+            any = branch->Push(frame_) || any;
+        }
+        av_frame_unref(frame_);
+
+        if (!any) {
+            SPDLOG_ERROR("All renditions failed.");
+            return false;
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef RENDITION_LADDER_H_
+#define RENDITION_LADDER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+#include "ffmpeghelper.h"
+
+/**
+ * @brief Transcodes one input into several renditions of different sizes from a single decode.
+ *
+ * The video is demuxed and decoded once, every decoded frame is handed to all branches by
+ * reference, no pixels are copied. Each branch scales, encodes and muxes its rendition on its own
+ * thread, behind a short queue, so the decoder runs as far ahead as the slowest branch allows.
+ * Frame timestamps and rate are kept from the input.
+ */
+class RenditionLadder
+{
+public:
+    using Rendition = FFmpegHelper::Rendition;
+
+    /**
+     * @param info Codec name, gop size and max b frames of all renditions, the size and bit rate
+     *             are taken from each rendition.
+     * @param job Optional progress and cancellation.
+     */
+    RenditionLadder(const FFmpegHelper::VideoInfo& info, JobContext* job);
+    ~RenditionLadder();
+
+    /**
+     * @return True if every rendition was written.
+     */
+    bool Run(const char* infile, const std::vector<Rendition>& renditions);
+
+private:
+    class Branch;
+
+    bool OpenInput(const char* infile);
+    bool OpenDecoder();
+
+    /**
+     * @brief Decode a packet, null drains the decoder, and hand the frames to the branches.
+     */
+    bool Decode(const AVPacket* pkt);
+
+    bool Cancelled() const { return job_ && job_->cancelled(); }
+
+private:
+    FFmpegHelper::VideoInfo info_;
+    JobContext* job_;
+
+    AVFormatContext* infmt_ctx_;
+    AVCodecContext* dec_ctx_;
+    AVStream* stream_;
+    AVFrame* frame_;
+    int64_t last_pts_;
+
+    std::vector<std::unique_ptr<Branch>> branches_;
+};
+
+#endif
@@ -0,0 +1,533 @@
+#include "segment_transcoder.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdio.h>
+
+extern "C"
+{
+#include "libavutil/mathematics.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libswscale/swscale.h"
+}
+
+#include "spdlog/spdlog.h"
+#include "util/cthread.h"
+
+#define CONCAT_BUFFER_SIZE (1 << 20)
+
+class SegmentTranscoder::Worker : public CThread
+{
+public:
+    explicit Worker(SegmentTranscoder* owner)
+        : CThread(nullptr)
+        , owner_(owner)
+    {}
+
+protected:
+    bool DoPrepare() override { return true; }
+
+    void DoTask() override
+    {
+        int count = static_cast<int>(owner_->segments_.size());
+        int index = 0;
+        while ((index = owner_->next_segment_++) < count) {
+            Segment& segment = owner_->segments_[index];
+            segment.ok = !owner_->Cancelled() && owner_->TranscodeSegment(&segment);
+        }
+    }
+
+    void DoFinish() override {}
+
+private:
+    SegmentTranscoder* owner_;
+};
+
+SegmentTranscoder::SegmentTranscoder(const FFmpegHelper::VideoInfo& info, JobContext* job)
+    : info_(info)
+    , job_(job)
+    , video_index_(-1)
+    , total_packets_(0)
+    , done_packets_(0)
+    , next_segment_(0)
+{}
+
+bool SegmentTranscoder::Run(const char* infile, const char* outfile, int segments)
+{
+    infile_ = infile;
+    if (!ScanKeyframes(infile))
+        return false;
+
+    int cores = std::max(1, QThread::idealThreadCount());
+    PlanSegments(segments > 0 ? segments : cores);
+    for (size_t i = 0; i < segments_.size(); ++i) {
+        segments_[i].path = std::string(outfile) + ".seg" + std::to_string(i);
+    }
+
+    int worker_count = std::min(cores, static_cast<int>(segments_.size()));
+    SPDLOG_INFO("Transcoding {0} as {1} segments on {2} workers, keyframes: {3}.", infile,
+                segments_.size(), worker_count, keyframes_.size());
+
+    done_packets_ = 0;
+    next_segment_ = 0;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < worker_count; ++i) {
+        workers.emplace_back(new Worker(this));
+        workers.back()->start();
+    }
+    for (auto& worker : workers) {
+        worker->wait();
+    }
+
+    bool ok = !Cancelled();
+    for (const auto& segment : segments_) {
+        ok = ok && segment.ok;
+    }
+
+    ok = ok && Concat(outfile);
+    RemoveSegments();
+
+    return ok;
+}
+
+bool SegmentTranscoder::ScanKeyframes(const char* infile)
+{
+    AVFormatContext* fmt_ctx = nullptr;
+    if (!OpenInput(&fmt_ctx, infile))
+        return false;
+    DEFER(avformat_close_input(&fmt_ctx);)
+
+    int ret = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+    video_index_ = ret;
+
+    // Only the packet headers of the video stream are needed, nothing is decoded.
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; ++i) {
+        if (static_cast<int>(i) != video_index_) {
+            fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    AVPacket* pkt = av_packet_alloc();
+    if (!pkt) {
+        SPDLOG_ERROR("Failed to alloc packet.");
+        return false;
+    }
+    DEFER(av_packet_free(&pkt);)
+
+    keyframes_.clear();
+    total_packets_ = 0;
+
+    while ((ret = av_read_frame(fmt_ctx, pkt)) >= 0) {
+        if (pkt->stream_index == video_index_) {
+            ++total_packets_;
+
+            int64_t time = PacketTime(pkt);
+            if ((pkt->flags & AV_PKT_FLAG_KEY) && time != AV_NOPTS_VALUE
+                && (keyframes_.empty() || time > keyframes_.back())) {
+                keyframes_.push_back(time);
+            }
+        }
+        av_packet_unref(pkt);
+
+        if (Cancelled())
+            return false;
+    }
+
+    if (ret != AVERROR_EOF) {
+        if (!Cancelled()) {
+            FFmpegHelper::FFmpegError(ret);
+        }
+        return false;
+    }
+
+    if (keyframes_.empty()) {
+        SPDLOG_ERROR("No keyframes in the video stream of {0}.", infile);
+        return false;
+    }
+
+    return true;
+}
+
+void SegmentTranscoder::PlanSegments(int count)
+{
+    int64_t first = keyframes_.front();
+    int64_t last = keyframes_.back();
+
+    // Split at the first keyframe at or after each even share of the duration.
+    std::vector<int64_t> starts(1, first);
+    size_t k = 0;
+    for (int i = 1; i < count; ++i) {
+        int64_t target = first + av_rescale(last - first, i, count);
+        while (k < keyframes_.size()
+               && (keyframes_[k] <= starts.back() || keyframes_[k] < target)) {
+            ++k;
+        }
+        if (k == keyframes_.size())
+            break;
+
+        starts.push_back(keyframes_[k]);
+    }
+
+    segments_.clear();
+    for (size_t i = 0; i < starts.size(); ++i) {
+        Segment segment;
+        segment.start = starts[i];
+        segment.end = i + 1 < starts.size() ? starts[i + 1] : INT64_MAX;
+        segment.ok = false;
+        segments_.push_back(segment);
+    }
+}
+
+bool SegmentTranscoder::TranscodeSegment(Segment* segment)
+{
+    AVFormatContext* fmt_ctx = nullptr;
+    if (!OpenInput(&fmt_ctx, infile_.c_str()))
+        return false;
+    DEFER(avformat_close_input(&fmt_ctx);)
+
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; ++i) {
+        if (static_cast<int>(i) != video_index_) {
+            fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    AVStream* stream = fmt_ctx->streams[video_index_];
+
+    // Decoder
+    const AVCodec* decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!decoder) {
+        SPDLOG_ERROR("Failed to find codec.");
+        return false;
+    }
+
+    AVCodecContext* dec_ctx = avcodec_alloc_context3(decoder);
+    if (!dec_ctx) {
+        SPDLOG_ERROR("Failed to alloc codec context.");
+        return false;
+    }
+    DEFER(avcodec_free_context(&dec_ctx);)
+
+    int ret = avcodec_parameters_to_context(dec_ctx, stream->codecpar);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    // The segments are the parallelism, codec threads would only compete with them.
+    dec_ctx->thread_count = 1;
+
+    ret = avcodec_open2(dec_ctx, decoder, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    // Encoder, the same parameters as SaveEncodeVideo
+    const AVCodec* encoder = avcodec_find_encoder_by_name(info_.codec_name.c_str());
+    if (!encoder) {
+        SPDLOG_ERROR("Failed to find video codec {0}.", info_.codec_name);
+        return false;
+    }
+
+    AVCodecContext* enc_ctx = avcodec_alloc_context3(encoder);
+    if (!enc_ctx) {
+        SPDLOG_ERROR("Failed to alloc codec context.");
+        return false;
+    }
+    DEFER(avcodec_free_context(&enc_ctx);)
+
+    int width = dec_ctx->width;
+    int height = dec_ctx->height;
+    if (!info_.video_size.empty()) {
+        ret = av_parse_video_size(&width, &height, info_.video_size.c_str());
+        if (ret < 0) {
+            SPDLOG_ERROR("Failed to parse video size:{0}.", info_.video_size);
+            return false;
+        }
+    }
+
+    enc_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    enc_ctx->width = width;
+    enc_ctx->height = height;
+    // Without a rate the input keeps its own.
+    AVRational framerate = {info_.framerate, 1};
+    if (info_.framerate <= 0) {
+        framerate = av_guess_frame_rate(fmt_ctx, stream, nullptr);
+        if (framerate.num <= 0 || framerate.den <= 0) {
+            framerate = {25, 1};
+        }
+    }
+    enc_ctx->framerate = framerate;
+    enc_ctx->time_base = av_inv_q(framerate);
+    enc_ctx->bit_rate = info_.bit_rate;
+    enc_ctx->gop_size = info_.gop_size;
+    enc_ctx->max_b_frames = info_.max_b_frames;
+    enc_ctx->thread_count = 1;
+
+    if (encoder->id == AV_CODEC_ID_H264) {
+        av_opt_set(enc_ctx->priv_data, "preset", "slow", 0);
+    }
+
+    ret = avcodec_open2(enc_ctx, encoder, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    AVPacket* pkt = av_packet_alloc();
+    AVPacket* enc_pkt = av_packet_alloc();
+    AVFrame* src_frame = av_frame_alloc();
+    AVFrame* dst_frame = av_frame_alloc();
+    DEFER(av_packet_free(&pkt); av_packet_free(&enc_pkt); av_frame_free(&src_frame);
+          av_frame_free(&dst_frame);)
+    if (!pkt || !enc_pkt || !src_frame || !dst_frame) {
+        SPDLOG_ERROR("Failed to alloc packet or frame.");
+        return false;
+    }
+
+    dst_frame->width = width;
+    dst_frame->height = height;
+    dst_frame->format = enc_ctx->pix_fmt;
+    ret = av_frame_get_buffer(dst_frame, 0);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    SwsContext* sws_ctx = nullptr;
+    DEFER(sws_freeContext(sws_ctx);)
+
+    FILE* outfile_fp = fopen(segment->path.c_str(), "wb");
+    if (!outfile_fp) {
+        SPDLOG_ERROR("Failed to open segment file {0}.", segment->path);
+        return false;
+    }
+    DEFER(fclose(outfile_fp);)
+
+    auto encode = [&](const AVFrame* frame) -> bool {
+        int ret = avcodec_send_frame(enc_ctx, frame);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        while (true) {
+            ret = avcodec_receive_packet(enc_ctx, enc_pkt);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return true;
+            } else if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                return false;
+            }
+
+            size_t size = static_cast<size_t>(enc_pkt->size);
+            bool written = fwrite(enc_pkt->data, 1, size, outfile_fp) == size;
+            av_packet_unref(enc_pkt);
+            if (!written) {
+                SPDLOG_ERROR("Failed to write segment file {0}.", segment->path);
+                return false;
+            }
+        }
+    };
+
+    // Pts restart in every segment, an elementary stream carries no timestamps and the encoder
+    // opens each segment with an IDR frame.
+    int64_t frame_num = 0;
+    auto decode = [&](const AVPacket* packet) -> bool {
+        int ret = avcodec_send_packet(dec_ctx, packet);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        while (true) {
+            ret = avcodec_receive_frame(dec_ctx, src_frame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return true;
+            } else if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                return false;
+            }
+
+            sws_ctx = sws_getCachedContext(sws_ctx, src_frame->width, src_frame->height,
+                                           static_cast<AVPixelFormat>(src_frame->format), width,
+                                           height, enc_ctx->pix_fmt, SWS_FAST_BILINEAR, nullptr,
+                                           nullptr, nullptr);
+            if (!sws_ctx) {
+                SPDLOG_ERROR("Failed to get sws context.");
+                return false;
+            }
+
+            // The encoder may still reference the previous frame.
+            ret = av_frame_make_writable(dst_frame);
+            if (ret < 0) {
+                FFmpegHelper::FFmpegError(ret);
+                return false;
+            }
+
+            sws_scale(sws_ctx, src_frame->data, src_frame->linesize, 0, src_frame->height,
+                      dst_frame->data, dst_frame->linesize);
+            av_frame_unref(src_frame);
+
+            dst_frame->pts = frame_num++;
+            if (!encode(dst_frame))
+                return false;
+
+            if (job_) {
+                job_->AddFrames(1);
+            }
+        }
+    };
+
+    if (segment->start > keyframes_.front()) {
+        ret = av_seek_frame(fmt_ctx, video_index_, segment->start, AVSEEK_FLAG_BACKWARD);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+    }
+
+    bool started = false;
+    while (!Cancelled()) {
+        ret = av_read_frame(fmt_ctx, pkt);
+        if (ret == AVERROR_EOF) {
+            break;
+        } else if (ret < 0) {
+            if (!Cancelled()) {
+                FFmpegHelper::FFmpegError(ret);
+            }
+            return false;
+        }
+
+        if (pkt->stream_index != video_index_) {
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        int64_t time = PacketTime(pkt);
+        bool key = pkt->flags & AV_PKT_FLAG_KEY;
+        if (!started) {
+            // The seek lands on the start keyframe or before it.
+            if (time == AV_NOPTS_VALUE || time < segment->start) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            if (!key || time != segment->start) {
+                SPDLOG_ERROR("Failed to seek to the segment keyframe {0}.", segment->start);
+                av_packet_unref(pkt);
+                return false;
+            }
+            started = true;
+        } else if (key && time != AV_NOPTS_VALUE && time >= segment->end) {
+            av_packet_unref(pkt);
+            break;
+        }
+
+        if (job_) {
+            job_->AddBytes(pkt->size);
+        }
+
+        bool ok = decode(pkt);
+        av_packet_unref(pkt);
+        if (!ok)
+            return false;
+
+        int64_t done = ++done_packets_;
+        if (job_) {
+            job_->UpdatePosition(done, total_packets_);
+        }
+    }
+
+    if (Cancelled())
+        return false;
+
+    // Flush decoder and encoder
+    return decode(nullptr) && encode(nullptr);
+}
+
+bool SegmentTranscoder::Concat(const char* outfile)
+{
+    FILE* outfile_fp = fopen(outfile, "wb");
+    if (!outfile_fp) {
+        SPDLOG_ERROR("Failed to open output file.");
+        return false;
+    }
+    DEFER(fclose(outfile_fp);)
+
+    // Every segment starts with an IDR frame and its parameter sets, they join byte for byte.
+    std::vector<uint8_t> buffer(CONCAT_BUFFER_SIZE);
+    for (const auto& segment : segments_) {
+        FILE* segment_fp = fopen(segment.path.c_str(), "rb");
+        if (!segment_fp) {
+            SPDLOG_ERROR("Failed to open segment file {0}.", segment.path);
+            return false;
+        }
+        DEFER(fclose(segment_fp);)
+
+        size_t size = 0;
+        while ((size = fread(buffer.data(), 1, buffer.size(), segment_fp)) > 0) {
+            if (fwrite(buffer.data(), 1, size, outfile_fp) != size) {
+                SPDLOG_ERROR("Failed to write output file.");
+                return false;
+            }
+        }
+    }
+
+    // Add sequence end code to have a real MPEG file
+    const AVCodec* encoder = avcodec_find_encoder_by_name(info_.codec_name.c_str());
+    if (encoder
+        && (encoder->id == AV_CODEC_ID_MPEG1VIDEO || encoder->id == AV_CODEC_ID_MPEG2VIDEO)) {
+        uint8_t endcode[] = {0, 0, 1, 0xb7};
+        fwrite(endcode, 1, sizeof(endcode), outfile_fp);
+    }
+
+    return true;
+}
+
+void SegmentTranscoder::RemoveSegments()
+{
+    for (const auto& segment : segments_) {
+        remove(segment.path.c_str());
+    }
+}
+
+bool SegmentTranscoder::OpenInput(AVFormatContext** fmt_ctx, const char* infile)
+{
+    *fmt_ctx = avformat_alloc_context();
+    if (!*fmt_ctx) {
+        SPDLOG_ERROR("Failed to alloc format context.");
+        return false;
+    }
+
+    if (job_) {
+        (*fmt_ctx)->interrupt_callback = job_->interrupt_cb();
+    }
+
+    // Frees the context on failure.
+    int ret = avformat_open_input(fmt_ctx, infile, nullptr, nullptr);
+    if (ret < 0) {
+        if (!Cancelled()) {
+            FFmpegHelper::FFmpegError(ret);
+        }
+        return false;
+    }
+
+    ret = avformat_find_stream_info(*fmt_ctx, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        avformat_close_input(fmt_ctx);
+        return false;
+    }
+
+    return true;
+}
+
+int64_t SegmentTranscoder::PacketTime(const AVPacket* pkt)
+{
+    return pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+}
@@ -0,0 +1,81 @@
+#ifndef SEGMENT_TRANSCODER_H_
+#define SEGMENT_TRANSCODER_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+}
+
+#include "ffmpeghelper.h"
+
+/**
+ * @brief Transcodes the video of a file as keyframe aligned segments in parallel.
+ *
+ * The input is split at keyframes into segments of about the same duration. Every segment is
+ * decoded, scaled and encoded by its own worker with its own contexts into a temporary elementary
+ * stream, which starts with an IDR frame. The segments are then concatenated in order, so the
+ * output is the same bitstream format as FFmpegHelper::SaveEncodeVideo writes.
+ *
+ * Decoding a segment does not look at the previous one, so the input must have closed GOPs, as
+ * H.264 without intra refresh has.
+ */
+class SegmentTranscoder
+{
+public:
+    /**
+     * @param info Encoder parameters, an empty video size or a zero frame rate keeps that of the
+     *             input.
+     * @param job Optional progress and cancellation.
+     */
+    SegmentTranscoder(const FFmpegHelper::VideoInfo& info, JobContext* job);
+
+    /**
+     * @param segments Count of segments and workers, 0 for one per core.
+     */
+    bool Run(const char* infile, const char* outfile, int segments);
+
+private:
+    struct Segment
+    {
+        int64_t start; // Timestamp of the first keyframe
+        int64_t end;   // Timestamp of the keyframe of the next segment, INT64_MAX for the last
+        std::string path;
+        bool ok;
+    };
+
+    class Worker;
+
+    /**
+     * @brief Demux the video stream once and collect the timestamps of its keyframes.
+     */
+    bool ScanKeyframes(const char* infile);
+    void PlanSegments(int count);
+    bool TranscodeSegment(Segment* segment);
+    bool Concat(const char* outfile);
+    void RemoveSegments();
+
+    bool OpenInput(AVFormatContext** fmt_ctx, const char* infile);
+    bool Cancelled() const { return job_ && job_->cancelled(); }
+
+    // Decode timestamp, which is monotonic, falls back to pts.
+    static int64_t PacketTime(const AVPacket* pkt);
+
+private:
+    FFmpegHelper::VideoInfo info_;
+    JobContext* job_;
+    std::string infile_;
+
+    int video_index_;
+    std::vector<int64_t> keyframes_;
+    int64_t total_packets_;
+    std::atomic<int64_t> done_packets_;
+
+    std::vector<Segment> segments_;
+    std::atomic<int> next_segment_;
+};
+
+#endif
@@ -0,0 +1,646 @@
+#include "smart_cutter.h"
+
+#include <algorithm>
+#include <string.h>
+
+extern "C"
+{
+#include "libavutil/mathematics.h"
+}
+
+#include "ffmpeghelper.h"
+#include "spdlog/spdlog.h"
+
+static const uint8_t* find_start_code(const uint8_t* p, const uint8_t* end)
+{
+    for (; p + 3 <= end; ++p) {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+
+    return end;
+}
+
+static void append_nal(std::vector<uint8_t>* out, const uint8_t* nal, size_t size,
+                       int length_size)
+{
+    if (length_size == 0) {
+        static const uint8_t start_code[] = {0, 0, 0, 1};
+        out->insert(out->end(), start_code, start_code + sizeof(start_code));
+    } else {
+        for (int i = length_size - 1; i >= 0; --i) {
+            out->push_back(static_cast<uint8_t>(size >> (8 * i)));
+        }
+    }
+    out->insert(out->end(), nal, nal + size);
+}
+
+SmartCutter::SmartCutter(JobContext* job)
+    : job_(job)
+    , infmt_ctx_(nullptr)
+    , outfmt_ctx_(nullptr)
+    , dec_ctx_(nullptr)
+    , enc_ctx_(nullptr)
+    , frame_(av_frame_alloc())
+    , enc_pkt_(av_packet_alloc())
+    , video_index_(-1)
+    , smart_(false)
+    , gop_key_(AV_NOPTS_VALUE)
+    , video_delay_(0)
+    , reencoded_(false)
+    , nal_length_size_(0)
+    , copied_gops_(0)
+    , reencoded_frames_(0)
+{}
+
+SmartCutter::~SmartCutter()
+{
+    ClearGop();
+    CloseEncoder();
+    avcodec_free_context(&dec_ctx_);
+    av_frame_free(&frame_);
+    av_packet_free(&enc_pkt_);
+
+    if (outfmt_ctx_) {
+        if (!(outfmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&outfmt_ctx_->pb);
+        }
+        avformat_free_context(outfmt_ctx_);
+    }
+    avformat_close_input(&infmt_ctx_);
+}
+
+bool SmartCutter::Run(const char* infile, const char* outfile, int64_t start_us, int64_t end_us)
+{
+    if (!frame_ || !enc_pkt_) {
+        SPDLOG_ERROR("Failed to alloc packet or frame.");
+        return false;
+    }
+
+    if (!OpenInput(infile) || !OpenOutput(outfile))
+        return false;
+
+    // Times of the range are relative to the start of the input.
+    int64_t origin = infmt_ctx_->start_time != AV_NOPTS_VALUE ? infmt_ctx_->start_time : 0;
+    int64_t duration = end_us > start_us ? end_us - start_us : infmt_ctx_->duration - start_us;
+
+    for (unsigned int i = 0; i < infmt_ctx_->nb_streams; ++i) {
+        AVRational time_base = infmt_ctx_->streams[i]->time_base;
+        starts_.push_back(av_rescale_q(origin + start_us, AV_TIME_BASE_Q, time_base));
+        ends_.push_back(end_us > start_us
+                            ? av_rescale_q(origin + end_us, AV_TIME_BASE_Q, time_base)
+                            : INT64_MAX);
+        done_.push_back(false);
+    }
+
+    AVStream* stream = infmt_ctx_->streams[video_index_];
+    ParseParameterSets();
+
+    // Try the encoder once, a cut must not fail halfway.
+    AVCodecParameters* par = stream->codecpar;
+    smart_ = (par->codec_id == AV_CODEC_ID_H264 || par->extradata_size == 0) && OpenEncoder();
+    CloseEncoder();
+    if (!smart_) {
+        SPDLOG_WARN("Can not re-encode {0}, cutting at keyframes.",
+                    avcodec_get_name(par->codec_id));
+    }
+
+    if (start_us > 0) {
+        // Lands on the keyframe at or before the start.
+        int ret = av_seek_frame(infmt_ctx_, video_index_, starts_[video_index_],
+                                AVSEEK_FLAG_BACKWARD);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+    }
+
+    if (job_) {
+        job_->set_duration(duration);
+    }
+
+    if (!ReadPackets())
+        return false;
+
+    int ret = av_write_trailer(outfmt_ctx_);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    SPDLOG_INFO("Smart cut {0}: copied gops: {1}, re-encoded frames: {2}.", outfile, copied_gops_,
+                reencoded_frames_);
+
+    return true;
+}
+
+bool SmartCutter::OpenInput(const char* infile)
+{
+    infmt_ctx_ = avformat_alloc_context();
+    if (!infmt_ctx_) {
+        SPDLOG_ERROR("Failed to alloc format context.");
+        return false;
+    }
+
+    if (job_) {
+        infmt_ctx_->interrupt_callback = job_->interrupt_cb();
+    }
+
+    // Frees the context on failure.
+    int ret = avformat_open_input(&infmt_ctx_, infile, nullptr, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    ret = avformat_find_stream_info(infmt_ctx_, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    ret = av_find_best_stream(infmt_ctx_, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+    video_index_ = ret;
+
+    return true;
+}
+
+bool SmartCutter::OpenOutput(const char* outfile)
+{
+    int ret = avformat_alloc_output_context2(&outfmt_ctx_, nullptr, nullptr, outfile);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    for (unsigned int i = 0; i < infmt_ctx_->nb_streams; ++i) {
+        AVStream* in_stream = infmt_ctx_->streams[i];
+        AVStream* out_stream = avformat_new_stream(outfmt_ctx_, nullptr);
+        if (!out_stream) {
+            SPDLOG_ERROR("Failed to create out stream index[{0}]", i);
+            return false;
+        }
+
+        ret = avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+        // Solve incompatible for codec
+        out_stream->codecpar->codec_tag = 0;
+    }
+
+    if (!(outfmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+        AVIOInterruptCB* interrupt_cb = nullptr;
+        if (job_) {
+            outfmt_ctx_->interrupt_callback = job_->interrupt_cb();
+            interrupt_cb = &outfmt_ctx_->interrupt_callback;
+        }
+
+        ret = avio_open2(&outfmt_ctx_->pb, outfile, AVIO_FLAG_WRITE, interrupt_cb, nullptr);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+    }
+
+    ret = avformat_write_header(outfmt_ctx_, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    return true;
+}
+
+bool SmartCutter::OpenDecoder()
+{
+    AVCodecParameters* par = infmt_ctx_->streams[video_index_]->codecpar;
+    const AVCodec* decoder = avcodec_find_decoder(par->codec_id);
+    if (!decoder) {
+        SPDLOG_ERROR("Failed to find codec.");
+        return false;
+    }
+
+    dec_ctx_ = avcodec_alloc_context3(decoder);
+    if (!dec_ctx_) {
+        SPDLOG_ERROR("Failed to alloc codec context.");
+        return false;
+    }
+
+    int ret = avcodec_parameters_to_context(dec_ctx_, par);
+    if (ret >= 0) {
+        dec_ctx_->pkt_timebase = infmt_ctx_->streams[video_index_]->time_base;
+        ret = avcodec_open2(dec_ctx_, decoder, nullptr);
+    }
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        avcodec_free_context(&dec_ctx_);
+        return false;
+    }
+
+    return true;
+}
+
+bool SmartCutter::OpenEncoder()
+{
+    AVStream* stream = infmt_ctx_->streams[video_index_];
+    AVCodecParameters* par = stream->codecpar;
+
+    const AVCodec* encoder = avcodec_find_encoder(par->codec_id);
+    if (!encoder)
+        return false;
+
+    enc_ctx_ = avcodec_alloc_context3(encoder);
+    if (!enc_ctx_)
+        return false;
+
+    // Match the copied GOPs, so one decoder configuration plays the whole output.
+    enc_ctx_->width = par->width;
+    enc_ctx_->height = par->height;
+    enc_ctx_->pix_fmt = static_cast<AVPixelFormat>(par->format);
+    enc_ctx_->sample_aspect_ratio = par->sample_aspect_ratio;
+    enc_ctx_->color_range = par->color_range;
+    enc_ctx_->color_primaries = par->color_primaries;
+    enc_ctx_->color_trc = par->color_trc;
+    enc_ctx_->colorspace = par->color_space;
+    enc_ctx_->profile = par->profile;
+    enc_ctx_->level = par->level;
+    enc_ctx_->bit_rate = par->bit_rate;
+    enc_ctx_->time_base = stream->time_base;
+    enc_ctx_->framerate = av_guess_frame_rate(infmt_ctx_, stream, nullptr);
+
+    // Decode order is presentation order, the dts of the re-encoded frames can simply follow
+    // their pts.
+    enc_ctx_->max_b_frames = 0;
+
+    int ret = avcodec_open2(enc_ctx_, encoder, nullptr);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        CloseEncoder();
+        return false;
+    }
+
+    return true;
+}
+
+void SmartCutter::CloseEncoder()
+{
+    avcodec_free_context(&enc_ctx_);
+}
+
+bool SmartCutter::ReadPackets()
+{
+    AVPacket* pkt = av_packet_alloc();
+    if (!pkt) {
+        SPDLOG_ERROR("Failed to alloc packet.");
+        return false;
+    }
+    DEFER(av_packet_free(&pkt);)
+
+    while (!Cancelled()) {
+        int ret = av_read_frame(infmt_ctx_, pkt);
+        if (ret == AVERROR_EOF) {
+            break;
+        } else if (ret < 0) {
+            if (!Cancelled()) {
+                FFmpegHelper::FFmpegError(ret);
+            }
+            return false;
+        }
+
+        AVStream* stream = infmt_ctx_->streams[pkt->stream_index];
+        if (job_) {
+            job_->UpdatePacket(pkt, stream);
+        }
+
+        bool ok = pkt->stream_index == video_index_ ? HandleVideo(pkt) : HandleOther(pkt);
+        av_packet_unref(pkt);
+        if (!ok)
+            return false;
+
+        // Streams are interleaved loosely, read until every one has passed the end.
+        bool done = true;
+        for (unsigned int i = 0; i < infmt_ctx_->nb_streams; ++i) {
+            AVMediaType type = infmt_ctx_->streams[i]->codecpar->codec_type;
+            if (!done_[i] && (static_cast<int>(i) == video_index_ || type == AVMEDIA_TYPE_AUDIO)) {
+                done = false;
+            }
+        }
+        if (done)
+            break;
+    }
+
+    if (Cancelled())
+        return false;
+
+    return FlushGop(INT64_MAX);
+}
+
+bool SmartCutter::HandleVideo(AVPacket* pkt)
+{
+    if (done_[video_index_])
+        return true;
+
+    int64_t pts = PacketPts(pkt);
+    if ((pkt->flags & AV_PKT_FLAG_KEY) && pts != AV_NOPTS_VALUE) {
+        if (!FlushGop(pts))
+            return false;
+
+        if (pts >= ends_[video_index_]) {
+            done_[video_index_] = true;
+            return true;
+        }
+
+        if (pkt->pts != AV_NOPTS_VALUE && pkt->dts != AV_NOPTS_VALUE) {
+            video_delay_ = std::max<int64_t>(0, pkt->pts - pkt->dts);
+        }
+        gop_key_ = pts;
+    } else if (gop_.empty()) {
+        // Packets before the first keyframe can not be decoded.
+        return true;
+    }
+
+    AVPacket* copy = av_packet_clone(pkt);
+    if (!copy) {
+        SPDLOG_ERROR("Failed to alloc packet.");
+        return false;
+    }
+    gop_.push_back(copy);
+
+    return true;
+}
+
+bool SmartCutter::HandleOther(AVPacket* pkt)
+{
+    int index = pkt->stream_index;
+    int64_t pts = PacketPts(pkt);
+    if (done_[index] || pts == AV_NOPTS_VALUE || pts < starts_[index])
+        return true;
+
+    if (pts >= ends_[index]) {
+        done_[index] = true;
+        return true;
+    }
+
+    return Write(pkt);
+}
+
+bool SmartCutter::FlushGop(int64_t next_key)
+{
+    if (gop_.empty())
+        return true;
+
+    int64_t start = starts_[video_index_];
+    int64_t end = ends_[video_index_];
+
+    bool ok = true;
+    if (next_key <= start) {
+        // Before the range.
+    } else if ((gop_key_ >= start && next_key <= end) || !smart_) {
+        ok = CopyGop();
+    } else {
+        ok = ReencodeGop();
+    }
+
+    ClearGop();
+    return ok;
+}
+
+void SmartCutter::ClearGop()
+{
+    for (auto& pkt : gop_) {
+        av_packet_free(&pkt);
+    }
+    gop_.clear();
+}
+
+bool SmartCutter::CopyGop()
+{
+    for (size_t i = 0; i < gop_.size(); ++i) {
+        if (i == 0 && reencoded_ && !parameter_sets_.empty()) {
+            // The decoder holds the parameter sets of the encoder now.
+            AVPacket* pkt = av_packet_alloc();
+            DEFER(av_packet_free(&pkt);)
+            if (!pkt || !PrependParameterSets(gop_[i], pkt) || !Write(pkt))
+                return false;
+        } else if (!Write(gop_[i])) {
+            return false;
+        }
+    }
+
+    reencoded_ = false;
+    ++copied_gops_;
+
+    return true;
+}
+
+bool SmartCutter::ReencodeGop()
+{
+    if (!dec_ctx_ && !OpenDecoder())
+        return false;
+
+    for (auto pkt : gop_) {
+        int ret = avcodec_send_packet(dec_ctx_, pkt);
+        if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        if (!ReceiveFrames())
+            return false;
+    }
+
+    // Drain the GOP, every GOP is decoded on its own.
+    avcodec_send_packet(dec_ctx_, nullptr);
+    bool ok = ReceiveFrames();
+    avcodec_flush_buffers(dec_ctx_);
+    if (!ok)
+        return false;
+
+    // Encoders can not be restarted after a flush, the next partial GOP opens a new one.
+    if (enc_ctx_) {
+        ok = EncodeFrame(nullptr);
+        CloseEncoder();
+        reencoded_ = true;
+    }
+
+    return ok;
+}
+
+bool SmartCutter::ReceiveFrames()
+{
+    while (true) {
+        int ret = avcodec_receive_frame(dec_ctx_, frame_);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        } else if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        int64_t pts = frame_->best_effort_timestamp;
+        bool inside =
+            pts != AV_NOPTS_VALUE && pts >= starts_[video_index_] && pts < ends_[video_index_];
+
+        bool ok = !inside || EncodeFrame(frame_);
+        av_frame_unref(frame_);
+        if (!ok)
+            return false;
+    }
+}
+
+bool SmartCutter::EncodeFrame(AVFrame* frame)
+{
+    if (frame) {
+        if (!enc_ctx_ && !OpenEncoder())
+            return false;
+
+        frame->pts = frame->best_effort_timestamp;
+        frame->pict_type = AV_PICTURE_TYPE_NONE;
+        ++reencoded_frames_;
+    }
+
+    int ret = avcodec_send_frame(enc_ctx_, frame);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    while (true) {
+        ret = avcodec_receive_packet(enc_ctx_, enc_pkt_);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        } else if (ret < 0) {
+            FFmpegHelper::FFmpegError(ret);
+            return false;
+        }
+
+        // Shifted like the copied packets, so the dts keep increasing across the cut.
+        enc_pkt_->dts = enc_pkt_->pts - video_delay_;
+        enc_pkt_->stream_index = video_index_;
+
+        AVPacket* pkt = av_packet_alloc();
+        bool ok = pkt && ToStreamFormat(enc_pkt_, pkt) && Write(pkt);
+        av_packet_free(&pkt);
+        av_packet_unref(enc_pkt_);
+        if (!ok)
+            return false;
+    }
+}
+
+bool SmartCutter::Write(AVPacket* pkt)
+{
+    int index = pkt->stream_index;
+    AVStream* in_stream = infmt_ctx_->streams[index];
+    AVStream* out_stream = outfmt_ctx_->streams[index];
+
+    if (pkt->pts != AV_NOPTS_VALUE) {
+        pkt->pts -= starts_[index];
+    }
+    if (pkt->dts != AV_NOPTS_VALUE) {
+        pkt->dts -= starts_[index];
+    }
+    av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base);
+    pkt->pos = -1;
+
+    int ret = av_interleaved_write_frame(outfmt_ctx_, pkt);
+    if (ret < 0) {
+        FFmpegHelper::FFmpegError(ret);
+        return false;
+    }
+
+    return true;
+}
+
+void SmartCutter::ParseParameterSets()
+{
+    AVCodecParameters* par = infmt_ctx_->streams[video_index_]->codecpar;
+    const uint8_t* data = par->extradata;
+    int size = par->extradata_size;
+
+    nal_length_size_ = 0;
+    parameter_sets_.clear();
+    if (par->codec_id != AV_CODEC_ID_H264 || size == 0)
+        return;
+
+    if (data[0] != 1) {
+        // Annex B extradata already is a sequence of start codes and parameter sets.
+        parameter_sets_.assign(data, data + size);
+        return;
+    }
+
+    // avcC: version, profile, compatibility, level, length size, sps count, sps..., pps count,
+    // pps...
+    if (size < 7)
+        return;
+
+    nal_length_size_ = (data[4] & 0x03) + 1;
+
+    const uint8_t* p = data + 5;
+    const uint8_t* end = data + size;
+    for (int set = 0; set < 2 && p < end; ++set) {
+        int count = set == 0 ? (*p++ & 0x1f) : *p++;
+        for (int i = 0; i < count && p + 2 <= end; ++i) {
+            size_t length = (p[0] << 8) | p[1];
+            p += 2;
+            if (p + length > end)
+                return;
+
+            append_nal(&parameter_sets_, p, length, nal_length_size_);
+            p += length;
+        }
+    }
+}
+
+bool SmartCutter::ToStreamFormat(const AVPacket* in, AVPacket* out) const
+{
+    if (nal_length_size_ == 0)
+        return av_packet_ref(out, in) == 0;
+
+    // Encoders emit Annex B, the stream stores length prefixed NAL units.
+    std::vector<uint8_t> data;
+    data.reserve(in->size + 16);
+
+    const uint8_t* end = in->data + in->size;
+    const uint8_t* start_code = find_start_code(in->data, end);
+    while (start_code < end) {
+        const uint8_t* nal = start_code + 3;
+        start_code = find_start_code(nal, end);
+
+        // The zero byte before a four byte start code belongs to it.
+        const uint8_t* nal_end = start_code;
+        while (nal_end > nal && nal_end[-1] == 0) {
+            --nal_end;
+        }
+        if (nal_end > nal) {
+            append_nal(&data, nal, nal_end - nal, nal_length_size_);
+        }
+    }
+
+    if (av_new_packet(out, static_cast<int>(data.size())) < 0)
+        return false;
+
+    memcpy(out->data, data.data(), data.size());
+    return av_packet_copy_props(out, in) == 0;
+}
+
+bool SmartCutter::PrependParameterSets(const AVPacket* in, AVPacket* out) const
+{
+    int size = static_cast<int>(parameter_sets_.size());
+    if (av_new_packet(out, size + in->size) < 0)
+        return false;
+
+    memcpy(out->data, parameter_sets_.data(), size);
+    memcpy(out->data + size, in->data, in->size);
+    return av_packet_copy_props(out, in) == 0;
+}
+
+int64_t SmartCutter::PacketPts(const AVPacket* pkt)
+{
+    return pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+}
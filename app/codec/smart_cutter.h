@@ -0,0 +1,102 @@
+#ifndef SMART_CUTTER_H_
+#define SMART_CUTTER_H_
+
+#include <stdint.h>
+#include <vector>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+}
+
+#include "job/job_context.h"
+
+/**
+ * @brief Frame accurate trimming at close to stream copy speed.
+ *
+ * The video is processed a GOP at a time. GOPs that lie entirely inside the range are copied, the
+ * partial GOPs at the cut points are decoded and only their frames inside the range are encoded
+ * again, with the codec parameters of the input. Packets of the other streams are copied when
+ * they start inside the range.
+ *
+ * Re-encoded H.264 carries its parameter sets in band and the first copied keyframe after it gets
+ * the parameter sets of the input again. Video codecs that can not be re-encoded this way fall
+ * back to cutting at the keyframe before the start. The input must have closed GOPs.
+ */
+class SmartCutter
+{
+public:
+    explicit SmartCutter(JobContext* job = nullptr);
+    ~SmartCutter();
+
+    /**
+     * @param end_us End of the range, at or before start_us for the end of the input.
+     */
+    bool Run(const char* infile, const char* outfile, int64_t start_us, int64_t end_us);
+
+private:
+    bool OpenInput(const char* infile);
+    bool OpenOutput(const char* outfile);
+    bool OpenDecoder();
+    bool OpenEncoder();
+    void CloseEncoder();
+
+    bool ReadPackets();
+    bool HandleVideo(AVPacket* pkt);
+    bool HandleOther(AVPacket* pkt);
+
+    /**
+     * @brief Copy, re-encode or drop the buffered GOP, which ends at next_key.
+     */
+    bool FlushGop(int64_t next_key);
+    void ClearGop();
+    bool CopyGop();
+    bool ReencodeGop();
+    bool ReceiveFrames();
+    bool EncodeFrame(AVFrame* frame);
+
+    /**
+     * @brief Move the packet to the output with its timestamps relative to the range start.
+     */
+    bool Write(AVPacket* pkt);
+
+    // Parameter sets and NAL length size of the input, for H.264 in avcC format.
+    void ParseParameterSets();
+    bool ToStreamFormat(const AVPacket* in, AVPacket* out) const;
+    bool PrependParameterSets(const AVPacket* in, AVPacket* out) const;
+
+    bool Cancelled() const { return job_ && job_->cancelled(); }
+    static int64_t PacketPts(const AVPacket* pkt);
+
+private:
+    JobContext* job_;
+
+    AVFormatContext* infmt_ctx_;
+    AVFormatContext* outfmt_ctx_;
+    AVCodecContext* dec_ctx_;
+    AVCodecContext* enc_ctx_;
+    AVFrame* frame_;
+    AVPacket* enc_pkt_;
+
+    int video_index_;
+    bool smart_;
+
+    // Range in the time base of each stream, the start is the output origin.
+    std::vector<int64_t> starts_;
+    std::vector<int64_t> ends_;
+    std::vector<bool> done_;
+
+    std::vector<AVPacket*> gop_;
+    int64_t gop_key_;
+    int64_t video_delay_; // pts - dts of the copied packets
+    bool reencoded_;      // The last video written came from the encoder
+
+    int nal_length_size_; // 0 for Annex B
+    std::vector<uint8_t> parameter_sets_;
+
+    int64_t copied_gops_;
+    int64_t reencoded_frames_;
+};
+
+#endif
@@ -6,6 +6,7 @@ typedef enum
     kFile,
     kNetwork,
     kCapture,
+    kRawFile, // Raw I420 or Y4M, memory mapped
     kNone
 } MediaSourceType;
 
@@ -15,8 +16,23 @@ typedef enum
     PIX_FMT_YUVJ422P,
     PIX_FMT_NV12,
     PIX_FMT_RGB,
+    PIX_FMT_P010, // 10 bits in the high bits of 16-bit little endian words
+    PIX_FMT_P016,
 } PixelFormat;
 
+typedef enum
+{
+    kColorSpaceBT601,
+    kColorSpaceBT709,
+    kColorSpaceBT2020,
+} ColorSpace;
+
+typedef enum
+{
+    kColorRangeLimited, // 16-235 for 8 bits
+    kColorRangeFull,
+} ColorRange;
+
 typedef enum
 {
     H264,
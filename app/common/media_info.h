@@ -9,6 +9,7 @@ typedef struct media_info_
 {
     MediaSourceType type;
     std::string src;
+    std::string video_size; // Frame size of headerless raw video, like 1920x1080
 
     media_info_() { type = kNone; };
 } MediaInfo;
@@ -1,5 +1,11 @@
 #include "config.h"
 
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <QStandardPaths>
+#endif
+
 Config::Config(QObject* parent)
     : QObject(parent)
 {
@@ -24,9 +30,21 @@ void Config::SetAppConfigData(const QString& group, const QString& key, const QV
 
 QVariant Config::AppConfigData(const QString& group, const QString& key, const QVariant& default_value)
 {
+    auto it = overrides_.find(QString("%1/%2").arg(group, key));
+    if (it != overrides_.end())
+        return it.value();
+
     return AppConfigData(app_settings_, group, key, default_value);
 }
 
+void Config::SetOverride(const QString& group, const QString& key, const QVariant& value)
+{
+    if (group.isEmpty() || key.isEmpty())
+        return;
+
+    overrides_.insert(QString("%1/%2").arg(group, key), value);
+}
+
 QVariant Config::AppConfigData(QSettings* settings, const QString& group, const QString& key,
                                const QVariant& default_value)
 {
@@ -48,12 +66,19 @@ void Config::SetConfigData(QSettings* settings, const QString& group, const QStr
 
 quint32 Config::GetConfigFileDir(char* filename, quint32 size)
 {
+#ifdef _WIN32
     char system_path[128] = {0};
     GetSystemDirectoryA(system_path, 128);
 
     const char* pos = strchr(system_path, '\\');
     system_path[pos - system_path] = '\0';
     strcat(system_path, "\\ProgramData\\spark-player\\");
+#else
+    QByteArray config_dir =
+        QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation).toLocal8Bit()
+        + "/spark-player/";
+    const char* system_path = config_dir.constData();
+#endif
 
     memset(filename, 0, size);
     memcpy(filename, system_path, (std::min<size_t>)(strlen(system_path), size));
@@ -1,9 +1,9 @@
 #ifndef CONFIG_H_
 #define CONFIG_H_
 
+#include <QHash>
 #include <QObject>
 #include <QSettings>
-#include <Windows.h>
 
 class Config : public QObject
 {
@@ -16,6 +16,11 @@ public:
     QVariant AppConfigData(const QString& group, const QString& key,
                            const QVariant& default_value = QVariant());
 
+    /**
+     * @brief Override a value for this session only, it is not written to the config file.
+     */
+    void SetOverride(const QString& group, const QString& key, const QVariant& value);
+
     quint32 GetConfigFileDir(char* filename, quint32 size);
 
 private:
@@ -26,6 +31,9 @@ private:
 
 private:
     QSettings* app_settings_;
+
+    // Session values, e.g. from the command line
+    QHash<QString, QVariant> overrides_;
 };
 
 #endif
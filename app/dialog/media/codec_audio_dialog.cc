@@ -1,23 +1,35 @@
 #include "codec_audio_dialog.h"
 
+#include <QDir>
 #include <QFileDialog>
-#include <QMessagebox>
+#include <QFileInfo>
 #include <QPushButton>
 #include <QRadioButton>
 #include <QVBoxLayout>
 
 #include "codec/ffmpeghelper.h"
+#include "job/job_executor.h"
 #include "widget/common/uihelper.h"
 #include "widget/common/widgets.h"
 
-CodecAudioDialog::CodecAudioDialog(QWidget* parent)
+CodecAudioDialog::CodecAudioDialog(JobExecutor* executor, QWidget* parent)
     : ConfirmDialog(parent)
+    , executor_(executor)
 {
     setWindowTitle(tr("Codec Audio"));
 
     infile_edit_ = new FolderLineEdit(this);
     outfile_edit_ = new FolderLineEdit(this);
 
+    // Several infiles are separated by ';'.
+    infile_edit_->set_select_file_handle([this]() {
+        QStringList files = QFileDialog::getOpenFileNames(this);
+        if (!files.isEmpty()) {
+            infile_edit_->setText(files.join(';'));
+            infile_edit_->setToolTip(files.join('\n'));
+        }
+    });
+
     // normal
     auto normal_title = new QLabel(tr("Normal"), this);
     sample_rate_edit_ = new QLineEdit(this);
@@ -38,20 +50,36 @@ CodecAudioDialog::CodecAudioDialog(QWidget* parent)
     auto codec_title = new QLabel(tr("Codec"), this);
     auto codec_tip = new IconButton(style()->standardIcon(QStyle::SP_MessageBoxInformation), this);
     codec_tip->setFixedSize(16, 16);
-    codec_tip->setToolTip(tr("Only pcm files in f32le format are supported"));
+    codec_tip->setToolTip(tr("Only pcm files in f32le format are supported. Several infiles are "
+                             "encoded at once into the outfile folder."));
 
     codec_combo_ = new QComboBox(this);
     codec_combo_->addItem(tr("mp3"), 0);
     codec_combo_->addItem(tr("aac"), 1);
+    codec_combo_->addItem(tr("opus"), 2);
 
     widget_pair_list.clear();
     widget_pair_list.append(qMakePair(new QLabel(tr("Codec:")), codec_combo_));
     auto codec_layout = uihelper::InitDialogGridLayout(widget_pair_list);
 
+    // decode
+    auto output_title = new QLabel(tr("Output"), this);
+    sample_fmt_combo_ = new QComboBox(this);
+    sample_fmt_combo_->addItem(tr("Same as source"), AV_SAMPLE_FMT_NONE);
+    sample_fmt_combo_->addItem(tr("s16le"), AV_SAMPLE_FMT_S16);
+    sample_fmt_combo_->addItem(tr("s32le"), AV_SAMPLE_FMT_S32);
+    sample_fmt_combo_->addItem(tr("f32le"), AV_SAMPLE_FMT_FLT);
+    sample_fmt_combo_->addItem(tr("f64le"), AV_SAMPLE_FMT_DBL);
+
+    widget_pair_list.clear();
+    widget_pair_list.append(qMakePair(new QLabel(tr("Sample Format:")), sample_fmt_combo_));
+    auto output_layout = uihelper::InitDialogGridLayout(widget_pair_list);
+
     codec_tabwidget_ = new QTabWidget(this);
+    auto decoder_widget = new QWidget(codec_tabwidget_);
     auto encoder_widget = new QWidget(codec_tabwidget_);
 
-    codec_tabwidget_->insertTab(kDecode, new QWidget(codec_tabwidget_), tr("Decode"));
+    codec_tabwidget_->insertTab(kDecode, decoder_widget, tr("Decode"));
     codec_tabwidget_->insertTab(kEncode, encoder_widget, tr("Encode"));
 
     auto codec_title_layout = new QHBoxLayout;
@@ -59,6 +87,12 @@ CodecAudioDialog::CodecAudioDialog(QWidget* parent)
     codec_title_layout->addWidget(codec_tip);
     codec_title_layout->addStretch();
 
+    auto decode_layout = new QVBoxLayout(decoder_widget);
+    decode_layout->addWidget(output_title);
+    decode_layout->addLayout(output_layout);
+    decode_layout->addStretch();
+    decode_layout->setAlignment(output_title, Qt::AlignLeft);
+
     auto encode_layout = new QVBoxLayout(encoder_widget);
     encode_layout->addWidget(normal_title);
     encode_layout->addLayout(normal_layout);
@@ -82,25 +116,40 @@ void CodecAudioDialog::Encode()
     info.bit_rate = bit_rate_edit_->text().toInt();
     info.sample_rate = sample_rate_edit_->text().toInt();
     info.channels = channel_combo_->currentData().toInt();
-
-    bool ret = FFmpegHelper::SaveEncodeAudio(info, infile_edit_->text().toStdString().c_str(),
-                                             outfile_edit_->text().toStdString().c_str());
-    if (ret) {
-        QMessageBox::information(this, tr("Info"), tr("Successfully save the encoded audio file"));
-    } else {
-        QMessageBox::warning(this, tr("warning"), tr("Failed to save the encoded audio file"));
+    info.sample_fmt = AV_SAMPLE_FMT_FLT;
+
+    static const char* suffixes[] = {"mp3", "aac", "opus"};
+    QString suffix = suffixes[info.codec_id];
+
+    // One job per infile, the executor encodes them in parallel.
+    QStringList infiles = infile_edit_->text().split(';');
+    infiles.removeAll(QString());
+    for (const auto& file : infiles) {
+        QString out = outfile_edit_->text();
+        if (infiles.size() > 1) {
+            out = QDir(out).filePath(QFileInfo(file).completeBaseName() + "." + suffix);
+        }
+
+        std::string infile = file.trimmed().toStdString();
+        std::string outfile = out.toStdString();
+        executor_->Submit(tr("Encode %1").arg(out), [info, infile, outfile](JobContext* job) {
+            return FFmpegHelper::SaveEncodeAudio(info, infile.c_str(), outfile.c_str(), job);
+        });
     }
 }
 
 void CodecAudioDialog::Decode()
 {
-    bool ret = FFmpegHelper::SaveDecodeAudio(infile_edit_->text().toStdString().c_str(),
-                                             outfile_edit_->text().toStdString().c_str());
-    if (ret) {
-        QMessageBox::information(this, tr("Info"), tr("Successfully save the decoded audio file"));
-    } else {
-        QMessageBox::warning(this, tr("warning"), tr("Failed to save the decoded audio file"));
-    }
+    FFmpegHelper::AudioInfo info;
+    info.sample_fmt = sample_fmt_combo_->currentData().toInt();
+
+    std::string infile = infile_edit_->text().toStdString();
+    std::string outfile = outfile_edit_->text().toStdString();
+    executor_->Submit(tr("Decode %1").arg(outfile_edit_->text()),
+                      [info, infile, outfile](JobContext* job) {
+                          return FFmpegHelper::SaveDecodeAudio(info, infile.c_str(),
+                                                               outfile.c_str(), job);
+                      });
 }
 
 void CodecAudioDialog::OkClicked()
@@ -115,6 +164,9 @@ void CodecAudioDialog::OkClicked()
         Encode();
         break;
     default:
-        break;
+        return;
     }
+
+    // Results are reported by the status bar once the job finishes.
+    accept();
 }
@@ -10,11 +10,16 @@
 #include "dialog/base/custom_dialog.h"
 #include "widget/common/widgets.h"
 
+class JobExecutor;
+
 class CodecAudioDialog : public ConfirmDialog
 {
     Q_OBJECT
 public:
-    explicit CodecAudioDialog(QWidget* parent = nullptr);
+    /**
+     * @param executor Runs the jobs submitted by the dialog, it must outlive them.
+     */
+    explicit CodecAudioDialog(JobExecutor* executor, QWidget* parent = nullptr);
     ~CodecAudioDialog();
 
 private:
@@ -31,6 +36,8 @@ private slots:
     void OkClicked() override;
 
 private:
+    JobExecutor* executor_;
+
     FolderLineEdit* infile_edit_;
     FolderLineEdit* outfile_edit_;
 
@@ -40,6 +47,8 @@ private:
     QLineEdit* bit_rate_edit_;
     QComboBox* channel_combo_;
     QComboBox* codec_combo_;
+
+    QComboBox* sample_fmt_combo_;
 };
 
 #endif
@@ -1,19 +1,21 @@
 #include "codec_video_dialog.h"
 
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QLabel>
 #include <QList>
-#include <QMessagebox>
 #include <QPair>
 #include <QPushButton>
 #include <QRadioButton>
 #include <QVBoxLayout>
 
 #include "codec/ffmpeghelper.h"
+#include "job/job_executor.h"
 #include "widget/common/uihelper.h"
 
-CodecVideoDialog::CodecVideoDialog(QWidget* parent)
+CodecVideoDialog::CodecVideoDialog(JobExecutor* executor, QWidget* parent)
     : ConfirmDialog(parent)
+    , executor_(executor)
 {
     setWindowTitle(tr("Codec Video"));
 
@@ -70,13 +72,13 @@ CodecVideoDialog::CodecVideoDialog(QWidget* parent)
     // transcode
     auto crop_title = new QLabel(tr("Crop"), this);
     start_time_edit_ = new QTimeEdit(this);
-    start_time_edit_->setDisplayFormat("hh:mm:ss");
+    start_time_edit_->setDisplayFormat("hh:mm:ss.zzz");
     start_time_edit_->setMinimumTime(QTime(0, 0, 0));
     start_time_edit_->setMaximumTime(QTime(23, 59, 59));
     start_time_edit_->setTime(QTime(0, 0, 0));
 
     end_time_edit_ = new QTimeEdit(this);
-    end_time_edit_->setDisplayFormat("hh:mm:ss");
+    end_time_edit_->setDisplayFormat("hh:mm:ss.zzz");
     end_time_edit_->setMinimumTime(QTime(0, 0, 0));
     end_time_edit_->setMaximumTime(QTime(23, 59, 59));
     end_time_edit_->setTime(QTime(0, 0, 0));
@@ -86,14 +88,44 @@ CodecVideoDialog::CodecVideoDialog(QWidget* parent)
     widget_pair_list.append(qMakePair(new QLabel(tr("End Time:")), end_time_edit_));
     auto crop_grid_layout = uihelper::InitDialogGridLayout(widget_pair_list);
 
+    auto segments_title = new QLabel(tr("Parallel Segments"), this);
+    segments_check_ = new QCheckBox(tr("Re-encode in keyframe segments on all cores"), this);
+    segments_check_->setToolTip(tr("The codec and its parameters are taken from Encode."));
+    segments_edit_ = new QLineEdit(this);
+    segments_edit_->setPlaceholderText(tr("One per core"));
+    segments_edit_->setEnabled(false);
+
+    connect(segments_check_, &QCheckBox::toggled, this, [this](bool checked) {
+        // Segments cover the whole input, there is no crop.
+        segments_edit_->setEnabled(checked);
+        start_time_edit_->setEnabled(!checked);
+        end_time_edit_->setEnabled(!checked);
+    });
+
+    widget_pair_list.clear();
+    widget_pair_list.append(qMakePair(new QLabel(tr("Segments:")), segments_edit_));
+    auto segments_grid_layout = uihelper::InitDialogGridLayout(widget_pair_list);
+
+    // ladder
+    auto ladder_title = new QLabel(tr("Renditions"), this);
+    ladder_edit_ = new QLineEdit(this);
+    ladder_edit_->setText("1080,720,480,240");
+    ladder_edit_->setToolTip(tr("Heights of the renditions, the codec is taken from Encode."));
+
+    widget_pair_list.clear();
+    widget_pair_list.append(qMakePair(new QLabel(tr("Heights:")), ladder_edit_));
+    auto ladder_grid_layout = uihelper::InitDialogGridLayout(widget_pair_list);
+
     codec_tabwidget_ = new QTabWidget(this);
     auto decode_widget = new QWidget(codec_tabwidget_);
     auto encode_widget = new QWidget(codec_tabwidget_);
     auto transcode_widget = new QWidget(codec_tabwidget_);
+    auto ladder_widget = new QWidget(codec_tabwidget_);
 
     codec_tabwidget_->insertTab(kDecode, decode_widget, tr("Decode"));
     codec_tabwidget_->insertTab(kEncode, encode_widget, tr("Encode"));
     codec_tabwidget_->insertTab(kTranscode, transcode_widget, tr("Transcode"));
+    codec_tabwidget_->insertTab(kLadder, ladder_widget, tr("Ladder"));
 
     auto decode_layout = new QVBoxLayout(decode_widget);
     decode_layout->addWidget(decode_normal_title);
@@ -112,8 +144,23 @@ CodecVideoDialog::CodecVideoDialog(QWidget* parent)
     auto transcode_layout = new QVBoxLayout(transcode_widget);
     transcode_layout->addWidget(crop_title);
     transcode_layout->addLayout(crop_grid_layout);
+    transcode_layout->addWidget(segments_title);
+    transcode_layout->addWidget(segments_check_);
+    transcode_layout->addLayout(segments_grid_layout);
     transcode_layout->addStretch();
 
+    auto ladder_layout = new QVBoxLayout(ladder_widget);
+    ladder_layout->addWidget(ladder_title);
+    ladder_layout->addLayout(ladder_grid_layout);
+    ladder_layout->addStretch();
+
+    connect(infile_edit_, &QLineEdit::textChanged, this, [this](const QString& text) {
+        bool y4m = text.endsWith(".y4m", Qt::CaseInsensitive);
+        encode_w_edit_->setEnabled(!y4m);
+        encode_h_edit_->setEnabled(!y4m);
+        framerate_edit_->setEnabled(!y4m);
+    });
+
     auto main_layout = new QVBoxLayout(main_widget_);
     main_layout->addWidget(infile_edit_);
     main_layout->addWidget(outfile_edit_);
@@ -127,36 +174,107 @@ void CodecVideoDialog::Encode()
     FFmpegHelper::VideoInfo info;
     info.codec_name = codec_combo_->currentData().toString().toStdString();
     // info.codec_name = encoder_speed_combo_->currentText().toStdString();
-    info.video_size = QString(encode_w_edit_->text() + "x" + encode_h_edit_->text()).toStdString();
+    // A Y4M infile brings its own size and frame rate.
+    if (encode_w_edit_->isEnabled()) {
+        info.video_size =
+            QString(encode_w_edit_->text() + "x" + encode_h_edit_->text()).toStdString();
+    }
     info.framerate = framerate_edit_->text().toInt();
     info.bit_rate = bitrate_edit_->text().toInt();
     info.gop_size = gop_size_edit_->text().toInt();
     info.max_b_frames = max_b_frames_edit_->text().toInt();
 
-    bool ret = FFmpegHelper::SaveEncodeVideo(info, infile_edit_->text().toStdString().c_str(),
-                                             outfile_edit_->text().toStdString().c_str());
+    std::string infile = infile_edit_->text().toStdString();
+    std::string outfile = outfile_edit_->text().toStdString();
+    executor_->Submit(tr("Encode %1").arg(outfile_edit_->text()),
+                      [info, infile, outfile](JobContext* job) {
+                          return FFmpegHelper::SaveEncodeVideo(info, infile.c_str(),
+                                                               outfile.c_str(), job);
+                      });
+}
 
-    if (ret) {
-        QMessageBox::information(this, tr("Info"), tr("Successfully save the encoded video file"));
-    } else {
-        QMessageBox::warning(this, tr("Info"), tr("Failed to save the encoded video file"));
+void CodecVideoDialog::Transcode()
+{
+    if (segments_check_->isChecked()) {
+        TranscodeSegments();
+        return;
     }
+
+    FFmpegHelper::VideoInfo info;
+    info.start_time = start_time_edit_->time().msecsSinceStartOfDay();
+    info.end_time = end_time_edit_->time().msecsSinceStartOfDay();
+
+    std::string infile = infile_edit_->text().toStdString();
+    std::string outfile = outfile_edit_->text().toStdString();
+    executor_->Submit(tr("Transcode %1").arg(outfile_edit_->text()),
+                      [info, infile, outfile](JobContext* job) {
+                          return FFmpegHelper::SaveTranscodeFormat(info, infile.c_str(),
+                                                                   outfile.c_str(), job);
+                      });
 }
 
-void CodecVideoDialog::Transcode()
+void CodecVideoDialog::TranscodeSegments()
 {
     FFmpegHelper::VideoInfo info;
-    info.start_time = start_time_edit_->time().msecsSinceStartOfDay() / 1000;
-    info.end_time = end_time_edit_->time().msecsSinceStartOfDay() / 1000;
+    info.codec_name = codec_combo_->currentData().toString().toStdString();
+    if (!encode_w_edit_->text().isEmpty() && !encode_h_edit_->text().isEmpty()) {
+        info.video_size =
+            QString(encode_w_edit_->text() + "x" + encode_h_edit_->text()).toStdString();
+    }
+    info.framerate = framerate_edit_->text().toInt();
+    info.bit_rate = bitrate_edit_->text().toInt();
+    info.gop_size = gop_size_edit_->text().toInt();
+    info.max_b_frames = max_b_frames_edit_->text().toInt();
 
-    bool ret = FFmpegHelper::SaveTranscodeFormat(info, infile_edit_->text().toStdString().c_str(),
-                                                 outfile_edit_->text().toStdString().c_str());
+    int segments = qMax(0, segments_edit_->text().toInt());
 
-    if (ret) {
-        QMessageBox::information(this, tr("Info"), tr("Successfully save the transcode file"));
-    } else {
-        QMessageBox::warning(this, tr("Info"), tr("Failed to save the transcode file"));
+    std::string infile = infile_edit_->text().toStdString();
+    std::string outfile = outfile_edit_->text().toStdString();
+    executor_->Submit(tr("Transcode %1 in segments").arg(outfile_edit_->text()),
+                      [info, infile, outfile, segments](JobContext* job) {
+                          return FFmpegHelper::SaveSegmentedVideo(info, infile.c_str(),
+                                                                  outfile.c_str(), segments, job);
+                      });
+}
+
+void CodecVideoDialog::Ladder()
+{
+    FFmpegHelper::VideoInfo info;
+    info.codec_name = codec_combo_->currentData().toString().toStdString();
+    info.gop_size = gop_size_edit_->text().toInt();
+    info.max_b_frames = max_b_frames_edit_->text().toInt();
+
+    // outfile.mp4 becomes outfile_720p.mp4 and so on, the bit rates follow the common ladders.
+    QFileInfo outfile_info(outfile_edit_->text());
+    QString base = outfile_info.path() + "/" + outfile_info.completeBaseName();
+    QString suffix = outfile_info.suffix().isEmpty() ? "mp4" : outfile_info.suffix();
+
+    std::vector<FFmpegHelper::Rendition> renditions;
+    for (const QString& text : ladder_edit_->text().split(',')) {
+        // Empty entries parse as 0 as well.
+        int height = text.trimmed().toInt();
+        if (height <= 0)
+            continue;
+
+        FFmpegHelper::Rendition rendition;
+        rendition.outfile = QString("%1_%2p.%3").arg(base).arg(height).arg(suffix).toStdString();
+        rendition.width = 0;
+        rendition.height = height;
+        rendition.bit_rate = height >= 1080 ? 5000000
+                             : height >= 720 ? 2800000
+                             : height >= 480 ? 1400000
+                                             : 400000;
+        renditions.push_back(rendition);
     }
+    if (renditions.empty())
+        return;
+
+    std::string infile = infile_edit_->text().toStdString();
+    executor_->Submit(tr("Ladder %1").arg(outfile_edit_->text()),
+                      [info, infile, renditions](JobContext* job) {
+                          return FFmpegHelper::SaveRenditions(info, infile.c_str(), renditions,
+                                                              job);
+                      });
 }
 
 void CodecVideoDialog::Decode()
@@ -165,14 +283,13 @@ void CodecVideoDialog::Decode()
     info.video_size = QString(decode_w_edit_->text() + "x" + decode_h_edit_->text()).toStdString();
     info.pix_fmt = decode_pix_fmt_combo_->currentData().toString().toInt();
 
-    bool ret = FFmpegHelper::SaveDecodeVideo(info, infile_edit_->text().toStdString().c_str(),
-                                             outfile_edit_->text().toStdString().c_str());
-
-    if (ret) {
-        QMessageBox::information(this, tr("Info"), tr("Successfully save the decoded video file"));
-    } else {
-        QMessageBox::warning(this, tr("Info"), tr("Failed to save the decoded video file"));
-    }
+    std::string infile = infile_edit_->text().toStdString();
+    std::string outfile = outfile_edit_->text().toStdString();
+    executor_->Submit(tr("Decode %1").arg(outfile_edit_->text()),
+                      [info, infile, outfile](JobContext* job) {
+                          return FFmpegHelper::SaveDecodeVideo(info, infile.c_str(),
+                                                               outfile.c_str(), job);
+                      });
 }
 
 
@@ -190,7 +307,13 @@ void CodecVideoDialog::OkClicked()
     case CodecVideoDialog::kTranscode:
         Transcode();
         break;
-    default:
+    case CodecVideoDialog::kLadder:
+        Ladder();
         break;
+    default:
+        return;
     }
+
+    // Results are reported by the status bar once the job finishes.
+    accept();
 }
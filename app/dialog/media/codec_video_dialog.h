@@ -1,6 +1,7 @@
 #ifndef DECODE_VIDEO_DIGLOG_H_
 #define DECODE_VIDEO_DIGLOG_H_
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QDialog>
 #include <QGridLayout>
@@ -12,12 +13,17 @@
 #include "dialog/base/custom_dialog.h"
 #include "widget/common/widgets.h"
 
+class JobExecutor;
+
 class CodecVideoDialog : public ConfirmDialog
 {
     Q_OBJECT
 
 public:
-    explicit CodecVideoDialog(QWidget* parent = nullptr);
+    /**
+     * @param executor Runs the jobs submitted by the dialog, it must outlive them.
+     */
+    explicit CodecVideoDialog(JobExecutor* executor, QWidget* parent = nullptr);
     ~CodecVideoDialog();
 
 private:
@@ -25,18 +31,22 @@ private:
     {
         kDecode,
         kEncode,
-        kTranscode
+        kTranscode,
+        kLadder
     };
 
     void Transcode();
+    void TranscodeSegments();
     void Decode();
     void Encode();
-
+    void Ladder();
 
 private slots:
     void OkClicked() override;
 
 private:
+    JobExecutor* executor_;
+
     FolderLineEdit* infile_edit_;
     FolderLineEdit* outfile_edit_;
 
@@ -58,6 +68,11 @@ private:
 
     QTimeEdit* start_time_edit_;
     QTimeEdit* end_time_edit_;
+
+    QCheckBox* segments_check_;
+    QLineEdit* segments_edit_;
+
+    QLineEdit* ladder_edit_;
 };
 
 #endif
@@ -4,18 +4,22 @@
 #include <QMessageBox>
 
 #include "codec/ffmpeghelper.h"
+#include "job/job_executor.h"
 
-ExportStreamDialog::ExportStreamDialog(QWidget* parent)
+ExportStreamDialog::ExportStreamDialog(JobExecutor* executor, QWidget* parent)
     : ConfirmDialog(parent)
+    , executor_(executor)
 {
     setWindowTitle(tr("Export Stream"));
 
     file_edit_ = new FolderLineEdit(this);
 
+    // Checked streams are exported together in a single pass.
     btn_group_ = new QButtonGroup(this);
-    auto video_btn = new QRadioButton(tr("video"), this);
-    auto audio_btn = new QRadioButton(tr("audio"), this);
-    auto subtitle_btn = new QRadioButton(tr("subtitile"), this);
+    btn_group_->setExclusive(false);
+    auto video_btn = new QCheckBox(tr("video"), this);
+    auto audio_btn = new QCheckBox(tr("audio"), this);
+    auto subtitle_btn = new QCheckBox(tr("subtitile"), this);
     btn_group_->addButton(video_btn, 0);
     btn_group_->addButton(audio_btn, 1);
     btn_group_->addButton(subtitle_btn, 3);
@@ -51,21 +55,35 @@ void ExportStreamDialog::OkClicked()
         return;
     }
 
-    QFileDialog dlg;
-    if (dlg.exec() != QDialog::Accepted)
-        return;
+    std::vector<FFmpegHelper::ExportTarget> targets;
+    for (auto btn : btn_group_->buttons()) {
+        if (!btn->isChecked())
+            continue;
 
-    auto files = dlg.selectedFiles();
-    int media_type = btn_group_->id(btn_group_->checkedButton());
+        QFileDialog dlg;
+        dlg.setWindowTitle(tr("Export %1 stream").arg(btn->text()));
+        if (dlg.exec() != QDialog::Accepted)
+            return;
 
-    bool ret = FFmpegHelper::ExportSingleStream(media_type, file_edit_->text().toStdString().c_str(),
-                                                files.at(0).toStdString().c_str());
+        FFmpegHelper::ExportTarget target;
+        target.media_type = btn_group_->id(btn);
+        target.outfile = dlg.selectedFiles().at(0).toStdString();
+        targets.push_back(target);
+    }
 
-    if (ret) {
-        QMessageBox::information(this, tr("Info"), tr("Successfully to export the stream"));
-    } else {
-        QMessageBox::warning(this, tr("Warning"), tr("Failed to export the stream"));
+    if (targets.empty()) {
+        QMessageBox::warning(this, tr("Warning"), tr("Please select the streams to export!"));
+        return;
     }
+
+    std::string infile = file_edit_->text().toStdString();
+    executor_->Submit(tr("Export %1").arg(file_edit_->text()),
+                      [infile, targets](JobContext* job) {
+                          return FFmpegHelper::ExportStreams(infile.c_str(), targets, job);
+                      });
+
+    // Results are reported by the status bar once the job finishes.
+    accept();
 }
 
 void ExportStreamDialog::CancelClicked()
@@ -2,19 +2,24 @@
 #define EXPORT_STREAM_DIALOG_H_
 
 #include <QButtonGroup>
+#include <QCheckBox>
 #include <QLineEdit>
 #include <QPushButton>
-#include <QRadioButton>
 
 #include "dialog/base/custom_dialog.h"
 #include "widget/common/widgets.h"
 
+class JobExecutor;
+
 class ExportStreamDialog : public ConfirmDialog
 {
     Q_OBJECT
 
 public:
-    explicit ExportStreamDialog(QWidget* parent = nullptr);
+    /**
+     * @param executor Runs the jobs submitted by the dialog, it must outlive them.
+     */
+    explicit ExportStreamDialog(JobExecutor* executor, QWidget* parent = nullptr);
 
 private slots:
     void SelectFileClicked();
@@ -23,6 +28,8 @@ private slots:
     void CancelClicked() override;
 
 private:
+    JobExecutor* executor_;
+
     FolderLineEdit* file_edit_;
     QButtonGroup* btn_group_;
 };
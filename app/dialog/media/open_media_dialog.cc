@@ -31,6 +31,12 @@ OpenMediaDialog::OpenMediaDialog(QWidget* parent)
 #endif
     }
 
+    raw_file_edit_ = new FolderLineEdit(this);
+
+    raw_size_edit_ = new QLineEdit(this);
+    raw_size_edit_->setFixedWidth(360);
+    raw_size_edit_->setPlaceholderText(tr("Frame size of headerless I420, like 1920x1080"));
+
     // file
     auto file_widget = new QWidget(this);
     auto file_widget_layout = new QVBoxLayout(file_widget);
@@ -49,9 +55,17 @@ OpenMediaDialog::OpenMediaDialog(QWidget* parent)
     capture_widget_layout->addWidget(capture_dev_combo_);
     capture_widget_layout->setAlignment(Qt::AlignCenter);
 
+    // raw
+    auto raw_widget = new QWidget(this);
+    auto raw_widget_layout = new QVBoxLayout(raw_widget);
+    raw_widget_layout->addWidget(raw_file_edit_);
+    raw_widget_layout->addWidget(raw_size_edit_);
+    raw_widget_layout->setAlignment(Qt::AlignCenter);
+
     tabwidget_->insertTab(kFile, file_widget, tr("File Source"));
     tabwidget_->insertTab(kNetwork, network_widget, tr("Network Source"));
     tabwidget_->insertTab(kCapture, capture_widget, tr("Capture Source"));
+    tabwidget_->insertTab(kRawFile, raw_widget, tr("Raw Video Source"));
 
     auto main_layout = new QVBoxLayout(main_widget_);
     main_layout->addWidget(tabwidget_);
@@ -70,8 +84,11 @@ MediaInfo OpenMediaDialog::media()
         media.src = file_edit_->text().toStdString();
     } else if (index == kNetwork) {
         media.src = url_edit_->text().toStdString();
-    } else {
+    } else if (index == kCapture) {
         media.src = capture_dev_combo_->currentText().toStdString();
+    } else {
+        media.src = raw_file_edit_->text().toStdString();
+        media.video_size = raw_size_edit_->text().trimmed().toStdString();
     }
 
     return media;
@@ -26,6 +26,8 @@ private:
     FolderLineEdit* file_edit_;
     QLineEdit* url_edit_;
     QComboBox* capture_dev_combo_;
+    FolderLineEdit* raw_file_edit_;
+    QLineEdit* raw_size_edit_;
 };
 
 #endif
@@ -0,0 +1,105 @@
+#include "job_context.h"
+
+#include <algorithm>
+#include <chrono>
+
+extern "C"
+{
+#include "libavutil/mathematics.h"
+}
+
+static int64_t NowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+JobContext::JobContext()
+    : cancelled_(false)
+    , duration_us_(0)
+    , start_pts_us_(AV_NOPTS_VALUE)
+    , progress_(0.0)
+    , frames_(0)
+    , bytes_(0)
+    , start_time_(0)
+    , finish_time_(0)
+{}
+
+AVIOInterruptCB JobContext::interrupt_cb()
+{
+    AVIOInterruptCB cb;
+    cb.callback = &JobContext::Interrupt;
+    cb.opaque = this;
+    return cb;
+}
+
+void JobContext::Start()
+{
+    start_time_ = NowUs();
+    finish_time_ = 0;
+}
+
+void JobContext::Finish()
+{
+    finish_time_ = NowUs();
+    if (!cancelled_) {
+        progress_ = 1.0;
+    }
+}
+
+void JobContext::UpdatePacket(const AVPacket* pkt, const AVStream* stream)
+{
+    bytes_ += pkt->size;
+    if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        ++frames_;
+    }
+
+    int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (pts == AV_NOPTS_VALUE || duration_us_ <= 0)
+        return;
+
+    int64_t pts_us = av_rescale_q(pts, stream->time_base, AV_TIME_BASE_Q);
+    if (start_pts_us_ == AV_NOPTS_VALUE) {
+        start_pts_us_ = pts_us;
+    }
+
+    // Streams are interleaved, never let progress go backwards.
+    double progress = static_cast<double>(pts_us - start_pts_us_) / duration_us_;
+    progress = std::min(1.0, std::max<double>(progress, progress_));
+    progress_ = progress;
+}
+
+void JobContext::UpdatePosition(int64_t pos, int64_t size)
+{
+    if (size <= 0)
+        return;
+
+    progress_ = std::min(1.0, static_cast<double>(pos) / size);
+}
+
+double JobContext::elapsed() const
+{
+    if (start_time_ == 0)
+        return 0.0;
+
+    int64_t end = finish_time_ ? static_cast<int64_t>(finish_time_) : NowUs();
+    return (end - start_time_) / 1000000.0;
+}
+
+double JobContext::fps() const
+{
+    double seconds = elapsed();
+    return seconds > 0.0 ? frames_ / seconds : 0.0;
+}
+
+double JobContext::mbps() const
+{
+    double seconds = elapsed();
+    return seconds > 0.0 ? bytes_ / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+int JobContext::Interrupt(void* opaque)
+{
+    return static_cast<JobContext*>(opaque)->cancelled_ ? 1 : 0;
+}
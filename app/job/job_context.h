@@ -0,0 +1,78 @@
+#ifndef JOB_CONTEXT_H_
+#define JOB_CONTEXT_H_
+
+#include <atomic>
+#include <stdint.h>
+
+extern "C"
+{
+#include "libavformat/avformat.h"
+}
+
+/**
+ * @brief Progress, throughput and cancellation of one background job.
+ *
+ * Updated by the worker that runs the job and read from any thread. Cancel() also aborts blocking
+ * FFmpeg I/O of the job through the AVIO interrupt callback.
+ */
+class JobContext
+{
+public:
+    JobContext();
+
+    void Cancel() { cancelled_ = true; }
+    bool cancelled() const { return cancelled_; }
+
+    /**
+     * @brief Interrupt callback to install on every format context and avio of the job.
+     */
+    AVIOInterruptCB interrupt_cb();
+
+    void Start();
+    void Finish();
+
+    /**
+     * @brief Length of the input that will be processed, progress is measured against it.
+     */
+    void set_duration(int64_t duration_us) { duration_us_ = duration_us; }
+
+    /**
+     * @brief Account a demuxed packet, progress follows its pts from the first packet on.
+     */
+    void UpdatePacket(const AVPacket* pkt, const AVStream* stream);
+
+    /**
+     * @brief Progress of raw inputs by their read position.
+     */
+    void UpdatePosition(int64_t pos, int64_t size);
+
+    void AddFrames(int64_t count) { frames_ += count; }
+    void AddBytes(int64_t bytes) { bytes_ += bytes; }
+
+    double progress() const { return progress_; } // 0 - 1
+    int64_t frames() const { return frames_; }
+    int64_t bytes() const { return bytes_; }
+
+    double elapsed() const; // s
+    double fps() const;
+    double mbps() const; // MB of input per second
+
+private:
+    static int Interrupt(void* opaque);
+
+private:
+    std::atomic<bool> cancelled_;
+
+    std::atomic<int64_t> duration_us_;
+    int64_t start_pts_us_;
+    std::atomic<double> progress_;
+
+    std::atomic<int64_t> frames_;
+    std::atomic<int64_t> bytes_;
+
+    // Steady clock, us
+    std::atomic<int64_t> start_time_;
+    std::atomic<int64_t> finish_time_;
+};
+
+#endif
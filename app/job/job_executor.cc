@@ -0,0 +1,195 @@
+#include "job_executor.h"
+
+#include <QThread>
+
+#include "spdlog/spdlog.h"
+#include "util/cthread.h"
+
+#define PROGRESS_REPORT_INTERVAL 500 // ms
+
+class JobWorker : public CThread
+{
+public:
+    explicit JobWorker(JobExecutor* executor)
+        : CThread(nullptr)
+        , executor_(executor)
+    {}
+
+protected:
+    bool DoPrepare() override { return true; }
+
+    void DoTask() override
+    {
+        while (executor_->RunNext()) {
+        }
+    }
+
+    void DoFinish() override {}
+
+private:
+    JobExecutor* executor_;
+};
+
+JobExecutor::JobExecutor(int workers, QObject* parent)
+    : QObject(parent)
+    , stopping_(false)
+    , next_id_(0)
+{
+    if (workers <= 0) {
+        workers = qMax(1, QThread::idealThreadCount());
+    }
+
+    for (int i = 0; i < workers; ++i) {
+        workers_.emplace_back(new JobWorker(this));
+        workers_.back()->start();
+    }
+
+    progress_timer_ = new QTimer(this);
+    connect(progress_timer_, &QTimer::timeout, this, &JobExecutor::ReportProgress);
+    progress_timer_->start(PROGRESS_REPORT_INTERVAL);
+
+    SPDLOG_INFO("Job executor workers: {0}.", workers);
+}
+
+JobExecutor::~JobExecutor()
+{
+    std::deque<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        dropped.swap(queue_);
+        for (auto& job : running_) {
+            job.second.ctx->Cancel();
+        }
+    }
+    cv_.notify_all();
+
+    for (const auto& job : dropped) {
+        emit JobFinished(job.id, job.name, false, true, 0.0, 0.0, 0.0);
+    }
+
+    for (auto& worker : workers_) {
+        worker->wait();
+    }
+}
+
+int JobExecutor::Submit(const QString& name, const JobFunc& func)
+{
+    int id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = ++next_id_;
+    }
+
+    // Before a worker can take it, so no other signal of the job precedes this one.
+    emit JobQueued(id, name);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Job job;
+        job.id = id;
+        job.name = name;
+        job.func = func;
+        job.ctx = std::make_shared<JobContext>();
+        queue_.push_back(job);
+    }
+    cv_.notify_one();
+
+    SPDLOG_INFO("Job {0} queued: {1}.", id, name.toStdString());
+    return id;
+}
+
+void JobExecutor::Cancel(int id)
+{
+    bool dropped = false;
+    QString name;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto running = running_.find(id);
+        if (running != running_.end()) {
+            running->second.ctx->Cancel();
+            return;
+        }
+
+        for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+            if (it->id == id) {
+                name = it->name;
+                queue_.erase(it);
+                dropped = true;
+                break;
+            }
+        }
+    }
+
+    if (dropped) {
+        emit JobFinished(id, name, false, true, 0.0, 0.0, 0.0);
+    }
+}
+
+void JobExecutor::CancelAll()
+{
+    std::deque<Job> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dropped.swap(queue_);
+        for (auto& job : running_) {
+            job.second.ctx->Cancel();
+        }
+    }
+
+    for (const auto& job : dropped) {
+        emit JobFinished(job.id, job.name, false, true, 0.0, 0.0, 0.0);
+    }
+}
+
+bool JobExecutor::RunNext()
+{
+    Job job;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (stopping_)
+            return false;
+
+        job = queue_.front();
+        queue_.pop_front();
+        running_[job.id] = job;
+    }
+
+    emit JobStarted(job.id, job.name);
+
+    JobContext* ctx = job.ctx.get();
+    ctx->Start();
+    bool ok = job.func(ctx);
+    ctx->Finish();
+
+    bool cancelled = ctx->cancelled();
+    SPDLOG_INFO("Job {0} {1}: {2}, {3:.1f}s, {4:.1f} fps, {5:.2f} MB/s.", job.id,
+                cancelled ? "cancelled" : (ok ? "finished" : "failed"), job.name.toStdString(),
+                ctx->elapsed(), ctx->fps(), ctx->mbps());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_.erase(job.id);
+    }
+
+    emit JobFinished(job.id, job.name, ok && !cancelled, cancelled, ctx->elapsed(), ctx->fps(),
+                     ctx->mbps());
+
+    return true;
+}
+
+void JobExecutor::ReportProgress()
+{
+    std::vector<Job> running;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& job : running_) {
+            running.push_back(job.second);
+        }
+    }
+
+    for (const auto& job : running) {
+        emit JobProgress(job.id, job.name, job.ctx->progress(), job.ctx->fps(), job.ctx->mbps());
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef JOB_EXECUTOR_H_
+#define JOB_EXECUTOR_H_
+
+#include <QObject>
+#include <QTimer>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "job_context.h"
+
+class JobWorker;
+
+/**
+ * @brief Runs transcode and export jobs on a bounded pool of worker threads.
+ *
+ * Jobs are queued and picked up in order by one worker per core. Progress of running jobs is
+ * published periodically on the thread of the executor. JobQueued is emitted by Submit, on its
+ * caller's thread. The other signals are emitted from the workers, so receivers should use queued
+ * connections. Queued jobs that are dropped, on cancel or on destruction, finish as cancelled.
+ */
+class JobExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    // Returns false on failure, the context is used for progress and cancellation.
+    using JobFunc = std::function<bool(JobContext*)>;
+
+    /**
+     * @param workers Size of the pool, 0 for one worker per core.
+     */
+    explicit JobExecutor(int workers = 0, QObject* parent = nullptr);
+    ~JobExecutor();
+
+    /**
+     * @return Id of the job.
+     */
+    int Submit(const QString& name, const JobFunc& func);
+
+    /**
+     * @brief Drop a queued job, or interrupt a running one.
+     */
+    void Cancel(int id);
+    void CancelAll();
+
+    int worker_count() const { return static_cast<int>(workers_.size()); }
+
+signals:
+    void JobQueued(int id, const QString& name);
+    void JobStarted(int id, const QString& name);
+    void JobProgress(int id, const QString& name, double progress, double fps, double mbps);
+    void JobFinished(int id, const QString& name, bool ok, bool cancelled, double seconds,
+                     double fps, double mbps);
+
+private:
+    friend class JobWorker;
+
+    struct Job
+    {
+        int id;
+        QString name;
+        JobFunc func;
+        std::shared_ptr<JobContext> ctx;
+    };
+
+    /**
+     * @brief Take the next job and run it, called by the workers.
+     *
+     * @return False once the executor stops.
+     */
+    bool RunNext();
+    void ReportProgress();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> queue_;
+    std::map<int, Job> running_;
+    bool stopping_;
+    int next_id_;
+
+    std::vector<std::unique_ptr<JobWorker>> workers_;
+    QTimer* progress_timer_;
+};
+
+#endif
@@ -1,18 +1,125 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
 #include <QTextCodec>
 
+#include "common/singleton.h"
+#include "config/config.h"
+#include "render/render_factory.h"
 #include "spdlog/spdlog.h"
+#include "util/trace.h"
 #include "window/mainwindow/mainwindow.h"
 
 int main(int argc, char* argv[])
 {
+    // The video render thread shares textures with the widget contexts.
+    QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
     std::unique_ptr<QCoreApplication> a;
     a.reset(new QApplication(argc, argv));
 
     QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-8"));
 
+    QCommandLineParser parser;
+    parser.setApplicationDescription("A video player based on Qt and FFmpeg.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input", "Media file or url to play on start.", "[input]");
+
+    QCommandLineOption render_option(
+        QStringList() << "r" << "render",
+        "Render backend: opengl, sdl, gl-window, software, null or offscreen.", "type");
+    QCommandLineOption fps_option("fps", "Presentation rate, overrides the stream rate.", "fps");
+    QCommandLineOption rate_option("rate", "Playback rate, 0.25 to 32.", "rate");
+    QCommandLineOption dirty_tiles_option("dirty-tiles",
+                                          "Upload only the changed tiles of each frame.");
+    QCommandLineOption mirror_option(
+        "record-mirror", "Also stream recordings to the url, e.g. udp://127.0.0.1:1234.", "url");
+    QCommandLineOption gl_budget_option(
+        "gl-call-budget", "Fail an offscreen run whose frames issue more gl calls.", "calls");
+    QCommandLineOption quit_option("quit-at-end", "Quit when playback of the input ends.");
+    QCommandLineOption stats_option(
+        "stats", "Write playback stats as JSON lines to the file, or to unix:<socket path>.",
+        "output");
+    QCommandLineOption stats_overlay_option("stats-overlay", "Show playback stats over the video.");
+    QCommandLineOption trace_option(
+        "trace", "Trace the pipeline, written to the file on SIGUSR1 and at exit.", "file");
+    parser.addOption(render_option);
+    parser.addOption(fps_option);
+    parser.addOption(rate_option);
+    parser.addOption(dirty_tiles_option);
+    parser.addOption(mirror_option);
+    parser.addOption(gl_budget_option);
+    parser.addOption(quit_option);
+    parser.addOption(stats_option);
+    parser.addOption(stats_overlay_option);
+    parser.addOption(trace_option);
+    parser.process(*a);
+
+    // Command line values are not persisted to the config file.
+    if (parser.isSet(render_option)) {
+        RenderType type;
+        if (!RenderFactory::TypeFromName(parser.value(render_option), &type)) {
+            SPDLOG_ERROR("Unknown render type: {0}.", parser.value(render_option).toStdString());
+            return 1;
+        }
+        Singleton<Config>::Instance()->SetOverride("video_param", "render_type", type);
+    }
+    if (parser.isSet(fps_option)) {
+        Singleton<Config>::Instance()->SetOverride("video_param", "fps",
+                                                   parser.value(fps_option).toInt());
+    }
+    if (parser.isSet(rate_option)) {
+        Singleton<Config>::Instance()->SetOverride("video_param", "rate",
+                                                   parser.value(rate_option).toDouble());
+    }
+    if (parser.isSet(dirty_tiles_option)) {
+        Singleton<Config>::Instance()->SetOverride("video_param", "dirty_tile_upload", true);
+    }
+    if (parser.isSet(gl_budget_option)) {
+        Singleton<Config>::Instance()->SetOverride("video_param", "gl_call_budget",
+                                                   parser.value(gl_budget_option).toUInt());
+    }
+    if (parser.isSet(mirror_option)) {
+        Singleton<Config>::Instance()->SetOverride("record", "mirror_urls",
+                                                   parser.values(mirror_option).join(';'));
+    }
+
+    if (parser.isSet(stats_option)) {
+        Singleton<Config>::Instance()->SetOverride("stats", "output", parser.value(stats_option));
+    }
+    if (parser.isSet(stats_overlay_option)) {
+        Singleton<Config>::Instance()->SetOverride("stats", "overlay", true);
+    }
+
+    Trace::SetThreadName("gui");
+    if (parser.isSet(trace_option)) {
+        std::string trace_file = parser.value(trace_option).toStdString();
+        Trace::Enable(true);
+        Trace::ExportOnSignal(trace_file);
+        QObject::connect(a.get(), &QCoreApplication::aboutToQuit,
+                         [trace_file] { Trace::Export(trace_file); });
+    }
+
     MainWindow w;
     w.show();
 
+    if (!parser.positionalArguments().isEmpty()) {
+        QString input = parser.positionalArguments().first();
+
+        MediaInfo media;
+        media.type = QFileInfo::exists(input) ? kFile : kNetwork;
+        // Y4M captures are played from a mapping, without demuxer and decoder.
+        QString suffix = QFileInfo(input).suffix();
+        if (media.type == kFile && suffix.compare("y4m", Qt::CaseInsensitive) == 0) {
+            media.type = kRawFile;
+        }
+        media.src = input.toStdString();
+        w.Play(media);
+
+        if (parser.isSet(quit_option)) {
+            QObject::connect(&w, &MainWindow::PlaybackFinished, a.get(), &QCoreApplication::quit);
+        }
+    }
+
     return a->exec();
 }
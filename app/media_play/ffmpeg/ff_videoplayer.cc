@@ -1,10 +1,14 @@
 #include "ff_videoplayer.h"
 
 #include <QApplication>
+#include <chrono>
 
 #include "common/avdef.h"
+#include "common/singleton.h"
+#include "config/config.h"
 #include "media_play/stream_event_type.h"
 #include "spdlog/spdlog.h"
+#include "util/trace.h"
 
 FFVideoPlayer::FFVideoPlayer(QObject* parent)
     : VideoPlayer()
@@ -22,28 +26,18 @@ void FFVideoPlayer::Start()
     decoder_->set_media(media());
 
     start();
-}
 
-void FFVideoPlayer::Pause()
-{
-    set_state(kPause);
+    Post(kCmdOpen);
+    Post(kCmdPlay);
 }
 
 void FFVideoPlayer::Stop()
 {
-    set_state(kStop);
+    Post(kCmdStop);
 
-    quit();
     wait(); // Secure exit
 }
 
-void FFVideoPlayer::Resume()
-{
-    if (state() == kPause) {
-        set_state(kRunning);
-    }
-}
-
 void FFVideoPlayer::StartRecord(const char* file)
 {
     if (writer_)
@@ -54,6 +48,15 @@ void FFVideoPlayer::StartRecord(const char* file)
     auto media_info = media();
     media_info.src = file;
     writer_->set_media(media_info);
+
+    // Live consumers of the recording, e.g. udp://127.0.0.1:1234, separated by ';'.
+    QString mirrors =
+        Singleton<Config>::Instance()->AppConfigData("record", "mirror_urls").toString();
+    for (const QString& url : mirrors.split(';')) {
+        if (!url.trimmed().isEmpty()) {
+            writer_->AddSink(url.trimmed().toStdString());
+        }
+    }
 }
 
 void FFVideoPlayer::StopRecord()
@@ -65,6 +68,28 @@ void FFVideoPlayer::StopRecord()
 }
 
 bool FFVideoPlayer::DoPrepare()
+{
+    Trace::SetThreadName("player");
+
+    return true;
+}
+
+void FFVideoPlayer::DoTask()
+{
+    RunCommandLoop();
+}
+
+void FFVideoPlayer::DoFinish()
+{
+    decoder_->Close();
+
+    // A failed open was reported already.
+    if (opened()) {
+        event_cb(kStreamClose);
+    }
+}
+
+bool FFVideoPlayer::OpenStream()
 {
     bool ret = decoder_->Open();
     if (!ret) {
@@ -73,44 +98,64 @@ bool FFVideoPlayer::DoPrepare()
     }
 
     fps_ = decoder_->fps();
-    set_sleep_policy(kUntil, 1000 / fps_);
-    set_state(kRunning);
 
     event_cb(kOpenStreamSuccess);
 
     return true;
 }
 
-void FFVideoPlayer::DoTask()
+VideoPlayer::FrameResult FFVideoPlayer::NextFrame()
 {
-    while (state() != kStop) {
-        while (state() == kPause) {
-            std::this_thread::yield();
-        }
-
-        DecodeFrame* frame = decoder_->GetFrame();
-        if (frame) {
-            push_frame(frame);
+    TRACE_SCOPE("player.task");
+
+    auto decode_start = std::chrono::steady_clock::now();
+    DecodeFrame* frame = decoder_->GetFrame();
+    CountDecode(decoder_->input_bytes(),
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - decode_start)
+                    .count(),
+                frame != nullptr);
+    if (frame) {
+        push_frame(frame);
+    } else if (decoder_->end()) {
+        StopRecord();
+    }
 
-            CThread::Sleep();
-        } else {
-            if (decoder_->end()) {
-                set_state(kStop);
-                StopRecord();
+    DoRecordTask(frame);
 
-                event_cb(kStreamEnd);
-            }
+    if (frame && trick_play()) {
+        // On to the next keyframe past the skip, none may be left before the end.
+        if (!decoder_->Seek(static_cast<int64_t>(frame->ts) + TrickPlaySkip(), true)) {
+            DisableTrickPlay();
         }
-
-        DoRecordTask(frame);
     }
+
+    if (frame)
+        return kFramePushed;
+
+    return decoder_->end() ? kFrameEnd : kFrameAgain;
 }
 
-void FFVideoPlayer::DoFinish()
+void FFVideoPlayer::SetKeyframesOnly(bool enable)
 {
-    decoder_->Close();
+    decoder_->SetKeyframesOnly(enable);
+}
+
+bool FFVideoPlayer::SeekStream(int64_t position)
+{
+    if (!decoder_->Seek(position))
+        return false;
+
+    // The seek lands on the keyframe before, decode up to the position itself.
+    while (!decoder_->end()) {
+        DecodeFrame* frame = decoder_->GetFrame();
+        if (frame && static_cast<int64_t>(frame->ts) >= position) {
+            push_frame(frame);
+            break;
+        }
+    }
 
-    event_cb(kStreamClose);
+    return true;
 }
 
 void FFVideoPlayer::DoRecordTask(DecodeFrame* frame)
@@ -119,6 +164,8 @@ void FFVideoPlayer::DoRecordTask(DecodeFrame* frame)
         return;
     }
 
+    TRACE_SCOPE("record");
+
     if (frame) {
         if (!writer_->opened()) {
             bool opened = writer_->Open(*decoder_->encode_data_info());
@@ -19,9 +19,7 @@ public:
     ~FFVideoPlayer();
 
     void Start() override;
-    void Pause() override;
     void Stop() override;
-    void Resume() override;
 
     void StartRecord(const char* file) override;
     void StopRecord() override;
@@ -31,6 +29,11 @@ protected:
     void DoTask() override;
     void DoFinish() override;
 
+    bool OpenStream() override;
+    FrameResult NextFrame() override;
+    bool SeekStream(int64_t position) override;
+    void SetKeyframesOnly(bool enable) override;
+
 private:
     void DoRecordTask(DecodeFrame* frame);
 
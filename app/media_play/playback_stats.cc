@@ -0,0 +1,234 @@
+#include "playback_stats.h"
+
+#include <vector>
+
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "common/singleton.h"
+#include "config/config.h"
+#include "spdlog/spdlog.h"
+
+#define STATS_INTERVAL 1000 // ms
+#define STATS_SOCKET_PREFIX "unix:"
+
+QString PlaybackStats::ToText() const
+{
+    QString upload = upload_ms < 0.0 ? QString("-") : QString::number(upload_ms, 'f', 2);
+
+    return QString("#%1 %2 kbps, %3/%4 fps, %5 dropped/s, queue %6, decode %7 ms, upload %8 ms, "
+                   "A/V %9 ms")
+        .arg(player)
+        .arg(input_kbps, 0, 'f', 0)
+        .arg(decoded_fps, 0, 'f', 1)
+        .arg(presented_fps, 0, 'f', 1)
+        .arg(dropped_fps, 0, 'f', 1)
+        .arg(queue_depth)
+        .arg(decode_ms, 0, 'f', 2)
+        .arg(upload)
+        .arg(av_offset_ms, 0, 'f', 0);
+}
+
+QByteArray PlaybackStats::ToJson() const
+{
+    QJsonObject json;
+    json["time"] = time;
+    json["player"] = player;
+    json["src"] = src;
+    json["input_kbps"] = input_kbps;
+    json["decoded_fps"] = decoded_fps;
+    json["presented_fps"] = presented_fps;
+    json["dropped_fps"] = dropped_fps;
+    json["queue_depth"] = queue_depth;
+    json["decode_ms"] = decode_ms;
+    json["upload_ms"] = upload_ms < 0.0 ? QJsonValue() : QJsonValue(upload_ms);
+    json["av_offset_ms"] = av_offset_ms;
+
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+PlaybackStatsSampler::PlaybackStatsSampler(QObject* parent)
+    : QObject(parent)
+    , next_player_(1)
+    , timer_(new QTimer(this))
+    , socket_(-1)
+    , socket_warned_(false)
+{
+    qRegisterMetaType<PlaybackStats>("PlaybackStats");
+
+    int interval =
+        Singleton<Config>::Instance()->AppConfigData("stats", "interval", STATS_INTERVAL).toInt();
+    timer_->setInterval(qMax(100, interval));
+    connect(timer_, &QTimer::timeout, this, &PlaybackStatsSampler::Sample);
+
+    clock_.start();
+}
+
+PlaybackStatsSampler::~PlaybackStatsSampler()
+{
+    CloseOutput();
+}
+
+int PlaybackStatsSampler::Register(const QString& src, const Source& source)
+{
+    int id = next_player_++;
+
+    Player& player = players_[id];
+    player.src = src;
+    player.source = source;
+    player.last_time = clock_.elapsed();
+
+    if (!timer_->isActive()) {
+        OpenOutput();
+        timer_->start();
+    }
+
+    return id;
+}
+
+void PlaybackStatsSampler::Unregister(int player)
+{
+    players_.erase(player);
+
+    if (players_.empty()) {
+        timer_->stop();
+        CloseOutput();
+    }
+}
+
+void PlaybackStatsSampler::Sample()
+{
+    qint64 now = clock_.elapsed();
+    qint64 time = QDateTime::currentMSecsSinceEpoch();
+
+    // Emitted after the loop, a receiver may unregister a player.
+    std::vector<PlaybackStats> samples;
+    for (auto& it : players_) {
+        Player& player = it.second;
+        PlaybackTotals totals = player.source();
+        const PlaybackTotals& last = player.last;
+
+        double seconds = (now - player.last_time) / 1000.0;
+        if (seconds <= 0.0)
+            continue;
+
+        uint64_t decoded = totals.decoded - last.decoded;
+        uint64_t uploaded = totals.uploaded - last.uploaded;
+
+        PlaybackStats stats;
+        stats.player = it.first;
+        stats.src = player.src;
+        stats.time = time;
+        stats.input_kbps = (totals.input_bytes - last.input_bytes) * 8 / 1000.0 / seconds;
+        stats.decoded_fps = decoded / seconds;
+        stats.presented_fps = (totals.presented - last.presented) / seconds;
+        stats.dropped_fps = (totals.dropped - last.dropped) / seconds;
+        stats.queue_depth = totals.queue_depth;
+        if (decoded > 0) {
+            stats.decode_ms = (totals.decode_us - last.decode_us) / 1000.0 / decoded;
+        }
+        if (totals.has_upload) {
+            stats.upload_ms =
+                uploaded > 0 ? (totals.upload_us - last.upload_us) / 1000.0 / uploaded : 0.0;
+        }
+        stats.av_offset_ms = totals.av_offset_ms;
+
+        player.last = totals;
+        player.last_time = now;
+
+        WriteLine(stats.ToJson());
+        samples.push_back(stats);
+    }
+
+    for (const PlaybackStats& stats : samples) {
+        emit Sampled(stats);
+    }
+}
+
+bool PlaybackStatsSampler::OpenOutput()
+{
+    output_ = Singleton<Config>::Instance()->AppConfigData("stats", "output").toString();
+    if (output_.isEmpty())
+        return false;
+
+    if (output_.startsWith(STATS_SOCKET_PREFIX)) {
+#ifndef _WIN32
+        socket_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (socket_ < 0) {
+            SPDLOG_ERROR("Failed to create the stats socket: {0}.", strerror(errno));
+            return false;
+        }
+        // Never wait for a slow reader, the sample is dropped instead.
+        fcntl(socket_, F_SETFL, O_NONBLOCK);
+        socket_warned_ = false;
+        return true;
+#else
+        SPDLOG_ERROR("Unix sockets are not supported for the stats on this platform.");
+        return false;
+#endif
+    }
+
+    file_.setFileName(output_);
+    if (!file_.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        SPDLOG_ERROR("Failed to open stats output {0}.", output_.toStdString());
+        return false;
+    }
+
+    return true;
+}
+
+void PlaybackStatsSampler::CloseOutput()
+{
+#ifndef _WIN32
+    if (socket_ >= 0) {
+        close(socket_);
+        socket_ = -1;
+    }
+#endif
+
+    if (file_.isOpen()) {
+        file_.close();
+    }
+}
+
+void PlaybackStatsSampler::WriteLine(const QByteArray& line)
+{
+#ifndef _WIN32
+    if (socket_ >= 0) {
+        QByteArray path = output_.mid(strlen(STATS_SOCKET_PREFIX)).toLocal8Bit();
+
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= static_cast<int>(sizeof(addr.sun_path))) {
+            return;
+        }
+        memcpy(addr.sun_path, path.constData(), path.size());
+
+        QByteArray datagram = line + '\n';
+        ssize_t ret = sendto(socket_, datagram.constData(), datagram.size(), 0,
+                             reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        if (ret < 0 && !socket_warned_) {
+            // Usually no listener yet, keep sampling and warn once.
+            SPDLOG_WARN("Failed to send stats to {0}: {1}.", path.toStdString(), strerror(errno));
+            socket_warned_ = true;
+        }
+        return;
+    }
+#endif
+
+    if (file_.isOpen()) {
+        file_.write(line);
+        file_.write("\n");
+        file_.flush();
+    }
+}
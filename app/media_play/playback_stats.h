@@ -0,0 +1,111 @@
+#ifndef PLAYBACK_STATS_H_
+#define PLAYBACK_STATS_H_
+
+#include <functional>
+#include <map>
+#include <stdint.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMetaType>
+#include <QObject>
+#include <QTimer>
+
+/**
+ * @brief Counters of one player since it started, the sampler turns them into rates.
+ */
+struct PlaybackTotals
+{
+    uint64_t input_bytes = 0;
+    uint64_t decoded = 0;
+    int64_t decode_us = 0;
+    uint64_t presented = 0;
+    uint64_t dropped = 0; // Pushed out of the full frame queue, never presented
+    int queue_depth = 0;
+    bool has_upload = false; // The render window reports uploads
+    uint64_t uploaded = 0;
+    int64_t upload_us = 0;
+    double av_offset_ms = 0.0;
+};
+
+/**
+ * @brief One sample of a player, rates are over the interval since the previous sample.
+ */
+struct PlaybackStats
+{
+    int player = 0;
+    QString src;
+    qint64 time = 0; // ms since epoch
+    double input_kbps = 0.0;
+    double decoded_fps = 0.0;
+    double presented_fps = 0.0;
+    double dropped_fps = 0.0;
+    int queue_depth = 0;
+    double decode_ms = 0.0; // Per decoded frame
+    double upload_ms = -1.0; // Per uploaded frame, -1 if the render window does not report it
+    double av_offset_ms = 0.0;
+
+    QString ToText() const;
+    QByteArray ToJson() const;
+};
+
+Q_DECLARE_METATYPE(PlaybackStats)
+
+/**
+ * @brief Samples every registered player once per interval, for the status bar, the overlay and
+ * a JSON lines feed.
+ *
+ * The feed goes to the file of "stats/output", or to a Unix datagram socket if the value starts
+ * with "unix:", one datagram per line. Datagrams are dropped while nobody listens, so monitoring
+ * can scrape many players without slowing any of them down.
+ */
+class PlaybackStatsSampler : public QObject
+{
+    Q_OBJECT
+public:
+    using Source = std::function<PlaybackTotals()>;
+
+    explicit PlaybackStatsSampler(QObject* parent = nullptr);
+    ~PlaybackStatsSampler();
+
+    /**
+     * @brief Sample the source on the GUI thread until unregistered.
+     *
+     * @return Id of the player in the samples
+     */
+    int Register(const QString& src, const Source& source);
+    void Unregister(int player);
+
+signals:
+    void Sampled(const PlaybackStats& stats);
+
+private slots:
+    void Sample();
+
+private:
+    bool OpenOutput();
+    void CloseOutput();
+    void WriteLine(const QByteArray& line);
+
+private:
+    struct Player
+    {
+        QString src;
+        Source source;
+        PlaybackTotals last;
+        qint64 last_time; // ms of clock_
+    };
+
+    std::map<int, Player> players_;
+    int next_player_;
+
+    QTimer* timer_;
+    QElapsedTimer clock_;
+
+    QString output_;
+    QFile file_;
+    int socket_;
+    bool socket_warned_;
+};
+
+#endif
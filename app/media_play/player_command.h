@@ -0,0 +1,33 @@
+#ifndef PLAYER_COMMAND_H_
+#define PLAYER_COMMAND_H_
+
+#include <stdint.h>
+
+enum PlayerCommandType
+{
+    kCmdOpen,
+    kCmdPlay,
+    kCmdPause,
+    kCmdStop,
+    kCmdSeek,
+    kCmdStep,
+    kCmdSetRate
+};
+
+enum PlayerState
+{
+    kPlayerIdle,   // Not opened yet
+    kPlayerPaused, // Opened, no frames produced
+    kPlayerPlaying,
+    kPlayerStopped // Ended, failed or stopped, the thread exits
+};
+
+struct PlayerCommand
+{
+    uint64_t id = 0;
+    PlayerCommandType type = kCmdPlay;
+    int64_t position = 0; // ms of the frame timestamps, kCmdSeek
+    double rate = 1.0;    // kCmdSetRate
+};
+
+#endif
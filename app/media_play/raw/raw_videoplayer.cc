@@ -0,0 +1,196 @@
+#include "raw_videoplayer.h"
+
+#include <chrono>
+#include <cmath>
+
+extern "C"
+{
+#include "libavutil/mathematics.h"
+#include "libavutil/parseutils.h"
+}
+
+#include "common/avdef.h"
+#include "media_play/stream_event_type.h"
+#include "spdlog/spdlog.h"
+#include "util/trace.h"
+
+static int GetCommonFmt(int format)
+{
+    switch (format) {
+    case AV_PIX_FMT_YUV420P:
+        return PIX_FMT_IYUV;
+    case AV_PIX_FMT_YUV422P:
+        return PIX_FMT_YUVJ422P;
+    default:
+        return -1;
+    }
+}
+
+RawVideoPlayer::RawVideoPlayer(QObject* parent)
+    : VideoPlayer()
+    , CThread(parent)
+    , frame_(nullptr)
+    , input_bytes_(0)
+{
+    decode_frame_.w = 0;
+    decode_frame_.h = 0;
+    decode_frame_.ts = 0;
+    decode_frame_.format = PIX_FMT_IYUV;
+    decode_frame_.color_space = kColorSpaceBT601;
+    decode_frame_.color_range = kColorRangeLimited;
+    decode_frame_.pict_type_ = AV_PICTURE_TYPE_I;
+}
+
+RawVideoPlayer::~RawVideoPlayer()
+{
+    Stop();
+}
+
+void RawVideoPlayer::Start()
+{
+    start();
+
+    Post(kCmdOpen);
+    Post(kCmdPlay);
+}
+
+void RawVideoPlayer::Stop()
+{
+    Post(kCmdStop);
+
+    wait(); // Secure exit
+}
+
+void RawVideoPlayer::StartRecord(const char* file)
+{
+    (void)file;
+    SPDLOG_WARN("Recording raw video sources is not supported, encode the file instead.");
+}
+
+void RawVideoPlayer::StopRecord() {}
+
+bool RawVideoPlayer::DoPrepare()
+{
+    Trace::SetThreadName("player");
+
+    return true;
+}
+
+void RawVideoPlayer::DoTask()
+{
+    RunCommandLoop();
+}
+
+bool RawVideoPlayer::OpenStream()
+{
+    int width = 0;
+    int height = 0;
+    if (!media_.video_size.empty()
+        && av_parse_video_size(&width, &height, media_.video_size.c_str()) < 0) {
+        SPDLOG_ERROR("Failed to parse video size:{0}.", media_.video_size);
+        event_cb(kOpenStreamFail);
+        return false;
+    }
+
+    if (!reader_.Open(media_.src.c_str(), width, height)) {
+        event_cb(kOpenStreamFail);
+        return false;
+    }
+
+    if (GetCommonFmt(reader_.pix_fmt()) < 0) {
+        SPDLOG_ERROR("Unsupported raw video pixel format:{0}.", (int)reader_.pix_fmt());
+        reader_.Close();
+        event_cb(kOpenStreamFail);
+        return false;
+    }
+
+    frame_ = av_frame_alloc();
+    if (!frame_) {
+        SPDLOG_ERROR("Failed to alloc frame.");
+        reader_.Close();
+        event_cb(kOpenStreamFail);
+        return false;
+    }
+
+    fps_ = FFMAX(static_cast<int>(std::round(av_q2d(reader_.frame_rate()))), 1);
+
+    event_cb(kOpenStreamSuccess);
+
+    return true;
+}
+
+VideoPlayer::FrameResult RawVideoPlayer::NextFrame()
+{
+    TRACE_SCOPE("player.task");
+
+    auto read_start = std::chrono::steady_clock::now();
+    int ret = reader_.ReadFrame(frame_);
+    if (ret < 0)
+        return ret == AVERROR_EOF ? kFrameEnd : kFrameError;
+
+    FillDecodeFrame(frame_);
+    input_bytes_ += decode_frame_.buf.len;
+    CountDecode(input_bytes_,
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - read_start)
+                    .count(),
+                true);
+    push_frame(&decode_frame_);
+    int64_t index = frame_->pts;
+    av_frame_unref(frame_);
+
+    if (trick_play()) {
+        // Every raw frame is a keyframe, reading them is the load, skip the ones between.
+        int64_t skip = av_rescale_q(TrickPlaySkip(), {1, 1000}, av_inv_q(reader_.frame_rate()));
+        if (skip > 1) {
+            reader_.SeekFrame(index + skip);
+        }
+    }
+
+    return kFramePushed;
+}
+
+bool RawVideoPlayer::SeekStream(int64_t position)
+{
+    int64_t index = av_rescale_q(position, {1, 1000}, av_inv_q(reader_.frame_rate()));
+    int ret = reader_.SeekFrame(index);
+    if (ret < 0) {
+        SPDLOG_ERROR("Failed to seek raw video to frame {0}.", index);
+        return false;
+    }
+
+    // Like the decoder, the frame at the position is shown at once, even while paused.
+    ret = reader_.ReadFrame(frame_);
+    if (ret < 0)
+        return ret == AVERROR_EOF;
+
+    FillDecodeFrame(frame_);
+    push_frame(&decode_frame_);
+    av_frame_unref(frame_);
+
+    return true;
+}
+
+void RawVideoPlayer::DoFinish()
+{
+    av_frame_free(&frame_);
+    reader_.Close();
+
+    // A failed open was reported already.
+    if (opened()) {
+        event_cb(kStreamClose);
+    }
+}
+
+void RawVideoPlayer::FillDecodeFrame(const AVFrame* frame)
+{
+    // Borrow the mapped planes, they are packed like the decoder output.
+    decode_frame_.buf.base = reinterpret_cast<char*>(frame->data[0]);
+    decode_frame_.buf.len = frame->buf[0]->size;
+    decode_frame_.w = frame->width;
+    decode_frame_.h = frame->height;
+    decode_frame_.ts = av_rescale_q(frame->pts, av_inv_q(reader_.frame_rate()), {1, 1000});
+    decode_frame_.format = GetCommonFmt(frame->format);
+    decode_frame_.color_range =
+        frame->color_range == AVCOL_RANGE_JPEG ? kColorRangeFull : kColorRangeLimited;
+}
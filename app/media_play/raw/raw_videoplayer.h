@@ -0,0 +1,47 @@
+#ifndef RAW_VIDEO_PLAYER_H_
+#define RAW_VIDEO_PLAYER_H_
+
+#include <QObject>
+
+#include "codec/raw_video_reader.h"
+#include "media_play/video_player.h"
+#include "util/cthread.h"
+
+/**
+ * @brief Plays raw I420 or Y4M captures from a memory mapped file.
+ *
+ * There is no demuxer and no decoder, the frames handed to the frame buffer point into the
+ * mapping. Headerless files need MediaInfo::video_size.
+ */
+class RawVideoPlayer : public VideoPlayer, public CThread
+{
+public:
+    explicit RawVideoPlayer(QObject* parent = nullptr);
+    ~RawVideoPlayer();
+
+    void Start() override;
+    void Stop() override;
+
+    void StartRecord(const char* file) override;
+    void StopRecord() override;
+
+protected:
+    bool DoPrepare() override;
+    void DoTask() override;
+    void DoFinish() override;
+
+    bool OpenStream() override;
+    FrameResult NextFrame() override;
+    bool SeekStream(int64_t position) override;
+
+private:
+    void FillDecodeFrame(const AVFrame* frame);
+
+private:
+    RawVideoReader reader_;
+    AVFrame* frame_;
+    DecodeFrame decode_frame_;
+    uint64_t input_bytes_;
+};
+
+#endif
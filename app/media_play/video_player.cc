@@ -1,7 +1,42 @@
 #include "video_player.h"
 
+#include <algorithm>
+#include <cstdlib>
+
+#include "spdlog/spdlog.h"
+#include "util/trace.h"
+
+#define AV_CLOCK_RESYNC 10000 // ms, a larger offset is a discontinuity of the stream
+#define PLAYER_MIN_RATE 0.25
+#define PLAYER_MAX_RATE 32.0
+#define PTS_CLOCK_RESYNC 1000 // ms, a frame due further ahead is a discontinuity of the stream
+#define STEP_TIMEOUT 1000 // ms to produce the frame of a step
+#define TRICK_PLAY_ENTER_LOAD 0.9 // Share of the wall time the decoder needs at the rate
+#define TRICK_PLAY_LEAVE_LOAD 0.6
+#define TRICK_PLAY_INTERVAL 100 // ms of wall time between keyframes
+
 VideoPlayer::VideoPlayer()
     : fps_(0)
+    , next_command_(1)
+    , player_state_(kPlayerIdle)
+    , opened_(false)
+    , rate_(1.0)
+    , position_(0)
+    , anchored_(false)
+    , anchor_ts_(0)
+    , last_ts_(0)
+    , resume_ts_(-1)
+    , frame_cost_us_(0.0)
+    , produce_us_(0)
+    , trick_play_(false)
+    , can_skip_(true)
+    , input_bytes_(0)
+    , decoded_(0)
+    , decode_us_(0)
+    , reset_clock_(true)
+    , clock_base_time_(0)
+    , clock_base_ts_(0)
+    , av_offset_ms_(0)
 {}
 
 VideoPlayer::~VideoPlayer() {}
@@ -11,3 +46,335 @@ void VideoPlayer::event_cb(StreamEventType ev)
     if (event_cb_)
         event_cb_(ev);
 }
+
+uint64_t VideoPlayer::Post(PlayerCommandType type, int64_t position, double rate)
+{
+    PlayerCommand command;
+    command.type = type;
+    command.position = position;
+    command.rate = rate;
+
+    {
+        std::lock_guard<std::mutex> lock(command_mutex_);
+        command.id = next_command_++;
+
+        if (player_state_ != kPlayerStopped) {
+            commands_.push_back(command);
+            command_cv_.notify_one();
+            return command.id;
+        }
+    }
+
+    // Nobody left to apply it.
+    Ack(command, type == kCmdStop);
+    return command.id;
+}
+
+void VideoPlayer::RunCommandLoop()
+{
+    Clock::time_point next_frame = Clock::now();
+
+    while (player_state_ != kPlayerStopped) {
+        PlayerCommand command;
+        bool has_command = false;
+        {
+            TRACE_SCOPE("player.wait");
+
+            std::unique_lock<std::mutex> lock(command_mutex_);
+            auto pending = [this] { return !commands_.empty(); };
+            if (player_state_ == kPlayerPlaying) {
+                has_command = command_cv_.wait_until(lock, next_frame, pending);
+            } else {
+                command_cv_.wait(lock, pending);
+                has_command = true;
+            }
+
+            if (has_command) {
+                command = commands_.front();
+                commands_.pop_front();
+            }
+        }
+
+        if (has_command) {
+            Ack(command, Apply(command, &next_frame));
+        } else {
+            ProduceFrame(&next_frame);
+        }
+    }
+
+    std::deque<PlayerCommand> rejected;
+    {
+        std::lock_guard<std::mutex> lock(command_mutex_);
+        rejected.swap(commands_);
+    }
+    for (const PlayerCommand& command : rejected) {
+        Ack(command, command.type == kCmdStop);
+    }
+}
+
+bool VideoPlayer::Apply(const PlayerCommand& command, Clock::time_point* next_frame)
+{
+    PlayerState state = player_state_;
+    bool opened = state == kPlayerPaused || state == kPlayerPlaying;
+
+    switch (command.type) {
+    case kCmdOpen:
+        if (state != kPlayerIdle)
+            return false;
+
+        if (!OpenStream()) {
+            player_state_ = kPlayerStopped;
+            return false;
+        }
+        opened_ = true;
+        player_state_ = kPlayerPaused;
+        return true;
+    case kCmdPlay:
+        if (!opened)
+            return false;
+
+        if (state != kPlayerPlaying) {
+            player_state_ = kPlayerPlaying;
+            anchored_ = false;
+            *next_frame = Clock::now();
+        }
+        return true;
+    case kCmdPause:
+        if (!opened)
+            return false;
+
+        player_state_ = kPlayerPaused;
+        return true;
+    case kCmdStop:
+        player_state_ = kPlayerStopped;
+        return true;
+    case kCmdSeek: {
+        if (!opened)
+            return false;
+
+        frame_buf_.Clear();
+        resume_ts_ = -1;
+        bool ok = SeekStream(command.position);
+        if (ok) {
+            can_skip_ = true;
+        }
+        ResetClock();
+        anchored_ = false;
+        produce_us_ = 0;
+        *next_frame = Clock::now();
+        return ok;
+    }
+    case kCmdStep: {
+        if (state != kPlayerPaused)
+            return false;
+
+        // Until a frame is out, the decoder may need several packets. A stalled input must not
+        // hold up the commands behind the step, Stop among them.
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(STEP_TIMEOUT);
+        while (player_state_ == kPlayerPaused && Clock::now() < deadline) {
+            if (ProduceFrame(next_frame))
+                return true;
+
+            std::lock_guard<std::mutex> lock(command_mutex_);
+            if (!commands_.empty())
+                break;
+        }
+        return false;
+    }
+    case kCmdSetRate:
+        if (command.rate <= 0.0)
+            return false;
+
+        rate_ = std::min(std::max(command.rate, PLAYER_MIN_RATE), PLAYER_MAX_RATE);
+        if (rate_ != command.rate) {
+            SPDLOG_WARN("Playback rate {0} clamped to {1}.", command.rate, rate_.load());
+        }
+
+        // Takes effect with the next frame, the decoder is not reopened.
+        anchored_ = false;
+        ResetClock();
+        if (opened) {
+            UpdateTrickPlay();
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool VideoPlayer::ProduceFrame(Clock::time_point* next_frame)
+{
+    Clock::time_point start = Clock::now();
+    FrameResult result = NextFrame();
+    Clock::time_point now = Clock::now();
+    produce_us_ += std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+
+    switch (result) {
+    case kFramePushed:
+        // Keyframes alone say nothing of the cost of decoding every frame.
+        if (!trick_play_) {
+            frame_cost_us_ = frame_cost_us_ > 0.0 ? 0.9 * frame_cost_us_ + 0.1 * produce_us_
+                                                  : static_cast<double>(produce_us_);
+        }
+        produce_us_ = 0;
+
+        *next_frame = FrameDue(now);
+        UpdateTrickPlay();
+        return true;
+    case kFrameAgain:
+        return false;
+    case kFrameEnd:
+        player_state_ = kPlayerStopped;
+        event_cb(kStreamEnd);
+        return false;
+    case kFrameError:
+    default:
+        player_state_ = kPlayerStopped;
+        event_cb(kStreamError);
+        return false;
+    }
+}
+
+VideoPlayer::Clock::time_point VideoPlayer::FrameDue(Clock::time_point now)
+{
+    // The next frame is produced when the last one pushed is due, one frame ahead.
+    Clock::time_point due;
+    if (!anchored_) {
+        due = now;
+    } else if (last_ts_ > anchor_ts_) {
+        std::chrono::duration<double, std::milli> elapsed((last_ts_ - anchor_ts_) / rate_);
+        due = anchor_time_ + std::chrono::duration_cast<Clock::duration>(elapsed);
+    } else {
+        // No usable timestamps, pace by the frame rate.
+        due = last_due_ + FrameInterval();
+    }
+
+    // A late frame does not make the next ones burst, a jump of the timestamps does not stall.
+    bool resync = !anchored_ || due > now + std::chrono::milliseconds(PTS_CLOCK_RESYNC);
+    if (resync || due < now - FrameInterval()) {
+        due = now;
+    }
+    if (resync) {
+        // Play, seek, rate changes, trick play and jumps, the A/V offset restarts with them.
+        ResetClock();
+    }
+    if (!anchored_ || due == now || last_ts_ <= anchor_ts_) {
+        anchor_time_ = due;
+        anchor_ts_ = last_ts_;
+        anchored_ = true;
+    }
+    last_due_ = due;
+
+    return due;
+}
+
+void VideoPlayer::UpdateTrickPlay()
+{
+    double load = frame_cost_us_ * std::max(fps_, 1) * rate_ / 1000000.0;
+    bool trick_play = can_skip_ && rate_ > 1.0 &&
+                      load > (trick_play_ ? TRICK_PLAY_LEAVE_LOAD : TRICK_PLAY_ENTER_LOAD);
+    if (trick_play == trick_play_)
+        return;
+
+    SPDLOG_INFO("{0} trick play at {1}x, decoder load {2:.2f}.", trick_play ? "Enter" : "Leave",
+                rate_.load(), load);
+
+    trick_play_ = trick_play;
+    SetKeyframesOnly(trick_play);
+    anchored_ = false;
+
+    if (!trick_play && can_skip_) {
+        // Frames between the keyframes were never decoded, restart from the one before. Queued
+        // keyframes would play out at the rate of every frame, and the last one is not repeated.
+        frame_buf_.Clear();
+        resume_ts_ = last_ts_;
+        SeekStream(last_ts_);
+    }
+}
+
+void VideoPlayer::DisableTrickPlay()
+{
+    if (!can_skip_)
+        return;
+
+    SPDLOG_WARN("The input cannot skip ahead, trick play is off until the next seek.");
+    can_skip_ = false;
+}
+
+int64_t VideoPlayer::TrickPlaySkip() const
+{
+    return static_cast<int64_t>(rate_ * TRICK_PLAY_INTERVAL);
+}
+
+VideoPlayer::Clock::duration VideoPlayer::FrameInterval() const
+{
+    double fps = std::max(fps_, 1) * rate_;
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+}
+
+void VideoPlayer::Ack(const PlayerCommand& command, bool ok)
+{
+    if (ack_cb_)
+        ack_cb_(command, ok);
+}
+
+bool VideoPlayer::push_frame(DecodeFrame* frame)
+{
+    if (resume_ts_ >= 0) {
+        if (static_cast<int64_t>(frame->ts) <= resume_ts_)
+            return false;
+        resume_ts_ = -1;
+    }
+    last_ts_ = static_cast<int64_t>(frame->ts);
+
+    return frame_buf_.Push(frame);
+}
+
+bool VideoPlayer::pop_frame(DecodeFrame* frame)
+{
+    if (!frame_buf_.Pop(frame))
+        return false;
+
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    int64_t ts = static_cast<int64_t>(frame->ts);
+    position_ = ts;
+
+    // The stream advances at the rate against the wall clock.
+    int64_t offset =
+        static_cast<int64_t>((ts - clock_base_ts_) / rate_) - (now - clock_base_time_);
+    if (reset_clock_.exchange(false) || std::llabs(offset) > AV_CLOCK_RESYNC) {
+        clock_base_time_ = now;
+        clock_base_ts_ = ts;
+        offset = 0;
+    }
+    av_offset_ms_ = offset;
+
+    return true;
+}
+
+PlaybackTotals VideoPlayer::totals()
+{
+    FrameState state = frame_buf_.frame_state();
+
+    PlaybackTotals totals;
+    totals.input_bytes = input_bytes_;
+    totals.decoded = decoded_;
+    totals.decode_us = decode_us_;
+    totals.presented = state.pop_ok_cnt;
+    totals.dropped = state.drop_cnt;
+    totals.queue_depth = static_cast<int>(state.depth);
+    totals.av_offset_ms = static_cast<double>(av_offset_ms_);
+
+    return totals;
+}
+
+void VideoPlayer::CountDecode(uint64_t input_bytes, int64_t decode_us, bool decoded)
+{
+    input_bytes_ = input_bytes;
+    decode_us_ += decode_us;
+    if (decoded) {
+        ++decoded_;
+    }
+}
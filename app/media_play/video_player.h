@@ -1,22 +1,63 @@
 #ifndef VIDEO_PLAYER_H_
 #define VIDEO_PLAYER_H_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "player_command.h"
+#include "playback_stats.h"
 #include "stream_event_type.h"
 #include "common/media_info.h"
 #include "util/decode_frame_buf.h"
 
+/**
+ * @brief A player is a state machine on its own thread, driven by a queue of commands.
+ *
+ * Commands are posted from any thread and acknowledged through the ack callback, on the player
+ * thread. The thread blocks on a condition variable while idle or paused and until the next frame
+ * is due while playing, so a command is applied within one frame and a paused player costs no CPU.
+ *
+ * Frames are due by their timestamps divided by the rate. When the decoder can no longer keep up
+ * with a fast rate, the player switches to trick play: only keyframes are decoded and the stream
+ * is skipped ahead between them, so the CPU use stays bounded at any rate.
+ */
 class VideoPlayer
 {
 public:
     using StreamEventCallback = std::function<void(StreamEventType)>;
+    using CommandAckCallback = std::function<void(const PlayerCommand&, bool)>;
 
     VideoPlayer();
     virtual ~VideoPlayer();
 
+    /**
+     * @brief Start the thread, then open and play the media.
+     */
     virtual void Start() = 0;
-    virtual void Pause() = 0;
+
+    /**
+     * @brief Stop and join the thread, no command is applied after return.
+     */
     virtual void Stop() = 0;
-    virtual void Resume() = 0;
+
+    uint64_t Pause() { return Post(kCmdPause); }
+    uint64_t Resume() { return Post(kCmdPlay); }
+    uint64_t Seek(int64_t position) { return Post(kCmdSeek, position); }
+
+    /**
+     * @brief Produce the next frame while paused.
+     */
+    uint64_t Step() { return Post(kCmdStep); }
+    uint64_t SetRate(double rate) { return Post(kCmdSetRate, 0, rate); }
+
+    /**
+     * @return Id of the command in its acknowledgement
+     */
+    uint64_t Post(PlayerCommandType type, int64_t position = 0, double rate = 1.0);
 
     virtual void StartRecord(const char*) = 0;
     virtual void StopRecord() = 0;
@@ -27,18 +68,132 @@ public:
     void set_event_cb(StreamEventCallback cb) { event_cb_.swap(cb); }
     void event_cb(StreamEventType ev);
 
-    bool push_frame(DecodeFrame* frame) { return frame_buf_.Push(frame); };
-    bool pop_frame(DecodeFrame* frame) { return frame_buf_.Pop(frame); }
+    void set_ack_cb(CommandAckCallback cb) { ack_cb_.swap(cb); }
+
+    bool push_frame(DecodeFrame* frame);
+    bool pop_frame(DecodeFrame* frame);
 
     int fps() const { return fps_; }
 
+    /**
+     * @brief Timestamp of the last popped frame, ms.
+     */
+    int64_t position() const { return position_; }
+    double rate() const { return rate_; }
+    bool trick_play() const { return trick_play_; }
+    PlayerState player_state() const { return player_state_; }
+
+    /**
+     * @brief Whether the stream was opened, it may have stopped since.
+     */
+    bool opened() const { return opened_; }
+
+    /**
+     * @brief Counters for the stats sampler, callable from any thread.
+     */
+    PlaybackTotals totals();
+
+    /**
+     * @brief Restart the playback clock with the next presented frame, e.g. after a pause.
+     */
+    void ResetClock() { reset_clock_ = true; }
+
+protected:
+    enum FrameResult
+    {
+        kFramePushed,
+        kFrameAgain, // Nothing yet, e.g. the decoder needs more packets
+        kFrameEnd,
+        kFrameError
+    };
+
+    /**
+     * @brief Apply commands and produce frames until stopped, on the player thread.
+     */
+    void RunCommandLoop();
+
+    // Called on the player thread by RunCommandLoop.
+    virtual bool OpenStream() = 0;
+    virtual FrameResult NextFrame() = 0;
+    virtual bool SeekStream(int64_t position) = 0;
+
+    /**
+     * @brief Decode keyframes only, for trick play, a no-op without a decoder.
+     */
+    virtual void SetKeyframesOnly(bool enable) {}
+
+    /**
+     * @brief The input failed to skip ahead, e.g. a live stream or past the last keyframe.
+     *
+     * Trick play is left and not entered again until a seek succeeds.
+     */
+    void DisableTrickPlay();
+
+    /**
+     * @brief Stream time to skip after a frame in trick play, ms.
+     */
+    int64_t TrickPlaySkip() const;
+
+    /**
+     * @brief Account the work of the player thread to produce a frame, or to fail to.
+     *
+     * @param input_bytes Bytes read from the input in total
+     */
+    void CountDecode(uint64_t input_bytes, int64_t decode_us, bool decoded);
+
 protected:
     MediaInfo media_;
     int fps_;
 
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool Apply(const PlayerCommand& command, Clock::time_point* next_frame);
+    bool ProduceFrame(Clock::time_point* next_frame);
+    Clock::time_point FrameDue(Clock::time_point now);
+    Clock::duration FrameInterval() const;
+    void UpdateTrickPlay();
+    void Ack(const PlayerCommand& command, bool ok);
+
 private:
     DecodeFrameBuf frame_buf_;
     StreamEventCallback event_cb_;
+    CommandAckCallback ack_cb_;
+
+    std::mutex command_mutex_;
+    std::condition_variable command_cv_;
+    std::deque<PlayerCommand> commands_;
+    uint64_t next_command_;
+
+    std::atomic<PlayerState> player_state_;
+    std::atomic<bool> opened_;
+    std::atomic<double> rate_;
+    std::atomic<int64_t> position_;
+
+    // Player thread only. The pts clock maps frame timestamps to due times at the rate.
+    bool anchored_;
+    Clock::time_point anchor_time_;
+    int64_t anchor_ts_; // ms
+    int64_t last_ts_;   // ms, of the last pushed frame
+    int64_t resume_ts_; // ms, frames up to it are skipped after trick play, -1 for none
+    Clock::time_point last_due_;
+
+    // Time to produce a frame with every frame decoded, us, smoothed.
+    double frame_cost_us_;
+    int64_t produce_us_; // Spent on the frame in progress
+    std::atomic<bool> trick_play_;
+    bool can_skip_;
+
+    std::atomic<uint64_t> input_bytes_;
+    std::atomic<uint64_t> decoded_;
+    std::atomic<int64_t> decode_us_;
+
+    // The player has no audio output, the offset is that of the presented frames against the
+    // playback clock the audio would follow.
+    std::atomic<bool> reset_clock_;
+    int64_t clock_base_time_; // ms, steady
+    int64_t clock_base_ts_;   // ms, frame ts
+    std::atomic<int64_t> av_offset_ms_;
 };
 
 #endif
@@ -4,6 +4,7 @@
 #include "video_player.h"
 #include "common/avdef.h"
 #include "ffmpeg/ff_videoplayer.h"
+#include "raw/raw_videoplayer.h"
 
 class VideoPlayerFactory
 {
@@ -15,6 +16,8 @@ public:
         case kNetwork:
         case kCapture:
             return new FFVideoPlayer;
+        case kRawFile:
+            return new RawVideoPlayer;
         case kNone:
         default:
             return nullptr;
@@ -0,0 +1,66 @@
+#include "render_wnd_null.h"
+
+#include <QDateTime>
+
+#include "spdlog/spdlog.h"
+
+extern "C"
+{
+#include "libavutil/adler32.h"
+}
+
+#define NULL_REPORT_INTERVAL 1000 // ms
+
+RenderWndNull::RenderWndNull(QWidget* parent)
+    : QWidget(parent)
+    , frames_(0)
+    , bytes_(0)
+    , checksum_(1)
+    , start_time_(0)
+    , report_time_(0)
+    , report_frames_(0)
+{
+    setStyleSheet("QWidget {background: black;}");
+}
+
+RenderWndNull::~RenderWndNull()
+{
+    Report(true);
+}
+
+void RenderWndNull::Render(const DecodeFrame& frame)
+{
+    if (frame.IsNull())
+        return;
+
+    if (frames_ == 0) {
+        start_time_ = QDateTime::currentMSecsSinceEpoch();
+        report_time_ = start_time_;
+    }
+
+    checksum_ = av_adler32_update(checksum_, reinterpret_cast<const uint8_t*>(frame.buf.base),
+                                  frame.buf.len);
+    ++frames_;
+    bytes_ += frame.buf.len;
+
+    Report(false);
+}
+
+void RenderWndNull::Report(bool force)
+{
+    if (frames_ == 0)
+        return;
+
+    int64_t now = QDateTime::currentMSecsSinceEpoch();
+    if (!force && now - report_time_ < NULL_REPORT_INTERVAL)
+        return;
+
+    double interval = (now - report_time_) / 1000.0;
+    double elapsed = (now - start_time_) / 1000.0;
+    SPDLOG_INFO("Null sink frames: {0}, fps: {1:.1f} (avg {2:.1f}), MB: {3:.1f}, checksum: {4:08x}",
+                frames_, interval > 0.0 ? (frames_ - report_frames_) / interval : 0.0,
+                elapsed > 0.0 ? frames_ / elapsed : 0.0, bytes_ / (1024.0 * 1024.0), checksum_);
+
+    report_time_ = now;
+    report_frames_ = frames_;
+}
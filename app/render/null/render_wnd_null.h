@@ -0,0 +1,42 @@
+#ifndef RENDER_WND_NULL_H_
+#define RENDER_WND_NULL_H_
+
+#include <QWidget>
+
+#include "render/render_wnd.h"
+#include "util/decode_frame.h"
+
+/**
+ * @brief Render window that draws nothing, for measuring decode throughput without a display.
+ *
+ * Frames are only counted and checksummed, the running checksum allows to compare the decoded
+ * output of two runs.
+ */
+class RenderWndNull : public RenderWnd, public QWidget
+{
+public:
+    explicit RenderWndNull(QWidget* parent = nullptr);
+    ~RenderWndNull();
+
+    uint64_t frames() const { return frames_; }
+    uint32_t checksum() const { return checksum_; }
+
+protected:
+    void Render(const DecodeFrame& frame) override;
+    void setGeometry(const QRect& rect) override { QWidget::setGeometry(rect); }
+    void update() override {}
+
+private:
+    void Report(bool force);
+
+private:
+    uint64_t frames_;
+    uint64_t bytes_;
+    uint32_t checksum_; // Adler-32 over all frames
+
+    int64_t start_time_;
+    int64_t report_time_;
+    uint64_t report_frames_;
+};
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef GL_CALL_H_
+#define GL_CALL_H_
+
+// Issue a GL call and count it in the member gl_calls_, so the per-frame call budget of the
+// renderer can be checked by benchmarks.
+#define GL_CALL(expr) (++gl_calls_, expr)
+
+#endif
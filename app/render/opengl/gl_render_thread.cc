@@ -0,0 +1,397 @@
+#include "gl_render_thread.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QOpenGLExtraFunctions>
+
+#include "shader_cache.h"
+#include "spdlog/spdlog.h"
+#include "util/trace.h"
+
+#define UPLOAD_REPORT_INTERVAL 1000 // ms
+
+GLRenderThread::GLRenderThread(QOpenGLContext* share_context, QObject* parent)
+    : CThread(parent)
+    , context_(new QOpenGLContext())
+    , surface_(new QOffscreenSurface())
+    , shader_key_({-1, -1, -1})
+    , dirty_tiles_(false)
+    , pending_(false)
+    , resized_(false)
+    , presenting_(false)
+    , interval_ms_(0)
+    , applied_interval_ms_(0)
+    , front_(-1)
+    , reading_(-1)
+    , frame_gl_calls_(0)
+    , uploaded_frames_(0)
+    , upload_us_(0)
+    , report_time_(0)
+{
+    if (share_context) {
+        context_->setFormat(share_context->format());
+        context_->setShareContext(share_context);
+    } else {
+        QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+        format.setVersion(3, 3);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+        context_->setFormat(format);
+    }
+    if (!context_->create()) {
+        SPDLOG_ERROR("Failed to create render thread OpenGL context.");
+    }
+
+    // Offscreen surfaces have to be created on the GUI thread.
+    surface_->setFormat(context_->format());
+    surface_->create();
+
+    context_->moveToThread(this);
+}
+
+GLRenderThread::~GLRenderThread()
+{
+    Quit();
+
+    delete context_;
+    delete surface_;
+}
+
+void GLRenderThread::Launch()
+{
+    if (isRunning())
+        return;
+
+    set_state(kRunning);
+    start();
+}
+
+void GLRenderThread::Quit()
+{
+    if (!isRunning())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        set_state(kStop);
+    }
+    cv_.notify_all();
+
+    wait();
+}
+
+void GLRenderThread::SetFrameProvider(const RenderWnd::FrameProvider& provider, int fps)
+{
+    {
+        std::lock_guard<std::mutex> lock(provider_mutex_);
+        provider_ = provider;
+    }
+
+    {
+        // Under the lock of the wait, a notify between its predicate and its block is lost.
+        std::lock_guard<std::mutex> lock(mutex_);
+        interval_ms_ = 1000 / (fps > 0 ? fps : 25);
+        presenting_ = true;
+    }
+    cv_.notify_all();
+}
+
+void GLRenderThread::ClearFrameProvider()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        presenting_ = false;
+    }
+
+    // Waits for a running provider call, the provider may be destroyed after this.
+    std::lock_guard<std::mutex> lock(provider_mutex_);
+    provider_ = nullptr;
+}
+
+void GLRenderThread::Submit(const DecodeFrame& frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_frame_.Copy(frame);
+        pending_ = true;
+    }
+    cv_.notify_all();
+}
+
+void GLRenderThread::Resize(const QSize& size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_ = size;
+        resized_ = true;
+    }
+    cv_.notify_all();
+}
+
+bool GLRenderThread::AcquireFrame(GLuint* texture, GLsync* ready)
+{
+    std::lock_guard<std::mutex> lock(present_mutex_);
+    if (front_ < 0)
+        return false;
+
+    reading_ = front_;
+    *texture = buffers_[reading_].fbo->texture();
+    *ready = buffers_[reading_].ready;
+
+    return true;
+}
+
+void GLRenderThread::ReleaseFrame(GLsync released)
+{
+    std::lock_guard<std::mutex> lock(present_mutex_);
+    if (reading_ < 0)
+        return;
+
+    PresentBuffer& buf = buffers_[reading_];
+    if (buf.released) {
+        // Sync objects are shared, the previous read is older than this one.
+        QOpenGLContext::currentContext()->extraFunctions()->glDeleteSync(buf.released);
+    }
+    buf.released = released;
+    reading_ = -1;
+}
+
+bool GLRenderThread::DoPrepare()
+{
+    Trace::SetThreadName("gl render");
+
+    if (!context_->makeCurrent(surface_)) {
+        SPDLOG_ERROR("Failed to make render thread context current.");
+        return false;
+    }
+
+    initializeOpenGLFunctions();
+
+    // Programs are picked per frame from the shader cache of this context.
+    renderer_.reset(new OpenGLRenderer());
+
+    uploader_.Init();
+    uploader_.set_dirty_tiles(dirty_tiles_);
+    textures_.Init();
+
+    return true;
+}
+
+void GLRenderThread::DoTask()
+{
+    DecodeFrame frame;
+    QSize size;
+    bool was_paced = false;
+
+    while (state() != kStop) {
+        bool has_frame = false;
+        bool redraw = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] {
+                return state() == kStop || presenting_ || pending_ || resized_;
+            });
+            if (state() == kStop)
+                break;
+
+            if (pending_) {
+                frame.Copy(pending_frame_);
+                pending_ = false;
+                has_frame = true;
+            }
+
+            redraw = resized_;
+            resized_ = false;
+            size = size_;
+        }
+
+        bool paced = presenting_;
+        if (paced) {
+            has_frame = PullFrame(&frame) || has_frame;
+        }
+
+        if ((has_frame || redraw) && !size.isEmpty()) {
+            Present(has_frame ? &frame : nullptr, size);
+        }
+
+        if (paced) {
+            // Restart the pacing clock when presentation resumes, otherwise frames burst.
+            if (!was_paced || applied_interval_ms_ != interval_ms_) {
+                applied_interval_ms_ = interval_ms_;
+                set_sleep_policy(kUntil, applied_interval_ms_);
+            }
+            Sleep();
+        }
+        was_paced = paced;
+    }
+}
+
+void GLRenderThread::DoFinish()
+{
+    {
+        std::lock_guard<std::mutex> lock(present_mutex_);
+        for (auto& buf : buffers_) {
+            if (buf.ready) {
+                glDeleteSync(buf.ready);
+            }
+            if (buf.released) {
+                glDeleteSync(buf.released);
+            }
+            buf = PresentBuffer();
+        }
+        front_ = -1;
+        reading_ = -1;
+    }
+
+    uploader_.Release();
+    textures_.Release();
+    renderer_.reset();
+
+    context_->doneCurrent();
+    context_->moveToThread(QCoreApplication::instance()->thread());
+}
+
+bool GLRenderThread::PullFrame(DecodeFrame* frame)
+{
+    std::lock_guard<std::mutex> lock(provider_mutex_);
+    if (!provider_)
+        return false;
+
+    return provider_(frame);
+}
+
+void GLRenderThread::Present(const DecodeFrame* frame, const QSize& size)
+{
+    TRACE_SCOPE("render.present");
+
+    if (frame) {
+        PboUploader::Plane planes[PboUploader::kMaxPlanes];
+        int plane_count = PboUploader::FramePlanes(frame->format, frame->w, frame->h, planes);
+        if (plane_count == 0)
+            return;
+
+        ShaderKey key = ShaderKey::FromFrame(*frame);
+        if (key != shader_key_) {
+            shader_key_ = key;
+            renderer_->SetProgram(ShaderCache::Current()->Program(key));
+        }
+
+        if (textures_.Reserve(planes, plane_count)) {
+            renderer_->InvalidateState();
+            uploader_.InvalidateTiles();
+        }
+
+        TRACE_SCOPE("render.upload");
+        if (uploader_.Stage(*frame)) {
+            uploader_.Upload(textures_.ids());
+        }
+    }
+
+    if (!textures_.valid())
+        return;
+
+    GLsync released = nullptr;
+    int back = AcquireBackBuffer(&released);
+    PresentBuffer& buf = buffers_[back];
+
+    if (released) {
+        // Server side wait, the compositor may still have reads of this fbo in flight.
+        glWaitSync(released, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(released);
+    }
+
+    if (!buf.fbo || buf.fbo->size() != size) {
+        buf.fbo.reset(new QOpenGLFramebufferObject(size, QOpenGLFramebufferObject::NoAttachment,
+                                                   GL_TEXTURE_2D, GL_RGBA8));
+        // Creating the fbo texture disturbs the cached bindings.
+        renderer_->InvalidateState();
+    }
+
+    TRACE_SCOPE("render.draw");
+    buf.fbo->bind();
+    glViewport(0, 0, size.width(), size.height());
+    renderer_->SetSize(QVector2D(size.width(), size.height()));
+    renderer_->Draw(textures_.ids(), textures_.count(), textures_.content_scale(),
+                    textures_.content_clamp());
+
+    // Counted before the read back, which checks them against a budget.
+    frame_gl_calls_ = uploader_.gl_calls() + textures_.gl_calls() + renderer_->gl_calls();
+    uploader_.reset_gl_calls();
+    textures_.reset_gl_calls();
+    renderer_->reset_gl_calls();
+
+    if (readback_cb_) {
+        Readback(size);
+    }
+
+    GLsync ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // The compositor waits on this fence from another context, it must reach the GPU.
+    glFlush();
+
+    {
+        std::lock_guard<std::mutex> lock(present_mutex_);
+        if (buf.ready) {
+            glDeleteSync(buf.ready);
+        }
+        buf.ready = ready;
+        front_ = back;
+    }
+
+    uploaded_frames_ = uploader_.stats().frames;
+    upload_us_ = uploader_.stats().total_stage_us + uploader_.stats().total_upload_us;
+
+    ReportUploadStats();
+
+    if (frame_ready_cb_) {
+        frame_ready_cb_();
+    }
+}
+
+int GLRenderThread::AcquireBackBuffer(GLsync* released)
+{
+    std::lock_guard<std::mutex> lock(present_mutex_);
+
+    // Never the latest frame nor the one being composited.
+    int back = 0;
+    while (back == front_ || back == reading_) {
+        ++back;
+    }
+
+    *released = buffers_[back].released;
+    buffers_[back].released = nullptr;
+
+    return back;
+}
+
+void GLRenderThread::Readback(const QSize& size)
+{
+    readback_.resize(static_cast<size_t>(size.width()) * size.height() * 4);
+
+    // Waits for the draw to complete, this is meant for verification and benchmarking only.
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, readback_.data());
+
+    readback_cb_(readback_.data(), size.width(), size.height());
+}
+
+void GLRenderThread::ReportUploadStats()
+{
+    int64_t now = QDateTime::currentMSecsSinceEpoch();
+    if (now - report_time_ < UPLOAD_REPORT_INTERVAL)
+        return;
+    report_time_ = now;
+
+    const UploadStats& stats = uploader_.stats();
+    if (stats.frames == 0)
+        return;
+
+    SPDLOG_DEBUG("Upload frames: {0}, stage: {1}us (avg {2}us), upload: {3}us (avg {4}us), "
+                 "stalls: {5}, gl calls: {6}",
+                 stats.frames, stats.stage_us, stats.total_stage_us / stats.frames,
+                 stats.upload_us, stats.total_upload_us / stats.frames, stats.stalls,
+                 static_cast<uint32_t>(frame_gl_calls_));
+
+    if (uploader_.dirty_tiles() && stats.tiles > 0) {
+        SPDLOG_DEBUG("Dirty tiles uploaded: {0:.1f}%, skipped frames: {1}",
+                     100.0 * stats.dirty_tiles / stats.tiles, stats.skipped);
+    }
+}
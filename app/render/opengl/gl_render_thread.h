@@ -0,0 +1,153 @@
+#ifndef GL_RENDER_THREAD_H_
+#define GL_RENDER_THREAD_H_
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions_3_3_Core>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "opengl_renderer.h"
+#include "pbo_uploader.h"
+#include "plane_textures.h"
+#include "shader_cache.h"
+#include "render/render_wnd.h"
+#include "util/cthread.h"
+
+/**
+ * @brief Uploads and draws video frames on its own thread and context.
+ *
+ * Frames are drawn into a ring of framebuffer objects whose textures are shared with the widget,
+ * the GUI thread only composites the latest completed one. Buffers are handed over with fences,
+ * so neither side blocks the other on the CPU.
+ */
+class GLRenderThread : public CThread, protected QOpenGLFunctions_3_3_Core
+{
+public:
+    using FrameReadyCallback = std::function<void()>;
+    // Rgba pixels of the drawn frame, bottom-up, valid during the call.
+    using ReadbackCallback = std::function<void(const uint8_t* pixels, int w, int h)>;
+
+    /**
+     * @brief Must be created on the GUI thread, the context and surface are created here.
+     *
+     * @param share_context Null for a standalone context, e.g. when rendering headless.
+     */
+    explicit GLRenderThread(QOpenGLContext* share_context, QObject* parent = nullptr);
+    ~GLRenderThread();
+
+    void set_frame_ready_cb(FrameReadyCallback cb) { frame_ready_cb_.swap(cb); }
+
+    /**
+     * @brief Read every drawn frame back with glReadPixels, set before Launch().
+     */
+    void set_readback_cb(ReadbackCallback cb) { readback_cb_.swap(cb); }
+
+    /**
+     * @brief Upload only the tiles that changed since the previous frame, set before Launch().
+     */
+    void set_dirty_tiles(bool enable) { dirty_tiles_ = enable; }
+
+    void Launch();
+    void Quit();
+
+    /**
+     * @brief Pull frames from the provider at the given fps until ClearFrameProvider().
+     */
+    void SetFrameProvider(const RenderWnd::FrameProvider& provider, int fps);
+
+    /**
+     * @brief Block until the provider is no longer called.
+     */
+    void ClearFrameProvider();
+
+    void Submit(const DecodeFrame& frame);
+    void Resize(const QSize& size);
+
+    /**
+     * @brief Take the latest completed frame for compositing, called on the GUI thread.
+     *
+     * @param ready Fence the reader has to wait on before sampling the texture.
+     * @return False if nothing has been drawn yet.
+     */
+    bool AcquireFrame(GLuint* texture, GLsync* ready);
+
+    /**
+     * @brief Hand the acquired frame back with a fence placed after the last read.
+     */
+    void ReleaseFrame(GLsync released);
+
+    uint32_t frame_gl_calls() const { return frame_gl_calls_; }
+
+    // Totals of the uploader, staging and submission time together
+    uint64_t uploaded_frames() const { return uploaded_frames_; }
+    int64_t upload_us() const { return upload_us_; }
+
+protected:
+    bool DoPrepare() override;
+    void DoTask() override;
+    void DoFinish() override;
+
+private:
+    enum
+    {
+        kBufferCount = 3
+    };
+
+    struct PresentBuffer
+    {
+        std::unique_ptr<QOpenGLFramebufferObject> fbo;
+        GLsync ready = nullptr;    // Drawing into the fbo completed
+        GLsync released = nullptr; // Compositor finished sampling the fbo
+    };
+
+    bool PullFrame(DecodeFrame* frame);
+    void Present(const DecodeFrame* frame, const QSize& size);
+    int AcquireBackBuffer(GLsync* released);
+    void Readback(const QSize& size);
+    void ReportUploadStats();
+
+private:
+    QOpenGLContext* context_;
+    QOffscreenSurface* surface_;
+
+    PboUploader uploader_;
+    PlaneTextures textures_;
+    std::unique_ptr<OpenGLRenderer> renderer_;
+    ShaderKey shader_key_;
+    bool dirty_tiles_;
+
+    // Work queue
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    DecodeFrame pending_frame_;
+    bool pending_;
+    bool resized_;
+    QSize size_;
+
+    std::mutex provider_mutex_;
+    RenderWnd::FrameProvider provider_;
+    std::atomic<bool> presenting_;
+    std::atomic<int> interval_ms_;
+    int applied_interval_ms_;
+
+    // Guarded by present_mutex_
+    std::mutex present_mutex_;
+    PresentBuffer buffers_[kBufferCount];
+    int front_;
+    int reading_;
+
+    FrameReadyCallback frame_ready_cb_;
+    ReadbackCallback readback_cb_;
+    std::vector<uint8_t> readback_;
+
+    std::atomic<uint32_t> frame_gl_calls_;
+    std::atomic<uint64_t> uploaded_frames_;
+    std::atomic<int64_t> upload_us_;
+    int64_t report_time_;
+};
+
+#endif
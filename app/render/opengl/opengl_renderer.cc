@@ -1,11 +1,13 @@
 #include "opengl_renderer.h"
 
+#include "gl_call.h"
+
 // clang-format off
 static float sprite_vertices[] = {
 	// pos      // tex
     0.0f, 1.0f, 0.0f, 1.0f,
     1.0f, 0.0f, 1.0f, 0.0f,
-    0.0f, 0.0f, 0.0f, 0.0f, 
+    0.0f, 0.0f, 0.0f, 0.0f,
 
     0.0f, 1.0f, 0.0f, 1.0f,
     1.0f, 1.0f, 1.0f, 1.0f,
@@ -14,19 +16,54 @@ static float sprite_vertices[] = {
 // clang-format on
 
 OpenGLRenderer::OpenGLRenderer(const std::shared_ptr<QOpenGLShaderProgram>& shader_program)
-    : shader_program_(shader_program)
+    : vao_(0)
+    , vbo_(0)
+    , matrices_dirty_(true)
+    , state_valid_(false)
+    , gl_calls_(0)
 {
+    memset(&uniforms_, 0xff, sizeof(uniforms_));
+    // SetProgram returns early for a null program, which must not leave the cache uninitialized.
+    InvalidateState();
+
     InitRenderData();
+    SetProgram(shader_program);
 }
 
 OpenGLRenderer::~OpenGLRenderer()
 {
     glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &vbo_);
+}
+
+void OpenGLRenderer::SetProgram(const std::shared_ptr<QOpenGLShaderProgram>& shader_program)
+{
+    if (shader_program == shader_program_)
+        return;
+
+    shader_program_ = shader_program;
+    if (shader_program_) {
+        ResolveUniforms();
+    }
+
+    InvalidateState();
 }
 
 void OpenGLRenderer::SetSize(const QVector2D& size)
 {
+    if (size == size_)
+        return;
+
     size_ = size;
+
+    // Only recomputed here, draws upload them when they changed.
+    proj_mat_.setToIdentity();
+    proj_mat_.ortho(0.0f, size_.x(), size_.y(), 0.0f, -1.0f, 1.0f);
+
+    viewport_model_mat_.setToIdentity();
+    viewport_model_mat_.scale(size_);
+
+    matrices_dirty_ = true;
 }
 
 void OpenGLRenderer::Draw(std::shared_ptr<QOpenGLTexture> texture, const QVector2D& pos,
@@ -43,92 +80,68 @@ void OpenGLRenderer::Draw(std::shared_ptr<QOpenGLTexture> texture, const QVector
 void OpenGLRenderer::Draw(GLuint texture, const QVector2D& pos, const QVector2D& size, float rotate,
                           const QVector3D& color)
 {
-    shader_program_->bind();
-    shader_program_->setUniformValue("main_tex", 0);
-    shader_program_->setUniformValue("sprite_color", color);
+    if (!shader_program_)
+        return;
 
-    QMatrix4x4 proj_mat;
-    proj_mat.ortho(0.0f, size_.x(), size_.y(), 0.0f, -1.0f, 1.0f);
-    shader_program_->setUniformValue("proj_mat", proj_mat);
+    UseProgram();
+
+    GL_CALL(shader_program_->setUniformValue(uniforms_.sprite_color, color));
+
+    if (matrices_dirty_) {
+        GL_CALL(shader_program_->setUniformValue(uniforms_.proj_mat, proj_mat_));
+    }
 
     QMatrix4x4 model_mat;
     model_mat.translate(pos);
     model_mat.rotate(rotate, QVector3D(0.0f, 0.0f, 1.0f)); // TODO
     model_mat.scale(size);
-    shader_program_->setUniformValue("model_mat", model_mat);
+    GL_CALL(shader_program_->setUniformValue(uniforms_.model_mat, model_mat));
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    // The viewport model matrix has been overwritten.
+    matrices_dirty_ = true;
 
-    glBindVertexArray(vao_);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    BindTexture(0, texture);
 
-    // Bind default.
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    shader_program_->release();
+    GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 6));
 }
 
-void OpenGLRenderer::Draw(std::shared_ptr<QOpenGLTexture> y, std::shared_ptr<QOpenGLTexture> u,
-                          std::shared_ptr<QOpenGLTexture> v, int type, const QVector2D& size)
+void OpenGLRenderer::Draw(const GLuint* textures, int count, const QVector2D& content_scale,
+                          const QVector2D& content_clamp)
 {
-    shader_program_->bind();
-    shader_program_->setUniformValue("format", type);
-    shader_program_->setUniformValue("y_tex", 0);
-    shader_program_->setUniformValue("u_tex", 1);
-    shader_program_->setUniformValue("v_tex", 2);
+    if (!shader_program_)
+        return;
 
-    QMatrix4x4 proj_mat;
-    proj_mat.ortho(0.0f, size_.x(), size_.y(), 0.0f, -1.0f, 1.0f);
-    shader_program_->setUniformValue("proj_mat", proj_mat);
+    UseProgram();
 
-    QMatrix4x4 model_mat;
-    model_mat.translate(QVector2D(0.0f, 0.0f));
-    model_mat.scale(size);
-    shader_program_->setUniformValue("model_mat", model_mat);
+    if (matrices_dirty_) {
+        GL_CALL(shader_program_->setUniformValue(uniforms_.proj_mat, proj_mat_));
+        GL_CALL(shader_program_->setUniformValue(uniforms_.model_mat, viewport_model_mat_));
+        matrices_dirty_ = false;
+    }
 
-    if (y && y->isCreated() && u && u->isCreated() && v && v->isCreated()) {
-        y->bind(0);
-        u->bind(1);
-        v->bind(2);
+    if (content_scale != content_scale_) {
+        GL_CALL(shader_program_->setUniformValue(uniforms_.tex_scale, content_scale));
+        content_scale_ = content_scale;
+    }
+    if (content_clamp != content_clamp_) {
+        GL_CALL(shader_program_->setUniformValue(uniforms_.tex_clamp, content_clamp));
+        content_clamp_ = content_clamp;
     }
 
-    glBindVertexArray(vao_);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    for (int i = 0; i < count && i < MAX_TEXTURE_UNITS; ++i) {
+        BindTexture(i, textures[i]);
+    }
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    shader_program_->release();
+    GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 6));
 }
 
-void OpenGLRenderer::Draw(std::shared_ptr<QOpenGLTexture> y, std::shared_ptr<QOpenGLTexture> uv,
-                          int type, const QVector2D& size)
+void OpenGLRenderer::InvalidateState()
 {
-    shader_program_->bind();
-    shader_program_->setUniformValue("format", type);
-    shader_program_->setUniformValue("y_tex", 0);
-    shader_program_->setUniformValue("uv_tex", 3);
-
-    QMatrix4x4 proj_mat;
-    proj_mat.ortho(0.0f, size_.x(), size_.y(), 0.0f, -1.0f, 1.0f);
-    shader_program_->setUniformValue("proj_mat", proj_mat);
-
-    QMatrix4x4 model_mat;
-    model_mat.translate(QVector2D(0.0f, 0.0f));
-    model_mat.scale(size);
-    shader_program_->setUniformValue("model_mat", model_mat);
-
-    if (y && y->isCreated() && uv && uv->isCreated()) {
-        y->bind(0);
-        uv->bind(3);
-    }
-
-    glBindVertexArray(vao_);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    shader_program_->release();
+    state_valid_ = false;
+    matrices_dirty_ = true;
+    memset(bound_textures_, 0xff, sizeof(bound_textures_));
+    content_scale_ = QVector2D(-1.0f, -1.0f);
+    content_clamp_ = QVector2D(-1.0f, -1.0f);
 }
 
 void OpenGLRenderer::InitRenderData()
@@ -138,9 +151,8 @@ void OpenGLRenderer::InitRenderData()
     glGenVertexArrays(1, &vao_);
     glBindVertexArray(vao_);
 
-    quint32 vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glGenBuffers(1, &vbo_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(sprite_vertices), sprite_vertices, GL_STATIC_DRAW);
 
@@ -150,3 +162,47 @@ void OpenGLRenderer::InitRenderData()
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
+
+void OpenGLRenderer::ResolveUniforms()
+{
+    uniforms_.proj_mat = shader_program_->uniformLocation("proj_mat");
+    uniforms_.model_mat = shader_program_->uniformLocation("model_mat");
+    uniforms_.main_tex = shader_program_->uniformLocation("main_tex");
+    uniforms_.sprite_color = shader_program_->uniformLocation("sprite_color");
+    uniforms_.y_tex = shader_program_->uniformLocation("y_tex");
+    uniforms_.u_tex = shader_program_->uniformLocation("u_tex");
+    uniforms_.v_tex = shader_program_->uniformLocation("v_tex");
+    uniforms_.uv_tex = shader_program_->uniformLocation("uv_tex");
+    uniforms_.tex_scale = shader_program_->uniformLocation("tex_scale");
+    uniforms_.tex_clamp = shader_program_->uniformLocation("tex_clamp");
+
+    // Samplers never change, plane i is always sampled from unit i.
+    shader_program_->bind();
+    shader_program_->setUniformValue(uniforms_.main_tex, 0);
+    shader_program_->setUniformValue(uniforms_.y_tex, 0);
+    shader_program_->setUniformValue(uniforms_.u_tex, 1);
+    shader_program_->setUniformValue(uniforms_.v_tex, 2);
+    shader_program_->setUniformValue(uniforms_.uv_tex, 1);
+    shader_program_->release();
+}
+
+void OpenGLRenderer::UseProgram()
+{
+    if (state_valid_)
+        return;
+
+    GL_CALL(shader_program_->bind());
+    GL_CALL(glBindVertexArray(vao_));
+    state_valid_ = true;
+}
+
+void OpenGLRenderer::BindTexture(int unit, GLuint texture)
+{
+    if (bound_textures_[unit] == texture)
+        return;
+
+    // The active unit is not cached, the uploader switches it behind our back.
+    GL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, texture));
+    bound_textures_[unit] = texture;
+}
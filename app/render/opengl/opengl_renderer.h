@@ -1,18 +1,34 @@
 #ifndef OPENGL_RENDERER_H_
 #define OPENGL_RENDERER_H_
 
+#include <QMatrix4x4>
 #include <QOpenGLFunctions>
 #include <QOpenGLFunctions_3_3_Core>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLTexture>
 #include <memory>
 
+#define MAX_TEXTURE_UNITS 4
+
+/**
+ * @brief Draws textured quads with a linked shader program.
+ *
+ * Uniform locations are resolved once when the renderer is created and GL state (program, vao,
+ * texture bindings, uniforms) is cached, so a frame without changes only costs the draw call.
+ * The renderer assumes it owns that state in its context, call InvalidateState() after other
+ * code touched it.
+ */
 class OpenGLRenderer : protected QOpenGLFunctions_3_3_Core
 {
 public:
-    explicit OpenGLRenderer(const std::shared_ptr<QOpenGLShaderProgram>& shader_program);
+    explicit OpenGLRenderer(const std::shared_ptr<QOpenGLShaderProgram>& shader_program = nullptr);
     ~OpenGLRenderer();
 
+    /**
+     * @brief Switch program, uniforms are resolved again and the cached state is dropped.
+     */
+    void SetProgram(const std::shared_ptr<QOpenGLShaderProgram>& shader_program);
+
     void SetSize(const QVector2D& size);
 
     void Draw(std::shared_ptr<QOpenGLTexture> texture, const QVector2D& pos,
@@ -22,18 +38,55 @@ public:
     void Draw(GLuint texture, const QVector2D& pos, const QVector2D& size = QVector2D(10.0f, 10.0f),
               float rotate = 0.0f, const QVector3D& color = QVector3D(1.0f, 1.0f, 1.0f));
 
-    void Draw(std::shared_ptr<QOpenGLTexture> y, std::shared_ptr<QOpenGLTexture> u,
-              std::shared_ptr<QOpenGLTexture> v, int type, const QVector2D& size);
+    /**
+     * @brief Draw the yuv planes over the whole viewport, texture i is sampled from unit i.
+     */
+    void Draw(const GLuint* textures, int count, const QVector2D& content_scale,
+              const QVector2D& content_clamp);
 
-    void Draw(std::shared_ptr<QOpenGLTexture> y, std::shared_ptr<QOpenGLTexture> uv, int type,
-              const QVector2D& size);
+    void InvalidateState();
+
+    uint32_t gl_calls() const { return gl_calls_; }
+    void reset_gl_calls() { gl_calls_ = 0; }
 
 private:
     void InitRenderData();
+    void ResolveUniforms();
+
+    void UseProgram();
+    void BindTexture(int unit, GLuint texture);
 
 private:
+    struct Uniforms
+    {
+        GLint proj_mat;
+        GLint model_mat;
+        GLint main_tex;
+        GLint sprite_color;
+        GLint y_tex;
+        GLint u_tex;
+        GLint v_tex;
+        GLint uv_tex;
+        GLint tex_scale;
+        GLint tex_clamp;
+    };
+
     QVector2D size_;
     quint32 vao_;
+    quint32 vbo_;
     std::shared_ptr<QOpenGLShaderProgram> shader_program_;
+    Uniforms uniforms_;
+
+    QMatrix4x4 proj_mat_;
+    QMatrix4x4 viewport_model_mat_;
+    bool matrices_dirty_;
+
+    // Cached state
+    bool state_valid_;
+    GLuint bound_textures_[MAX_TEXTURE_UNITS];
+    QVector2D content_scale_;
+    QVector2D content_clamp_;
+
+    uint32_t gl_calls_;
 };
 #endif
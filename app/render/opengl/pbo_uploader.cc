@@ -0,0 +1,517 @@
+#include "pbo_uploader.h"
+
+#include <QOpenGLContext>
+#include <algorithm>
+#include <chrono>
+
+#include "gl_call.h"
+#include "common/avdef.h"
+#include "util/frame_layout.h"
+#include "spdlog/spdlog.h"
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#define SLOT_WAIT_TIMEOUT_NS 50000000 // 50ms
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TILE_DIFF_SSE2
+#endif
+
+static int64_t ElapsedUs(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()
+                                                                 - start)
+        .count();
+}
+
+static bool SamePlane(const PboUploader::Plane& a, const PboUploader::Plane& b)
+{
+    return a.offset == b.offset && a.width == b.width && a.height == b.height
+           && a.bytes_per_pixel == b.bytes_per_pixel && a.format == b.format && a.type == b.type;
+}
+
+// Compare a tile of two planes row by row, stops at the first row that differs.
+static bool TileChanged(const uint8_t* a, const uint8_t* b, size_t stride, int bytes, int rows)
+{
+    for (int row = 0; row < rows; ++row, a += stride, b += stride) {
+        int i = 0;
+#ifdef TILE_DIFF_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i diff = zero;
+        for (; i + 16 <= bytes; i += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            diff = _mm_or_si128(diff, _mm_xor_si128(va, vb));
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero)) != 0xffff)
+            return true;
+#endif
+        if (i < bytes && memcmp(a + i, b + i, bytes - i) != 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void CopyTile(uint8_t* dst, const uint8_t* src, size_t stride, int bytes, int rows)
+{
+    for (int row = 0; row < rows; ++row, dst += stride, src += stride) {
+        memcpy(dst, src, bytes);
+    }
+}
+
+PboUploader::PboUploader()
+    : buffer_storage_(nullptr)
+    , inited_(false)
+    , persistent_(false)
+    , write_slot_(0)
+    , staged_slot_(-1)
+    , plane_count_(0)
+    , unpack_aligned_(false)
+    , dirty_tiles_(false)
+    , prev_valid_(false)
+    , gl_calls_(0)
+{
+    memset(slots_, 0, sizeof(slots_));
+    memset(planes_, 0, sizeof(planes_));
+}
+
+PboUploader::~PboUploader() {}
+
+bool PboUploader::Init()
+{
+    if (inited_)
+        return true;
+
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+    if (!ctx) {
+        SPDLOG_ERROR("No current OpenGL context for pbo uploader.");
+        return false;
+    }
+
+    initializeOpenGLFunctions();
+
+    QPair<int, int> version = ctx->format().version();
+    if (version >= qMakePair(4, 4) || ctx->hasExtension("GL_ARB_buffer_storage")) {
+        buffer_storage_ =
+            reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(ctx->getProcAddress("glBufferStorage"));
+    }
+    persistent_ = buffer_storage_ != nullptr;
+
+    SPDLOG_INFO("Pbo uploader slots: {0}, persistent mapped: {1}.", kSlotCount, persistent_);
+
+    inited_ = true;
+    return true;
+}
+
+void PboUploader::Release()
+{
+    if (!inited_)
+        return;
+
+    FreeSlots();
+
+    plane_count_ = 0;
+    unpack_aligned_ = false;
+    prev_valid_ = false;
+    inited_ = false;
+}
+
+void PboUploader::set_dirty_tiles(bool enable)
+{
+    dirty_tiles_ = enable;
+    prev_valid_ = false;
+
+    if (!enable) {
+        for (auto& prev : prev_) {
+            std::vector<uint8_t>().swap(prev);
+        }
+    }
+}
+
+int PboUploader::FramePlanes(int format, int width, int height, Plane* planes)
+{
+    FrameLayout layout;
+    if (!GetFrameLayout(format, width, height, &layout))
+        return 0;
+
+    int cw = layout.chroma_w;
+    int ch = layout.chroma_h;
+    switch (format) {
+    case PIX_FMT_IYUV:
+    case PIX_FMT_YUVJ422P:
+        planes[0] = {0, width, height, 1, GL_RED, GL_UNSIGNED_BYTE};
+        planes[1] = {layout.offset[1], cw, ch, 1, GL_RED, GL_UNSIGNED_BYTE};
+        planes[2] = {layout.offset[2], cw, ch, 1, GL_RED, GL_UNSIGNED_BYTE};
+        return 3;
+    case PIX_FMT_NV12:
+        planes[0] = {0, width, height, 1, GL_RED, GL_UNSIGNED_BYTE};
+        planes[1] = {layout.offset[1], cw, ch, 2, GL_RG, GL_UNSIGNED_BYTE};
+        return 2;
+    case PIX_FMT_P010:
+    case PIX_FMT_P016:
+        // Semi-planar like NV12 with 16-bit samples.
+        planes[0] = {0, width, height, 2, GL_RED, GL_UNSIGNED_SHORT};
+        planes[1] = {layout.offset[1], cw, ch, 4, GL_RG, GL_UNSIGNED_SHORT};
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+bool PboUploader::Stage(const DecodeFrame& frame)
+{
+    if (!inited_ || frame.IsNull())
+        return false;
+
+    Plane planes[kMaxPlanes];
+    int plane_count = FramePlanes(frame.format, frame.w, frame.h, planes);
+    if (plane_count == 0)
+        return false;
+
+    const Plane& last = planes[plane_count - 1];
+    if (frame.buf.len < last.offset + last.size()) {
+        SPDLOG_ERROR("Frame buffer is smaller than its layout, len: {0}.", frame.buf.len);
+        return false;
+    }
+
+    bool layout_changed = plane_count != plane_count_;
+    for (int i = 0; i < plane_count && !layout_changed; ++i) {
+        layout_changed = !SamePlane(planes[i], planes_[i]);
+    }
+
+    if (layout_changed && !Realloc(planes, plane_count))
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (dirty_tiles_ && DiffTiles(frame) == 0) {
+        ++stats_.skipped;
+        return false;
+    }
+
+    Slot& slot = slots_[write_slot_];
+    if (!WaitSlot(slot)) {
+        // The GPU may still read the slot, writing it would tear the upload.
+        ++stats_.dropped;
+        prev_valid_ = false;
+        return false;
+    }
+
+    if (dirty_tiles_) {
+        StageTiles(slot, frame);
+    } else {
+        for (int i = 0; i < plane_count_; ++i) {
+            uint8_t* dst = MapSlotPlane(slot, i);
+            if (dst) {
+                memcpy(dst, frame.buf.base + planes_[i].offset, planes_[i].size());
+                UnmapSlotPlane();
+            }
+        }
+    }
+
+    if (!persistent_) {
+        GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+    }
+
+    staged_slot_ = write_slot_;
+    write_slot_ = (write_slot_ + 1) % kSlotCount;
+
+    stats_.stage_us = ElapsedUs(start);
+    stats_.total_stage_us += stats_.stage_us;
+
+    return true;
+}
+
+bool PboUploader::Upload(const GLuint* textures)
+{
+    if (staged_slot_ < 0)
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    Slot& slot = slots_[staged_slot_];
+
+    if (!unpack_aligned_) {
+        GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+        unpack_aligned_ = true;
+    }
+
+    for (int i = 0; i < plane_count_; ++i) {
+        const Plane& plane = planes_[i];
+
+        // Plane i is left bound to unit i, which is where the renderer samples it from.
+        GL_CALL(glActiveTexture(GL_TEXTURE0 + i));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, textures[i]));
+        GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo[i]));
+
+        if (dirty_tiles_) {
+            UploadTiles(plane, i);
+            continue;
+        }
+
+        // Source is the bound PBO, the transfer is done by the driver asynchronously.
+        GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane.width, plane.height, plane.format,
+                                plane.type, nullptr));
+    }
+    GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+    slot.fence = GL_CALL(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    staged_slot_ = -1;
+
+    ++stats_.frames;
+    stats_.upload_us = ElapsedUs(start);
+    stats_.total_upload_us += stats_.upload_us;
+
+    return true;
+}
+
+bool PboUploader::Realloc(const Plane* planes, int plane_count)
+{
+    FreeSlots();
+
+    memcpy(planes_, planes, sizeof(Plane) * plane_count);
+    plane_count_ = plane_count;
+    prev_valid_ = false;
+
+    GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    for (auto& slot : slots_) {
+        glGenBuffers(plane_count_, slot.pbo);
+
+        for (int i = 0; i < plane_count_; ++i) {
+            GLsizeiptr size = static_cast<GLsizeiptr>(planes_[i].size());
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo[i]);
+            if (persistent_) {
+                buffer_storage_(GL_PIXEL_UNPACK_BUFFER, size, nullptr, map_flags);
+                slot.mapped[i] = static_cast<uint8_t*>(
+                    glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, map_flags));
+                if (!slot.mapped[i]) {
+                    SPDLOG_WARN("Failed to map pbo persistently, fallback to map per frame.");
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+                    persistent_ = false;
+                    return Realloc(planes, plane_count);
+                }
+            } else {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            }
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    return true;
+}
+
+void PboUploader::FreeSlots()
+{
+    for (auto& slot : slots_) {
+        if (slot.fence) {
+            glDeleteSync(slot.fence);
+        }
+
+        for (int i = 0; i < plane_count_; ++i) {
+            if (slot.mapped[i]) {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo[i]);
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (slot.pbo[0]) {
+            glDeleteBuffers(plane_count_, slot.pbo);
+        }
+    }
+
+    memset(slots_, 0, sizeof(slots_));
+    write_slot_ = 0;
+    staged_slot_ = -1;
+}
+
+bool PboUploader::WaitSlot(Slot& slot)
+{
+    if (!slot.fence)
+        return true;
+
+    GLenum ret = GL_CALL(glClientWaitSync(slot.fence, 0, 0));
+    if (ret == GL_TIMEOUT_EXPIRED) {
+        ++stats_.stalls;
+        ret = GL_CALL(
+            glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, SLOT_WAIT_TIMEOUT_NS));
+    }
+    if (ret != GL_ALREADY_SIGNALED && ret != GL_CONDITION_SATISFIED) {
+        // Kept, the slot is waited again with the next frame.
+        return false;
+    }
+
+    GL_CALL(glDeleteSync(slot.fence));
+    slot.fence = nullptr;
+
+    return true;
+}
+
+uint8_t* PboUploader::MapSlotPlane(Slot& slot, int i)
+{
+    if (persistent_)
+        return slot.mapped[i];
+
+    GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo[i]));
+    // The slot fence has been waited, the previous contents can be dropped without syncing.
+    void* dst = GL_CALL(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, planes_[i].size(),
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+                                             | GL_MAP_UNSYNCHRONIZED_BIT));
+    return static_cast<uint8_t*>(dst);
+}
+
+void PboUploader::UnmapSlotPlane()
+{
+    if (!persistent_) {
+        GL_CALL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+    }
+}
+
+int PboUploader::DiffTiles(const DecodeFrame& frame)
+{
+    for (int i = 0; i < plane_count_; ++i) {
+        if (prev_[i].size() != planes_[i].size()) {
+            prev_[i].resize(planes_[i].size());
+            prev_valid_ = false;
+        }
+    }
+
+    int dirty_count = 0;
+    for (int i = 0; i < plane_count_; ++i) {
+        const Plane& plane = planes_[i];
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(frame.buf.base) + plane.offset;
+        const uint8_t* prev = prev_[i].data();
+        size_t stride = static_cast<size_t>(plane.width) * plane.bytes_per_pixel;
+
+        int tiles_x = (plane.width + kTileSize - 1) / kTileSize;
+        int tiles_y = (plane.height + kTileSize - 1) / kTileSize;
+        int tiles = tiles_x * tiles_y;
+
+        std::vector<uint8_t>& dirty = dirty_[i];
+        dirty.assign(tiles, prev_valid_ ? 0 : 1);
+        int plane_dirty = prev_valid_ ? 0 : tiles;
+
+        for (int ty = 0; ty < tiles_y && prev_valid_; ++ty) {
+            int rows = qMin<int>(kTileSize, plane.height - ty * kTileSize);
+            for (int tx = 0; tx < tiles_x; ++tx) {
+                int bytes =
+                    qMin<int>(kTileSize, plane.width - tx * kTileSize) * plane.bytes_per_pixel;
+                size_t offset = ty * kTileSize * stride + tx * kTileSize * plane.bytes_per_pixel;
+                if (TileChanged(src + offset, prev + offset, stride, bytes, rows)) {
+                    dirty[ty * tiles_x + tx] = 1;
+                    ++plane_dirty;
+                }
+            }
+        }
+
+        // Past half of the plane one transfer is cheaper than many small ones.
+        if (plane_dirty * 2 > tiles) {
+            std::fill(dirty.begin(), dirty.end(), 1);
+            plane_dirty = tiles;
+        }
+
+        stats_.tiles += tiles;
+        stats_.dirty_tiles += plane_dirty;
+        dirty_count += plane_dirty;
+    }
+
+    return dirty_count;
+}
+
+void PboUploader::StageTiles(Slot& slot, const DecodeFrame& frame)
+{
+    for (int i = 0; i < plane_count_; ++i) {
+        const Plane& plane = planes_[i];
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(frame.buf.base) + plane.offset;
+        uint8_t* prev = prev_[i].data();
+        const std::vector<uint8_t>& dirty = dirty_[i];
+
+        if (std::find(dirty.begin(), dirty.end(), 1) == dirty.end())
+            continue;
+
+        // Only the dirty tiles of the slot are written, they are all that Upload() reads.
+        uint8_t* dst = MapSlotPlane(slot, i);
+        if (!dst)
+            continue;
+
+        if (std::find(dirty.begin(), dirty.end(), 0) == dirty.end()) {
+            memcpy(dst, src, plane.size());
+            memcpy(prev, src, plane.size());
+        } else {
+            size_t stride = static_cast<size_t>(plane.width) * plane.bytes_per_pixel;
+            int tiles_x = (plane.width + kTileSize - 1) / kTileSize;
+            for (size_t t = 0; t < dirty.size(); ++t) {
+                if (!dirty[t])
+                    continue;
+
+                int tx = static_cast<int>(t) % tiles_x;
+                int ty = static_cast<int>(t) / tiles_x;
+                int rows = qMin<int>(kTileSize, plane.height - ty * kTileSize);
+                int bytes =
+                    qMin<int>(kTileSize, plane.width - tx * kTileSize) * plane.bytes_per_pixel;
+                size_t offset = ty * kTileSize * stride + tx * kTileSize * plane.bytes_per_pixel;
+                CopyTile(dst + offset, src + offset, stride, bytes, rows);
+                CopyTile(prev + offset, src + offset, stride, bytes, rows);
+            }
+        }
+
+        UnmapSlotPlane();
+    }
+
+    prev_valid_ = true;
+}
+
+void PboUploader::UploadTiles(const Plane& plane, int i)
+{
+    const std::vector<uint8_t>& dirty = dirty_[i];
+
+    if (std::find(dirty.begin(), dirty.end(), 0) == dirty.end()) {
+        GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane.width, plane.height, plane.format,
+                                plane.type, nullptr));
+        return;
+    }
+    if (std::find(dirty.begin(), dirty.end(), 1) == dirty.end())
+        return;
+
+    size_t stride = static_cast<size_t>(plane.width) * plane.bytes_per_pixel;
+    int tiles_x = (plane.width + kTileSize - 1) / kTileSize;
+    int tiles_y = static_cast<int>(dirty.size()) / tiles_x;
+
+    GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, plane.width));
+
+    // One call per horizontal run of dirty tiles.
+    for (int ty = 0; ty < tiles_y; ++ty) {
+        int y = ty * kTileSize;
+        int rows = qMin<int>(kTileSize, plane.height - y);
+
+        int tx = 0;
+        while (tx < tiles_x) {
+            if (!dirty[ty * tiles_x + tx]) {
+                ++tx;
+                continue;
+            }
+
+            int run = tx;
+            while (tx < tiles_x && dirty[ty * tiles_x + tx]) {
+                ++tx;
+            }
+
+            int x = run * kTileSize;
+            int w = qMin<int>(tx * kTileSize, plane.width) - x;
+            size_t offset = y * stride + x * plane.bytes_per_pixel;
+            GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, rows, plane.format, plane.type,
+                                    reinterpret_cast<const void*>(offset)));
+        }
+    }
+
+    GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+}
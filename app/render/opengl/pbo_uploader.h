@@ -0,0 +1,136 @@
+#ifndef PBO_UPLOADER_H_
+#define PBO_UPLOADER_H_
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <vector>
+
+#include "util/decode_frame.h"
+
+struct UploadStats
+{
+    uint64_t frames = 0;
+    uint64_t stalls = 0;   // Waited for the GPU to release a PBO slot.
+    uint64_t dropped = 0;  // The GPU held the slot past the timeout, the frame was not staged.
+    int64_t stage_us = 0;  // Last copy into the mapped PBO.
+    int64_t upload_us = 0; // Last glTexSubImage2D submission.
+    int64_t total_stage_us = 0;
+    int64_t total_upload_us = 0;
+
+    // Dirty tile mode only
+    uint64_t skipped = 0; // Identical to the previous frame, nothing uploaded.
+    uint64_t tiles = 0;
+    uint64_t dirty_tiles = 0;
+};
+
+/**
+ * @brief Streams decoded frames to textures through a ring of pixel buffer objects.
+ *
+ * Stage() copies a frame into the next free PBO and Upload() updates the plane textures from
+ * it with glTexSubImage2D, so the driver does the transfer asynchronously while the previous
+ * frame is drawn. Buffers are persistently mapped when GL_ARB_buffer_storage is available.
+ * Upload() leaves plane i bound to texture unit i. All calls require the owning context to be
+ * current.
+ *
+ * In dirty tile mode every plane is compared against the previous frame in fixed tiles, and only
+ * the changed tiles are staged and uploaded. Frames identical to the previous one are skipped.
+ */
+class PboUploader : protected QOpenGLFunctions_3_3_Core
+{
+public:
+    enum
+    {
+        kMaxPlanes = 3,
+        kSlotCount = 3,
+        kTileSize = 64 // In pixels of each plane
+    };
+
+    struct Plane
+    {
+        size_t offset; // Offset in DecodeFrame::buf
+        int width;
+        int height;
+        int bytes_per_pixel;
+        GLenum format;
+        GLenum type;
+
+        size_t size() const { return static_cast<size_t>(width) * height * bytes_per_pixel; }
+    };
+
+    PboUploader();
+    ~PboUploader();
+
+    bool Init();
+    void Release();
+
+    /**
+     * @brief Get the plane layout of a tightly packed DecodeFrame.
+     *
+     * @return Number of planes, 0 if the format is not supported.
+     */
+    static int FramePlanes(int format, int width, int height, Plane* planes);
+
+    /**
+     * @return False if there is nothing to upload, e.g. an identical frame in dirty tile mode.
+     */
+    bool Stage(const DecodeFrame& frame);
+    bool Upload(const GLuint* textures);
+
+    void set_dirty_tiles(bool enable);
+    bool dirty_tiles() const { return dirty_tiles_; }
+
+    /**
+     * @brief Upload the next frame completely, e.g. after the textures were reallocated.
+     */
+    void InvalidateTiles() { prev_valid_ = false; }
+
+    bool persistent() const { return persistent_; }
+    const UploadStats& stats() const { return stats_; }
+
+    uint32_t gl_calls() const { return gl_calls_; }
+    void reset_gl_calls() { gl_calls_ = 0; }
+
+private:
+    struct Slot
+    {
+        GLuint pbo[kMaxPlanes];
+        uint8_t* mapped[kMaxPlanes];
+        GLsync fence;
+    };
+
+    bool Realloc(const Plane* planes, int plane_count);
+    void FreeSlots();
+    bool WaitSlot(Slot& slot);
+    uint8_t* MapSlotPlane(Slot& slot, int i);
+    // Unmaps the buffer MapSlotPlane bound, only after it returned a mapping.
+    void UnmapSlotPlane();
+
+    int DiffTiles(const DecodeFrame& frame);
+    void StageTiles(Slot& slot, const DecodeFrame& frame);
+    void UploadTiles(const Plane& plane, int i);
+
+private:
+    PFNGLBUFFERSTORAGEPROC buffer_storage_;
+
+    bool inited_;
+    bool persistent_;
+
+    Slot slots_[kSlotCount];
+    int write_slot_;
+    int staged_slot_;
+
+    Plane planes_[kMaxPlanes];
+    int plane_count_;
+
+    bool unpack_aligned_;
+
+    // Dirty tile mode
+    bool dirty_tiles_;
+    bool prev_valid_;
+    std::vector<uint8_t> prev_[kMaxPlanes]; // Last uploaded contents of each plane
+    std::vector<uint8_t> dirty_[kMaxPlanes]; // Per tile of the staged frame, row major
+
+    UploadStats stats_;
+    uint32_t gl_calls_;
+};
+
+#endif
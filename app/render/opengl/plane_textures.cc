@@ -0,0 +1,150 @@
+#include "plane_textures.h"
+
+#include <QOpenGLContext>
+
+#include "gl_call.h"
+#include "spdlog/spdlog.h"
+
+// Grow by a quarter, so that small resolution changes of a stream do not reallocate.
+#define TEX_HEADROOM(x) ((x) + (x) / 4)
+#define TEX_ALIGN(x, a) (((x) + (a)-1) / (a) * (a))
+
+PlaneTextures::PlaneTextures()
+    : tex_storage_(nullptr)
+    , inited_(false)
+    , plane_count_(0)
+    , cap_w_(0)
+    , cap_h_(0)
+    , content_scale_(1.0f, 1.0f)
+    , content_clamp_(1.0f, 1.0f)
+    , gl_calls_(0)
+{
+    memset(textures_, 0, sizeof(textures_));
+    memset(internal_formats_, 0, sizeof(internal_formats_));
+}
+
+PlaneTextures::~PlaneTextures() {}
+
+bool PlaneTextures::Init()
+{
+    if (inited_)
+        return true;
+
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+    if (!ctx) {
+        SPDLOG_ERROR("No current OpenGL context for plane textures.");
+        return false;
+    }
+
+    initializeOpenGLFunctions();
+
+    QPair<int, int> version = ctx->format().version();
+    if (version >= qMakePair(4, 2) || ctx->hasExtension("GL_ARB_texture_storage")) {
+        tex_storage_ =
+            reinterpret_cast<PFNGLTEXSTORAGE2DPROC>(ctx->getProcAddress("glTexStorage2D"));
+    }
+    if (!tex_storage_) {
+        SPDLOG_WARN("glTexStorage2D is unavailable, textures will use mutable storage.");
+    }
+
+    inited_ = true;
+    return true;
+}
+
+void PlaneTextures::Release()
+{
+    if (!inited_)
+        return;
+
+    Free();
+    inited_ = false;
+}
+
+bool PlaneTextures::Reserve(const PboUploader::Plane* planes, int plane_count)
+{
+    if (!inited_ || plane_count <= 0)
+        return false;
+
+    int w = planes[0].width;
+    int h = planes[0].height;
+
+    bool realloc = plane_count != plane_count_ || w > cap_w_ || h > cap_h_;
+    for (int i = 0; i < plane_count && !realloc; ++i) {
+        realloc = InternalFormat(planes[i]) != internal_formats_[i];
+    }
+
+    if (realloc) {
+        Alloc(planes, plane_count, TEX_ALIGN(TEX_HEADROOM(w), 64), TEX_ALIGN(TEX_HEADROOM(h), 16));
+    }
+
+    content_scale_ = QVector2D(static_cast<float>(w) / cap_w_, static_cast<float>(h) / cap_h_);
+
+    // Keep linear filtering away from the texels behind the content of the coarsest plane.
+    content_clamp_ = content_scale_;
+    for (int i = 0; i < plane_count; ++i) {
+        int plane_cap_w = cap_w_ * planes[i].width / w;
+        int plane_cap_h = cap_h_ * planes[i].height / h;
+        content_clamp_.setX(qMin(content_clamp_.x(), (planes[i].width - 0.5f) / plane_cap_w));
+        content_clamp_.setY(qMin(content_clamp_.y(), (planes[i].height - 0.5f) / plane_cap_h));
+    }
+
+    return realloc;
+}
+
+void PlaneTextures::Alloc(const PboUploader::Plane* planes, int plane_count, int cap_w, int cap_h)
+{
+    Free();
+
+    cap_w_ = cap_w;
+    cap_h_ = cap_h;
+    plane_count_ = plane_count;
+
+    GL_CALL(glGenTextures(plane_count_, textures_));
+    for (int i = 0; i < plane_count_; ++i) {
+        const PboUploader::Plane& plane = planes[i];
+        int plane_cap_w = cap_w_ * plane.width / planes[0].width;
+        int plane_cap_h = cap_h_ * plane.height / planes[0].height;
+
+        internal_formats_[i] = InternalFormat(plane);
+
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, textures_[i]));
+        // Single level, so plain linear filtering makes the texture complete.
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+
+        if (tex_storage_) {
+            GL_CALL(tex_storage_(GL_TEXTURE_2D, 1, internal_formats_[i], plane_cap_w, plane_cap_h));
+        } else {
+            GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, internal_formats_[i], plane_cap_w, plane_cap_h, 0,
+                                 plane.format, plane.type, nullptr));
+        }
+    }
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+
+    SPDLOG_INFO("Alloc plane textures count: {0}, storage: [{1}x{2}], frame: [{3}x{4}].",
+                plane_count_, cap_w_, cap_h_, planes[0].width, planes[0].height);
+}
+
+void PlaneTextures::Free()
+{
+    if (plane_count_ > 0) {
+        GL_CALL(glDeleteTextures(plane_count_, textures_));
+    }
+
+    memset(textures_, 0, sizeof(textures_));
+    memset(internal_formats_, 0, sizeof(internal_formats_));
+    plane_count_ = 0;
+    cap_w_ = 0;
+    cap_h_ = 0;
+}
+
+GLenum PlaneTextures::InternalFormat(const PboUploader::Plane& plane)
+{
+    if (plane.type == GL_UNSIGNED_SHORT)
+        return plane.format == GL_RG ? GL_RG16 : GL_R16;
+
+    return plane.format == GL_RG ? GL_RG8 : GL_R8;
+}
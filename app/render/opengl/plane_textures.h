@@ -0,0 +1,66 @@
+#ifndef PLANE_TEXTURES_H_
+#define PLANE_TEXTURES_H_
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector2D>
+
+#include "pbo_uploader.h"
+
+/**
+ * @brief Immutable textures for the planes of a video frame.
+ *
+ * Storage is allocated once with glTexStorage2D and some growth headroom, a frame that fits in
+ * the current storage only updates the content size. Renderers sample the valid region through
+ * content_scale() and content_clamp().
+ */
+class PlaneTextures : protected QOpenGLFunctions_3_3_Core
+{
+public:
+    PlaneTextures();
+    ~PlaneTextures();
+
+    bool Init();
+    void Release();
+
+    /**
+     * @brief Make sure the storage can hold the planes, reallocate only if it can not.
+     *
+     * @return True if the textures were (re)allocated.
+     */
+    bool Reserve(const PboUploader::Plane* planes, int plane_count);
+
+    const GLuint* ids() const { return textures_; }
+    int count() const { return plane_count_; }
+    bool valid() const { return plane_count_ > 0; }
+
+    QVector2D content_scale() const { return content_scale_; }
+    QVector2D content_clamp() const { return content_clamp_; }
+
+    uint32_t gl_calls() const { return gl_calls_; }
+    void reset_gl_calls() { gl_calls_ = 0; }
+
+private:
+    void Alloc(const PboUploader::Plane* planes, int plane_count, int cap_w, int cap_h);
+    void Free();
+
+    static GLenum InternalFormat(const PboUploader::Plane& plane);
+
+private:
+    PFNGLTEXSTORAGE2DPROC tex_storage_;
+    bool inited_;
+
+    GLuint textures_[PboUploader::kMaxPlanes];
+    GLenum internal_formats_[PboUploader::kMaxPlanes];
+    int plane_count_;
+
+    // Luma storage size, chroma storage is derived by the plane subsampling.
+    int cap_w_;
+    int cap_h_;
+
+    QVector2D content_scale_;
+    QVector2D content_clamp_;
+
+    uint32_t gl_calls_;
+};
+
+#endif
@@ -2,171 +2,158 @@
 
 #include <QOpenGLShaderProgram>
 
-#include "common/avdef.h"
+#include "common/singleton.h"
+#include "config/config.h"
 #include "spdlog/spdlog.h"
+#include "util/trace.h"
 
 RenderWndGL::RenderWndGL(QWidget* parent)
     : QOpenGLWidget(parent)
-    , format_(0)
+    , provider_fps_(0)
 {}
 
-RenderWndGL::~RenderWndGL() {}
-
-void RenderWndGL::Render(const DecodeFrame& frame)
+RenderWndGL::~RenderWndGL()
 {
-    if (frame.w == 0 || frame.h == 0)
-        return;
+    // Joins the thread, which frees its GL resources in its own context.
+    render_thread_.reset();
 
-    int tex_width = frame.w;
-    int tex_height = frame.h;
+    if (isValid()) {
+        // The context is destroyed after this, do not run the handler on a destroyed widget.
+        disconnect(context(), &QOpenGLContext::aboutToBeDestroyed, this, nullptr);
 
-    format_ = frame.format;
-    switch (format_) {
-    case PIX_FMT_IYUV: {
-        tex_width /= 2;
-        tex_height /= 2;
-        ResetTexYuv(frame, tex_width, tex_height);
-        break;
-    }
-    case PIX_FMT_YUVJ422P: {
-        tex_width = tex_width / 2;
-        ResetTexYuv(frame, tex_width, tex_height);
-        break;
-    }
-    case PIX_FMT_NV12: {
-        ResetTexNV12(frame);
-        break;
-    }
-    default:
-        break;
+        makeCurrent();
+        ReleaseCompositor();
+        doneCurrent();
     }
-
-    update();
 }
 
-void RenderWndGL::initializeGL()
+void RenderWndGL::Render(const DecodeFrame& frame)
 {
-    auto shader_program = std::make_shared<QOpenGLShaderProgram>();
-    shader_program->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/res/shaders/yuv2rgb.vert");
-    shader_program->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/res/shaders/yuv2rgb.frag");
-    if (!shader_program->link()) {
-        SPDLOG_ERROR(shader_program->log().toStdString());
-    }
+    TRACE_SCOPE("render.submit");
 
-    if (!renderer_) {
-        renderer_ = std::make_shared<OpenGLRenderer>(shader_program);
-    }
+    if (frame.w == 0 || frame.h == 0)
+        return;
 
-    initializeOpenGLFunctions();
+    if (render_thread_) {
+        render_thread_->Submit(frame);
+    }
 }
 
-void RenderWndGL::resizeGL(int w, int h)
+bool RenderWndGL::StartPresent(const FrameProvider& provider, int fps)
 {
-    QOpenGLWidget::resizeGL(w, h);
+    if (!render_thread_) {
+        // Not shown yet, the render thread takes the provider once initializeGL creates it.
+        provider_ = provider;
+        provider_fps_ = fps;
+        return true;
+    }
 
-    renderer_->SetSize(QVector2D(w, h));
+    render_thread_->SetFrameProvider(provider, fps);
+    return true;
 }
 
-void RenderWndGL::paintGL()
+void RenderWndGL::StopPresent()
 {
-    switch (format_) {
-    case PIX_FMT_IYUV:
-    case PIX_FMT_YUVJ422P: {
-        renderer_->Draw(y_tex_, u_tex_, v_tex_, format_, QVector2D(width(), height()));
-        break;
-    }
-    case PIX_FMT_NV12: {
-        renderer_->Draw(y_tex_, uv_tex_, format_, QVector2D(width(), height()));
-        break;
-    }
-    default:
-        break;
+    provider_ = nullptr;
+    provider_fps_ = 0;
+
+    if (render_thread_) {
+        render_thread_->ClearFrameProvider();
     }
 }
 
-void RenderWndGL::ReallocTex(QOpenGLTexturePtr tex, int type, int width, int height, int depth)
+bool RenderWndGL::UploadTotals(uint64_t* frames, int64_t* us) const
 {
-    tex->setSize(width, height);
-    tex->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear, QOpenGLTexture::Linear);
-    tex->setFormat(static_cast<QOpenGLTexture::TextureFormat>(type));
-    tex->allocateStorage();
+    if (!render_thread_)
+        return false;
+
+    *frames = render_thread_->uploaded_frames();
+    *us = render_thread_->upload_us();
+    return true;
 }
 
-void RenderWndGL::ResetTexYuv(const DecodeFrame& frame, int width, int height)
+void RenderWndGL::initializeGL()
 {
-    if (frame.w != frame_size_.width() || frame.h != frame_size_.height()) {
-        FreeTexYuv();
-    }
+    initializeOpenGLFunctions();
 
-    if (!y_tex_) {
-        y_tex_ = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2D);
-        ReallocTex(y_tex_, QOpenGLTexture::R8_UNorm, frame.w, frame.h);
-    }
-    if (!u_tex_) {
-        u_tex_ = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2D);
-        ReallocTex(u_tex_, QOpenGLTexture::R8_UNorm, width, height);
+    auto shader_program = std::make_shared<QOpenGLShaderProgram>();
+    shader_program->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/res/shaders/sprite.vert");
+    shader_program->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/res/shaders/sprite.frag");
+    if (!shader_program->link()) {
+        SPDLOG_ERROR(shader_program->log().toStdString());
     }
-    if (!v_tex_) {
-        v_tex_ = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2D);
-        ReallocTex(v_tex_, QOpenGLTexture::R8_UNorm, width, height);
+    compositor_.reset(new OpenGLRenderer(shader_program));
+
+    // A reparented widget gets a new context, its vao must go with the old one.
+    connect(context(), &QOpenGLContext::aboutToBeDestroyed, this, [this] {
+        makeCurrent();
+        ReleaseCompositor();
+        doneCurrent();
+    });
+
+    if (!render_thread_) {
+        // Shared with every widget context when Qt::AA_ShareOpenGLContexts is set, so frames
+        // survive the widget being reparented.
+        QOpenGLContext* share_context = QOpenGLContext::globalShareContext();
+        if (!share_context) {
+            share_context = context();
+        }
+
+        render_thread_.reset(new GLRenderThread(share_context));
+        bool dirty_tiles = Singleton<Config>::Instance()
+                           ->AppConfigData("video_param", "dirty_tile_upload", false)
+                           .toBool();
+        render_thread_->set_dirty_tiles(dirty_tiles);
+        render_thread_->set_frame_ready_cb(
+            [this] { QMetaObject::invokeMethod(this, "update", Qt::QueuedConnection); });
+        render_thread_->Resize(size() * devicePixelRatioF());
+        render_thread_->Launch();
+
+        if (provider_) {
+            render_thread_->SetFrameProvider(provider_, provider_fps_);
+            provider_ = nullptr;
+        }
     }
-
-    frame_size_.setWidth(frame.w);
-    frame_size_.setHeight(frame.h);
-
-    pix_transfer_opts_.setImageHeight(frame.h);
-
-    int y_size = frame.w * frame.h;
-
-    pix_transfer_opts_.setRowLength(frame.w);
-    y_tex_->setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, frame.buf.base, &pix_transfer_opts_);
-
-    pix_transfer_opts_.setRowLength(frame.w / 2);
-    u_tex_->setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, frame.buf.base + y_size,
-                    &pix_transfer_opts_);
-
-    pix_transfer_opts_.setRowLength(frame.w / 2);
-    v_tex_->setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8,
-                    frame.buf.base + y_size + y_size / 4, &pix_transfer_opts_);
 }
 
-void RenderWndGL::ResetTexNV12(const DecodeFrame& frame)
+void RenderWndGL::resizeGL(int w, int h)
 {
-    if (frame.w != frame_size_.width() || frame.h != frame_size_.height()) {
-        FreeTexNV12();
-    }
+    QOpenGLWidget::resizeGL(w, h);
 
-    if (!y_tex_) {
-        y_tex_ = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2D);
-        ReallocTex(y_tex_, QOpenGLTexture::R8_UNorm, frame.w, frame.h);
+    if (compositor_) {
+        compositor_->SetSize(QVector2D(w, h));
     }
-    if (!uv_tex_) {
-        uv_tex_ = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2D);
-        ReallocTex(uv_tex_, QOpenGLTexture::RG8_UNorm, frame.w / 2, frame.h / 2);
+    if (render_thread_) {
+        render_thread_->Resize(size() * devicePixelRatioF());
     }
+}
+
+void RenderWndGL::paintGL()
+{
+    TRACE_SCOPE("paint");
 
-    frame_size_.setWidth(frame.w);
-    frame_size_.setHeight(frame.h);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-    pix_transfer_opts_.setImageHeight(frame.h);
-    pix_transfer_opts_.setRowLength(frame.w);
-    y_tex_->setData(QOpenGLTexture::Red, QOpenGLTexture::UInt8, frame.buf.base, &pix_transfer_opts_);
+    GLuint texture = 0;
+    GLsync ready = nullptr;
+    if (!compositor_ || !render_thread_ || !render_thread_->AcquireFrame(&texture, &ready))
+        return;
 
-    // pix_transfer_opts_.setImageHeight(frame.h/ 2);
-    // pix_transfer_opts_.setRowLength(frame.linesize[1] / 2); // uv interleaved
+    if (ready) {
+        glWaitSync(ready, 0, GL_TIMEOUT_IGNORED);
+    }
 
-    // uv_tex_->setData(QOpenGLTexture::RG, QOpenGLTexture::UInt8, frame.data[1], &pix_transfer_opts_);
-}
+    // Fbo textures are bottom-up, flip them while drawing over the widget.
+    TRACE_SCOPE("paint.composite");
+    compositor_->Draw(texture, QVector2D(0.0f, height()), QVector2D(width(), -height()));
 
-void RenderWndGL::FreeTexYuv()
-{
-    y_tex_.reset();
-    u_tex_.reset();
-    v_tex_.reset();
+    GLsync released = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    render_thread_->ReleaseFrame(released);
 }
 
-void RenderWndGL::FreeTexNV12()
+void RenderWndGL::ReleaseCompositor()
 {
-    y_tex_.reset();
-    uv_tex_.reset();
+    compositor_.reset();
 }
@@ -2,22 +2,24 @@
 #define RENDER_WND_GL_H_
 
 #include <QMenu>
-#include <QOpenGLFunctions>
-#include <QOpenGLPixelTransferOptions>
-#include <QOpenGLTexture>
+#include <QOpenGLFunctions_3_3_Core>
 #include <QOpenGLWidget>
 #include <QTimer>
 #include <QWidget>
 #include <memory>
-#include <mutex>
 
+#include "gl_render_thread.h"
 #include "opengl_renderer.h"
 #include "render/render_wnd.h"
 #include "util/decode_frame.h"
 
-using QOpenGLTexturePtr = std::shared_ptr<QOpenGLTexture>;
-
-class RenderWndGL : public RenderWnd, public QOpenGLWidget, protected QOpenGLFunctions
+/**
+ * @brief OpenGL render window, frames are uploaded and drawn by a GLRenderThread.
+ *
+ * The widget only composites the latest frame of the render thread, so playback does not depend
+ * on the GUI thread being responsive.
+ */
+class RenderWndGL : public RenderWnd, public QOpenGLWidget, protected QOpenGLFunctions_3_3_Core
 {
 public:
     explicit RenderWndGL(QWidget* parent = nullptr);
@@ -32,27 +34,23 @@ protected:
     void setGeometry(const QRect& rect) override { QOpenGLWidget::setGeometry(rect); }
     void update() override { QOpenGLWidget::update(); }
 
-private:
-    void ReallocTex(QOpenGLTexturePtr tex, int type, int width, int height = 1, int depth = 1);
-    void ResetTexYuv(const DecodeFrame& frame, int width, int height);
-    void ResetTexNV12(const DecodeFrame& frame);
-    void FreeTexYuv();
-    void FreeTexNV12();
+    bool StartPresent(const FrameProvider& provider, int fps) override;
+    void StopPresent() override;
+
+    bool UploadTotals(uint64_t* frames, int64_t* us) const override;
 
 private:
-    std::shared_ptr<OpenGLRenderer> renderer_;
+    void ReleaseCompositor();
 
-    std::mutex mutex_;
+private:
+    // Owned by the widget context, recreated when the widget is reparented.
+    std::unique_ptr<OpenGLRenderer> compositor_;
 
-    QSize frame_size_;
-    int format_;
-    QOpenGLPixelTransferOptions pix_transfer_opts_;
-    std::shared_ptr<QOpenGLTexture> y_tex_;
-    std::shared_ptr<QOpenGLTexture> u_tex_;
-    std::shared_ptr<QOpenGLTexture> v_tex_;
-    std::shared_ptr<QOpenGLTexture> uv_tex_;
+    std::unique_ptr<GLRenderThread> render_thread_;
 
-    quint32 vao_;
+    // Presentation started before the render thread exists.
+    FrameProvider provider_;
+    int provider_fps_;
 };
 
 #endif
@@ -0,0 +1,50 @@
+#include "render_wnd_gl_window.h"
+
+RenderWndGLWindow::RenderWndGLWindow(QWidget* parent)
+    : QWidget(parent)
+{
+    setStyleSheet("QWidget {background: black;}");
+
+    window_ = new VideoGLWindow(this);
+    container_ = QWidget::createWindowContainer(window_, this);
+    container_->setGeometry(rect());
+}
+
+RenderWndGLWindow::~RenderWndGLWindow() {}
+
+void RenderWndGLWindow::Render(const DecodeFrame& frame)
+{
+    if (frame.IsNull())
+        return;
+
+    window_->Submit(frame);
+}
+
+void RenderWndGLWindow::update()
+{
+    window_->update();
+}
+
+bool RenderWndGLWindow::StartPresent(const FrameProvider& provider, int fps)
+{
+    // Paced by the display refresh, the pts of the frames decide what is shown.
+    window_->SetFrameProvider(provider);
+    return true;
+}
+
+void RenderWndGLWindow::StopPresent()
+{
+    window_->ClearFrameProvider();
+}
+
+void RenderWndGLWindow::SetRate(double rate)
+{
+    window_->SetRate(rate);
+}
+
+void RenderWndGLWindow::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+
+    container_->setGeometry(rect());
+}
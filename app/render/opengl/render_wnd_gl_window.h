@@ -0,0 +1,40 @@
+#ifndef RENDER_WND_GL_WINDOW_H_
+#define RENDER_WND_GL_WINDOW_H_
+
+#include <QWidget>
+
+#include "video_gl_window.h"
+#include "render/render_wnd.h"
+#include "util/decode_frame.h"
+
+/**
+ * @brief Render window hosting a VideoGLWindow through createWindowContainer.
+ *
+ * Frames go straight to the window surface instead of a QOpenGLWidget fbo that Qt composites
+ * again, and presentation is paced by frameSwapped rather than a timer.
+ */
+class RenderWndGLWindow : public RenderWnd, public QWidget
+{
+public:
+    explicit RenderWndGLWindow(QWidget* parent = nullptr);
+    ~RenderWndGLWindow();
+
+    const JudderStats& judder_stats() const { return window_->judder_stats(); }
+
+protected:
+    void Render(const DecodeFrame& frame) override;
+    void setGeometry(const QRect& rect) override { QWidget::setGeometry(rect); }
+    void update() override;
+
+    bool StartPresent(const FrameProvider& provider, int fps) override;
+    void StopPresent() override;
+    void SetRate(double rate) override;
+
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    VideoGLWindow* window_; // Owned by container_
+    QWidget* container_;
+};
+
+#endif
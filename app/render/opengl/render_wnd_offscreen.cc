@@ -0,0 +1,134 @@
+#include "render_wnd_offscreen.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+
+#include "common/singleton.h"
+#include "config/config.h"
+#include "spdlog/spdlog.h"
+
+extern "C"
+{
+#include "libavutil/adler32.h"
+}
+
+#define OFFSCREEN_REPORT_INTERVAL 1000 // ms
+#define OFFSCREEN_BUDGET_EXIT 2         // Exit code of a frame over the gl call budget
+
+RenderWndOffscreen::RenderWndOffscreen(QWidget* parent)
+    : QWidget(parent)
+    , frames_(0)
+    , blank_frames_(0)
+    , checksum_(1)
+    , over_budget_frames_(0)
+    , start_time_(0)
+    , report_time_(0)
+    , report_frames_(0)
+{
+    setStyleSheet("QWidget {background: black;}");
+
+    gl_call_budget_ = Singleton<Config>::Instance()
+                      ->AppConfigData("video_param", "gl_call_budget", 0)
+                      .toUInt();
+
+    render_thread_.reset(new GLRenderThread(nullptr));
+    bool dirty_tiles = Singleton<Config>::Instance()
+                       ->AppConfigData("video_param", "dirty_tile_upload", false)
+                       .toBool();
+    render_thread_->set_dirty_tiles(dirty_tiles);
+    // Not through render_thread_, which is already null while the thread is joined.
+    GLRenderThread* thread = render_thread_.get();
+    render_thread_->set_readback_cb([this, thread](const uint8_t* pixels, int w, int h) {
+        OnReadback(pixels, w, h, thread->frame_gl_calls());
+    });
+    render_thread_->Resize(size());
+    render_thread_->Launch();
+}
+
+RenderWndOffscreen::~RenderWndOffscreen()
+{
+    render_thread_.reset();
+
+    Report(true);
+}
+
+void RenderWndOffscreen::Render(const DecodeFrame& frame)
+{
+    if (frame.IsNull())
+        return;
+
+    render_thread_->Submit(frame);
+}
+
+bool RenderWndOffscreen::StartPresent(const FrameProvider& provider, int fps)
+{
+    render_thread_->SetFrameProvider(provider, fps);
+    return true;
+}
+
+void RenderWndOffscreen::StopPresent()
+{
+    render_thread_->ClearFrameProvider();
+}
+
+void RenderWndOffscreen::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+
+    render_thread_->Resize(size());
+}
+
+void RenderWndOffscreen::OnReadback(const uint8_t* pixels, int w, int h, uint32_t gl_calls)
+{
+    if (gl_call_budget_ > 0 && gl_calls > gl_call_budget_ && over_budget_frames_++ == 0) {
+        SPDLOG_ERROR("Offscreen frame took {0} gl calls, over the budget of {1}.", gl_calls,
+                     gl_call_budget_);
+        QMetaObject::invokeMethod(
+            QCoreApplication::instance(), [] { QCoreApplication::exit(OFFSCREEN_BUDGET_EXIT); },
+            Qt::QueuedConnection);
+    }
+
+    size_t size = static_cast<size_t>(w) * h * 4;
+
+    // Rgb of every pixel is zero if nothing reached the framebuffer.
+    bool blank = true;
+    for (size_t i = 0; i < size && blank; i += 4) {
+        blank = (pixels[i] | pixels[i + 1] | pixels[i + 2]) == 0;
+    }
+    if (blank) {
+        ++blank_frames_;
+    }
+
+    if (frames_ == 0) {
+        start_time_ = QDateTime::currentMSecsSinceEpoch();
+        report_time_ = start_time_;
+    }
+
+    checksum_ = av_adler32_update(checksum_, pixels, size);
+    ++frames_;
+
+    Report(false);
+}
+
+void RenderWndOffscreen::Report(bool force)
+{
+    if (frames_ == 0)
+        return;
+
+    int64_t now = QDateTime::currentMSecsSinceEpoch();
+    if (!force && now - report_time_ < OFFSCREEN_REPORT_INTERVAL)
+        return;
+
+    uint64_t frames = frames_;
+    uint32_t gl_calls = render_thread_ ? render_thread_->frame_gl_calls() : 0;
+    double interval = (now - report_time_) / 1000.0;
+    double elapsed = (now - start_time_) / 1000.0;
+    SPDLOG_INFO("Offscreen frames: {0}, fps: {1:.1f} (avg {2:.1f}), blank: {3}, checksum: {4:08x}, "
+                "gl calls: {5}",
+                frames, interval > 0.0 ? (frames - report_frames_) / interval : 0.0,
+                elapsed > 0.0 ? frames / elapsed : 0.0, static_cast<uint64_t>(blank_frames_),
+                static_cast<uint32_t>(checksum_), gl_calls);
+
+    report_time_ = now;
+    report_frames_ = frames;
+}
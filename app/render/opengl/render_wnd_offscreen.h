@@ -0,0 +1,60 @@
+#ifndef RENDER_WND_OFFSCREEN_H_
+#define RENDER_WND_OFFSCREEN_H_
+
+#include <QWidget>
+#include <atomic>
+#include <memory>
+
+#include "gl_render_thread.h"
+#include "render/render_wnd.h"
+#include "util/decode_frame.h"
+
+/**
+ * @brief Headless OpenGL render window, frames are drawn into an offscreen framebuffer only.
+ *
+ * Runs the same upload and draw path as RenderWndGL on a standalone context, so it works without
+ * a display, e.g. on Mesa llvmpipe or EGL surfaceless. Every drawn frame is read back to verify
+ * that the pipeline produced an image and to checksum it. A frame issuing more gl calls than the
+ * video_param/gl_call_budget config value quits the application with exit code 2.
+ */
+class RenderWndOffscreen : public RenderWnd, public QWidget
+{
+public:
+    explicit RenderWndOffscreen(QWidget* parent = nullptr);
+    ~RenderWndOffscreen();
+
+    uint64_t frames() const { return frames_; }
+    uint64_t blank_frames() const { return blank_frames_; }
+    uint32_t checksum() const { return checksum_; }
+
+protected:
+    void Render(const DecodeFrame& frame) override;
+    void setGeometry(const QRect& rect) override { QWidget::setGeometry(rect); }
+    void update() override {}
+
+    bool StartPresent(const FrameProvider& provider, int fps) override;
+    void StopPresent() override;
+
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    void OnReadback(const uint8_t* pixels, int w, int h, uint32_t gl_calls);
+    void Report(bool force);
+
+private:
+    std::unique_ptr<GLRenderThread> render_thread_;
+
+    // Updated on the render thread
+    std::atomic<uint64_t> frames_;
+    std::atomic<uint64_t> blank_frames_; // Nothing but black was drawn
+    std::atomic<uint32_t> checksum_;     // Adler-32 over all read back frames
+    uint64_t over_budget_frames_;
+
+    uint32_t gl_call_budget_; // Most gl calls of a frame, 0 for no limit
+
+    int64_t start_time_;
+    int64_t report_time_;
+    uint64_t report_frames_;
+};
+
+#endif
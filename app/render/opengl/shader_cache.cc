@@ -0,0 +1,133 @@
+#include "shader_cache.h"
+
+#include <QFile>
+
+#include "common/avdef.h"
+#include "spdlog/spdlog.h"
+
+std::mutex ShaderCache::caches_mutex_;
+std::map<QOpenGLContext*, std::unique_ptr<ShaderCache>> ShaderCache::caches_;
+
+static QByteArray ReadShader(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        SPDLOG_ERROR("Failed to read shader {0}.", path.toStdString());
+        return QByteArray();
+    }
+
+    return file.readAll();
+}
+
+ShaderKey ShaderKey::FromFrame(const DecodeFrame& frame)
+{
+    ShaderKey key;
+    key.format = frame.format;
+    key.color_space = frame.color_space;
+    key.color_range = frame.color_range;
+    return key;
+}
+
+bool ShaderKey::operator<(const ShaderKey& other) const
+{
+    if (format != other.format)
+        return format < other.format;
+    if (color_space != other.color_space)
+        return color_space < other.color_space;
+    return color_range < other.color_range;
+}
+
+ShaderCache::ShaderCache()
+    : vert_src_(ReadShader(":/res/shaders/yuv2rgb.vert"))
+    , frag_src_(ReadShader(":/res/shaders/yuv2rgb.frag"))
+{}
+
+ShaderCache* ShaderCache::Current()
+{
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+    if (!ctx)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(caches_mutex_);
+
+    auto iter = caches_.find(ctx);
+    if (iter != caches_.end())
+        return iter->second.get();
+
+    ShaderCache* cache = new ShaderCache();
+    caches_[ctx].reset(cache);
+
+    QObject::connect(
+        ctx, &QOpenGLContext::aboutToBeDestroyed, ctx,
+        [ctx] {
+            std::lock_guard<std::mutex> lock(caches_mutex_);
+            caches_.erase(ctx);
+        },
+        Qt::DirectConnection);
+
+    return cache;
+}
+
+std::shared_ptr<QOpenGLShaderProgram> ShaderCache::Program(const ShaderKey& key)
+{
+    auto iter = programs_.find(key);
+    if (iter != programs_.end())
+        return iter->second;
+
+    QByteArray header = "#version 330 core\n" + Defines(key);
+
+    auto program = std::make_shared<QOpenGLShaderProgram>();
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, vert_src_);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, header + frag_src_);
+    if (!program->link()) {
+        SPDLOG_ERROR(program->log().toStdString());
+        program.reset();
+    } else {
+        SPDLOG_INFO("Build yuv program format: {0}, color space: {1}, color range: {2}.",
+                    key.format, key.color_space, key.color_range);
+    }
+
+    // Failures are cached too, they would fail again.
+    programs_[key] = program;
+    return program;
+}
+
+QByteArray ShaderCache::Defines(const ShaderKey& key) const
+{
+    QByteArray defines;
+
+    switch (key.format) {
+    case PIX_FMT_NV12:
+        defines += "#define SEMI_PLANAR\n#define BIT_DEPTH 8\n#define SAMPLE_SCALE 1.0\n";
+        break;
+    case PIX_FMT_P010:
+        // 10 bits stored in the high bits, the maximum sample is 0xffc0.
+        defines += "#define SEMI_PLANAR\n#define BIT_DEPTH 10\n"
+                   "#define SAMPLE_SCALE (65535.0 / 65472.0)\n";
+        break;
+    case PIX_FMT_P016:
+        defines += "#define SEMI_PLANAR\n#define BIT_DEPTH 16\n#define SAMPLE_SCALE 1.0\n";
+        break;
+    default:
+        defines += "#define BIT_DEPTH 8\n#define SAMPLE_SCALE 1.0\n";
+        break;
+    }
+
+    switch (key.color_space) {
+    case kColorSpaceBT709:
+        defines += "#define COLOR_BT709\n";
+        break;
+    case kColorSpaceBT2020:
+        defines += "#define COLOR_BT2020\n";
+        break;
+    default:
+        defines += "#define COLOR_BT601\n";
+        break;
+    }
+
+    if (key.color_range == kColorRangeFull) {
+        defines += "#define FULL_RANGE\n";
+    }
+
+    return defines;
+}
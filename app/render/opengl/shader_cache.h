@@ -0,0 +1,65 @@
+#ifndef SHADER_CACHE_H_
+#define SHADER_CACHE_H_
+
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "util/decode_frame.h"
+
+/**
+ * @brief Identifies a specialized yuv to rgb program.
+ */
+struct ShaderKey
+{
+    int format;      // PixelFormat
+    int color_space; // ColorSpace
+    int color_range; // ColorRange
+
+    static ShaderKey FromFrame(const DecodeFrame& frame);
+
+    bool operator==(const ShaderKey& other) const
+    {
+        return format == other.format && color_space == other.color_space
+               && color_range == other.color_range;
+    }
+    bool operator!=(const ShaderKey& other) const { return !(*this == other); }
+    bool operator<(const ShaderKey& other) const;
+};
+
+/**
+ * @brief Yuv to rgb programs compiled per pixel format, color matrix, range and bit depth.
+ *
+ * Each variant is built from the same source with defines, so the fragment shader has no
+ * runtime branches. One cache exists per context and goes away with it.
+ */
+class ShaderCache
+{
+public:
+    /**
+     * @brief The cache of the current context.
+     */
+    static ShaderCache* Current();
+
+    /**
+     * @return Linked program, nullptr if it failed to build.
+     */
+    std::shared_ptr<QOpenGLShaderProgram> Program(const ShaderKey& key);
+
+private:
+    ShaderCache();
+
+    QByteArray Defines(const ShaderKey& key) const;
+
+private:
+    QByteArray vert_src_;
+    QByteArray frag_src_;
+    std::map<ShaderKey, std::shared_ptr<QOpenGLShaderProgram>> programs_;
+
+    static std::mutex caches_mutex_;
+    static std::map<QOpenGLContext*, std::unique_ptr<ShaderCache>> caches_;
+};
+
+#endif
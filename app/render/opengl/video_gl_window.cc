@@ -0,0 +1,322 @@
+#include "video_gl_window.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QMouseEvent>
+#include <QScreen>
+#include <cmath>
+
+#include "shader_cache.h"
+#include "common/singleton.h"
+#include "config/config.h"
+#include "spdlog/spdlog.h"
+
+#define MAX_QUEUED_FRAMES 4
+#define RESYNC_THRESHOLD_MS 500
+#define JUDDER_REPORT_INTERVAL 1000 // ms
+
+VideoGLWindow::VideoGLWindow(QWidget* event_target)
+    : QOpenGLWindow(QOpenGLWindow::NoPartialUpdate)
+    , event_target_(event_target)
+    , shader_key_({-1, -1, -1})
+    , epoch_(Clock::now())
+    , anchored_(false)
+    , base_display_ms_(0.0)
+    , base_pts_(0.0)
+    , rate_(1.0)
+    , last_swap_ms_(0.0)
+    , shown_vsyncs_(0)
+    , shown_pts_(0.0)
+    , presented_pts_(0.0)
+    , report_time_(0)
+{
+    QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    format.setSwapInterval(1);
+    setFormat(format);
+
+    qreal refresh_rate = screen() ? screen()->refreshRate() : 0.0;
+    judder_.refresh_ms = 1000.0 / (refresh_rate > 1.0 ? refresh_rate : 60.0);
+
+    connect(this, &QOpenGLWindow::frameSwapped, this, [this] { OnFrameSwapped(); });
+}
+
+VideoGLWindow::~VideoGLWindow()
+{
+    ReleaseGL();
+}
+
+void VideoGLWindow::SetFrameProvider(const RenderWnd::FrameProvider& provider)
+{
+    provider_ = provider;
+
+    // Re-anchor the clock, and do not count the pause as judder.
+    anchored_ = false;
+    shown_vsyncs_ = 0;
+    last_swap_ms_ = 0.0;
+
+    update();
+}
+
+void VideoGLWindow::ClearFrameProvider()
+{
+    provider_ = nullptr;
+    anchored_ = false;
+}
+
+void VideoGLWindow::SetRate(double rate)
+{
+    if (rate <= 0.0 || rate == rate_)
+        return;
+
+    rate_ = rate;
+    anchored_ = false;
+}
+
+void VideoGLWindow::Submit(const DecodeFrame& frame)
+{
+    if (queue_.size() >= MAX_QUEUED_FRAMES) {
+        free_frames_.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+        ++judder_.dropped;
+    }
+
+    std::unique_ptr<DecodeFrame> queued = AllocFrame();
+    queued->Copy(frame);
+    queue_.push_back(std::move(queued));
+
+    update();
+}
+
+void VideoGLWindow::initializeGL()
+{
+    initializeOpenGLFunctions();
+
+    // Programs are picked per frame from the shader cache of this context.
+    renderer_.reset(new OpenGLRenderer());
+
+    uploader_.Init();
+    bool dirty_tiles = Singleton<Config>::Instance()
+                       ->AppConfigData("video_param", "dirty_tile_upload", false)
+                       .toBool();
+    uploader_.set_dirty_tiles(dirty_tiles);
+    textures_.Init();
+
+    SPDLOG_INFO("Video window swap interval: {0}, refresh: {1}ms.", format().swapInterval(),
+                judder_.refresh_ms);
+}
+
+void VideoGLWindow::resizeGL(int w, int h)
+{
+    if (renderer_) {
+        renderer_->SetSize(QVector2D(w, h));
+    }
+}
+
+void VideoGLWindow::paintGL()
+{
+    FillQueue();
+
+    // What is drawn now becomes visible with the next refresh.
+    bool new_frame = false;
+    if (!queue_.empty()) {
+        new_frame = SelectFrame(NowMs() + judder_.refresh_ms);
+    }
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    if (textures_.valid()) {
+        renderer_->Draw(textures_.ids(), textures_.count(), textures_.content_scale(),
+                        textures_.content_clamp());
+    }
+
+    if (provider_) {
+        UpdateJudder(new_frame);
+    }
+}
+
+void VideoGLWindow::mouseReleaseEvent(QMouseEvent* event)
+{
+    QOpenGLWindow::mouseReleaseEvent(event);
+
+    // Native child windows swallow mouse input, forward the context menu request.
+    if (event->button() == Qt::RightButton && event_target_) {
+        QContextMenuEvent menu_event(QContextMenuEvent::Mouse, event->pos(), event->globalPos());
+        QCoreApplication::sendEvent(event_target_, &menu_event);
+    }
+}
+
+void VideoGLWindow::OnFrameSwapped()
+{
+    double now = NowMs();
+    if (last_swap_ms_ > 0.0) {
+        // Track the real refresh interval, ignoring idle gaps and missed vsyncs.
+        double delta = now - last_swap_ms_;
+        if (delta > judder_.refresh_ms * 0.5 && delta < judder_.refresh_ms * 1.5) {
+            judder_.refresh_ms = judder_.refresh_ms * 0.95 + delta * 0.05;
+        }
+    }
+
+    if (provider_) {
+        last_swap_ms_ = now;
+
+        // Blocks in the swap of the next frame, which paces presentation to vsync.
+        update();
+    } else {
+        last_swap_ms_ = 0.0;
+    }
+
+    ReportJudder();
+}
+
+void VideoGLWindow::FillQueue()
+{
+    if (!provider_)
+        return;
+
+    while (queue_.size() < MAX_QUEUED_FRAMES) {
+        std::unique_ptr<DecodeFrame> frame = AllocFrame();
+        if (!provider_(frame.get())) {
+            free_frames_.push_back(std::move(frame));
+            break;
+        }
+        queue_.push_back(std::move(frame));
+    }
+}
+
+std::unique_ptr<DecodeFrame> VideoGLWindow::AllocFrame()
+{
+    if (free_frames_.empty())
+        return std::unique_ptr<DecodeFrame>(new DecodeFrame());
+
+    std::unique_ptr<DecodeFrame> frame = std::move(free_frames_.back());
+    free_frames_.pop_back();
+    return frame;
+}
+
+bool VideoGLWindow::SelectFrame(double display_ms)
+{
+    double head_pts = static_cast<double>(queue_.front()->ts);
+    if (!anchored_) {
+        base_display_ms_ = display_ms;
+        base_pts_ = head_pts;
+        anchored_ = true;
+    }
+
+    double target_pts = base_pts_ + (display_ms - base_display_ms_) * rate_;
+
+    // Seeks, pts jumps and decoder stalls, follow the queue rather than the clock.
+    if (std::fabs(head_pts - target_pts) / rate_ > RESYNC_THRESHOLD_MS) {
+        base_display_ms_ = display_ms;
+        base_pts_ = head_pts;
+        target_pts = head_pts;
+        ++judder_.resyncs;
+    }
+
+    // The latest frame that is due by the middle of the refresh interval.
+    double deadline = target_pts + judder_.refresh_ms / 2 * rate_;
+    size_t due = 0;
+    while (due < queue_.size() && static_cast<double>(queue_[due]->ts) <= deadline) {
+        ++due;
+    }
+    if (due == 0)
+        return false;
+
+    judder_.dropped += due - 1;
+    ShowFrame(*queue_[due - 1]);
+
+    for (size_t i = 0; i < due; ++i) {
+        free_frames_.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+    }
+
+    return true;
+}
+
+void VideoGLWindow::ShowFrame(const DecodeFrame& frame)
+{
+    PboUploader::Plane planes[PboUploader::kMaxPlanes];
+    int plane_count = PboUploader::FramePlanes(frame.format, frame.w, frame.h, planes);
+    if (plane_count == 0)
+        return;
+
+    ShaderKey key = ShaderKey::FromFrame(frame);
+    if (key != shader_key_) {
+        shader_key_ = key;
+        renderer_->SetProgram(ShaderCache::Current()->Program(key));
+    }
+
+    if (textures_.Reserve(planes, plane_count)) {
+        renderer_->InvalidateState();
+        uploader_.InvalidateTiles();
+    }
+
+    if (uploader_.Stage(frame)) {
+        uploader_.Upload(textures_.ids());
+    }
+
+    presented_pts_ = static_cast<double>(frame.ts);
+}
+
+void VideoGLWindow::UpdateJudder(bool new_frame)
+{
+    ++judder_.vsyncs;
+
+    if (!new_frame) {
+        if (shown_vsyncs_ > 0) {
+            ++judder_.repeated;
+            ++shown_vsyncs_;
+        }
+        return;
+    }
+
+    ++judder_.presented;
+
+    // The previous frame stayed for shown_vsyncs_ refreshes, ideally that matches its pts delta.
+    if (shown_vsyncs_ > 0) {
+        double on_screen_ms = shown_vsyncs_ * judder_.refresh_ms;
+        double pts_delta = (presented_pts_ - shown_pts_) / rate_;
+        if (pts_delta > 0.0) {
+            double dev = std::fabs(on_screen_ms - pts_delta);
+            judder_.total_dev_ms += dev;
+            judder_.max_dev_ms = std::max(judder_.max_dev_ms, dev);
+        }
+    }
+
+    shown_pts_ = presented_pts_;
+    shown_vsyncs_ = 1;
+}
+
+void VideoGLWindow::ReportJudder()
+{
+    int64_t now = QDateTime::currentMSecsSinceEpoch();
+    if (now - report_time_ < JUDDER_REPORT_INTERVAL)
+        return;
+    report_time_ = now;
+
+    if (judder_.presented == 0)
+        return;
+
+    SPDLOG_DEBUG("Vsync presentation refresh: {0:.2f}ms, vsyncs: {1}, presented: {2}, repeated: "
+                 "{3}, dropped: {4}, resyncs: {5}, judder avg: {6:.2f}ms max: {7:.2f}ms",
+                 judder_.refresh_ms, judder_.vsyncs, judder_.presented, judder_.repeated,
+                 judder_.dropped, judder_.resyncs, judder_.total_dev_ms / judder_.presented,
+                 judder_.max_dev_ms);
+}
+
+double VideoGLWindow::NowMs() const
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - epoch_).count();
+}
+
+void VideoGLWindow::ReleaseGL()
+{
+    if (!context())
+        return;
+
+    makeCurrent();
+    uploader_.Release();
+    textures_.Release();
+    renderer_.reset();
+    doneCurrent();
+}
@@ -0,0 +1,105 @@
+#ifndef VIDEO_GL_WINDOW_H_
+#define VIDEO_GL_WINDOW_H_
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLWindow>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "opengl_renderer.h"
+#include "pbo_uploader.h"
+#include "plane_textures.h"
+#include "shader_cache.h"
+#include "render/render_wnd.h"
+
+struct JudderStats
+{
+    uint64_t vsyncs = 0;
+    uint64_t presented = 0; // Vsyncs showing a new frame
+    uint64_t repeated = 0;  // Vsyncs showing the previous frame again
+    uint64_t dropped = 0;   // Queued frames that were never shown
+    uint64_t resyncs = 0;   // Clock re-anchored to the queue
+    double refresh_ms = 0.0;
+    double total_dev_ms = 0.0; // Sum of |on screen time - pts delta| of presented frames
+    double max_dev_ms = 0.0;
+};
+
+/**
+ * @brief Presents frames directly to a window surface, paced by vsync.
+ *
+ * Every frameSwapped schedules the next update, and the frame to show is the latest queued one
+ * whose pts falls before the next refresh. How long each frame stayed on screen compared to its
+ * pts delta is collected as refresh aligned judder.
+ */
+class VideoGLWindow : public QOpenGLWindow, protected QOpenGLFunctions_3_3_Core
+{
+public:
+    /**
+     * @param event_target Widget receiving the context menu requests of this window.
+     */
+    explicit VideoGLWindow(QWidget* event_target);
+    ~VideoGLWindow();
+
+    void SetFrameProvider(const RenderWnd::FrameProvider& provider);
+    void ClearFrameProvider();
+
+    /**
+     * @brief Pts ms per display ms, the clock is re-anchored.
+     */
+    void SetRate(double rate);
+    void Submit(const DecodeFrame& frame);
+
+    const JudderStats& judder_stats() const { return judder_; }
+
+protected:
+    void initializeGL() override;
+    void resizeGL(int w, int h) override;
+    void paintGL() override;
+
+    void mouseReleaseEvent(QMouseEvent* event) override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void OnFrameSwapped();
+    void FillQueue();
+    std::unique_ptr<DecodeFrame> AllocFrame();
+    bool SelectFrame(double display_ms);
+    void ShowFrame(const DecodeFrame& frame);
+    void UpdateJudder(bool new_frame);
+    void ReportJudder();
+    double NowMs() const;
+    void ReleaseGL();
+
+private:
+    QWidget* event_target_;
+
+    std::unique_ptr<OpenGLRenderer> renderer_;
+    PboUploader uploader_;
+    PlaneTextures textures_;
+    ShaderKey shader_key_;
+
+    RenderWnd::FrameProvider provider_;
+    // Frames own their buffers, reused through the free list to avoid reallocations.
+    std::deque<std::unique_ptr<DecodeFrame>> queue_;
+    std::vector<std::unique_ptr<DecodeFrame>> free_frames_;
+
+    // Pts clock, anchored to the display time of the first frame.
+    Clock::time_point epoch_;
+    bool anchored_;
+    double base_display_ms_;
+    double base_pts_;
+    double rate_;
+    double last_swap_ms_;
+
+    // Judder
+    JudderStats judder_;
+    uint64_t shown_vsyncs_;
+    double shown_pts_;
+    double presented_pts_;
+    int64_t report_time_;
+};
+
+#endif
@@ -2,13 +2,21 @@
 #define RENDER_FACTORY_H_
 
 #include "render/opengl/render_wnd_gl.h"
+#include "render/opengl/render_wnd_gl_window.h"
+#include "render/opengl/render_wnd_offscreen.h"
+#include "render/null/render_wnd_null.h"
 #include "render/render_wnd.h"
 #include "render/sdl2/render_wnd_sdl.h"
+#include "render/software/render_wnd_soft.h"
 
 enum RenderType
 {
     kOpenGL,
     kSDL2,
+    kOpenGLWindow,
+    kSoftware,
+    kNull,
+    kOffscreen,
 };
 
 class RenderFactory
@@ -21,10 +29,48 @@ public:
             return new RenderWndGL(parent);
         case kSDL2:
             return new RenderWndSDL(parent);
+        case kOpenGLWindow:
+            return new RenderWndGLWindow(parent);
+        case kSoftware:
+            return new RenderWndSoft(parent);
+        case kNull:
+            return new RenderWndNull(parent);
+        case kOffscreen:
+            return new RenderWndOffscreen(parent);
         default:
             return nullptr;
         }
     }
+
+    /**
+     * @brief Map a name given on the command line to a render type.
+     *
+     * @return False if the name is unknown.
+     */
+    static bool TypeFromName(const QString& name, RenderType* type)
+    {
+        static const struct
+        {
+            const char* name;
+            RenderType type;
+        } kNames[] = {
+            {"opengl", kOpenGL},
+            {"sdl", kSDL2},
+            {"gl-window", kOpenGLWindow},
+            {"software", kSoftware},
+            {"null", kNull},
+            {"offscreen", kOffscreen},
+        };
+
+        for (const auto& entry : kNames) {
+            if (name.compare(entry.name, Qt::CaseInsensitive) == 0) {
+                *type = entry.type;
+                return true;
+            }
+        }
+
+        return false;
+    }
 };
 
 #endif
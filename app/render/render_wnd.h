@@ -4,12 +4,16 @@
 #include <QtCore>
 #include <QtGui>
 #include <QtWidgets>
+#include <functional>
 
 #include "util/decode_frame.h"
 
 class RenderWnd
 {
 public:
+    // Fill the frame to present next, return false if there is none yet.
+    using FrameProvider = std::function<bool(DecodeFrame*)>;
+
     RenderWnd();
     virtual ~RenderWnd();
 
@@ -17,6 +21,31 @@ public:
     virtual void update() = 0;
     virtual void setGeometry(const QRect&) = 0;
 
+    /**
+     * @brief Let the render window pull and pace frames itself, off the GUI thread.
+     *
+     * @return False if not supported, the caller has to drive Render() instead.
+     */
+    virtual bool StartPresent(const FrameProvider& provider, int fps) { return false; }
+
+    /**
+     * @brief Stop pulling frames, the provider is not called anymore after return.
+     */
+    virtual void StopPresent() {}
+
+    /**
+     * @brief Playback rate, for render windows that pace by the frame pts. Set before
+     * StartPresent, which restarts their clock.
+     */
+    virtual void SetRate(double rate) {}
+
+    /**
+     * @brief Frames uploaded to the GPU and the time spent on it, for the playback stats.
+     *
+     * @return False if the render window does not upload or does not measure it
+     */
+    virtual bool UploadTotals(uint64_t* frames, int64_t* us) const { return false; }
+
 private:
 };
 
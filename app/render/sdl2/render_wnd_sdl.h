@@ -1,6 +1,9 @@
 #ifndef RENDER_WND_SDL_H_
 #define RENDER_WND_SDL_H_
 
+#include <memory>
+
+#include "sdl_render_thread.h"
 #include "SDL.h"
 #include "render/render_wnd.h"
 #include "util/decode_frame.h"
@@ -16,19 +19,19 @@ protected:
     void setGeometry(const QRect& rect) override { QWidget::setGeometry(rect); }
     void update() override;
 
+    bool StartPresent(const FrameProvider& provider, int fps) override;
+    void StopPresent() override;
+
+    void resizeEvent(QResizeEvent* event) override;
+
 private:
     void InitSDL();
 
 private:
     static std::atomic_flag sdl_inited_;
     SDL_Window* wnd_;
-    SDL_Renderer* renderer_;
-    SDL_Texture* video_tex_;
 
-    int frame_w_;
-    int frame_h_;
-    int frame_format_;
-    int frame_pitch_;
+    std::unique_ptr<SDLRenderThread> render_thread_;
 };
 
 #endif
@@ -0,0 +1,345 @@
+#include "sdl_render_thread.h"
+
+#include "common/avdef.h"
+#include "util/frame_layout.h"
+#include "spdlog/spdlog.h"
+
+static SDL_PixelFormatEnum get_sdl_fmt(int fmt)
+{
+    switch (fmt) {
+    case PIX_FMT_IYUV:
+        return SDL_PIXELFORMAT_IYUV;
+    case PIX_FMT_NV12:
+    case PIX_FMT_P010: // Narrowed to NV12, SDL2 has no 16-bit yuv textures.
+    case PIX_FMT_P016:
+        return SDL_PIXELFORMAT_NV12;
+    case PIX_FMT_RGB:
+        return SDL_PIXELFORMAT_RGB24;
+    }
+
+    return SDL_PIXELFORMAT_UNKNOWN;
+}
+
+SDLRenderThread::SDLRenderThread(SDL_Window* wnd, bool headless, QObject* parent)
+    : CThread(parent)
+    , wnd_(wnd)
+    , headless_(headless)
+    , renderer_(nullptr)
+    , video_tex_(nullptr)
+    , software_(false)
+    , frame_w_(0)
+    , frame_h_(0)
+    , frame_format_(-1)
+    , pending_(false)
+    , refresh_(false)
+    , presenting_(false)
+    , interval_ms_(0)
+    , applied_interval_ms_(0)
+{}
+
+SDLRenderThread::~SDLRenderThread()
+{
+    Quit();
+}
+
+void SDLRenderThread::Launch()
+{
+    if (isRunning() || !wnd_)
+        return;
+
+    set_state(kRunning);
+    start();
+}
+
+void SDLRenderThread::Quit()
+{
+    if (!isRunning())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        set_state(kStop);
+    }
+    cv_.notify_all();
+
+    wait();
+}
+
+void SDLRenderThread::SetFrameProvider(const RenderWnd::FrameProvider& provider, int fps)
+{
+    {
+        std::lock_guard<std::mutex> lock(provider_mutex_);
+        provider_ = provider;
+    }
+
+    {
+        // Under the lock of the wait, a notify between its predicate and its block is lost.
+        std::lock_guard<std::mutex> lock(mutex_);
+        interval_ms_ = 1000 / (fps > 0 ? fps : 25);
+        presenting_ = true;
+    }
+    cv_.notify_all();
+}
+
+void SDLRenderThread::ClearFrameProvider()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        presenting_ = false;
+    }
+
+    // Waits for a running provider call, the provider may be destroyed after this.
+    std::lock_guard<std::mutex> lock(provider_mutex_);
+    provider_ = nullptr;
+}
+
+void SDLRenderThread::Submit(const DecodeFrame& frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_frame_.Copy(frame);
+        pending_ = true;
+    }
+    cv_.notify_all();
+}
+
+void SDLRenderThread::Refresh()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        refresh_ = true;
+    }
+    cv_.notify_all();
+}
+
+bool SDLRenderThread::DoPrepare()
+{
+    // Renderers and textures must be used from the thread that created them.
+    return CreateRenderer(headless_);
+}
+
+void SDLRenderThread::DoTask()
+{
+    DecodeFrame frame;
+    bool was_paced = false;
+
+    while (state() != kStop) {
+        bool has_frame = false;
+        bool refresh = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] {
+                return state() == kStop || presenting_ || pending_ || refresh_;
+            });
+            if (state() == kStop)
+                break;
+
+            if (pending_) {
+                frame.Copy(pending_frame_);
+                pending_ = false;
+                has_frame = true;
+            }
+
+            refresh = refresh_;
+            refresh_ = false;
+        }
+
+        bool paced = presenting_;
+        if (paced) {
+            has_frame = PullFrame(&frame) || has_frame;
+        }
+
+        if (has_frame && !frame.IsNull()) {
+            if (ResetTexture(frame)) {
+                UpdateTexture(frame);
+            }
+        }
+
+        if (has_frame || refresh) {
+            Present();
+        }
+
+        if (paced) {
+            // Restart the pacing clock when presentation resumes, otherwise frames burst.
+            if (!was_paced || applied_interval_ms_ != interval_ms_) {
+                applied_interval_ms_ = interval_ms_;
+                set_sleep_policy(kUntil, applied_interval_ms_);
+            }
+            Sleep();
+        }
+        was_paced = paced;
+    }
+}
+
+void SDLRenderThread::DoFinish()
+{
+    DestroyRenderer();
+}
+
+bool SDLRenderThread::CreateRenderer(bool software)
+{
+    DestroyRenderer();
+
+    if (!software) {
+        renderer_ =
+            SDL_CreateRenderer(wnd_, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+        if (!renderer_) {
+            SPDLOG_WARN("Faild to create SDL accelerated renderer, fallback to software: {0}.",
+                        SDL_GetError());
+        }
+    }
+
+    if (!renderer_) {
+        renderer_ = SDL_CreateRenderer(wnd_, -1, SDL_RENDERER_SOFTWARE);
+        if (!renderer_) {
+            SPDLOG_ERROR("Faild to create SDL software renderer desc: {0}.", SDL_GetError());
+            return false;
+        }
+        software = true;
+    }
+    software_ = software;
+
+    SDL_RendererInfo renderer_info;
+    SDL_GetRendererInfo(renderer_, &renderer_info);
+    SPDLOG_INFO("SDL renderer: {0}, texture formats: {1}.", renderer_info.name,
+                renderer_info.num_texture_formats);
+
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+
+    return true;
+}
+
+void SDLRenderThread::DestroyRenderer()
+{
+    if (video_tex_) {
+        SDL_DestroyTexture(video_tex_);
+        video_tex_ = nullptr;
+    }
+
+    if (renderer_) {
+        SDL_DestroyRenderer(renderer_);
+        renderer_ = nullptr;
+    }
+
+    frame_w_ = 0;
+    frame_h_ = 0;
+    frame_format_ = -1;
+}
+
+bool SDLRenderThread::ResetTexture(const DecodeFrame& frame)
+{
+    if (video_tex_ && frame_w_ == frame.w && frame_h_ == frame.h && frame_format_ == frame.format)
+        return true;
+
+    if (video_tex_) {
+        SDL_DestroyTexture(video_tex_);
+        video_tex_ = nullptr;
+    }
+
+    uint32_t fmt = get_sdl_fmt(frame.format);
+    if (fmt == SDL_PIXELFORMAT_UNKNOWN)
+        return false;
+
+    video_tex_ = SDL_CreateTexture(renderer_, fmt, SDL_TEXTUREACCESS_STREAMING, frame.w, frame.h);
+    if (!video_tex_ && !software_) {
+        SPDLOG_WARN("Faild to create SDL texture desc: {0}, fallback to software renderer.",
+                    SDL_GetError());
+
+        if (CreateRenderer(true)) {
+            video_tex_ =
+                SDL_CreateTexture(renderer_, fmt, SDL_TEXTUREACCESS_STREAMING, frame.w, frame.h);
+        }
+    }
+    if (!video_tex_) {
+        SPDLOG_ERROR("Faild to create SDL texture desc: {0}.", SDL_GetError());
+        return false;
+    }
+
+    frame_w_ = frame.w;
+    frame_h_ = frame.h;
+    frame_format_ = frame.format;
+
+    return true;
+}
+
+bool SDLRenderThread::UpdateTexture(const DecodeFrame& frame)
+{
+    // Planes of a DecodeFrame are tightly packed, the luma stride is the width.
+    const Uint8* y = reinterpret_cast<const Uint8*>(frame.buf.base);
+    FrameLayout layout;
+    GetFrameLayout(frame.format, frame.w, frame.h, &layout);
+
+    switch (frame.format) {
+    case PIX_FMT_IYUV:
+        return SDL_UpdateYUVTexture(video_tex_, nullptr, y, frame.w, y + layout.offset[1],
+                                    layout.chroma_w, y + layout.offset[2], layout.chroma_w)
+               == 0;
+    case PIX_FMT_NV12:
+        return SDL_UpdateNVTexture(video_tex_, nullptr, y, frame.w, y + layout.offset[1],
+                                   layout.chroma_w * 2)
+               == 0;
+    case PIX_FMT_P010:
+    case PIX_FMT_P016:
+        return NarrowToTexture(frame);
+    default:
+        return SDL_UpdateTexture(video_tex_, nullptr, frame.buf.base, frame.w * 3) == 0;
+    }
+}
+
+bool SDLRenderThread::NarrowToTexture(const DecodeFrame& frame)
+{
+    void* pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(video_tex_, nullptr, &pixels, &pitch) < 0) {
+        SPDLOG_ERROR("Faild to lock SDL texture desc: {0}.", SDL_GetError());
+        return false;
+    }
+
+    // Locked NV12 memory is the Y plane followed by the UV plane, both with an even pitch.
+    int uv_pitch = (pitch + 1) & ~1;
+    Uint8* dst_y = static_cast<Uint8*>(pixels);
+    Uint8* dst_uv = dst_y + pitch * frame.h;
+
+    FrameLayout layout;
+    GetFrameLayout(frame.format, frame.w, frame.h, &layout);
+    int uv_w = layout.chroma_w * 2;
+
+    // Keep the high byte of every sample.
+    const uint16_t* src = reinterpret_cast<const uint16_t*>(frame.buf.base);
+    for (int row = 0; row < frame.h; ++row, src += frame.w) {
+        Uint8* dst = dst_y + row * pitch;
+        for (int i = 0; i < frame.w; ++i) {
+            dst[i] = static_cast<Uint8>(src[i] >> 8);
+        }
+    }
+    for (int row = 0; row < layout.chroma_h; ++row, src += uv_w) {
+        Uint8* dst = dst_uv + row * uv_pitch;
+        for (int i = 0; i < uv_w; ++i) {
+            dst[i] = static_cast<Uint8>(src[i] >> 8);
+        }
+    }
+
+    SDL_UnlockTexture(video_tex_);
+    return true;
+}
+
+void SDLRenderThread::Present()
+{
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+    SDL_RenderClear(renderer_);
+
+    if (video_tex_) {
+        SDL_RenderCopy(renderer_, video_tex_, nullptr, nullptr);
+    }
+
+    SDL_RenderPresent(renderer_);
+}
+
+bool SDLRenderThread::PullFrame(DecodeFrame* frame)
+{
+    std::lock_guard<std::mutex> lock(provider_mutex_);
+    if (!provider_)
+        return false;
+
+    return provider_(frame);
+}
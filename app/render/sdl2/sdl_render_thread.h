@@ -0,0 +1,89 @@
+#ifndef SDL_RENDER_THREAD_H_
+#define SDL_RENDER_THREAD_H_
+
+#include <condition_variable>
+#include <mutex>
+
+#include "SDL.h"
+#include "render/render_wnd.h"
+#include "util/cthread.h"
+#include "util/decode_frame.h"
+
+/**
+ * @brief Owns the SDL renderer of a window and presents frames on its own thread.
+ *
+ * Frames are popped from the queue into a frame of the thread, then uploaded with their strides
+ * through SDL_UpdateYUVTexture/SDL_UpdateNVTexture. Frames that need a conversion are converted
+ * straight into SDL_LockTexture memory without an intermediate buffer. Falls back to the software
+ * renderer when the accelerated one can not be created or can not hold the frame format.
+ */
+class SDLRenderThread : public CThread
+{
+public:
+    /**
+     * @param wnd Window created on the GUI thread, it must outlive the thread.
+     * @param headless No display, render with the software renderer without vsync.
+     */
+    SDLRenderThread(SDL_Window* wnd, bool headless, QObject* parent = nullptr);
+    ~SDLRenderThread();
+
+    void Launch();
+    void Quit();
+
+    void SetFrameProvider(const RenderWnd::FrameProvider& provider, int fps);
+
+    /**
+     * @brief Block until the provider is no longer called.
+     */
+    void ClearFrameProvider();
+
+    void Submit(const DecodeFrame& frame);
+
+    /**
+     * @brief Present the last frame again, e.g. after the window was resized.
+     */
+    void Refresh();
+
+    bool software() const { return software_; }
+
+protected:
+    bool DoPrepare() override;
+    void DoTask() override;
+    void DoFinish() override;
+
+private:
+    bool CreateRenderer(bool software);
+    void DestroyRenderer();
+    bool ResetTexture(const DecodeFrame& frame);
+    bool UpdateTexture(const DecodeFrame& frame);
+    bool NarrowToTexture(const DecodeFrame& frame);
+    void Present();
+    bool PullFrame(DecodeFrame* frame);
+
+private:
+    SDL_Window* wnd_;
+    bool headless_;
+
+    SDL_Renderer* renderer_;
+    SDL_Texture* video_tex_;
+    std::atomic<bool> software_;
+
+    int frame_w_;
+    int frame_h_;
+    int frame_format_;
+
+    // Work queue
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    DecodeFrame pending_frame_;
+    bool pending_;
+    bool refresh_;
+
+    std::mutex provider_mutex_;
+    RenderWnd::FrameProvider provider_;
+    std::atomic<bool> presenting_;
+    std::atomic<int> interval_ms_;
+    int applied_interval_ms_;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "render_wnd_soft.h"
+
+#include <QPainter>
+
+#include "spdlog/spdlog.h"
+
+RenderWndSoft::RenderWndSoft(QWidget* parent)
+    : QWidget(parent)
+    , frame_()
+    , dirty_(false)
+{
+    // Every pixel is painted from image_, skip the background erase.
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setAttribute(Qt::WA_NoSystemBackground);
+}
+
+RenderWndSoft::~RenderWndSoft() {}
+
+void RenderWndSoft::Render(const DecodeFrame& frame)
+{
+    if (frame.IsNull())
+        return;
+
+    bool resized = frame.w != frame_.w || frame.h != frame_.h;
+    frame_.Copy(frame);
+    dirty_ = true;
+
+    // The letterbox depends on the aspect of the frame.
+    if (resized) {
+        image_ = QImage();
+    }
+
+    update();
+}
+
+void RenderWndSoft::paintEvent(QPaintEvent* event)
+{
+    if (image_.isNull()) {
+        ResetImage();
+    }
+
+    if (dirty_) {
+        ConvertFrame();
+        dirty_ = false;
+    }
+
+    // The source rect is in device pixels of the image, the target in logical pixels.
+    qreal dpr = image_.devicePixelRatio();
+    QRect rect = event->rect();
+    QPainter painter(this);
+    painter.drawImage(QRectF(rect), image_,
+                      QRectF(QPointF(rect.topLeft()) * dpr, QSizeF(rect.size()) * dpr));
+}
+
+void RenderWndSoft::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+
+    image_ = QImage();
+}
+
+void RenderWndSoft::ResetImage()
+{
+    qreal dpr = devicePixelRatioF();
+    QSize size = this->size() * dpr;
+    if (size.isEmpty())
+        return;
+
+    image_ = QImage(size, QImage::Format_RGB32);
+    image_.setDevicePixelRatio(dpr);
+    image_.fill(Qt::black);
+
+    video_rect_ = QRect();
+    if (frame_.w > 0 && frame_.h > 0) {
+        QSize video_size = QSize(frame_.w, frame_.h).scaled(size, Qt::KeepAspectRatio);
+        video_rect_ = QRect(QPoint((size.width() - video_size.width()) / 2,
+                                   (size.height() - video_size.height()) / 2),
+                            video_size);
+    }
+
+    // The new image has to be filled, even if no new frame arrives.
+    dirty_ = !frame_.IsNull();
+}
+
+void RenderWndSoft::ConvertFrame()
+{
+    if (image_.isNull() || video_rect_.isEmpty())
+        return;
+
+    uint8_t* dst = image_.bits() + video_rect_.y() * image_.bytesPerLine() + video_rect_.x() * 4;
+    if (!scaler_.Scale(frame_, dst, video_rect_.width(), video_rect_.height(),
+                       image_.bytesPerLine())) {
+        SPDLOG_ERROR("Software renderer does not support pixel format: {0}.", frame_.format);
+    }
+}
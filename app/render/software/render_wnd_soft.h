@@ -0,0 +1,46 @@
+#ifndef RENDER_WND_SOFT_H_
+#define RENDER_WND_SOFT_H_
+
+#include <QImage>
+#include <QWidget>
+
+#include "yuv_scaler.h"
+#include "render/render_wnd.h"
+#include "util/decode_frame.h"
+
+/**
+ * @brief CPU render window for machines without a usable GPU.
+ *
+ * Frames are converted and scaled straight into a RGB32 image of the widget size, which is reused
+ * across frames and painted without any further scaling. Conversion only happens when a new frame
+ * arrived or the widget was resized, other paints reuse the image.
+ */
+class RenderWndSoft : public RenderWnd, public QWidget
+{
+public:
+    explicit RenderWndSoft(QWidget* parent = nullptr);
+    ~RenderWndSoft();
+
+protected:
+    void Render(const DecodeFrame& frame) override;
+    void setGeometry(const QRect& rect) override { QWidget::setGeometry(rect); }
+    void update() override { QWidget::update(); }
+
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    void ResetImage();
+    void ConvertFrame();
+
+private:
+    YuvScaler scaler_;
+    DecodeFrame frame_;
+    bool dirty_;
+
+    // Widget sized image in device pixels, the video is letterboxed into video_rect_.
+    QImage image_;
+    QRect video_rect_;
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "yuv_scaler.h"
+
+#include <string.h>
+
+#include "common/avdef.h"
+#include "util/frame_layout.h"
+
+#ifdef YUV_SCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+static inline uint8_t Clamp8(int v)
+{
+    return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+YuvScaler::YuvScaler()
+    : src_w_(0)
+    , src_h_(0)
+    , format_(-1)
+    , color_space_(-1)
+    , color_range_(-1)
+    , dst_w_(0)
+    , dst_h_(0)
+    , rgb_(false)
+{
+    memset(planes_, 0, sizeof(planes_));
+    memset(&coeffs_, 0, sizeof(coeffs_));
+}
+
+bool YuvScaler::Scale(const DecodeFrame& frame, uint8_t* dst, int dst_w, int dst_h, int dst_stride)
+{
+    if (frame.IsNull() || dst_w <= 0 || dst_h <= 0)
+        return false;
+
+    if (!Prepare(frame, dst_w, dst_h))
+        return false;
+
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(frame.buf.base);
+    for (int dy = 0; dy < dst_h; ++dy) {
+        int sy = y_rows_[dy];
+
+        // Gather the samples of this row, so the conversion works on contiguous bytes.
+        for (int p = 0; p < 3; ++p) {
+            const Plane& plane = planes_[p];
+            const uint8_t* src_row = src + plane.offset + (sy >> plane.y_shift) * plane.stride;
+            const int* x_offsets = x_offsets_[p].data();
+            uint8_t* row = rows_[p].data();
+            for (int dx = 0; dx < dst_w; ++dx) {
+                row[dx] = src_row[x_offsets[dx]];
+            }
+        }
+
+        uint32_t* dst_row = reinterpret_cast<uint32_t*>(dst + dy * dst_stride);
+        ConvertRow(rows_[0].data(), rows_[1].data(), rows_[2].data(), dst_row, dst_w);
+    }
+
+    return true;
+}
+
+bool YuvScaler::Prepare(const DecodeFrame& frame, int dst_w, int dst_h)
+{
+    if (frame.w == src_w_ && frame.h == src_h_ && frame.format == format_
+        && frame.color_space == color_space_ && frame.color_range == color_range_
+        && dst_w == dst_w_ && dst_h == dst_h_)
+        return true;
+
+    FrameLayout layout;
+    GetFrameLayout(frame.format, frame.w, frame.h, &layout);
+    size_t* offset = layout.offset;
+    int w = frame.w;
+    int cw = layout.chroma_w;
+
+    rgb_ = false;
+    switch (frame.format) {
+    case PIX_FMT_IYUV:
+        planes_[0] = {0, w, 1, 0, 0, 0};
+        planes_[1] = {offset[1], cw, 1, 0, 1, 1};
+        planes_[2] = {offset[2], cw, 1, 0, 1, 1};
+        break;
+    case PIX_FMT_YUVJ422P:
+        planes_[0] = {0, w, 1, 0, 0, 0};
+        planes_[1] = {offset[1], cw, 1, 0, 1, 0};
+        planes_[2] = {offset[2], cw, 1, 0, 1, 0};
+        break;
+    case PIX_FMT_NV12:
+        planes_[0] = {0, w, 1, 0, 0, 0};
+        planes_[1] = {offset[1], cw * 2, 2, 0, 1, 1};
+        planes_[2] = {offset[1], cw * 2, 2, 1, 1, 1};
+        break;
+    case PIX_FMT_P010:
+    case PIX_FMT_P016:
+        // Little endian 16-bit samples, the high byte is enough for display.
+        planes_[0] = {0, w * 2, 2, 1, 0, 0};
+        planes_[1] = {offset[1], cw * 4, 4, 1, 1, 1};
+        planes_[2] = {offset[1], cw * 4, 4, 3, 1, 1};
+        break;
+    case PIX_FMT_RGB:
+        planes_[0] = {0, w * 3, 3, 0, 0, 0};
+        planes_[1] = {0, w * 3, 3, 1, 0, 0};
+        planes_[2] = {0, w * 3, 3, 2, 0, 0};
+        rgb_ = true;
+        break;
+    default:
+        return false;
+    }
+
+    // Sample at the centre of each destination pixel.
+    for (int p = 0; p < 3; ++p) {
+        const Plane& plane = planes_[p];
+        x_offsets_[p].resize(dst_w);
+        for (int dx = 0; dx < dst_w; ++dx) {
+            int sx = static_cast<int>((2LL * dx + 1) * frame.w / (2LL * dst_w));
+            x_offsets_[p][dx] = (sx >> plane.x_shift) * plane.step + plane.sample;
+        }
+        rows_[p].resize(dst_w);
+    }
+
+    y_rows_.resize(dst_h);
+    for (int dy = 0; dy < dst_h; ++dy) {
+        y_rows_[dy] = static_cast<int>((2LL * dy + 1) * frame.h / (2LL * dst_h));
+    }
+
+    coeffs_ = ComputeCoeffs(frame.color_space, frame.color_range);
+
+    src_w_ = frame.w;
+    src_h_ = frame.h;
+    format_ = frame.format;
+    color_space_ = frame.color_space;
+    color_range_ = frame.color_range;
+    dst_w_ = dst_w;
+    dst_h_ = dst_h;
+
+    return true;
+}
+
+YuvScaler::Coeffs YuvScaler::ComputeCoeffs(int color_space, int color_range)
+{
+    double kr = 0.299;
+    double kb = 0.114;
+    if (color_space == kColorSpaceBT709) {
+        kr = 0.2126;
+        kb = 0.0722;
+    } else if (color_space == kColorSpaceBT2020) {
+        kr = 0.2627;
+        kb = 0.0593;
+    }
+    double kg = 1.0 - kr - kb;
+
+    bool full = color_range == kColorRangeFull;
+    double y_scale = full ? 1.0 : 255.0 / 219.0;
+    double c_scale = full ? 1.0 : 255.0 / 224.0;
+    double one = 1 << kCoefBits;
+
+    Coeffs coeffs;
+    coeffs.y_offset = full ? 0 : 16;
+    coeffs.y = static_cast<int>(y_scale * one + 0.5);
+    coeffs.v_r = static_cast<int>(2.0 * (1.0 - kr) * c_scale * one + 0.5);
+    coeffs.u_g = static_cast<int>(2.0 * kb * (1.0 - kb) / kg * c_scale * one + 0.5);
+    coeffs.v_g = static_cast<int>(2.0 * kr * (1.0 - kr) / kg * c_scale * one + 0.5);
+    coeffs.u_b = static_cast<int>(2.0 * (1.0 - kb) * c_scale * one + 0.5);
+    return coeffs;
+}
+
+void YuvScaler::ConvertRow(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst,
+                           int w)
+{
+    if (rgb_) {
+        for (int i = 0; i < w; ++i) {
+            dst[i] = 0xff000000u | (y[i] << 16) | (u[i] << 8) | v[i];
+        }
+        return;
+    }
+
+#ifdef YUV_SCALER_SSE2
+    ConvertRowSSE2(y, u, v, dst, w);
+#else
+    ConvertRowScalar(y, u, v, dst, w);
+#endif
+}
+
+void YuvScaler::ConvertRowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                                 uint32_t* dst, int w) const
+{
+    const int round = 1 << (kCoefBits - 1);
+    for (int i = 0; i < w; ++i) {
+        int ys = (y[i] - coeffs_.y_offset) * coeffs_.y + round;
+        int us = u[i] - 128;
+        int vs = v[i] - 128;
+
+        uint8_t r = Clamp8((ys + coeffs_.v_r * vs) >> kCoefBits);
+        uint8_t g = Clamp8((ys - coeffs_.u_g * us - coeffs_.v_g * vs) >> kCoefBits);
+        uint8_t b = Clamp8((ys + coeffs_.u_b * us) >> kCoefBits);
+
+        dst[i] = 0xff000000u | (r << 16) | (g << 8) | b;
+    }
+}
+
+#ifdef YUV_SCALER_SSE2
+void YuvScaler::ConvertRowSSE2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                               uint32_t* dst, int w) const
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+    const __m128i y_offset = _mm_set1_epi16(static_cast<short>(coeffs_.y_offset));
+    const __m128i c_offset = _mm_set1_epi16(128);
+    const __m128i round = _mm_set1_epi32(1 << (kCoefBits - 1));
+
+    // Coefficients for _mm_madd_epi16 over interleaved sample pairs.
+    const short cy = static_cast<short>(coeffs_.y);
+    const __m128i r_coef = _mm_set_epi16(coeffs_.v_r, cy, coeffs_.v_r, cy, coeffs_.v_r, cy,
+                                         coeffs_.v_r, cy); // (y, v)
+    const __m128i g_coef = _mm_set_epi16(-coeffs_.u_g, cy, -coeffs_.u_g, cy, -coeffs_.u_g, cy,
+                                         -coeffs_.u_g, cy); // (y, u)
+    const __m128i gv_coef = _mm_set_epi16(0, -coeffs_.v_g, 0, -coeffs_.v_g, 0, -coeffs_.v_g, 0,
+                                          -coeffs_.v_g); // (v, 0)
+    const __m128i b_coef = _mm_set_epi16(coeffs_.u_b, cy, coeffs_.u_b, cy, coeffs_.u_b, cy,
+                                         coeffs_.u_b, cy); // (y, u)
+
+    int i = 0;
+    for (; i + 8 <= w; i += 8) {
+        __m128i ys = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i)),
+                                       zero);
+        __m128i us = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + i)),
+                                       zero);
+        __m128i vs = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + i)),
+                                       zero);
+        ys = _mm_sub_epi16(ys, y_offset);
+        us = _mm_sub_epi16(us, c_offset);
+        vs = _mm_sub_epi16(vs, c_offset);
+
+        __m128i yv_lo = _mm_unpacklo_epi16(ys, vs);
+        __m128i yv_hi = _mm_unpackhi_epi16(ys, vs);
+        __m128i yu_lo = _mm_unpacklo_epi16(ys, us);
+        __m128i yu_hi = _mm_unpackhi_epi16(ys, us);
+        __m128i v0_lo = _mm_unpacklo_epi16(vs, zero);
+        __m128i v0_hi = _mm_unpackhi_epi16(vs, zero);
+
+        __m128i r_lo = _mm_madd_epi16(yv_lo, r_coef);
+        __m128i r_hi = _mm_madd_epi16(yv_hi, r_coef);
+        __m128i g_lo =
+            _mm_add_epi32(_mm_madd_epi16(yu_lo, g_coef), _mm_madd_epi16(v0_lo, gv_coef));
+        __m128i g_hi =
+            _mm_add_epi32(_mm_madd_epi16(yu_hi, g_coef), _mm_madd_epi16(v0_hi, gv_coef));
+        __m128i b_lo = _mm_madd_epi16(yu_lo, b_coef);
+        __m128i b_hi = _mm_madd_epi16(yu_hi, b_coef);
+
+        r_lo = _mm_srai_epi32(_mm_add_epi32(r_lo, round), kCoefBits);
+        r_hi = _mm_srai_epi32(_mm_add_epi32(r_hi, round), kCoefBits);
+        g_lo = _mm_srai_epi32(_mm_add_epi32(g_lo, round), kCoefBits);
+        g_hi = _mm_srai_epi32(_mm_add_epi32(g_hi, round), kCoefBits);
+        b_lo = _mm_srai_epi32(_mm_add_epi32(b_lo, round), kCoefBits);
+        b_hi = _mm_srai_epi32(_mm_add_epi32(b_hi, round), kCoefBits);
+
+        // Saturate to bytes, the low 8 bytes hold the 8 pixels.
+        __m128i r = _mm_packus_epi16(_mm_packs_epi32(r_lo, r_hi), zero);
+        __m128i g = _mm_packus_epi16(_mm_packs_epi32(g_lo, g_hi), zero);
+        __m128i b = _mm_packus_epi16(_mm_packs_epi32(b_lo, b_hi), zero);
+
+        // 0xffRRGGBB is B, G, R, A in memory.
+        __m128i bg = _mm_unpacklo_epi8(b, g);
+        __m128i ra = _mm_unpacklo_epi8(r, alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(bg, ra));
+    }
+
+    ConvertRowScalar(y + i, u + i, v + i, dst + i, w - i);
+}
+#endif
@@ -0,0 +1,92 @@
+#ifndef YUV_SCALER_H_
+#define YUV_SCALER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "util/decode_frame.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define YUV_SCALER_SSE2
+#endif
+
+/**
+ * @brief Converts decoded yuv frames to scaled RGB32 images in a single pass.
+ *
+ * Each destination row gathers its samples by nearest neighbour through precomputed offset
+ * tables and is then converted with fixed point coefficients, eight pixels at a time with SSE2
+ * where available. 16-bit formats are reduced to their high byte.
+ */
+class YuvScaler
+{
+public:
+    YuvScaler();
+
+    /**
+     * @brief Scale the frame into 0xffRRGGBB pixels.
+     *
+     * @param dst_stride Bytes per destination row.
+     * @return False if the format is not supported.
+     */
+    bool Scale(const DecodeFrame& frame, uint8_t* dst, int dst_w, int dst_h, int dst_stride);
+
+private:
+    struct Plane
+    {
+        size_t offset; // Offset of the plane in DecodeFrame::buf
+        int stride;    // Bytes per row
+        int step;      // Bytes per sample
+        int sample;    // Byte of the sample that is used
+        int x_shift;   // Subsampling
+        int y_shift;
+    };
+
+    // Multipliers of (Y - y_offset) and (U - 128), (V - 128) in 1 << kCoefBits fixed point.
+    struct Coeffs
+    {
+        int y_offset;
+        int y;
+        int v_r;
+        int u_g;
+        int v_g;
+        int u_b;
+    };
+
+    enum
+    {
+        kCoefBits = 13
+    };
+
+    bool Prepare(const DecodeFrame& frame, int dst_w, int dst_h);
+    static Coeffs ComputeCoeffs(int color_space, int color_range);
+
+    void ConvertRow(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst, int w);
+    void ConvertRowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst,
+                          int w) const;
+#ifdef YUV_SCALER_SSE2
+    void ConvertRowSSE2(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint32_t* dst,
+                        int w) const;
+#endif
+
+private:
+    // Layout of the prepared frame.
+    int src_w_;
+    int src_h_;
+    int format_;
+    int color_space_;
+    int color_range_;
+    int dst_w_;
+    int dst_h_;
+    bool rgb_;
+
+    Plane planes_[3];
+    Coeffs coeffs_;
+
+    // Byte offsets of the sampled pixels in a source row, per destination column.
+    std::vector<int> x_offsets_[3];
+    std::vector<int> y_rows_;
+
+    std::vector<uint8_t> rows_[3];
+};
+
+#endif
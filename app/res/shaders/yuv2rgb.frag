@@ -1,6 +1,8 @@
-#version 330 core
-
-uniform int format = -1;
+// Compiled by ShaderCache, which prepends the version and the variant defines:
+//   SEMI_PLANAR                            - uv interleaved in uv_tex, else u_tex and v_tex
+//   COLOR_BT601, COLOR_BT709, COLOR_BT2020 - color matrix
+//   FULL_RANGE                             - full range samples, else limited range
+//   BIT_DEPTH, SAMPLE_SCALE                - significant bits, scale to normalize samples
 
 uniform sampler2D y_tex;
 uniform sampler2D u_tex;
@@ -8,32 +10,54 @@ uniform sampler2D v_tex;
 
 uniform sampler2D uv_tex;
 
+uniform vec2 tex_clamp = vec2(1.0, 1.0);
+
 in vec2 tex_coords;
 out vec4 frag_color;
 
-const mat4 YUV_TO_RGB_MATRIX =
-    mat4(
-        1.1643835616, 0, 1.7927410714, -0.9729450750,
-        1.1643835616, -0.2132486143, -0.5329093286, 0.3014826655,
-        1.1643835616, 2.1124017857, 0, -1.1334022179,
-        0, 0, 0, 1);
+#if defined(COLOR_BT709)
+const float KR = 0.2126;
+const float KB = 0.0722;
+#elif defined(COLOR_BT2020)
+const float KR = 0.2627;
+const float KB = 0.0593;
+#else
+const float KR = 0.299;
+const float KB = 0.114;
+#endif
+const float KG = 1.0 - KR - KB;
+
+const float MAX_CODE = exp2(float(BIT_DEPTH)) - 1.0;
+const float CODE_SCALE = exp2(float(BIT_DEPTH) - 8.0) / MAX_CODE;
+
+#ifdef FULL_RANGE
+const vec3 YUV_OFFSET = vec3(0.0, 128.0, 128.0) * CODE_SCALE;
+const vec3 YUV_SCALE = vec3(1.0, 1.0, 1.0);
+#else
+const vec3 YUV_OFFSET = vec3(16.0, 128.0, 128.0) * CODE_SCALE;
+const vec3 YUV_SCALE = vec3(1.0 / 219.0, 1.0 / 224.0, 1.0 / 224.0) / CODE_SCALE;
+#endif
+
+const mat3 YUV_TO_RGB_MATRIX =
+    mat3(
+        1.0, 1.0, 1.0,
+        0.0, -2.0 * KB * (1.0 - KB) / KG, 2.0 * (1.0 - KB),
+        2.0 * (1.0 - KR), -2.0 * KR * (1.0 - KR) / KG, 0.0);
 
 void main() 
 {
-    float y = texture2D(y_tex, tex_coords).r;
-
-    float u = 0.0;
-    float v = 0.0;
-
-    if(format == 0 ||
-	   format == 1 ||
-       format == 3 ) {
-        u = texture2D(u_tex, tex_coords).r;
-        v = texture2D(v_tex, tex_coords).r;
-    } else if(format == 2) {
-        u = texture2D(uv_tex, tex_coords).r;
-        v = texture2D(uv_tex, tex_coords).g;
-    }
-
-    frag_color = vec4(y, u, v, 1.0) * YUV_TO_RGB_MATRIX;
+    vec2 coords = min(tex_coords, tex_clamp);
+
+    vec3 yuv;
+    yuv.x = texture(y_tex, coords).r;
+#ifdef SEMI_PLANAR
+    yuv.yz = texture(uv_tex, coords).rg;
+#else
+    yuv.y = texture(u_tex, coords).r;
+    yuv.z = texture(v_tex, coords).r;
+#endif
+
+    yuv = (yuv * SAMPLE_SCALE - YUV_OFFSET) * YUV_SCALE;
+
+    frag_color = vec4(clamp(YUV_TO_RGB_MATRIX * yuv, 0.0, 1.0), 1.0);
 }
@@ -3,11 +3,13 @@ layout (location = 0) in vec4 vertex;
 
 uniform mat4 model_mat;
 uniform mat4 proj_mat;
+// Textures can be larger than the frame, only the content region is sampled.
+uniform vec2 tex_scale = vec2(1.0, 1.0);
 
 out vec2 tex_coords;
 
 void main()
 {
 	gl_Position = proj_mat * model_mat * vec4(vertex.xy, 0.0, 1.0);
-	tex_coords = vec2(vertex.z, vertex.w);
+	tex_coords = vec2(vertex.z, vertex.w) * tex_scale;
 }
\ No newline at end of file
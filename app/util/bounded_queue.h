@@ -0,0 +1,103 @@
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+/**
+ * @brief Blocking FIFO with a fixed capacity, joins the stages of a pipeline.
+ *
+ * A full queue blocks the producer, so a slow stage throttles the ones before it instead of
+ * letting memory grow.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity)
+        , closed_(false)
+    {}
+
+    /**
+     * @brief Wait for space and append the item.
+     *
+     * @return False if the queue is closed, the item is not taken then.
+     */
+    bool Push(const T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_)
+            return false;
+
+        items_.push_back(item);
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Append the item only if there is space, for producers that must not wait.
+     *
+     * @return False if the queue is full or closed, the item is not taken then.
+     */
+    bool TryPush(const T& item)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_ || items_.size() >= capacity_)
+            return false;
+
+        items_.push_back(item);
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Wait for an item, the items left in a closed queue are still returned.
+     *
+     * @return False once the queue is closed and empty.
+     */
+    bool Pop(T* item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty())
+            return false;
+
+        *item = items_.front();
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Refuse new items and wake all waiters.
+     */
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    size_t capacity() const { return capacity_; }
+
+private:
+    size_t capacity_;
+    bool closed_;
+    std::deque<T> items_;
+
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+#endif
@@ -14,6 +14,8 @@ public:
         h = frame.h;
         ts = frame.ts;
         format = frame.format;
+        color_space = frame.color_space;
+        color_range = frame.color_range;
         pict_type_ = frame.pict_type_;
     }
 
@@ -25,6 +27,8 @@ public:
     int h;
     uint64_t ts; // ms
     int format;
+    int color_space; // ColorSpace
+    int color_range; // ColorRange
     int pict_type_;
 };
 
@@ -1,5 +1,7 @@
 #include "decode_frame_buf.h"
 
+#include "trace.h"
+
 #define DEFAUT_FRAME_CACHE_NUM 10
 
 DecodeFrameBuf::DecodeFrameBuf()
@@ -10,32 +12,34 @@ DecodeFrameBuf::~DecodeFrameBuf() {}
 
 bool DecodeFrameBuf::Push(DecodeFrame* frame)
 {
+    TRACE_SCOPE("queue.push");
+
+    // The counters are read by the stats sampler, keep them under the lock with the frames.
+    std::lock_guard<std::mutex> lock_guard(mutex_);
+
     ++frame_state_.push_cnt;
 
     if (frame->IsNull())
         return false;
 
-    {
-        std::lock_guard<std::mutex> lock_guard(mutex_);
-
-        // dropped frame
-        if (frames_.size() >= cache_num_) {
-            DecodeFrame& cache_frame = frames_.front();
-            frames_.pop_front();
-            free(cache_frame.buf.len);
-        }
-
-        if (isNull()) {
-            resize(cache_num_ * frame->buf.len);
-        }
-
-        DecodeFrame cache_frame;
-        cache_frame.buf.base = alloc(frame->buf.len);
-        cache_frame.buf.len = frame->buf.len;
-        cache_frame.Copy(*frame);
-        frames_.emplace_back(cache_frame);
+    // dropped frame
+    if (frames_.size() >= cache_num_) {
+        DecodeFrame& cache_frame = frames_.front();
+        frames_.pop_front();
+        free(cache_frame.buf.len);
+        ++frame_state_.drop_cnt;
     }
 
+    if (isNull()) {
+        resize(cache_num_ * frame->buf.len);
+    }
+
+    DecodeFrame cache_frame;
+    cache_frame.buf.base = alloc(frame->buf.len);
+    cache_frame.buf.len = frame->buf.len;
+    cache_frame.Copy(*frame);
+    frames_.emplace_back(cache_frame);
+
     ++frame_state_.push_ok_cnt;
 
     return true;
@@ -43,23 +47,42 @@ bool DecodeFrameBuf::Push(DecodeFrame* frame)
 
 bool DecodeFrameBuf::Pop(DecodeFrame* frame)
 {
-    --frame_state_.pop_cnt;
-
-    {
-        std::lock_guard<std::mutex> lock_guard(mutex_);
+    TRACE_SCOPE("queue.pop");
 
-        if (frames_.size() == 0) {
-            return false;
-        }
+    std::lock_guard<std::mutex> lock_guard(mutex_);
 
-        DecodeFrame& cache_frame = frames_.front();
-        frames_.pop_front();
-        free(cache_frame.buf.len);
+    ++frame_state_.pop_cnt;
 
-        frame->Copy(cache_frame);
+    if (frames_.size() == 0) {
+        return false;
     }
 
-    --frame_state_.pop_ok_cnt;
+    DecodeFrame& cache_frame = frames_.front();
+    frames_.pop_front();
+    free(cache_frame.buf.len);
+
+    frame->Copy(cache_frame);
+
+    ++frame_state_.pop_ok_cnt;
 
     return true;
 }
+
+void DecodeFrameBuf::Clear()
+{
+    std::lock_guard<std::mutex> lock_guard(mutex_);
+
+    while (!frames_.empty()) {
+        free(frames_.front().buf.len);
+        frames_.pop_front();
+    }
+}
+
+FrameState DecodeFrameBuf::frame_state()
+{
+    std::lock_guard<std::mutex> lock_guard(mutex_);
+
+    FrameState state = frame_state_;
+    state.depth = frames_.size();
+    return state;
+}
@@ -8,10 +8,12 @@
 
 struct FrameState
 {
-    uint32_t push_cnt = 0;
-    uint32_t pop_cnt = 0;
-    uint32_t push_ok_cnt = 0;
-    uint32_t pop_ok_cnt = 0;
+    uint64_t push_cnt = 0;
+    uint64_t pop_cnt = 0;
+    uint64_t push_ok_cnt = 0;
+    uint64_t pop_ok_cnt = 0;
+    uint64_t drop_cnt = 0; // Oldest frames pushed out of a full buffer
+    size_t depth = 0;      // Frames buffered
 };
 
 class DecodeFrameBuf : public HRingBuf
@@ -25,6 +27,16 @@ public:
     bool Push(DecodeFrame* frame);
     bool Pop(DecodeFrame* frame);
 
+    /**
+     * @brief Drop the buffered frames, e.g. after a seek.
+     */
+    void Clear();
+
+    /**
+     * @brief Counters since construction, consistent with each other.
+     */
+    FrameState frame_state();
+
 private:
     std::deque<DecodeFrame> frames_;
     int cache_num_;
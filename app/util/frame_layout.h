@@ -0,0 +1,65 @@
+#ifndef FRAME_LAYOUT_H_
+#define FRAME_LAYOUT_H_
+
+#include <stddef.h>
+
+#include "common/avdef.h"
+
+/**
+ * @brief Planes of a tightly packed yuv DecodeFrame, as av_image_fill_arrays lays them out.
+ *
+ * Chroma rows and columns are rounded up, an odd sized frame has one more of them than half.
+ */
+struct FrameLayout
+{
+    int planes = 0;
+    size_t offset[3] = {}; // Bytes into DecodeFrame::buf
+    int chroma_w = 0;      // Samples per chroma row, U and V interleaved count as one
+    int chroma_h = 0;
+};
+
+inline bool GetFrameLayout(int format, int width, int height, FrameLayout* layout)
+{
+    int half_w = (width + 1) >> 1;
+    int half_h = (height + 1) >> 1;
+    size_t y_size = static_cast<size_t>(width) * height;
+
+    switch (format) {
+    case PIX_FMT_IYUV:
+        layout->planes = 3;
+        layout->chroma_w = half_w;
+        layout->chroma_h = half_h;
+        layout->offset[1] = y_size;
+        layout->offset[2] = y_size + static_cast<size_t>(half_w) * half_h;
+        break;
+    case PIX_FMT_YUVJ422P:
+        layout->planes = 3;
+        layout->chroma_w = half_w;
+        layout->chroma_h = height;
+        layout->offset[1] = y_size;
+        layout->offset[2] = y_size + static_cast<size_t>(half_w) * height;
+        break;
+    case PIX_FMT_NV12:
+        layout->planes = 2;
+        layout->chroma_w = half_w;
+        layout->chroma_h = half_h;
+        layout->offset[1] = y_size;
+        layout->offset[2] = 0;
+        break;
+    case PIX_FMT_P010:
+    case PIX_FMT_P016:
+        layout->planes = 2;
+        layout->chroma_w = half_w;
+        layout->chroma_h = half_h;
+        layout->offset[1] = y_size * 2;
+        layout->offset[2] = 0;
+        break;
+    default:
+        return false;
+    }
+    layout->offset[0] = 0;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef TASK_THREAD_H_
+#define TASK_THREAD_H_
+
+#include <functional>
+
+#include "cthread.h"
+
+/**
+ * @brief Runs a single function on its own thread, for the stages of a pipeline.
+ */
+class TaskThread : public CThread
+{
+public:
+    explicit TaskThread(const std::function<void()>& task)
+        : CThread(nullptr)
+        , task_(task)
+    {}
+
+protected:
+    bool DoPrepare() override { return true; }
+    void DoTask() override { task_(); }
+    void DoFinish() override {}
+
+private:
+    std::function<void()> task_;
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+#include <QCoreApplication>
+
+#ifndef _WIN32
+#include <QSocketNotifier>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "spdlog/spdlog.h"
+
+#define TRACE_RING_EVENTS (1 << 14) // events per thread, a power of two
+#define TRACE_MAX_RETIRED 16        // rings of finished threads kept for the export
+
+// Fields are atomics so the export may read a slot while its thread overwrites it.
+struct TraceEvent
+{
+    std::atomic<const char*> name;
+    std::atomic<int64_t> begin; // ns
+    std::atomic<int64_t> end;   // ns
+};
+
+struct TraceRing
+{
+    explicit TraceRing(int tid)
+        : events(TRACE_RING_EVENTS)
+        , head(0)
+        , tid(tid)
+        , name(nullptr)
+        , retired(false)
+    {}
+
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head; // Events ever written, only its own thread stores
+    int tid;
+    std::atomic<const char*> name;
+    std::atomic<bool> retired;
+};
+
+struct TraceRegistry
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    int next_tid = 1;
+};
+
+static TraceRegistry& Registry()
+{
+    static TraceRegistry registry;
+    return registry;
+}
+
+static const std::chrono::steady_clock::time_point g_trace_epoch = std::chrono::steady_clock::now();
+
+// Retires the ring when its thread ends, the events stay exportable for a while.
+struct TraceRingHolder
+{
+    ~TraceRingHolder()
+    {
+        if (ring) {
+            ring->retired = true;
+        }
+    }
+
+    std::shared_ptr<TraceRing> ring;
+};
+
+static thread_local TraceRingHolder t_ring;
+
+// Kept apart from the ring, which only threads that record while enabled allocate.
+static thread_local const char* t_name = nullptr;
+
+static TraceRing* LocalRing()
+{
+    if (!t_ring.ring) {
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        // Players come and go with their threads, drop the oldest finished ones.
+        int retired = 0;
+        for (auto it = registry.rings.rbegin(); it != registry.rings.rend(); ++it) {
+            retired += (*it)->retired ? 1 : 0;
+        }
+        for (auto it = registry.rings.begin();
+             it != registry.rings.end() && retired > TRACE_MAX_RETIRED;) {
+            if ((*it)->retired) {
+                it = registry.rings.erase(it);
+                --retired;
+            } else {
+                ++it;
+            }
+        }
+
+        t_ring.ring = std::make_shared<TraceRing>(registry.next_tid++);
+        t_ring.ring->name = t_name;
+        registry.rings.push_back(t_ring.ring);
+    }
+
+    return t_ring.ring.get();
+}
+
+std::atomic<bool> Trace::enabled_(false);
+
+void Trace::Enable(bool enable)
+{
+    enabled_ = enable;
+
+    SPDLOG_INFO("Tracing {0}.", enable ? "enabled" : "disabled");
+}
+
+void Trace::SetThreadName(const char* name)
+{
+    t_name = name;
+
+    if (t_ring.ring) {
+        t_ring.ring->name = name;
+    }
+}
+
+int64_t Trace::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                                - g_trace_epoch)
+        .count();
+}
+
+void Trace::Record(const char* name, int64_t begin, int64_t end)
+{
+    TraceRing* ring = LocalRing();
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent& event = ring->events[head & (TRACE_RING_EVENTS - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::Export(const std::string& file)
+{
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    {
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        rings = registry.rings;
+    }
+
+    FILE* fp = fopen(file.c_str(), "w");
+    if (!fp) {
+        SPDLOG_ERROR("Failed to open trace file {0}.", file);
+        return false;
+    }
+
+    qint64 pid = QCoreApplication::applicationPid();
+    size_t count = 0;
+    const char* separator = "";
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (const auto& ring : rings) {
+        const char* thread_name = ring->name.load();
+        if (thread_name) {
+            fprintf(fp,
+                    "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lld,\"tid\":%d,"
+                    "\"args\":{\"name\":\"%s\"}}",
+                    separator, static_cast<long long>(pid), ring->tid, thread_name);
+            separator = ",";
+        }
+
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+
+        std::vector<TraceEvent> events(head - first);
+        for (uint64_t i = first; i < head; ++i) {
+            const TraceEvent& src = ring->events[i & (TRACE_RING_EVENTS - 1)];
+            TraceEvent& dst = events[i - first];
+            dst.name.store(src.name.load(std::memory_order_relaxed));
+            dst.begin.store(src.begin.load(std::memory_order_relaxed));
+            dst.end.store(src.end.load(std::memory_order_relaxed));
+        }
+
+        // The thread kept recording while copying, its oldest slots may be newer events by now.
+        uint64_t overwritten = ring->head.load(std::memory_order_acquire);
+        uint64_t valid = overwritten > TRACE_RING_EVENTS ? overwritten - TRACE_RING_EVENTS : 0;
+        for (uint64_t i = std::max(first, valid); i < head; ++i) {
+            const TraceEvent& event = events[i - first];
+            int64_t begin = event.begin.load();
+            int64_t end = event.end.load();
+            fprintf(fp,
+                    "%s\n{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":%lld,"
+                    "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    separator, event.name.load(), static_cast<long long>(pid), ring->tid,
+                    begin / 1000.0, (end - begin) / 1000.0);
+            separator = ",";
+            ++count;
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    bool ok = ferror(fp) == 0;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok) {
+        SPDLOG_ERROR("Failed to write trace file {0}.", file);
+        return false;
+    }
+
+    SPDLOG_INFO("Exported {0} trace events of {1} threads to {2}.", count, rings.size(), file);
+    return true;
+}
+
+#ifndef _WIN32
+static int g_signal_pipe[2] = {-1, -1};
+
+static void OnExportSignal(int)
+{
+    char byte = 1;
+    ssize_t ret = write(g_signal_pipe[1], &byte, 1);
+    (void)ret;
+}
+#endif
+
+void Trace::ExportOnSignal(const std::string& file)
+{
+#ifndef _WIN32
+    if (g_signal_pipe[0] >= 0)
+        return;
+
+    if (pipe(g_signal_pipe) != 0) {
+        SPDLOG_ERROR("Failed to create the trace signal pipe.");
+        return;
+    }
+    fcntl(g_signal_pipe[1], F_SETFL, O_NONBLOCK);
+
+    auto notifier = new QSocketNotifier(g_signal_pipe[0], QSocketNotifier::Read,
+                                        QCoreApplication::instance());
+    QObject::connect(notifier, &QSocketNotifier::activated, [file] {
+        char byte;
+        if (read(g_signal_pipe[0], &byte, 1) == 1) {
+            Export(file);
+        }
+    });
+
+    struct sigaction action = {};
+    action.sa_handler = OnExportSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, nullptr);
+#else
+    (void)file;
+    SPDLOG_WARN("Trace export on a signal is not supported on this platform.");
+#endif
+}
@@ -0,0 +1,81 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * @brief Time the rest of the enclosing scope as a stage of the pipeline.
+ *
+ * The name must be a string literal, only the pointer is recorded.
+ */
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+/**
+ * @brief Records the stages of the pipeline into one ring buffer per thread, and exports them as
+ * Chrome trace JSON, which chrome://tracing and ui.perfetto.dev open.
+ *
+ * A thread only ever writes its own ring, so recording takes no lock. While disabled a trace point
+ * costs a relaxed load and a branch.
+ */
+class Trace
+{
+public:
+    static void Enable(bool enable);
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Name of the calling thread in the trace, a string literal.
+     *
+     * Costs no allocation, the ring of the thread is created by its first recorded event.
+     */
+    static void SetThreadName(const char* name);
+
+    /**
+     * @brief Write the events still in the rings, the recording goes on.
+     */
+    static bool Export(const std::string& file);
+
+    /**
+     * @brief Export to the file whenever the process gets SIGUSR1, for runs without a menu.
+     *
+     * The export runs on the thread of the application event loop, not in the handler.
+     */
+    static void ExportOnSignal(const std::string& file);
+
+    static int64_t Now(); // ns
+
+    static void Record(const char* name, int64_t begin, int64_t end);
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name)
+        : name_(Trace::enabled() ? name : nullptr)
+        , begin_(name_ ? Trace::Now() : 0)
+    {}
+
+    ~TraceScope()
+    {
+        if (name_) {
+            Trace::Record(name_, begin_, Trace::Now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    int64_t begin_;
+};
+
+#endif
@@ -10,6 +10,8 @@
 #include "dialog/media/open_media_dialog.h"
 #include "media_play/ffmpeg/ff_videoplayer.h"
 
+#define SEEK_STEP 10000 // ms
+
 VideoDisplayWidget::VideoDisplayWidget(QWidget* parent)
     : QWidget(parent)
 {
@@ -20,7 +22,10 @@ VideoDisplayWidget::VideoDisplayWidget(QWidget* parent)
     file_edit_->set_select_file_handle(std::bind(&VideoDisplayWidget::SelectMediaClicked, this));
 
     video_widget_ = new VideoWidget(this);
-    connect(video_widget_, &VideoWidget::StreamClosed, this, [this] { PlayStateChanged(false); });
+    connect(video_widget_, &VideoWidget::StreamClosed, this, [this] {
+        PlayStateChanged(false);
+        emit PlaybackFinished();
+    });
 
     auto fill_bg_wiget = new QWidget(this);
 
@@ -33,6 +38,16 @@ VideoDisplayWidget::VideoDisplayWidget(QWidget* parent)
     auto stop_btn = new QPushButton(tr("Stop"), this);
     stop_btn->setFixedHeight(32);
 
+    auto backward_btn = new QPushButton(tr("-10s"), this);
+    backward_btn->setFixedHeight(32);
+
+    auto forward_btn = new QPushButton(tr("+10s"), this);
+    forward_btn->setFixedHeight(32);
+
+    auto step_btn = new QPushButton(tr("Step"), this);
+    step_btn->setFixedHeight(32);
+    step_btn->setToolTip(tr("Show the next frame while paused"));
+
     play_stop_widget_ = new QStackedWidget(this);
     play_stop_widget_->addWidget(play_btn_);
     play_stop_widget_->addWidget(pause_btn_);
@@ -42,6 +57,9 @@ VideoDisplayWidget::VideoDisplayWidget(QWidget* parent)
     connect(play_btn_, &QPushButton::clicked, this, &VideoDisplayWidget::PlayClicked);
     connect(pause_btn_, &QPushButton::clicked, this, &VideoDisplayWidget::PauseClicked);
     connect(stop_btn, &QPushButton::clicked, this, &VideoDisplayWidget::StopClicked);
+    connect(backward_btn, &QPushButton::clicked, this, &VideoDisplayWidget::BackwardClicked);
+    connect(forward_btn, &QPushButton::clicked, this, &VideoDisplayWidget::ForwardClicked);
+    connect(step_btn, &QPushButton::clicked, this, &VideoDisplayWidget::StepClicked);
 
     auto software_dc = new QRadioButton(tr("Soft Decoding"), this);
     auto hardware_dc = new QRadioButton(tr("Hard Decoding"), this);
@@ -57,12 +75,26 @@ VideoDisplayWidget::VideoDisplayWidget(QWidget* parent)
     connect(dc_btn_group, qOverload<int>(&QButtonGroup::buttonClicked), this,
             &VideoDisplayWidget::DecodeBtnClicked);
 
+    rate_box_ = new QComboBox(this);
+    rate_box_->setFixedHeight(32);
+    for (double rate : {0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.0, 32.0}) {
+        rate_box_->addItem(QString("%1x").arg(rate), rate);
+    }
+    int rate_index = rate_box_->findData(video_widget_->rate());
+    rate_box_->setCurrentIndex(rate_index >= 0 ? rate_index : rate_box_->findData(1.0));
+    connect(rate_box_, qOverload<int>(&QComboBox::currentIndexChanged), this,
+            &VideoDisplayWidget::RateChanged);
+
     auto btn_layout = new QHBoxLayout;
     btn_layout->addWidget(file_edit_);
     btn_layout->addStretch(9);
     btn_layout->addWidget(software_dc);
     btn_layout->addWidget(hardware_dc);
+    btn_layout->addWidget(rate_box_);
+    btn_layout->addWidget(backward_btn);
     btn_layout->addWidget(play_stop_widget_);
+    btn_layout->addWidget(forward_btn);
+    btn_layout->addWidget(step_btn);
     btn_layout->addWidget(stop_btn);
 
     auto main_layout = new QVBoxLayout(this);
@@ -73,6 +105,15 @@ VideoDisplayWidget::VideoDisplayWidget(QWidget* parent)
 
 VideoDisplayWidget::~VideoDisplayWidget() {}
 
+void VideoDisplayWidget::Play(const MediaInfo& media)
+{
+    media_ = media;
+    file_edit_->setText(QString::fromStdString(media_.src));
+    file_edit_->setToolTip(QString::fromStdString(media_.src));
+
+    PlayClicked();
+}
+
 void VideoDisplayWidget::PlayClicked()
 {
     QString url(media_.src.c_str());
@@ -98,11 +139,31 @@ void VideoDisplayWidget::StopClicked()
     PlayStateChanged(false);
 }
 
+void VideoDisplayWidget::BackwardClicked()
+{
+    video_widget_->SeekBy(-SEEK_STEP);
+}
+
+void VideoDisplayWidget::ForwardClicked()
+{
+    video_widget_->SeekBy(SEEK_STEP);
+}
+
+void VideoDisplayWidget::StepClicked()
+{
+    video_widget_->Step();
+}
+
 void VideoDisplayWidget::DecodeBtnClicked(int id)
 {
     Singleton<Config>::Instance()->SetAppConfigData("video_param", "enable_hw_decode", (bool)id);
 }
 
+void VideoDisplayWidget::RateChanged(int index)
+{
+    video_widget_->SetRate(rate_box_->itemData(index).toDouble());
+}
+
 void VideoDisplayWidget::PlayStateChanged(bool playing)
 {
     play_stop_widget_->setCurrentWidget(playing ? pause_btn_ : play_btn_);
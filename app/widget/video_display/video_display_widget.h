@@ -1,6 +1,7 @@
 #ifndef VIDEO_DISPLAY_WIDGET_H_
 #define VIDEO_DISPLAY_WIDGET_H_
 
+#include <QComboBox>
 #include <QLabel>
 #include <QLineEdit>
 #include <QPushButton>
@@ -18,12 +19,21 @@ public:
     explicit VideoDisplayWidget(QWidget* parent = nullptr);
     ~VideoDisplayWidget();
 
+    void Play(const MediaInfo& media);
+
+signals:
+    void PlaybackFinished();
+
 private slots:
     void SelectMediaClicked();
     void PlayClicked();
     void PauseClicked();
     void StopClicked();
+    void BackwardClicked();
+    void ForwardClicked();
+    void StepClicked();
     void DecodeBtnClicked(int id);
+    void RateChanged(int index);
 
     void PlayStateChanged(bool playing);
 
@@ -34,6 +44,7 @@ private:
     QPushButton* play_btn_;
     QPushButton* pause_btn_;
     QStackedWidget* play_stop_widget_;
+    QComboBox* rate_box_;
 
     MediaInfo media_;
 };
@@ -11,8 +11,12 @@ VideoMenu::VideoMenu(QWidget* parent)
     start_recording_ = menu_->addAction(tr("Start Recording"), this, &VideoMenu::StartRecording);
     stop_recording_ = menu_->addAction(tr("Stop Recording"), this, &VideoMenu::StopRecording);
 
+    show_stats_ = menu_->addAction(tr("Show Statistics"), this, &VideoMenu::ShowStats);
+    hide_stats_ = menu_->addAction(tr("Hide Statistics"), this, &VideoMenu::HideStats);
+
     SetFullscreenState(false);
     SetRecordState(false);
+    SetStatsState(false);
 }
 
 VideoMenu::~VideoMenu() {}
@@ -33,3 +37,9 @@ void VideoMenu::SetRecordState(bool start)
     start_recording_->setVisible(!start);
     stop_recording_->setVisible(start);
 }
+
+void VideoMenu::SetStatsState(bool shown)
+{
+    show_stats_->setVisible(!shown);
+    hide_stats_->setVisible(shown);
+}
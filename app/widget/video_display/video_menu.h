@@ -14,12 +14,15 @@ public:
 
     void SetFullscreenState(bool fullscreen);
     void SetRecordState(bool start);
+    void SetStatsState(bool shown);
 
 signals:
     void FullScreen();
     void ExitFullScreen();
     void StopRecording();
     void StartRecording();
+    void ShowStats();
+    void HideStats();
 
 private:
     QMenu* menu_;
@@ -28,6 +31,8 @@ private:
     QAction* exit_fullscreen_;
     QAction* start_recording_;
     QAction* stop_recording_;
+    QAction* show_stats_;
+    QAction* hide_stats_;
 };
 
 #endif
@@ -1,18 +1,27 @@
 #include "video_widget.h"
 
+#include <algorithm>
+#include <cmath>
 #include <functional>
 
 #include "common/singleton.h"
 #include "config/config.h"
 #include "media_play/video_player_factory.h"
 #include "render/render_factory.h"
+#include "spdlog/spdlog.h"
 #include "widget/common/fast_layout.h"
 
+#define STATS_OVERLAY_MARGIN 8 // px
+#define RENDER_MAX_FPS 60 // Presentation cap at fast rates, the player drops the rest
+
 VideoWidget::VideoWidget(QWidget* parent)
     : QWidget(parent)
     , video_player_(nullptr)
     , play_state_(kStop)
+    , player_generation_(0)
+    , rate_(1.0)
     , fps_(0)
+    , stats_player_(0)
     , recording_(false)
 {
     qRegisterMetaType<StreamEventType>("StreamEventType");
@@ -37,7 +46,18 @@ void VideoWidget::Open(const MediaInfo& media)
         video_player_->set_event_cb(
             std::bind(&VideoWidget::StreamEventCallback, this, std::placeholders::_1));
 
+        // Acks of a stopped player may still be queued, they must not apply to this one.
+        int generation = ++player_generation_;
+        video_player_->set_ack_cb([this, generation](const PlayerCommand& command, bool ok) {
+            QMetaObject::invokeMethod(this, "OnCommandAck", Qt::QueuedConnection,
+                                      Q_ARG(int, generation), Q_ARG(int, command.type),
+                                      Q_ARG(bool, ok));
+        });
+
         video_player_->Start();
+        if (rate_ != 1.0) {
+            video_player_->SetRate(rate_);
+        }
     } else {
         Resume();
     }
@@ -48,18 +68,18 @@ void VideoWidget::Pause()
     if (!video_player_ || play_state_ != kRunning)
         return;
 
-    play_state_ = kPause;
-    render_timer_->stop();
-
+    // Rendering stops with the ack, the frames of the last interval are still shown.
     video_player_->Pause();
 }
 
 void VideoWidget::Stop()
 {
-    if (!video_player_ || play_state_ == kStop)
+    // The player may still be opening, it has to be joined anyway.
+    if (!video_player_)
         return;
 
-    render_timer_->stop();
+    StopRender();
+    StopStats();
 
     StopRecording();
 
@@ -72,6 +92,7 @@ void VideoWidget::Stop()
 void VideoWidget::resizeEvent(QResizeEvent* event)
 {
     render_wnd_->setGeometry(rect());
+    stats_label_->move(STATS_OVERLAY_MARGIN, STATS_OVERLAY_MARGIN);
 }
 
 void VideoWidget::contextMenuEvent(QContextMenuEvent* event)
@@ -88,11 +109,28 @@ void VideoWidget::InitUi()
     connect(menu_, &VideoMenu::ExitFullScreen, this, &VideoWidget::ExitFullScreen);
     connect(menu_, &VideoMenu::StartRecording, this, &VideoWidget::StartRecording);
     connect(menu_, &VideoMenu::StopRecording, this, &VideoWidget::StopRecording);
+    connect(menu_, &VideoMenu::ShowStats, this, &VideoWidget::ShowStats);
+    connect(menu_, &VideoMenu::HideStats, this, &VideoWidget::HideStats);
 
     int type = Singleton<Config>::Instance()->AppConfigData("video_param", "render_type").toInt();
     render_wnd_ = RenderFactory::Create(static_cast<RenderType>(type), this);
 
     fps_ = Singleton<Config>::Instance()->AppConfigData("video_param", "fps").toInt();
+    rate_ = Singleton<Config>::Instance()->AppConfigData("video_param", "rate", 1.0).toDouble();
+
+    // Drawn over the render window, which is a child widget of its own.
+    stats_label_ = new QLabel(this);
+    stats_label_->setStyleSheet(
+        "QLabel { color: white; background-color: rgba(0, 0, 0, 160); padding: 4px; }");
+    stats_label_->setAttribute(Qt::WA_TransparentForMouseEvents);
+    stats_label_->move(STATS_OVERLAY_MARGIN, STATS_OVERLAY_MARGIN);
+    stats_label_->hide();
+
+    bool overlay =
+        Singleton<Config>::Instance()->AppConfigData("stats", "overlay", false).toBool();
+    if (overlay) {
+        ShowStats();
+    }
 
     render_timer_ = new QTimer(this);
     render_timer_->setTimerType(Qt::PreciseTimer);
@@ -107,10 +145,93 @@ void VideoWidget::Resume()
     if (!video_player_)
         return;
 
-    render_timer_->start(1000 / (fps_ ? fps_ : video_player_->fps()));
     video_player_->Resume();
+}
+
+void VideoWidget::Seek(int64_t position)
+{
+    if (video_player_) {
+        video_player_->Seek(position);
+    }
+}
+
+void VideoWidget::SeekBy(int64_t offset)
+{
+    if (video_player_) {
+        video_player_->Seek(std::max<int64_t>(0, video_player_->position() + offset));
+    }
+}
+
+void VideoWidget::Step()
+{
+    if (video_player_ && play_state_ == kPause) {
+        video_player_->Step();
+    }
+}
+
+void VideoWidget::SetRate(double rate)
+{
+    rate_ = rate;
+
+    if (video_player_) {
+        video_player_->SetRate(rate);
+    }
+}
+
+void VideoWidget::StartRender()
+{
+    int fps = fps_ ? fps_ : video_player_->fps();
+    int max_fps = std::max(fps, RENDER_MAX_FPS);
+    fps = std::max(1, static_cast<int>(std::lround(fps * video_player_->rate())));
+    fps = std::min(fps, max_fps);
+
+    // Paused time is not an A/V offset.
+    video_player_->ResetClock();
+
+    // Windows pacing by pts restart their clock at the rate.
+    render_wnd_->SetRate(video_player_->rate());
+
+    // Prefer the render window pacing itself off the GUI thread, the timer is the fallback.
+    VideoPlayer* player = video_player_;
+    bool self_paced = render_wnd_->StartPresent(
+        [player](DecodeFrame* frame) { return player->pop_frame(frame); }, fps);
+    if (!self_paced) {
+        render_timer_->start(1000 / fps);
+    }
+}
+
+void VideoWidget::StopRender()
+{
+    render_timer_->stop();
+    render_wnd_->StopPresent();
+}
+
+void VideoWidget::StartStats()
+{
+    if (stats_player_ || !video_player_)
+        return;
 
-    play_state_ = kRunning;
+    VideoPlayer* player = video_player_;
+    RenderWnd* render_wnd = render_wnd_;
+    auto sampler = Singleton<PlaybackStatsSampler>::Instance();
+    stats_player_ = sampler->Register(QString::fromStdString(player->media().src),
+                                      [player, render_wnd] {
+                                          PlaybackTotals totals = player->totals();
+                                          totals.has_upload = render_wnd->UploadTotals(
+                                              &totals.uploaded, &totals.upload_us);
+                                          return totals;
+                                      });
+    connect(sampler.get(), &PlaybackStatsSampler::Sampled, this, &VideoWidget::OnStatsSampled,
+            Qt::UniqueConnection);
+}
+
+void VideoWidget::StopStats()
+{
+    if (!stats_player_)
+        return;
+
+    Singleton<PlaybackStatsSampler>::Instance()->Unregister(stats_player_);
+    stats_player_ = 0;
 }
 
 void VideoWidget::StreamEventCallback(StreamEventType type)
@@ -144,9 +265,8 @@ void VideoWidget::OnEventProcess(StreamEventType type)
 
 void VideoWidget::OnOpenStreamSuccess()
 {
-    play_state_ = kRunning;
-
-    render_timer_->start(1000 / (fps_ ? fps_ : video_player_->fps()));
+    // Rendering starts with the ack of the play command that follows the open.
+    StartStats();
 }
 
 void VideoWidget::OnOpenStreamFail()
@@ -174,6 +294,44 @@ void VideoWidget::OnStreamError()
     QMessageBox::warning(this, tr("Warning"), tr("An error occurred during playback."));
 }
 
+void VideoWidget::OnCommandAck(int generation, int type, bool ok)
+{
+    if (generation != player_generation_ || !video_player_)
+        return;
+
+    if (!ok) {
+        SPDLOG_WARN("Player command {0} was not applied.", type);
+        return;
+    }
+
+    switch (type) {
+    case kCmdPlay:
+        play_state_ = kRunning;
+        StartRender();
+        break;
+    case kCmdPause:
+        play_state_ = kPause;
+        StopRender();
+        break;
+    case kCmdSeek:
+    case kCmdStep:
+        // Show the frame the player stopped at, the render is not pulling while paused.
+        if (play_state_ == kPause) {
+            OnRender();
+        }
+        break;
+    case kCmdSetRate:
+        // Present at the new rate, the player produces at it already.
+        if (play_state_ == kRunning) {
+            StopRender();
+            StartRender();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
 void VideoWidget::OnRender()
 {
     DecodeFrame frame;
@@ -233,3 +391,41 @@ void VideoWidget::StopRecording()
     recording_ = false;
     menu_->SetRecordState(recording_);
 }
+
+void VideoWidget::ShowStats()
+{
+    stats_label_->setText(tr("Waiting for statistics"));
+    stats_label_->adjustSize();
+    stats_label_->show();
+    stats_label_->raise();
+
+    menu_->SetStatsState(true);
+}
+
+void VideoWidget::HideStats()
+{
+    stats_label_->hide();
+
+    menu_->SetStatsState(false);
+}
+
+void VideoWidget::OnStatsSampled(const PlaybackStats& stats)
+{
+    if (stats.player != stats_player_ || !stats_label_->isVisible())
+        return;
+
+    QString upload =
+        stats.upload_ms < 0.0 ? QString("-") : QString::number(stats.upload_ms, 'f', 2);
+    stats_label_->setText(tr("Input: %1 kbps\nDecoded: %2 fps\nPresented: %3 fps\n"
+                             "Dropped: %4 fps\nQueue: %5\nDecode: %6 ms\nUpload: %7 ms\n"
+                             "A/V offset: %8 ms")
+                              .arg(stats.input_kbps, 0, 'f', 0)
+                              .arg(stats.decoded_fps, 0, 'f', 1)
+                              .arg(stats.presented_fps, 0, 'f', 1)
+                              .arg(stats.dropped_fps, 0, 'f', 1)
+                              .arg(stats.queue_depth)
+                              .arg(stats.decode_ms, 0, 'f', 2)
+                              .arg(upload)
+                              .arg(stats.av_offset_ms, 0, 'f', 0));
+    stats_label_->adjustSize();
+}
@@ -5,6 +5,7 @@
 
 #include "video_menu.h"
 #include "media_play/ffmpeg/ff_videoplayer.h"
+#include "media_play/playback_stats.h"
 #include "media_play/stream_event_type.h"
 #include "render/opengl/render_wnd_gl.h"
 
@@ -19,6 +20,27 @@ public:
     void Pause();
     void Stop();
 
+    /**
+     * @param position ms, in the time of the frame timestamps
+     */
+    void Seek(int64_t position);
+
+    /**
+     * @param offset ms from the frame on screen, negative to go back
+     */
+    void SeekBy(int64_t offset);
+
+    /**
+     * @brief Show the next frame, while paused.
+     */
+    void Step();
+
+    /**
+     * @brief Kept for the players opened later, 0.25 to 32.
+     */
+    void SetRate(double rate);
+    double rate() const { return rate_; }
+
 signals:
     void StreamClosed();
 
@@ -36,6 +58,10 @@ private:
 
     void InitUi();
     void Resume();
+    void StartRender();
+    void StopRender();
+    void StartStats();
+    void StopStats();
 
     // event cb
     void StreamEventCallback(StreamEventType type);
@@ -47,11 +73,15 @@ private:
 
 private slots:
     void OnEventProcess(StreamEventType type);
+    void OnCommandAck(int generation, int type, bool ok);
     void OnRender();
     void FullScreen();
     void ExitFullScreen();
     void StartRecording();
     void StopRecording();
+    void ShowStats();
+    void HideStats();
+    void OnStatsSampled(const PlaybackStats& stats);
 
 private:
     VideoMenu* menu_;
@@ -59,12 +89,18 @@ private:
     // decode
     VideoPlayer* video_player_;
     PlayState play_state_;
+    int player_generation_;
+    double rate_;
 
     // render
     QTimer* render_timer_;
     RenderWnd* render_wnd_;
     int fps_;
 
+    // stats
+    int stats_player_; // Id in the sampler, 0 if not registered
+    QLabel* stats_label_;
+
     // encoder
     bool recording_;
     std::unique_ptr<FFmpegWriter> writer_;
@@ -1,34 +1,61 @@
 #include "mainmenu.h"
 
+#include <QDir>
+#include <QFileDialog>
+
 #include "dialog/media/codec_audio_dialog.h"
 #include "dialog/media/codec_video_dialog.h"
 #include "dialog/media/export_stream_dialog.h"
+#include "util/trace.h"
 
-MainMenu::MainMenu(QWidget* parent)
+MainMenu::MainMenu(JobExecutor* executor, QWidget* parent)
     : QMenuBar(parent)
+    , executor_(executor)
 {
     auto tool_menu = addMenu(tr("Tools"));
     tool_menu->addAction(tr("Codec Audio"), this, &MainMenu::CodecAudio);
     tool_menu->addAction(tr("Codec Video"), this, &MainMenu::CodecVideo);
     tool_menu->addAction(tr("Export Stream"), this, &MainMenu::ExportStream);
+    tool_menu->addSeparator();
+
+    auto trace = tool_menu->addAction(tr("Trace Pipeline"), this, &MainMenu::ToggleTrace);
+    trace->setCheckable(true);
+    trace->setChecked(Trace::enabled());
+    tool_menu->addAction(tr("Export Trace"), this, &MainMenu::ExportTrace);
 }
 
 MainMenu::~MainMenu() {}
 
 void MainMenu::CodecAudio()
 {
-    CodecAudioDialog dlg(this);
+    CodecAudioDialog dlg(executor_, this);
     dlg.exec();
 }
 
 void MainMenu::CodecVideo()
 {
-    CodecVideoDialog dlg(this);
+    CodecVideoDialog dlg(executor_, this);
     dlg.exec();
 }
 
 void MainMenu::ExportStream()
 {
-    ExportStreamDialog dlg(this);
+    ExportStreamDialog dlg(executor_, this);
     dlg.exec();
 }
+
+void MainMenu::ToggleTrace(bool enable)
+{
+    Trace::Enable(enable);
+}
+
+void MainMenu::ExportTrace()
+{
+    QString file = QFileDialog::getSaveFileName(this, tr("Export Trace"),
+                                                QDir::homePath() + "/spark-player.trace.json",
+                                                tr("Chrome Trace (*.json)"));
+    if (file.isEmpty())
+        return;
+
+    Trace::Export(file.toStdString());
+}
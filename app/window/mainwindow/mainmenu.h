@@ -3,17 +3,24 @@
 
 #include <QMenuBar>
 
+class JobExecutor;
+
 class MainMenu : public QMenuBar
 {
     Q_OBJECT
 public:
-    explicit MainMenu(QWidget* parent = nullptr);
+    explicit MainMenu(JobExecutor* executor, QWidget* parent = nullptr);
     ~MainMenu();
 
 private slots:
     void CodecAudio();
     void CodecVideo();
     void ExportStream();
+    void ToggleTrace(bool enable);
+    void ExportTrace();
+
+private:
+    JobExecutor* executor_;
 };
 
 #endif
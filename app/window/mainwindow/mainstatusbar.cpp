@@ -2,8 +2,87 @@
 
 MainStatusBar::MainStatusBar(QWidget* parent)
     : QStatusBar(parent)
+    , playback_label_(new QLabel(this))
+    , cancel_btn_(new QToolButton(this))
+    , cancel_menu_(new QMenu(this))
 {
     showMessage("Development phase");
+
+    addPermanentWidget(playback_label_);
+
+    connect(cancel_menu_, &QMenu::aboutToShow, this, &MainStatusBar::UpdateCancelMenu);
+    cancel_btn_->setText(tr("Cancel Job"));
+    cancel_btn_->setPopupMode(QToolButton::InstantPopup);
+    cancel_btn_->setMenu(cancel_menu_);
+    cancel_btn_->hide();
+    addPermanentWidget(cancel_btn_);
 }
 
 MainStatusBar::~MainStatusBar() {}
+
+void MainStatusBar::ShowJobQueued(int id, const QString& name)
+{
+    jobs_[id].name = name;
+    cancel_btn_->show();
+}
+
+void MainStatusBar::ShowJobStarted(int id, const QString& name)
+{
+    JobEntry& job = jobs_[id];
+    job.name = name;
+    job.running = true;
+    cancel_btn_->show();
+
+    showMessage(tr("%1: started").arg(name));
+}
+
+void MainStatusBar::ShowJobProgress(int id, const QString& name, double progress, double fps,
+                                    double mbps)
+{
+    Q_UNUSED(id)
+
+    showMessage(tr("%1: %2%, %3 fps, %4 MB/s")
+                    .arg(name)
+                    .arg(progress * 100, 0, 'f', 1)
+                    .arg(fps, 0, 'f', 1)
+                    .arg(mbps, 0, 'f', 2));
+}
+
+void MainStatusBar::ShowJobFinished(int id, const QString& name, bool ok, bool cancelled,
+                                    double seconds, double fps, double mbps)
+{
+    jobs_.erase(id);
+    cancel_btn_->setVisible(!jobs_.empty());
+
+    if (cancelled) {
+        showMessage(tr("%1: cancelled").arg(name));
+    } else if (!ok) {
+        showMessage(tr("%1: failed").arg(name));
+    } else {
+        showMessage(tr("%1: done in %2s, %3 fps, %4 MB/s")
+                        .arg(name)
+                        .arg(seconds, 0, 'f', 1)
+                        .arg(fps, 0, 'f', 1)
+                        .arg(mbps, 0, 'f', 2));
+    }
+}
+
+void MainStatusBar::UpdateCancelMenu()
+{
+    cancel_menu_->clear();
+
+    for (const auto& it : jobs_) {
+        int id = it.first;
+        QString text = it.second.running ? it.second.name : tr("%1 (queued)").arg(it.second.name);
+        cancel_menu_->addAction(text, this, [this, id] { emit CancelJob(id); });
+    }
+
+    cancel_menu_->addSeparator();
+    cancel_menu_->addAction(tr("Cancel All"), this, &MainStatusBar::CancelAllJobs);
+}
+
+void MainStatusBar::ShowPlaybackStats(const PlaybackStats& stats)
+{
+    playback_label_->setText(stats.ToText());
+    playback_label_->setToolTip(stats.src);
+}
@@ -1,7 +1,13 @@
 #ifndef MAINSTATUSBAR_H_
 #define MAINSTATUSBAR_H_
 
+#include <QLabel>
+#include <QMenu>
 #include <QStatusBar>
+#include <QToolButton>
+#include <map>
+
+#include "media_play/playback_stats.h"
 
 class MainStatusBar : public QStatusBar
 {
@@ -9,6 +15,36 @@ class MainStatusBar : public QStatusBar
 public:
     explicit MainStatusBar(QWidget* parent = nullptr);
     ~MainStatusBar();
+
+signals:
+    void CancelJob(int id);
+    void CancelAllJobs();
+
+public slots:
+    void ShowJobQueued(int id, const QString& name);
+    void ShowJobStarted(int id, const QString& name);
+    void ShowJobProgress(int id, const QString& name, double progress, double fps, double mbps);
+    void ShowJobFinished(int id, const QString& name, bool ok, bool cancelled, double seconds,
+                         double fps, double mbps);
+    void ShowPlaybackStats(const PlaybackStats& stats);
+
+private slots:
+    void UpdateCancelMenu();
+
+private:
+    // Kept beside the job messages, which are temporary.
+    QLabel* playback_label_;
+
+    struct JobEntry
+    {
+        QString name;
+        bool running = false;
+    };
+
+    // Lists the queued and running jobs, shown while there are any.
+    QToolButton* cancel_btn_;
+    QMenu* cancel_menu_;
+    std::map<int, JobEntry> jobs_;
 };
 
 #endif
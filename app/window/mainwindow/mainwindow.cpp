@@ -2,6 +2,9 @@
 
 #include <QMenuBar>
 
+#include "common/singleton.h"
+#include "job/job_executor.h"
+#include "media_play/playback_stats.h"
 #include "mainmenu.h"
 #include "mainstatusbar.h"
 #include "widget/video_display/video_display_widget.h"
@@ -9,14 +12,32 @@
 MainWindow::MainWindow(QWidget* parent, Qt::WindowFlags flags)
     : QMainWindow(parent, flags)
 {
-    auto main_menu = new MainMenu(this);
+    auto executor = new JobExecutor(0, this);
+
+    auto main_menu = new MainMenu(executor, this);
     setMenuBar(main_menu);
 
     auto status_bar = new MainStatusBar(this);
     setStatusBar(status_bar);
 
-    auto w = new VideoDisplayWidget(this);
-    setCentralWidget(w);
+    connect(executor, &JobExecutor::JobQueued, status_bar, &MainStatusBar::ShowJobQueued);
+    connect(executor, &JobExecutor::JobStarted, status_bar, &MainStatusBar::ShowJobStarted);
+    connect(executor, &JobExecutor::JobProgress, status_bar, &MainStatusBar::ShowJobProgress);
+    connect(executor, &JobExecutor::JobFinished, status_bar, &MainStatusBar::ShowJobFinished);
+    connect(Singleton<PlaybackStatsSampler>::Instance().get(), &PlaybackStatsSampler::Sampled,
+            status_bar, &MainStatusBar::ShowPlaybackStats);
+    connect(status_bar, &MainStatusBar::CancelJob, executor, &JobExecutor::Cancel);
+    connect(status_bar, &MainStatusBar::CancelAllJobs, executor, &JobExecutor::CancelAll);
+
+    display_widget_ = new VideoDisplayWidget(this);
+    connect(display_widget_, &VideoDisplayWidget::PlaybackFinished, this,
+            &MainWindow::PlaybackFinished);
+    setCentralWidget(display_widget_);
 }
 
 MainWindow::~MainWindow() {}
+
+void MainWindow::Play(const MediaInfo& media)
+{
+    display_widget_->Play(media);
+}
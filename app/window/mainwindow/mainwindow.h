@@ -3,12 +3,24 @@
 
 #include <QMainWindow>
 
+#include "common/media_info.h"
+
+class VideoDisplayWidget;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 public:
     explicit MainWindow(QWidget* parent = nullptr, Qt::WindowFlags flags = Qt::WindowFlags());
     ~MainWindow();
+
+    void Play(const MediaInfo& media);
+
+signals:
+    void PlaybackFinished();
+
+private:
+    VideoDisplayWidget* display_widget_;
 };
 
 #endif